@@ -0,0 +1,26 @@
+#!/bin/sh
+#
+# Scan benchmarks against gqrx-sim, sweep and bookmark mode on fixed seeds.
+# Usage: bench/run.sh [seconds]   (build first, the binaries are taken from $BIN)
+#
+BIN=${BIN:-bin}
+SECS=${1:-60}
+PORT=${PORT:-7399}
+DIR=$(dirname "$0")
+
+run ()
+{
+    name=$1; scenario=$2; shift 2
+    echo "== $name"
+    "$BIN/gqrx-sim" -p "$PORT" -d "$SECS" "$scenario" | grep -v '^Listening' &
+    sim=$!
+    sleep 0.5
+    "$BIN/gqrx-scanner" --headless -p "$PORT" "$@" > /dev/null &
+    scan=$!
+    wait $sim
+    kill $scan 2> /dev/null
+    wait $scan 2> /dev/null
+}
+
+run sweep    "$DIR/sweep.sim"    -m sweep -b 144900000 -e 145100000
+run bookmark "$DIR/bookmark.sim" -m bookmark -k "$DIR/bookmarks.csv" -b 144900000 -e 145900000
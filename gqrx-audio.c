@@ -0,0 +1,285 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // pipe2
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gqrx-audio.h"
+#include "gqrx-clock.h"
+#include "gqrx-metrics.h"
+#include "gqrx-capture.h"
+
+#define AUDIO_LANES     8       // independent accumulators of the feature kernel
+#define AUDIO_DATAGRAM  65536
+
+static int          audio_fd = -1;
+static int          stop_pipe[2] = { -1, -1 };
+static pthread_t    audio_thread;
+static bool         running = false;
+static AUDIO_NOTIFY notify = NULL;
+static atomic_int   state;          // AUDIO_STATE
+static atomic_int   energy_cdb;     // energy of the last window, in 1/100 dB
+static TONE_DECODER tone_decoder;
+static pthread_mutex_t tone_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+//
+// AudioFeatures
+// Energy in dBFS and zero crossing rate of a window. The sums are split in
+// lanes without dependencies between them, so the compiler can turn the
+// inner loops into vector instructions.
+//
+void AudioFeatures (const int16_t *samples, int n, double *energy, double *zcr)
+{
+    float power[AUDIO_LANES] = { 0 };
+    int   cross[AUDIO_LANES] = { 0 };
+    float total = 0;
+    int   crossings = 0;
+    int   i, l;
+
+    for (i = 0; i + AUDIO_LANES <= n; i += AUDIO_LANES)
+        for (l = 0; l < AUDIO_LANES; l++)
+            power[l] += (float)samples[i + l] * samples[i + l];
+    for (; i < n; i++)
+        power[0] += (float)samples[i] * samples[i];
+
+    // the sign bit of the xor is set where consecutive samples change sign
+    for (i = 1; i + AUDIO_LANES <= n; i += AUDIO_LANES)
+        for (l = 0; l < AUDIO_LANES; l++)
+            cross[l] += (samples[i + l - 1] ^ samples[i + l]) < 0;
+    for (; i < n; i++)
+        cross[0] += (samples[i - 1] ^ samples[i]) < 0;
+
+    for (l = 0; l < AUDIO_LANES; l++)
+    {
+        total     += power[l];
+        crossings += cross[l];
+    }
+    *energy = (total > 0) ? 10 * log10(total / n / (32768.0 * 32768.0)) : -120.0;
+    *zcr    = (n > 1) ? (double)crossings / (n - 1) : 0;
+}
+
+//
+// AudioIsSignal
+// A window carries a signal when it is not silence and not hiss
+//
+bool AudioIsSignal (double energy, double zcr)
+{
+    return energy > AUDIO_SILENCE && zcr < AUDIO_ZCR_NOISE;
+}
+
+static void SetState (AUDIO_STATE new_state)
+{
+    if (atomic_exchange(&state, new_state) != (int)new_state && notify != NULL)
+        notify();
+}
+
+//
+// Classify
+// One window, signal or quiet, through the attack and release counts
+//
+static void Classify (bool signal, int *signal_run, int *quiet_run)
+{
+    if (signal)
+    {
+        (*signal_run)++;
+        *quiet_run = 0;
+    }
+    else
+    {
+        (*quiet_run)++;
+        *signal_run = 0;
+    }
+    if (*signal_run >= AUDIO_ATTACK)
+        SetState(AUDIO_ACTIVE);
+    else if (*quiet_run >= AUDIO_RELEASE || atomic_load(&state) == AUDIO_NONE)
+        SetState(AUDIO_IDLE);
+    MetricAdd(METRIC_AUDIO_WINDOWS, 1);
+}
+
+static void *AudioThread (void *arg)
+{
+    struct pollfd fds[2] = { { audio_fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+    static uint8_t datagram[AUDIO_DATAGRAM];
+    static int16_t samples[AUDIO_DATAGRAM / 2];
+    int16_t    window[AUDIO_WINDOW];
+    int        fill = 0, signal_run = 0, quiet_run = 0;
+    clock_us_t last = 0; // last datagram
+    double     energy, zcr;
+
+    (void)arg;
+    while (true)
+    {
+        int ready = poll(fds, 2, AUDIO_WINDOW * 1000 / AUDIO_RATE);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (ready == 0)
+        {
+            // gqrx may stop sending with the squelch closed: quiet, then gone
+            if (last != 0 && ClockNow() - last >= AUDIO_STALE)
+            {
+                SetState(AUDIO_NONE);
+                last = 0;
+                fill = signal_run = quiet_run = 0;
+            }
+            else if (last != 0)
+                Classify(false, &signal_run, &quiet_run);
+            continue;
+        }
+        ssize_t len = recv(audio_fd, datagram, sizeof(datagram), 0);
+        if (len <= 0)
+            continue;
+        last = ClockNow();
+        int count = (int)(len / 2);
+        for (int i = 0; i < count; i++)
+            samples[i] = (int16_t)(datagram[2 * i] | (datagram[2 * i + 1] << 8)); // little endian
+        pthread_mutex_lock(&tone_mutex);
+        ToneFeed(&tone_decoder, samples, count);
+        pthread_mutex_unlock(&tone_mutex);
+        CaptureFeed(samples, count);
+        for (int i = 0; i < count; i++)
+        {
+            window[fill++] = samples[i];
+            if (fill < AUDIO_WINDOW)
+                continue;
+            fill = 0;
+            AudioFeatures(window, AUDIO_WINDOW, &energy, &zcr);
+            atomic_store(&energy_cdb, (int)lrint(energy * 100));
+            Classify(AudioIsSignal(energy, zcr), &signal_run, &quiet_run);
+        }
+    }
+    return NULL;
+}
+
+//
+// AudioStart
+// Receive the audio stream on "[address:]port", localhost by default.
+// notify is called by the detector thread when the state changes.
+//
+bool AudioStart (const char *listen_on, AUDIO_NOTIFY on_change)
+{
+    struct sockaddr_in addr;
+    char   host[64] = "127.0.0.1";
+    const char *port = strrchr(listen_on, ':');
+    int    one = 1;
+
+    if (port != NULL)
+    {
+        size_t len = port - listen_on;
+        if (len >= sizeof(host))
+            return false;
+        memcpy(host, listen_on, len);
+        host[len] = '\0';
+        port++;
+    }
+    else
+        port = listen_on;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(atoi(port));
+    if (atoi(port) <= 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        return false;
+
+    audio_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (audio_fd < 0)
+        return false;
+    setsockopt(audio_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(audio_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || pipe2(stop_pipe, O_CLOEXEC) != 0)
+    {
+        close(audio_fd);
+        audio_fd = -1;
+        return false;
+    }
+    notify = on_change;
+    ToneInit(&tone_decoder);
+    atomic_store(&state, AUDIO_NONE);
+    atomic_store(&energy_cdb, -12000);
+    running = pthread_create(&audio_thread, NULL, AudioThread, NULL) == 0;
+    return running;
+}
+
+//
+// AudioState
+// Current state of the channel, energy of the last window in dBFS
+//
+AUDIO_STATE AudioState (double *energy)
+{
+    if (energy != NULL)
+        *energy = atomic_load(&energy_cdb) / 100.0;
+    return (running) ? (AUDIO_STATE)atomic_load(&state) : AUDIO_NONE;
+}
+
+//
+// AudioToneReset
+// Start decoding the tone of a new channel
+//
+void AudioToneReset (void)
+{
+    pthread_mutex_lock(&tone_mutex);
+    ToneReset(&tone_decoder);
+    pthread_mutex_unlock(&tone_mutex);
+}
+
+//
+// AudioToneMatch
+// Does the audio since AudioToneReset carry the wanted CTCSS tone or DCS code
+//
+TONE_MATCH_RESULT AudioToneMatch (const TONE *want)
+{
+    pthread_mutex_lock(&tone_mutex);
+    TONE_MATCH_RESULT result = ToneMatch(&tone_decoder, want);
+    pthread_mutex_unlock(&tone_mutex);
+    return result;
+}
+
+void AudioStop (void)
+{
+    if (!running)
+        return;
+    if (write(stop_pipe[1], "", 1) == 1)
+        pthread_join(audio_thread, NULL);
+    running = false;
+    close(audio_fd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    audio_fd = stop_pipe[0] = stop_pipe[1] = -1;
+    notify = NULL;
+}
@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_AUDIO_H_
+#define _GQRX_AUDIO_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "gqrx-tone.h"
+
+//
+// Audio activity detector
+//
+// gqrx streams the demodulated audio as UDP datagrams of 16 bit signed
+// mono samples at 48 kHz (Audio settings, UDP). A thread cuts the stream in
+// 10 ms windows and classifies each one on its energy and zero crossing rate:
+// speech, tones and data cross zero much less often than the discriminator
+// hiss of an open squelch, and a closed squelch is silence. The channel is
+// active after AUDIO_ATTACK signal windows and idle after AUDIO_RELEASE quiet
+// ones, so a transmission is seen starting or ending within tens of ms.
+// The same thread feeds the CTCSS/DCS decoder (gqrx-tone.h) and the
+// capture pre-roll (gqrx-capture.h).
+//
+#define AUDIO_PORT          7355    // gqrx default
+#define AUDIO_RATE          48000
+#define AUDIO_WINDOW        480     // samples, 10 ms
+#define AUDIO_SILENCE       -55.0   // dBFS, quieter windows are silence
+#define AUDIO_ZCR_NOISE     0.08    // crossings per sample, more is hiss (5 kHz wide noise is ~0.12)
+#define AUDIO_ATTACK        2       // signal windows to become active
+#define AUDIO_RELEASE       4       // quiet windows to become idle
+#define AUDIO_STALE         500000  // us without datagrams, the stream is gone
+
+typedef enum
+{
+    AUDIO_NONE = 0,     // no stream, the level is used instead
+    AUDIO_IDLE,
+    AUDIO_ACTIVE
+} AUDIO_STATE;
+
+typedef void (*AUDIO_NOTIFY)(void);
+
+void AudioFeatures(const int16_t *samples, int n, double *energy, double *zcr);
+bool AudioIsSignal(double energy, double zcr);
+
+bool AudioStart(const char *listen_on, AUDIO_NOTIFY notify);
+AUDIO_STATE AudioState(double *energy);
+void AudioToneReset(void);
+TONE_MATCH_RESULT AudioToneMatch(const TONE *want);
+void AudioStop(void);
+
+#endif /* _GQRX_AUDIO_H_ */
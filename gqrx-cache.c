@@ -0,0 +1,528 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "gqrx-cache.h"
+
+#define CACHE_ALIGN(x)  (((x) + 7) & ~((uint64_t)7))
+#define FNV_OFFSET      14695981039346656037ULL
+#define FNV_PRIME       1099511628211ULL
+
+typedef struct {
+    freq_t   freq;
+    uint32_t descr;
+    uint32_t tag_first;
+    uint32_t tag_count;
+    uint32_t order;     // insertion order, keeps the sort stable
+} BUILDER_FREQ;
+
+struct CACHE_BUILDER {
+    BUILDER_FREQ *freqs;
+    uint32_t      n_freqs, freqs_size;
+    uint32_t     *tag_refs;
+    uint32_t      n_tag_refs, tag_refs_size;
+    uint32_t     *tag_table;    // string offsets of the interned tags
+    uint32_t      n_tags, tag_table_size;
+    uint32_t     *tag_hash;     // open addressing: tag id + 1, 0 = empty
+    uint32_t      tag_hash_size;
+    char         *strings;
+    uint64_t      strings_len, strings_size;
+};
+
+//
+// Grow
+// realloc an array to hold at least 'needed' elements
+//
+static bool Grow (void **array, uint32_t *size, uint64_t needed, size_t elem)
+{
+    if (needed <= *size)
+        return true;
+    uint64_t new_size = (*size) ? (*size) : 64;
+    while (new_size < needed)
+        new_size *= 2;
+    if (new_size > UINT32_MAX)
+        return false;
+    void *p = realloc(*array, new_size * elem);
+    if (p == NULL)
+        return false;
+    *array = p;
+    *size  = (uint32_t) new_size;
+    return true;
+}
+
+static uint64_t HashBytes (uint64_t hash, const void *data, size_t len)
+{
+    const unsigned char *p = data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= FNV_PRIME;
+    }
+    return hash;
+}
+
+//
+// HashFile
+// FNV-1a of the whole file content
+//
+uint64_t HashFile (const char *path, bool *ok)
+{
+    unsigned char buf[65536];
+    uint64_t hash = FNV_OFFSET;
+    size_t   n;
+
+    *ok = false;
+    FILE *fd = fopen(path, "rb");
+    if (fd == NULL)
+        return 0;
+    while ((n = fread(buf, 1, sizeof(buf), fd)) > 0)
+        hash = HashBytes(hash, buf, n);
+    *ok = !ferror(fd);
+    fclose(fd);
+    return hash;
+}
+
+static bool AddString (CACHE_BUILDER *b, const char *str, uint32_t *offset)
+{
+    size_t len = strlen(str) + 1;
+    if (b->strings_len + len > UINT32_MAX)
+        return false;
+    if (b->strings_len + len > b->strings_size)
+    {
+        uint64_t new_size = (b->strings_size) ? b->strings_size : 4096;
+        while (new_size < b->strings_len + len)
+            new_size *= 2;
+        char *p = realloc(b->strings, new_size);
+        if (p == NULL)
+            return false;
+        b->strings      = p;
+        b->strings_size = new_size;
+    }
+    memcpy(b->strings + b->strings_len, str, len);
+    *offset = (uint32_t) b->strings_len;
+    b->strings_len += len;
+    return true;
+}
+
+//
+// InternTag
+// Return the id of the tag, adding it to the tag table if not already seen
+//
+static bool InternTag (CACHE_BUILDER *b, const char *tag, uint32_t *id)
+{
+    // keep the load factor under 1/2
+    if ((b->n_tags + 1) * 2 > b->tag_hash_size)
+    {
+        uint32_t new_size = (b->tag_hash_size) ? b->tag_hash_size * 2 : 256;
+        uint32_t *table = calloc(new_size, sizeof(uint32_t));
+        if (table == NULL)
+            return false;
+        for (uint32_t t = 0; t < b->n_tags; t++)
+        {
+            const char *name = b->strings + b->tag_table[t];
+            uint32_t h = (uint32_t) HashBytes(FNV_OFFSET, name, strlen(name)) & (new_size - 1);
+            while (table[h] != 0)
+                h = (h + 1) & (new_size - 1);
+            table[h] = t + 1;
+        }
+        free(b->tag_hash);
+        b->tag_hash      = table;
+        b->tag_hash_size = new_size;
+    }
+
+    uint32_t h = (uint32_t) HashBytes(FNV_OFFSET, tag, strlen(tag)) & (b->tag_hash_size - 1);
+    while (b->tag_hash[h] != 0)
+    {
+        uint32_t t = b->tag_hash[h] - 1;
+        if (strcmp(b->strings + b->tag_table[t], tag) == 0)
+        {
+            *id = t;
+            return true;
+        }
+        h = (h + 1) & (b->tag_hash_size - 1);
+    }
+
+    uint32_t offset;
+    if (!Grow((void **)&b->tag_table, &b->tag_table_size, b->n_tags + 1, sizeof(uint32_t)))
+        return false;
+    if (!AddString(b, tag, &offset))
+        return false;
+    b->tag_table[b->n_tags] = offset;
+    b->tag_hash[h] = b->n_tags + 1;
+    *id = b->n_tags++;
+    return true;
+}
+
+CACHE_BUILDER *CacheBuilderCreate (void)
+{
+    return calloc(1, sizeof(CACHE_BUILDER));
+}
+
+void CacheBuilderFree (CACHE_BUILDER *builder)
+{
+    if (builder == NULL)
+        return;
+    free(builder->freqs);
+    free(builder->tag_refs);
+    free(builder->tag_table);
+    free(builder->tag_hash);
+    free(builder->strings);
+    free(builder);
+}
+
+int CacheBuilderCount (CACHE_BUILDER *builder)
+{
+    return (int) builder->n_freqs;
+}
+
+//
+// CacheBuilderAdd
+// Append a bookmark, tags are interned
+//
+bool CacheBuilderAdd (CACHE_BUILDER *b, freq_t freq, const char *descr, char **tags, int tag_max)
+{
+    if (!Grow((void **)&b->freqs, &b->freqs_size, (uint64_t)b->n_freqs + 1, sizeof(BUILDER_FREQ)))
+        return false;
+    if (!Grow((void **)&b->tag_refs, &b->tag_refs_size, (uint64_t)b->n_tag_refs + tag_max, sizeof(uint32_t)))
+        return false;
+
+    BUILDER_FREQ *f = &b->freqs[b->n_freqs];
+    f->freq      = freq;
+    f->order     = b->n_freqs;
+    f->tag_first = b->n_tag_refs;
+    f->tag_count = 0;
+    if (!AddString(b, (descr) ? descr : "", &f->descr))
+        return false;
+
+    for (int k = 0; k < tag_max; k++)
+    {
+        uint32_t id;
+        if (!InternTag(b, tags[k], &id))
+            return false;
+        b->tag_refs[b->n_tag_refs++] = id;
+        f->tag_count++;
+    }
+    b->n_freqs++;
+    return true;
+}
+
+static int CompareFreq (const void *a, const void *b)
+{
+    const BUILDER_FREQ *fa = a, *fb = b;
+    if (fa->freq != fb->freq)
+        return (fa->freq < fb->freq) ? -1 : 1;
+    return (fa->order < fb->order) ? -1 : (fa->order > fb->order);
+}
+
+static bool WriteAt (FILE *fd, uint64_t offset, const void *data, size_t len)
+{
+    if (fseeko(fd, (off_t) offset, SEEK_SET) != 0)
+        return false;
+    return (len == 0) || (fwrite(data, len, 1, fd) == 1);
+}
+
+//
+// CacheBuilderWrite
+// Sort the bookmarks and write the image to a temporary file, then
+// rename it over 'path' so that readers never map a partial image.
+//
+bool CacheBuilderWrite (CACHE_BUILDER *b, const char *path, const char **sources, int n_sources)
+{
+    CACHE_HEADER header;
+    CACHE_SOURCE src[CACHE_SOURCES_MAX];
+    char tmp_path[CACHE_PATH_MAX + 16];
+
+    if (n_sources > CACHE_SOURCES_MAX || strlen(path) >= CACHE_PATH_MAX)
+        return false;
+
+    memset(src, 0, sizeof(src));
+    for (int s = 0; s < n_sources; s++)
+    {
+        struct stat st;
+        bool ok;
+        if (strlen(sources[s]) >= CACHE_PATH_MAX || stat(sources[s], &st) != 0)
+            return false;
+        strcpy(src[s].path, sources[s]);
+        src[s].mtime = (int64_t) st.st_mtime;
+        src[s].size  = (uint64_t) st.st_size;
+        src[s].hash  = HashFile(sources[s], &ok);
+        if (!ok)
+            return false;
+    }
+
+    qsort(b->freqs, b->n_freqs, sizeof(BUILDER_FREQ), CompareFreq);
+
+    memset(&header, 0, sizeof(header));
+    header.magic            = CACHE_MAGIC;
+    header.version          = CACHE_VERSION;
+    header.n_sources        = n_sources;
+    header.n_freqs          = b->n_freqs;
+    header.n_tags           = b->n_tags;
+    header.n_tag_refs       = b->n_tag_refs;
+    header.bitset_words     = (b->n_tags + 63) / 64;
+    header.sources_offset   = CACHE_ALIGN(sizeof(CACHE_HEADER));
+    header.freqs_offset     = CACHE_ALIGN(header.sources_offset   + (uint64_t)n_sources * sizeof(CACHE_SOURCE));
+    header.tag_refs_offset  = CACHE_ALIGN(header.freqs_offset     + (uint64_t)b->n_freqs * sizeof(CACHE_FREQ));
+    header.tag_table_offset = CACHE_ALIGN(header.tag_refs_offset  + (uint64_t)b->n_tag_refs * sizeof(uint32_t));
+    header.tag_bits_offset  = CACHE_ALIGN(header.tag_table_offset + (uint64_t)b->n_tags * sizeof(uint32_t));
+    header.strings_offset   = CACHE_ALIGN(header.tag_bits_offset  +
+                                          (uint64_t)b->n_freqs * header.bitset_words * sizeof(uint64_t));
+    header.strings_size     = b->strings_len;
+    header.file_size        = header.strings_offset + b->strings_len;
+
+    sprintf(tmp_path, "%s.tmp", path);
+    FILE *fd = fopen(tmp_path, "wb");
+    if (fd == NULL)
+        return false;
+
+    bool ok = WriteAt(fd, 0, &header, sizeof(header)) &&
+              WriteAt(fd, header.sources_offset, src, n_sources * sizeof(CACHE_SOURCE));
+
+    // bookmarks and their tag refs, in frequency order
+    CACHE_FREQ rec;
+    uint32_t   ref = 0;
+    for (uint32_t i = 0; ok && i < b->n_freqs; i++)
+    {
+        BUILDER_FREQ *f = &b->freqs[i];
+        memset(&rec, 0, sizeof(rec));
+        rec.freq      = f->freq;
+        rec.descr     = f->descr;
+        rec.tag_first = ref;
+        rec.tag_count = f->tag_count;
+        ok = WriteAt(fd, header.freqs_offset + (uint64_t)i * sizeof(CACHE_FREQ), &rec, sizeof(rec)) &&
+             WriteAt(fd, header.tag_refs_offset + (uint64_t)ref * sizeof(uint32_t),
+                     &b->tag_refs[f->tag_first], f->tag_count * sizeof(uint32_t));
+        ref += f->tag_count;
+    }
+
+    ok = ok && WriteAt(fd, header.tag_table_offset, b->tag_table, b->n_tags * sizeof(uint32_t));
+
+    // precomputed tag bitsets, one row per bookmark
+    if (ok && header.bitset_words > 0)
+    {
+        uint64_t *row = malloc(header.bitset_words * sizeof(uint64_t));
+        ok = (row != NULL) && (fseeko(fd, (off_t) header.tag_bits_offset, SEEK_SET) == 0);
+        for (uint32_t i = 0; ok && i < b->n_freqs; i++)
+        {
+            BUILDER_FREQ *f = &b->freqs[i];
+            memset(row, 0, header.bitset_words * sizeof(uint64_t));
+            for (uint32_t k = 0; k < f->tag_count; k++)
+            {
+                uint32_t t = b->tag_refs[f->tag_first + k];
+                row[t / 64] |= 1ULL << (t % 64);
+            }
+            ok = fwrite(row, header.bitset_words * sizeof(uint64_t), 1, fd) == 1;
+        }
+        free(row);
+    }
+
+    ok = ok && WriteAt(fd, header.strings_offset, b->strings, b->strings_len);
+    ok = (fclose(fd) == 0) && ok;
+    if (!ok || rename(tmp_path, path) != 0)
+    {
+        unlink(tmp_path);
+        return false;
+    }
+    return true;
+}
+
+static bool InFile (const CACHE_HEADER *h, uint64_t offset, uint64_t count, uint64_t elem)
+{
+    if (offset % 8 != 0 || offset > h->file_size)
+        return false;
+    return count <= (h->file_size - offset) / elem;
+}
+
+//
+// ValidateSources
+// The image is up to date when the sources have the same mtime and size,
+// or, if they have been touched, the same content hash.
+//
+static bool ValidateSources (const BOOKMARK_CACHE *cache, const char **sources, int n_sources)
+{
+    if ((int)cache->header->n_sources != n_sources)
+        return false;
+    for (int s = 0; s < n_sources; s++)
+    {
+        const CACHE_SOURCE *src = &cache->sources[s];
+        struct stat st;
+        bool ok;
+
+        if (strncmp(src->path, sources[s], CACHE_PATH_MAX) != 0)
+            return false;
+        if (stat(sources[s], &st) != 0)
+            return false;
+        if ((uint64_t) st.st_size != src->size)
+            return false;
+        if ((int64_t) st.st_mtime == src->mtime)
+            continue;
+        if (HashFile(sources[s], &ok) != src->hash || !ok)
+            return false;
+    }
+    return true;
+}
+
+static bool ValidateImage (const BOOKMARK_CACHE *cache)
+{
+    const CACHE_HEADER *h = cache->header;
+
+    if (h->magic != CACHE_MAGIC || h->version != CACHE_VERSION)
+        return false;
+    if (h->file_size != cache->size || h->n_sources > CACHE_SOURCES_MAX)
+        return false;
+    if (h->bitset_words != (h->n_tags + 63) / 64)
+        return false;
+    if (!InFile(h, h->sources_offset,   h->n_sources,  sizeof(CACHE_SOURCE)) ||
+        !InFile(h, h->freqs_offset,     h->n_freqs,    sizeof(CACHE_FREQ))   ||
+        !InFile(h, h->tag_refs_offset,  h->n_tag_refs, sizeof(uint32_t))     ||
+        !InFile(h, h->tag_table_offset, h->n_tags,     sizeof(uint32_t))     ||
+        !InFile(h, h->tag_bits_offset,  (uint64_t)h->n_freqs * h->bitset_words, sizeof(uint64_t)))
+        return false;
+    if (h->strings_offset > h->file_size || h->strings_size != h->file_size - h->strings_offset)
+        return false;
+    if (h->strings_size == 0 || cache->strings[h->strings_size - 1] != '\0')
+        return false;
+
+    for (uint32_t t = 0; t < h->n_tags; t++)
+        if (cache->tag_table[t] >= h->strings_size)
+            return false;
+    for (uint32_t r = 0; r < h->n_tag_refs; r++)
+        if (cache->tag_refs[r] >= h->n_tags)
+            return false;
+    for (uint32_t i = 0; i < h->n_freqs; i++)
+    {
+        const CACHE_FREQ *f = &cache->freqs[i];
+        if (f->descr >= h->strings_size)
+            return false;
+        if (f->tag_first > h->n_tag_refs || f->tag_count > h->n_tag_refs - f->tag_first)
+            return false;
+        if (i > 0 && f->freq < cache->freqs[i-1].freq)
+            return false;
+    }
+    return true;
+}
+
+//
+// CacheOpen
+// Map the image and check it against the given source files.
+// Returns false if the image is missing, corrupted or stale.
+//
+bool CacheOpen (BOOKMARK_CACHE *cache, const char *path, const char **sources, int n_sources)
+{
+    struct stat st;
+
+    memset(cache, 0, sizeof(*cache));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(CACHE_HEADER))
+    {
+        close(fd);
+        return false;
+    }
+    void *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+
+    cache->base    = base;
+    cache->size    = st.st_size;
+    cache->header  = base;
+
+    const CACHE_HEADER *h = cache->header;
+    const char *p = base;
+    if (h->file_size == cache->size && h->strings_offset <= cache->size &&
+        h->sources_offset <= cache->size && h->freqs_offset <= cache->size &&
+        h->tag_refs_offset <= cache->size && h->tag_table_offset <= cache->size &&
+        h->tag_bits_offset <= cache->size)
+    {
+        cache->sources   = (const CACHE_SOURCE *)(p + h->sources_offset);
+        cache->freqs     = (const CACHE_FREQ *)  (p + h->freqs_offset);
+        cache->tag_refs  = (const uint32_t *)    (p + h->tag_refs_offset);
+        cache->tag_table = (const uint32_t *)    (p + h->tag_table_offset);
+        cache->tag_bits  = (const uint64_t *)    (p + h->tag_bits_offset);
+        cache->strings   = p + h->strings_offset;
+
+        if (ValidateImage(cache) && ValidateSources(cache, sources, n_sources))
+            return true;
+    }
+
+    CacheClose(cache);
+    return false;
+}
+
+void CacheClose (BOOKMARK_CACHE *cache)
+{
+    if (cache->base != NULL)
+        munmap(cache->base, cache->size);
+    memset(cache, 0, sizeof(*cache));
+}
+
+//
+// CacheLowerBound
+// Index of the first bookmark with frequency >= freq
+//
+uint32_t CacheLowerBound (const BOOKMARK_CACHE *cache, freq_t freq)
+{
+    uint32_t lo = 0, hi = cache->header->n_freqs;
+    while (lo < hi)
+    {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (cache->freqs[mid].freq < freq)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+const char *CacheString (const BOOKMARK_CACHE *cache, uint32_t offset)
+{
+    return cache->strings + offset;
+}
+
+const char *CacheTagName (const BOOKMARK_CACHE *cache, uint32_t tag)
+{
+    return cache->strings + cache->tag_table[tag];
+}
+
+//
+// CacheMatchTags
+// True if the bookmark has at least one of the tags set in mask
+//
+bool CacheMatchTags (const BOOKMARK_CACHE *cache, uint32_t idx, const uint64_t *mask)
+{
+    uint32_t words = cache->header->bitset_words;
+    const uint64_t *bits = cache->tag_bits + (uint64_t)idx * words;
+    for (uint32_t w = 0; w < words; w++)
+        if (bits[w] & mask[w])
+            return true;
+    return false;
+}
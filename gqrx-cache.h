@@ -0,0 +1,116 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_CACHE_H_
+#define _GQRX_CACHE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "gqrx-prot.h"
+
+//
+// Compiled bookmark cache
+//
+// Binary image of one or more gqrx bookmark files:
+//   header | sources | freqs (sorted) | tag refs | tag table | tag bitsets | strings
+// All the offsets are relative to the beginning of the file.
+//
+#define CACHE_MAGIC         0x43535147  // "GQSC"
+#define CACHE_VERSION       1
+#define CACHE_SOURCES_MAX   16
+#define CACHE_PATH_MAX      256
+
+typedef struct {
+    char     path[CACHE_PATH_MAX];
+    int64_t  mtime;
+    uint64_t size;
+    uint64_t hash;      // FNV-1a of the file content
+} CACHE_SOURCE;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_sources;
+    uint32_t n_freqs;
+    uint32_t n_tags;
+    uint32_t n_tag_refs;
+    uint32_t bitset_words;  // uint64_t words per bookmark in the tag bitsets
+    uint32_t reserved;
+    uint64_t sources_offset;
+    uint64_t freqs_offset;
+    uint64_t tag_refs_offset;
+    uint64_t tag_table_offset;
+    uint64_t tag_bits_offset;
+    uint64_t strings_offset;
+    uint64_t strings_size;
+    uint64_t file_size;
+} CACHE_HEADER;
+
+typedef struct {
+    uint64_t freq;
+    uint32_t descr;     // offset in the string table
+    uint32_t tag_first; // first index in tag refs
+    uint32_t tag_count;
+    uint32_t reserved;
+} CACHE_FREQ;
+
+typedef struct {
+    void                *base;
+    size_t               size;
+    const CACHE_HEADER  *header;
+    const CACHE_SOURCE  *sources;
+    const CACHE_FREQ    *freqs;
+    const uint32_t      *tag_refs;
+    const uint32_t      *tag_table;
+    const uint64_t      *tag_bits;
+    const char          *strings;
+} BOOKMARK_CACHE;
+
+typedef struct CACHE_BUILDER CACHE_BUILDER;
+
+//
+// Builder
+//
+CACHE_BUILDER *CacheBuilderCreate(void);
+bool CacheBuilderAdd(CACHE_BUILDER *builder, freq_t freq, const char *descr, char **tags, int tag_max);
+int  CacheBuilderCount(CACHE_BUILDER *builder);
+bool CacheBuilderWrite(CACHE_BUILDER *builder, const char *path, const char **sources, int n_sources);
+void CacheBuilderFree(CACHE_BUILDER *builder);
+
+//
+// Reader
+//
+bool CacheOpen(BOOKMARK_CACHE *cache, const char *path, const char **sources, int n_sources);
+void CacheClose(BOOKMARK_CACHE *cache);
+uint32_t CacheLowerBound(const BOOKMARK_CACHE *cache, freq_t freq);
+const char *CacheString(const BOOKMARK_CACHE *cache, uint32_t offset);
+const char *CacheTagName(const BOOKMARK_CACHE *cache, uint32_t tag);
+bool CacheMatchTags(const BOOKMARK_CACHE *cache, uint32_t idx, const uint64_t *mask);
+
+//
+// Utilities
+//
+uint64_t HashFile(const char *path, bool *ok);
+
+#endif /* _GQRX_CACHE_H_ */
@@ -0,0 +1,367 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "gqrx-capture.h"
+#include "gqrx-metrics.h"
+
+#define PREROLL_SIZE    (CAPTURE_PREROLL * CAPTURE_RATE)
+#define QUEUE_SIZE      (CAPTURE_QUEUE * CAPTURE_RATE)
+
+typedef enum
+{
+    CAPTURE_OPEN,
+    CAPTURE_CLOSE
+} CAPTURE_OP;
+
+typedef struct {
+    CAPTURE_OP op;
+    uint64_t   pos;     // in the queue, run once the samples before it are written
+    char       path[CAPTURE_PATH_SIZE];
+} CAPTURE_COMMAND;
+
+static char            capture_dir[CAPTURE_PATH_SIZE - 64];   // room for the file name
+static int16_t        *preroll = NULL;  // ring of the last PREROLL_SIZE samples
+static uint64_t        preroll_in;      // samples fed so far
+static uint64_t        preroll_from;    // preroll_in when the receiver was last tuned
+static int16_t        *queue = NULL;    // samples for the writer, ring
+static uint64_t        queue_in, queue_out;
+static CAPTURE_COMMAND commands[CAPTURE_COMMANDS];
+static unsigned        command_in, command_out;
+static bool            capturing = false;   // the live audio goes to a file
+static bool            stopping  = false;
+static unsigned long   dropped;
+static pthread_mutex_t capture_mutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  capture_cond  = PTHREAD_COND_INITIALIZER;
+static pthread_t       writer_thread;
+static bool            running = false;
+
+static void Put32 (uint8_t *p, uint32_t v)
+{
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = v >> 24;
+}
+
+static void Put16 (uint8_t *p, uint16_t v)
+{
+    p[0] = v & 0xFF; p[1] = v >> 8;
+}
+
+//
+// WavHeader
+// 44 bytes of a 16 bit mono PCM file with data_bytes of samples
+//
+static void WavHeader (FILE *file, uint32_t data_bytes)
+{
+    uint8_t h[44];
+
+    memcpy(h, "RIFF", 4);
+    Put32(h + 4, 36 + data_bytes);
+    memcpy(h + 8, "WAVEfmt ", 8);
+    Put32(h + 16, 16);
+    Put16(h + 20, 1);                   // PCM
+    Put16(h + 22, 1);                   // mono
+    Put32(h + 24, CAPTURE_RATE);
+    Put32(h + 28, CAPTURE_RATE * 2);    // bytes per second
+    Put16(h + 32, 2);                   // bytes per frame
+    Put16(h + 34, 16);
+    memcpy(h + 36, "data", 4);
+    Put32(h + 40, data_bytes);
+    fwrite(h, 1, sizeof(h), file);
+}
+
+static FILE *WavOpen (const char *path)
+{
+    FILE *file = fopen(path, "wbe");
+
+    if (file == NULL)
+    {
+        printf ("Error: cannot write capture %s\n", path);
+        return NULL;
+    }
+    setvbuf(file, NULL, _IOFBF, CAPTURE_BUFFER);
+    WavHeader(file, 0); // sizes written at the end
+    MetricAdd(METRIC_CAPTURES, 1);
+    return file;
+}
+
+static void WavClose (FILE *file, uint32_t data_bytes)
+{
+    fflush(file);
+    fseek(file, 0, SEEK_SET);
+    WavHeader(file, data_bytes);
+    fclose(file);
+}
+
+//
+// Enqueue
+// Copy samples for the writer, or drop them all when they do not fit.
+// Called with the mutex held.
+//
+static void Enqueue (const int16_t *samples, int n)
+{
+    if (queue_in - queue_out + n > QUEUE_SIZE)
+    {
+        dropped += n;
+        MetricAdd(METRIC_CAPTURE_DROPS, n);
+        return;
+    }
+    while (n > 0)
+    {
+        int at   = (int)(queue_in % QUEUE_SIZE);
+        int part = (n < QUEUE_SIZE - at) ? n : QUEUE_SIZE - at;
+        memcpy(queue + at, samples, part * sizeof(int16_t));
+        samples  += part;
+        n        -= part;
+        queue_in += part;
+    }
+}
+
+static bool Command (CAPTURE_OP op, const char *path)
+{
+    if (command_in - command_out == CAPTURE_COMMANDS)
+        return false;
+    CAPTURE_COMMAND *cmd = &commands[command_in % CAPTURE_COMMANDS];
+    cmd->op  = op;
+    cmd->pos = queue_in;
+    if (path != NULL)
+        snprintf(cmd->path, sizeof(cmd->path), "%s", path);
+    command_in++;
+    return true;
+}
+
+static void *WriterThread (void *arg)
+{
+    static int16_t chunk[CAPTURE_CHUNK];
+    static uint8_t bytes[CAPTURE_CHUNK * 2];
+    FILE    *file = NULL;
+    uint32_t data_bytes = 0;
+
+    (void)arg;
+    pthread_mutex_lock(&capture_mutex);
+    while (true)
+    {
+        bool     command = command_out != command_in;
+        uint64_t limit   = (command) ? commands[command_out % CAPTURE_COMMANDS].pos : queue_in;
+
+        if (queue_out < limit)
+        {
+            int n  = (limit - queue_out < CAPTURE_CHUNK) ? (int)(limit - queue_out) : CAPTURE_CHUNK;
+            int at = (int)(queue_out % QUEUE_SIZE);
+            int part = (n < QUEUE_SIZE - at) ? n : QUEUE_SIZE - at;
+            memcpy(chunk, queue + at, part * sizeof(int16_t));
+            memcpy(chunk + part, queue, (n - part) * sizeof(int16_t));
+            queue_out += n;
+            pthread_mutex_unlock(&capture_mutex);
+
+            for (int i = 0; i < n; i++)
+                Put16(bytes + 2 * i, (uint16_t)chunk[i]); // little endian
+            if (file != NULL)
+            {
+                fwrite(bytes, 2, n, file);
+                data_bytes += 2 * n;
+            }
+            pthread_mutex_lock(&capture_mutex);
+        }
+        else if (command)
+        {
+            CAPTURE_COMMAND cmd = commands[command_out % CAPTURE_COMMANDS];
+            command_out++;
+            pthread_mutex_unlock(&capture_mutex);
+
+            if (file != NULL)
+                WavClose(file, data_bytes);
+            file = (cmd.op == CAPTURE_OPEN) ? WavOpen(cmd.path) : NULL;
+            data_bytes = 0;
+            pthread_mutex_lock(&capture_mutex);
+        }
+        else if (stopping)
+            break;
+        else
+            pthread_cond_wait(&capture_cond, &capture_mutex);
+    }
+    pthread_mutex_unlock(&capture_mutex);
+    if (file != NULL)
+        WavClose(file, data_bytes);
+    return NULL;
+}
+
+//
+// CaptureStart
+// Keep the pre-roll and write the captures to the directory dir
+//
+bool CaptureStart (const char *dir)
+{
+    struct stat st;
+    size_t len = strlen(dir);
+
+    if (stat(dir, &st) != 0 || !S_ISDIR(st.st_mode) || len >= sizeof(capture_dir))
+        return false;
+    strcpy(capture_dir, dir);
+    while (len > 1 && capture_dir[len - 1] == '/')
+        capture_dir[--len] = '\0';
+
+    preroll = malloc(PREROLL_SIZE * sizeof(int16_t));
+    queue   = malloc(QUEUE_SIZE * sizeof(int16_t));
+    if (preroll == NULL || queue == NULL)
+    {
+        free(preroll);
+        free(queue);
+        preroll = queue = NULL;
+        return false;
+    }
+    preroll_in = preroll_from = queue_in = queue_out = 0;
+    command_in = command_out = 0;
+    dropped   = 0;
+    capturing = stopping = false;
+    if (pthread_create(&writer_thread, NULL, WriterThread, NULL) != 0)
+        return false;
+    running = true;
+    return true;
+}
+
+//
+// CaptureFeed
+// Audio from the stream, called by the audio thread: never waits for the disk
+//
+void CaptureFeed (const int16_t *samples, int n)
+{
+    if (!running)
+        return;
+    pthread_mutex_lock(&capture_mutex);
+    if (capturing)
+    {
+        Enqueue(samples, n);
+        pthread_cond_signal(&capture_cond);
+    }
+    if (n > PREROLL_SIZE)
+    {
+        samples    += n - PREROLL_SIZE;
+        preroll_in += n - PREROLL_SIZE;
+        n = PREROLL_SIZE;
+    }
+    for (int i = 0; i < n; i++)
+        preroll[(preroll_in + i) % PREROLL_SIZE] = samples[i];
+    preroll_in += n;
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+//
+// CaptureTuned
+// The receiver moved to another frequency: the pre-roll of a hit starts here
+//
+void CaptureTuned (void)
+{
+    if (!running)
+        return;
+    pthread_mutex_lock(&capture_mutex);
+    preroll_from = preroll_in;
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+//
+// CaptureOpen
+// Start the capture of a hit with the pre-roll, the path of the file is
+// returned in path. A capture still open is closed.
+//
+bool CaptureOpen (freq_t freq, time_t hit_time, char *path, size_t size)
+{
+    char      name[CAPTURE_PATH_SIZE], stamp[32];
+    struct tm tm;
+
+    if (!running)
+        return false;
+    localtime_r(&hit_time, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    snprintf(name, sizeof(name), "%s/%llu_%s.wav", capture_dir, (unsigned long long)freq, stamp);
+
+    pthread_mutex_lock(&capture_mutex);
+    if (!Command(CAPTURE_OPEN, name)) // the writer closes the previous file first
+    {
+        pthread_mutex_unlock(&capture_mutex);
+        return false;
+    }
+    // the pre-roll since the tune, at most PREROLL_SIZE, oldest sample first
+    uint64_t count = preroll_in - preroll_from;
+    if (count > PREROLL_SIZE)
+        count = PREROLL_SIZE;
+    int      first = (int)((preroll_in - count) % PREROLL_SIZE);
+    int      part  = ((int)count < PREROLL_SIZE - first) ? (int)count : PREROLL_SIZE - first;
+    Enqueue(preroll + first, part);
+    Enqueue(preroll, (int)count - part);
+    capturing = true;
+    pthread_cond_signal(&capture_cond);
+    pthread_mutex_unlock(&capture_mutex);
+
+    if (path != NULL)
+        snprintf(path, size, "%s", name);
+    return true;
+}
+
+//
+// CaptureClose
+// End the capture of the hit, the file is closed once its audio is written
+//
+void CaptureClose (void)
+{
+    if (!running)
+        return;
+    pthread_mutex_lock(&capture_mutex);
+    if (capturing && Command(CAPTURE_CLOSE, NULL))
+    {
+        capturing = false;
+        pthread_cond_signal(&capture_cond);
+    }
+    pthread_mutex_unlock(&capture_mutex);
+}
+
+unsigned long CaptureDropped (void)
+{
+    pthread_mutex_lock(&capture_mutex);
+    unsigned long n = dropped;
+    pthread_mutex_unlock(&capture_mutex);
+    return n;
+}
+
+//
+// CaptureStop
+// Write what is queued, close the file and stop the writer
+//
+void CaptureStop (void)
+{
+    if (!running)
+        return;
+    pthread_mutex_lock(&capture_mutex);
+    capturing = false;
+    stopping  = true;
+    pthread_cond_signal(&capture_cond);
+    pthread_mutex_unlock(&capture_mutex);
+    pthread_join(writer_thread, NULL);
+    running = false;
+    free(preroll);
+    free(queue);
+    preroll = queue = NULL;
+}
@@ -0,0 +1,60 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_CAPTURE_H_
+#define _GQRX_CAPTURE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+#include "gqrx-prot.h"
+
+//
+// Audio capture
+//
+// The last CAPTURE_PREROLL seconds of the UDP audio stream are kept in a
+// ring. A hit opens a WAV file named by frequency and time in the capture
+// directory: the pre-roll is queued first, then the live audio until the hit
+// ends. The pre-roll never reaches back before the last CaptureTuned, the
+// audio of the previous frequency is not part of the hit. The audio thread only copies samples to memory, a writer thread
+// drains the queue to the files with large buffered writes; when the disk
+// falls behind by more than CAPTURE_QUEUE seconds the samples are dropped.
+//
+#define CAPTURE_RATE        48000
+#define CAPTURE_PREROLL     2       // seconds
+#define CAPTURE_QUEUE       10      // seconds
+#define CAPTURE_CHUNK       16384   // samples written at once
+#define CAPTURE_BUFFER      (1 << 20)
+#define CAPTURE_COMMANDS    8       // opens and closes not yet run by the writer
+#define CAPTURE_PATH_SIZE   1024
+
+bool CaptureStart(const char *dir);
+void CaptureFeed(const int16_t *samples, int n);
+void CaptureTuned(void);
+bool CaptureOpen(freq_t freq, time_t hit_time, char *path, size_t size);
+void CaptureClose(void);
+unsigned long CaptureDropped(void);
+void CaptureStop(void);
+
+#endif /* _GQRX_CAPTURE_H_ */
@@ -0,0 +1,144 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gqrx-cfar.h"
+
+bool CfarInit (CFAR *cfar, int n, int train, double factor, double hysteresis)
+{
+    cfar->cells      = calloc((n > 0) ? n : 1, sizeof(CFAR_CELL));
+    cfar->n          = n;
+    cfar->train      = train;
+    cfar->factor     = factor;
+    cfar->hysteresis = hysteresis;
+    return cfar->cells != NULL;
+}
+
+void CfarFree (CFAR *cfar)
+{
+    free(cfar->cells);
+    cfar->cells = NULL;
+    cfar->n = 0;
+}
+
+static bool Usable (const CFAR_CELL *cell)
+{
+    return cell->samples >= CFAR_WARMUP && !cell->open;
+}
+
+static int Compare (const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+//
+// CfarThreshold
+// Open and close thresholds of a bin in dBFS, false while the bin has not learned
+// its noise: judged on its neighbours only, a noisy bin would open and never learn it.
+//
+bool CfarThreshold (const CFAR *cfar, int bin, double *open, double *close)
+{
+    const CFAR_CELL *own = &cfar->cells[bin];
+    float  means[2 * CFAR_TRAIN];
+    int    n = 0;
+
+    if (own->samples < CFAR_WARMUP)
+        return false;
+
+    for (int d = CFAR_GUARD + 1; d <= CFAR_GUARD + cfar->train && d <= CFAR_GUARD + CFAR_TRAIN; d++)
+    {
+        int side[2] = { bin - d, bin + d };
+        for (int s = 0; s < 2; s++)
+        {
+            if (side[s] < 0 || side[s] >= cfar->n || !Usable(&cfar->cells[side[s]]))
+                continue;
+            means[n++] = cfar->cells[side[s]].mean;
+        }
+    }
+    // greatest of the own noise and the median of the neighbours: a bin in a noisy
+    // stretch is not more sensitive than its surroundings, and an ordered statistic
+    // is not raised by a signal or a single noisy bin among them
+    double reference = own->mean;
+    if (n > 0)
+    {
+        qsort(means, n, sizeof(float), Compare);
+        if (means[n / 2] > reference)
+            reference = means[n / 2];
+    }
+
+    double margin = cfar->factor * sqrt(own->var);
+    *open  = reference + ((margin > CFAR_MARGIN) ? margin : CFAR_MARGIN);
+    *close = *open - cfar->hysteresis;
+    if (*close < reference + CFAR_CLOSE_MARGIN)
+        *close = reference + CFAR_CLOSE_MARGIN; // not in the noise, or a hit would never end
+    return true;
+}
+
+//
+// CfarUpdate
+// Feed a noise level to the averages of the bin
+//
+void CfarUpdate (CFAR *cfar, int bin, double level)
+{
+    CFAR_CELL *cell = &cfar->cells[bin];
+
+    if (cell->samples == 0)
+    {
+        cell->mean = level;
+        cell->var  = 0;
+    }
+    else
+    {
+        // the first samples weigh more, then a moving average
+        double w = (cell->samples < CFAR_WARMUP) ? 1.0 / (cell->samples + 1) : CFAR_WEIGHT;
+        double delta = level - cell->mean;
+        cell->mean += w * delta;
+        cell->var   = (1 - w) * (cell->var + w * delta * delta);
+    }
+    if (cell->samples < UINT16_MAX)
+        cell->samples++;
+}
+
+//
+// CfarDetect
+// Whether a level is a signal in a bin: above the open threshold, or above the
+// close threshold while the bin is open. Quiet levels refine the noise of the bin.
+//
+bool CfarDetect (CFAR *cfar, int bin, double level, double squelch)
+{
+    CFAR_CELL *cell = &cfar->cells[bin];
+    double open, close;
+    bool   detected;
+
+    if (CfarThreshold(cfar, bin, &open, &close))
+        detected = level >= ((cell->open) ? close : open);
+    else
+        detected = level >= squelch;
+    cell->open = detected;
+    if (!detected)
+        CfarUpdate(cfar, bin, level);
+    return detected;
+}
@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_CFAR_H_
+#define _GQRX_CFAR_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//
+// Constant false alarm rate detector
+//
+// Each bin (or bookmark) learns the mean and the spread of its own noise level
+// from the passes where nothing was detected. A signal opens the bin when it
+// is 'factor' deviations of its noise above the reference, the greatest of the
+// bin own noise and the median noise of its neighbours (training cells on both
+// sides, past the guard cells), and closes it when it falls 'hysteresis' dB below.
+// Open bins are left out of the reference of their neighbours.
+// Until a bin has learned its noise, the gqrx squelch is used.
+//
+#define CFAR_GUARD          1       // cells next to the bin left out of the reference
+#define CFAR_TRAIN          4       // reference cells on each side
+#define CFAR_WARMUP         4       // noise samples before a cell is used as reference
+#define CFAR_WEIGHT         0.125   // weight of a new noise sample in the averages
+#define CFAR_FACTOR         4.0     // default deviations above the reference
+#define CFAR_MARGIN         3.0     // the threshold is at least 3 dB above the reference
+#define CFAR_HYSTERESIS     1.5     // dB below the open threshold to close
+#define CFAR_CLOSE_MARGIN   1.5     // the close threshold is at least 1.5 dB above the reference
+
+typedef struct {
+    float    mean;      // noise level, dBFS
+    float    var;       // spread of the noise level, dB^2
+    uint16_t samples;
+    bool     open;
+} CFAR_CELL;
+
+typedef struct {
+    CFAR_CELL *cells;
+    int        n;
+    int        train;       // 0: the bin own noise only (bookmarks)
+    double     factor;
+    double     hysteresis;
+} CFAR;
+
+bool CfarInit(CFAR *cfar, int n, int train, double factor, double hysteresis);
+void CfarFree(CFAR *cfar);
+bool CfarThreshold(const CFAR *cfar, int bin, double *open, double *close);
+bool CfarDetect(CFAR *cfar, int bin, double level, double squelch);
+void CfarUpdate(CFAR *cfar, int bin, double level);
+
+#endif /* _GQRX_CFAR_H_ */
@@ -0,0 +1,91 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <time.h>
+#include <errno.h>
+#include "gqrx-clock.h"
+
+//
+// ClockNow
+// Monotonic time in microseconds
+//
+clock_us_t ClockNow (void)
+{
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (clock_us_t)now.tv_sec * 1000000 + now.tv_nsec / 1000;
+}
+
+//
+// SleepUntil
+// Sleep until the absolute monotonic deadline (in microseconds), restarting on signals
+//
+void SleepUntil (clock_us_t deadline)
+{
+#ifndef OSX
+    struct timespec ts;
+    ts.tv_sec  = deadline / 1000000;
+    ts.tv_nsec = (deadline % 1000000) * 1000;
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+        ;
+#else
+    // no clock_nanosleep on OSX: sleep the remaining time
+    clock_us_t now;
+    while ((now = ClockNow()) < deadline)
+    {
+        struct timespec ts;
+        ts.tv_sec  = (deadline - now) / 1000000;
+        ts.tv_nsec = ((deadline - now) % 1000000) * 1000;
+        nanosleep(&ts, NULL);
+    }
+#endif
+}
+
+void SleepFor (long usec)
+{
+    if (usec > 0)
+        SleepUntil(ClockNow() + usec);
+}
+
+void TickerStart (TICKER *ticker, long period)
+{
+    ticker->period = period;
+    ticker->next   = ClockNow() + period;
+}
+
+//
+// TickerWait
+// Wait for the next tick
+//
+void TickerWait (TICKER *ticker)
+{
+    clock_us_t now = ClockNow();
+    if (ticker->next <= now)
+    {
+        // late: skip the missed ticks
+        clock_us_t missed = (now - ticker->next) / ticker->period + 1;
+        ticker->next += missed * ticker->period;
+    }
+    SleepUntil(ticker->next);
+    ticker->next += ticker->period;
+}
@@ -0,0 +1,53 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_CLOCK_H_
+#define _GQRX_CLOCK_H_
+
+#include <stdint.h>
+
+//
+// Scan clock
+//
+// Monotonic time in microseconds and sleeps to absolute deadlines, so that
+// chains of waits do not accumulate the time spent between them.
+//
+typedef uint64_t clock_us_t;
+
+clock_us_t ClockNow(void);
+void SleepUntil(clock_us_t deadline);
+void SleepFor(long usec);
+
+//
+// Periodic ticker: ticks are scheduled at start + n * period.
+// If a tick is missed the schedule skips ahead instead of bursting.
+//
+typedef struct {
+    clock_us_t next;
+    long       period;
+} TICKER;
+
+void TickerStart(TICKER *ticker, long period);
+void TickerWait(TICKER *ticker);
+
+#endif /* _GQRX_CLOCK_H_ */
@@ -0,0 +1,315 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // pipe2, accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "gqrx-control.h"
+#include "gqrx-input.h"
+
+typedef struct {
+    int      fd;        // -1 = free slot
+    unsigned gen;       // a reply goes only to the client that sent the command
+    size_t   len;
+    char     buf[CONTROL_LINE];
+} CLIENT;
+
+typedef struct {
+    int      slot;
+    unsigned gen;
+    char    *text;
+} MESSAGE;
+
+typedef struct {
+    MESSAGE  items[CONTROL_QUEUE];
+    unsigned head, tail;
+} QUEUE;
+
+static CLIENT          clients[CONTROL_CLIENTS];
+static QUEUE           requests, replies;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static atomic_int      pending;
+static atomic_bool     stopping;
+static int             listen_fd = -1;
+static int             wake_pipe[2] = { -1, -1 };
+static pthread_t       server_thread;
+static bool            running = false;
+static CONTROL_HANDLER control_handler;
+static char            socket_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+
+static bool Push (QUEUE *q, int slot, unsigned gen, char *text)
+{
+    bool ok = false;
+    pthread_mutex_lock(&lock);
+    if (q->tail - q->head < CONTROL_QUEUE)
+    {
+        MESSAGE *m = &q->items[q->tail++ % CONTROL_QUEUE];
+        m->slot = slot;
+        m->gen  = gen;
+        m->text = text;
+        ok = true;
+    }
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
+
+static bool Pop (QUEUE *q, MESSAGE *m)
+{
+    bool ok = false;
+    pthread_mutex_lock(&lock);
+    if (q->head != q->tail)
+    {
+        *m = q->items[q->head++ % CONTROL_QUEUE];
+        ok = true;
+    }
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
+
+static void Send (int fd, const char *text)
+{
+    // never block the server on a client that does not read
+    send(fd, text, strlen(text), MSG_NOSIGNAL | MSG_DONTWAIT);
+}
+
+static void CloseClient (CLIENT *c)
+{
+    close(c->fd);
+    c->fd  = -1;
+    c->len = 0;
+}
+
+static void Accept (void)
+{
+    int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+    if (fd < 0)
+        return;
+    for (int i = 0; i < CONTROL_CLIENTS; i++)
+    {
+        if (clients[i].fd < 0)
+        {
+            clients[i].fd  = fd;
+            clients[i].len = 0;
+            clients[i].gen++;
+            return;
+        }
+    }
+    Send(fd, "ERR too many clients\n");
+    close(fd);
+}
+
+//
+// Receive
+// Queue the complete lines of a client
+//
+static void Receive (int slot)
+{
+    CLIENT *c = &clients[slot];
+    ssize_t n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - c->len - 1, 0);
+    if (n <= 0)
+    {
+        CloseClient(c);
+        return;
+    }
+    c->len += n;
+    c->buf[c->len] = '\0';
+
+    char *line = c->buf, *nl;
+    while ((nl = strchr(line, '\n')) != NULL)
+    {
+        *nl = '\0';
+        if (nl > line && nl[-1] == '\r')
+            nl[-1] = '\0';
+        if (*line != '\0')
+        {
+            char *text = strdup(line);
+            if (text == NULL || !Push(&requests, slot, c->gen, text))
+            {
+                free(text);
+                Send(c->fd, "ERR busy\n");
+            }
+            else
+            {
+                atomic_fetch_add(&pending, 1);
+                InputWake(); // the scan loop may be paused
+            }
+        }
+        line = nl + 1;
+    }
+    c->len = strlen(line);
+    memmove(c->buf, line, c->len);
+    if (c->len == sizeof(c->buf) - 1)
+    {
+        Send(c->fd, "ERR line too long\n");
+        c->len = 0;
+    }
+}
+
+static void SendReplies (void)
+{
+    MESSAGE m;
+    while (Pop(&replies, &m))
+    {
+        if (clients[m.slot].fd >= 0 && clients[m.slot].gen == m.gen)
+            Send(clients[m.slot].fd, m.text);
+        free(m.text);
+    }
+}
+
+static void *ServerThread (void *arg)
+{
+    struct pollfd fds[CONTROL_CLIENTS + 2];
+    char drain[64];
+
+    (void)arg;
+    while (!atomic_load(&stopping))
+    {
+        int n = 0;
+        fds[n++] = (struct pollfd){ listen_fd, POLLIN, 0 };
+        fds[n++] = (struct pollfd){ wake_pipe[0], POLLIN, 0 };
+        for (int i = 0; i < CONTROL_CLIENTS; i++)
+            fds[n++] = (struct pollfd){ clients[i].fd, POLLIN, 0 };  // negative fds are ignored
+
+        if (poll(fds, n, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+        {
+            while (read(wake_pipe[0], drain, sizeof(drain)) > 0)
+                ;
+            SendReplies();
+        }
+        for (int i = 0; i < CONTROL_CLIENTS; i++)
+            if (fds[i + 2].revents && clients[i].fd >= 0)
+                Receive(i);
+        if (fds[0].revents)
+            Accept();
+    }
+    return NULL;
+}
+
+//
+// ControlStart
+// Listen on the Unix socket 'path', commands are run by 'handler'
+//
+bool ControlStart (const char *path, CONTROL_HANDLER handler)
+{
+    struct sockaddr_un addr;
+
+    if (strlen(path) >= sizeof(addr.sun_path))
+        return false;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, path);
+    strcpy(socket_path, path);
+
+    listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        return false;
+    unlink(path); // stale socket of a previous run
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 ||
+        chmod(path, 0660) != 0 || listen(listen_fd, CONTROL_CLIENTS) != 0 ||
+        pipe2(wake_pipe, O_CLOEXEC) != 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    fcntl(wake_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake_pipe[1], F_SETFL, O_NONBLOCK);
+
+    for (int i = 0; i < CONTROL_CLIENTS; i++)
+        clients[i].fd = -1;
+    control_handler = handler;
+    atomic_store(&pending, 0);
+    atomic_store(&stopping, false);
+    running = pthread_create(&server_thread, NULL, ServerThread, NULL) == 0;
+    return running;
+}
+
+void ControlStop (void)
+{
+    MESSAGE m;
+
+    if (!running)
+        return;
+    atomic_store(&stopping, true);
+    if (write(wake_pipe[1], "", 1) == 1)
+        pthread_join(server_thread, NULL);
+    running = false;
+
+    for (int i = 0; i < CONTROL_CLIENTS; i++)
+        if (clients[i].fd >= 0)
+            CloseClient(&clients[i]);
+    while (Pop(&requests, &m))
+        free(m.text);
+    while (Pop(&replies, &m))
+        free(m.text);
+    close(listen_fd);
+    close(wake_pipe[0]);
+    close(wake_pipe[1]);
+    listen_fd = wake_pipe[0] = wake_pipe[1] = -1;
+    unlink(socket_path);
+}
+
+//
+// ControlDispatch
+// Run the queued commands, called by the scan loop. Nothing but an atomic
+// load when there is no command.
+//
+void ControlDispatch (void)
+{
+    MESSAGE m;
+
+    if (atomic_load(&pending) == 0)
+        return;
+    while (Pop(&requests, &m))
+    {
+        char *reply = malloc(CONTROL_REPLY + 1);
+        atomic_fetch_sub(&pending, 1);
+        if (reply != NULL)
+        {
+            control_handler(m.text, reply, CONTROL_REPLY);
+            strcat(reply, "\n");
+            if (!Push(&replies, m.slot, m.gen, reply))
+                free(reply);
+        }
+        free(m.text);
+    }
+    if (write(wake_pipe[1], "", 1) < 0)
+        return; // the replies go with the next wake up
+}
@@ -0,0 +1,50 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_CONTROL_H_
+#define _GQRX_CONTROL_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Control socket
+//
+// Line protocol on a Unix domain socket, one command per line, one reply line
+// per command. A server thread accepts the clients and queues the commands;
+// the scan loop runs them at its safe points (ControlDispatch), the replies
+// are sent back by the server thread.
+//
+#define CONTROL_CLIENTS     8
+#define CONTROL_QUEUE       64
+#define CONTROL_LINE        512
+#define CONTROL_REPLY       4096
+
+// runs a command on the scan thread, writes the reply (without newline)
+typedef void (*CONTROL_HANDLER)(char *line, char *reply, size_t size);
+
+bool ControlStart(const char *path, CONTROL_HANDLER handler);
+void ControlStop(void);
+void ControlDispatch(void);
+
+#endif /* _GQRX_CONTROL_H_ */
@@ -0,0 +1,1080 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gqrx-engine.h"
+#include "gqrx-clock.h"
+#include "gqrx-settle.h"
+#include "gqrx-metrics.h"
+#include "gqrx-profile.h"
+#include "gqrx-trace.h"
+
+//
+// EngineInit
+// No sink open, no hooks, no connection: the options are set by the caller
+//
+void EngineInit (ENGINE *en)
+{
+    memset(en, 0, sizeof(*en));
+    ScannerInit(&en->sc);
+    en->sockfd        = -1;
+    en->hitlog.fd     = -1;
+    en->occupancy.fd  = -1;
+    en->survey.fd     = -1;
+    en->waterfall.fd  = -1;
+}
+
+//
+// EngineFree
+// Close the sinks and free the context, the events thread (writer of the
+// hit log and the occupancy) is stopped
+//
+void EngineFree (ENGINE *en)
+{
+    HitLogClose(&en->hitlog);
+    OccupancyClose(&en->occupancy);
+    SurveyClose(&en->survey);
+    WaterfallClose(&en->waterfall);
+    ScannerFree(&en->sc);
+}
+
+static void Dispatch (ENGINE *en)
+{
+    if (en->hooks.dispatch != NULL)
+        en->hooks.dispatch(en);
+}
+
+//
+// Input
+// Next key of the front end. Without one, a wait is a sleep.
+//
+static INPUT_COMMAND Input (ENGINE *en, long timeout)
+{
+    if (en->hooks.input != NULL)
+        return en->hooks.input(en, timeout);
+    if (timeout != 0)
+        SleepFor((timeout == INPUT_FOREVER) ? MONITOR_CHECK : timeout);
+    return INPUT_NONE;
+}
+
+static void Flush (ENGINE *en)
+{
+    while (Input(en, 0) != INPUT_NONE)
+        ;
+}
+
+static void Tuned (ENGINE *en, freq_t freq)
+{
+    en->freq = freq;
+    if (en->hooks.tuned != NULL)
+        en->hooks.tuned(en, freq);
+}
+
+static bool Rejected (ENGINE *en, freq_t freq, int bookmark)
+{
+    return en->hooks.rejected != NULL && en->hooks.rejected(en, freq, bookmark);
+}
+
+static AUDIO_STATE Audio (ENGINE *en)
+{
+    return (en->hooks.audio != NULL) ? en->hooks.audio(en) : AUDIO_NONE;
+}
+
+//
+// Hit
+// A hit start or end to the front end, peak and mean are the levels while listening
+//
+static void Hit (ENGINE *en, EVENT_TYPE type, freq_t freq, int bookmark, const char *descr, double level,
+                 double squelch, double squelch_set, time_t hit_time, double peak, double mean)
+{
+    EVENT event;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    event.type         = type;
+    event.time         = ts.tv_sec;
+    event.stamp        = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    event.start        = hit_time;
+    event.freq         = freq;
+    event.bookmark     = bookmark;
+    if (bookmark >= 0)
+        EventSetBookmark(&event, descr, en->sc.freqs[bookmark].tags, en->sc.freqs[bookmark].tag_max);
+    else
+        EventSetBookmark(&event, NULL, NULL, 0);
+    event.level        = level;
+    event.squelch      = squelch;
+    event.squelch_set  = squelch_set;
+    event.squelch_auto = en->opt.squelch_delta_auto;
+    event.duration     = (type == EVENT_HIT_END) ? (long)difftime(event.time, hit_time) : 0;
+    event.peak         = peak;
+    event.mean         = mean;
+    if (en->hooks.hit != NULL)
+        en->hooks.hit(en, &event);
+    if (type == EVENT_HIT_START)
+    {
+        MetricAdd(METRIC_HITS, 1);
+        en->listened = event;
+    }
+}
+
+//
+// HitUpdate
+// The hit being listened to is still active, for the subscribers
+//
+static void HitUpdate (ENGINE *en, double level, double peak, double mean)
+{
+    EVENT event = en->listened;
+    struct timespec ts;
+
+    clock_gettime(CLOCK_REALTIME, &ts);
+    event.type  = EVENT_HIT_UPDATE;
+    event.time  = ts.tv_sec;
+    event.stamp = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    event.level = level;
+    event.peak  = peak;
+    event.mean  = mean;
+    if (en->hooks.hit != NULL)
+        en->hooks.hit(en, &event);
+}
+
+//
+// EngineInterrupted
+// The scan loops return on quit, at the end of a replayed trace or to restart with new settings
+//
+bool EngineInterrupted (const ENGINE *en)
+{
+    return en->quit || en->restart || TraceReplayDone();
+}
+
+//
+// CheckUserInput
+//
+// Clear the bans if 'c' is pressed during the scan cycles,
+// 'p' blocks the scan until another 'p'. Runs the control commands.
+//
+void CheckUserInput (ENGINE *en)
+{
+    INPUT_COMMAND cmd;
+
+    MetricSet(METRIC_BANS,  en->sc.banned_max);
+    MetricSet(METRIC_SAVED, en->sc.saved_max);
+    do
+    {
+        Dispatch(en);
+        cmd = (en->paused) ? Input(en, INPUT_FOREVER) : Input(en, 0);
+        switch (cmd)
+        {
+            case INPUT_CLEAR:
+                // Clear all bans
+                ClearAllBans(&en->sc);
+                break;
+            case INPUT_PAUSE:
+                // pause until another 'p'
+                en->paused ^= true; // switch pause mode
+                break;
+            default:
+                break;
+        }
+    } while ( (cmd != INPUT_NONE || en->paused) && !EngineInterrupted(en) );
+    return;
+}
+
+
+//
+// WaitUserInputOrDelay
+// Waits for user input or a delay after the carrier is gone
+// Returns if the user has pressed <space> or <enter> to skip frequency
+// The level is polled at an interval adapted to the signal (MonitorInterval),
+// fast around the squelch and slow on a long carrier; keys and commands wake
+// the wait. With the audio stream (-a) the activity comes from the audio
+// detector, which wakes the wait on a change, and the level is only polled
+// for the statistics. Delay and max listen time are measured on the monotonic clock.
+// peak and mean return the level above the squelch while listening.
+//
+bool WaitUserInputOrDelay (ENGINE *en, long delay, freq_t *current_freq, double *peak, double *mean)
+{
+    int     sockfd = en->sockfd;
+    double  level_sum = 0;
+    int     level_count = 0;
+    double  squelch = 0;
+    double  level;
+    int     exit = 0;
+    bool    skip = false;
+    bool    paused = false;
+    clock_us_t listen_start = ClockNow(); // moved forward by the time spent in pause
+    clock_us_t quiet_since  = 0;          // signal below squelch since, 0 = active
+    clock_us_t pause_start  = 0;
+    clock_us_t crossed_at   = listen_start; // last squelch crossing
+    clock_us_t next_check   = 0;            // next frequency and squelch check
+    clock_us_t next_update  = listen_start + EVENTS_UPDATE;
+    clock_us_t now;
+    bool       above = true;
+    bool       active = true;
+    AUDIO_STATE audio = AUDIO_NONE;
+    INPUT_COMMAND cmd = INPUT_NONE;
+
+    Flush(en);
+    // the hit was detected at this level: active until a read says otherwise
+    GetSquelchLevel(sockfd, &squelch);
+    level = squelch;
+
+    do
+    {
+        Dispatch(en);
+        if (en->paused)
+        {
+            // nothing to poll, block until the next key or command
+            if (cmd == INPUT_NONE)
+                cmd = Input(en, INPUT_FOREVER);
+        }
+        else
+        {
+            // only the level on most ticks, the frequency and the squelch
+            // (changed by the user in gqrx) pipelined with it once in a while
+            now = ClockNow();
+            if (now >= next_check)
+            {
+                // tried again on the next tick until the squelch is read
+                if (MonitorLevel(sockfd, current_freq, &squelch, &level))
+                    next_check = now + MONITOR_CHECK;
+            }
+            else
+                MonitorLevel(sockfd, NULL, NULL, &level);
+            if (cmd == INPUT_NONE)
+                cmd = Input(en, 0);
+        }
+        switch (cmd)
+        {
+            case INPUT_SKIP:
+            {
+                exit = 1; // exit
+                skip = true;
+                break;
+            }
+            case INPUT_BAN:
+            {
+                // Ban a frequency
+                BanFreq(&en->sc, *current_freq);
+                exit = 1;
+                skip = true;
+                break;
+            }
+            case INPUT_CLEAR:
+            {
+                // Clear all bans
+                ClearAllBans(&en->sc);
+                exit = 0;
+                break;
+            }
+            case INPUT_PAUSE:
+            {
+                // pause until another 'p'
+                en->paused ^= true; // switch pause mode
+                exit = 0;
+                break;
+            }
+            default:
+                exit = 0;
+
+        }
+        cmd = INPUT_NONE;
+        if (en->paused != paused)
+        {
+            // paused or resumed, by key or command
+            paused = en->paused;
+            if (paused)
+                pause_start = ClockNow();
+            else
+            {
+                listen_start += ClockNow() - pause_start;
+                quiet_since = 0;
+                next_check = 0;
+                StateInvalidate(); // the user may have changed gqrx while paused
+            }
+        }
+        if (exit == 1)
+            break;
+
+        if (en->paused)
+            continue;
+
+        now = ClockNow();
+        audio  = Audio(en);
+        active = (audio == AUDIO_NONE) ? level >= squelch : audio == AUDIO_ACTIVE;
+        if (active != above)
+        {
+            above = !above;
+            crossed_at = now;
+        }
+        if (en->opt.max_listen != 0 && (long)(now - listen_start) >= en->opt.max_listen) {
+            exit = 1;
+            skip = true;
+        }
+
+        if (active)
+        {
+            if (level_count == 0 || level > *peak)
+                *peak = level;
+            level_sum += level;
+            level_count++;
+        }
+        if (en->opt.updates && now >= next_update)
+        {
+            HitUpdate(en, level, (level_count) ? *peak : level, (level_count) ? level_sum / level_count : level);
+            next_update = now + EVENTS_UPDATE;
+        }
+
+        // exit = 0
+        if (!active)
+        {
+            // Signal drop below the threshold, start counting sleep time
+            if (quiet_since == 0)
+                quiet_since = now;
+            if ((long)(now - quiet_since) > delay)
+            {
+
+                exit = 1;
+                skip = false;
+            }
+        }
+        else
+        {
+            quiet_since = 0; //
+        }
+        // someone is tx'ing: wait for the next poll, a key or a command
+        if (!exit)
+        {
+            long wait = (audio == AUDIO_NONE) ? MonitorInterval(level, squelch, (long)(now - crossed_at)) : MONITOR_CHECK;
+            if (quiet_since != 0 && (long)(quiet_since + delay - now) + 1 < wait)
+                wait = (long)(quiet_since + delay - now) + 1;
+            cmd = Input(en, wait);
+        }
+    } while ( !exit && !EngineInterrupted(en) ) ;
+    en->paused = false; // skipping resumes the scan
+
+    if (level_count == 0)
+        *peak = level;
+    *mean = (level_count) ? level_sum / level_count : level;
+
+
+    // restart scanning
+    *current_freq+=g_ban_tollerance;
+    // round up to next near tenth of khz  145892125 -> 145900000
+    *current_freq = ceil( *current_freq / (double)en->opt.scan_bw ) * en->opt.scan_bw;
+
+    Flush(en);
+    return skip;
+}
+
+
+//
+// Dwell
+// Wait for the signal level to settle after tuning a bookmark, as long as the time
+// learned for it (*settle), or as the settle time model predicts for the jump while
+// nothing is learned, and at most max_dwell us. measured is the time waited. Only a settled level updates the time learned for
+// the bookmark and the settle time model, a timeout is not a settle time.
+// Returns true if the level settled.
+//
+bool Dwell (ENGINE *en, long *settle, freq_t from, freq_t to, bool after_active, long max_dwell, long *measured)
+{
+    if (!SettleWait(en->sockfd, &en->sc.settle, from, to, after_active, *settle, max_dwell, measured))
+        return false;
+    *settle = (*settle) ? (3 * (*settle) + *measured) / 4 : *measured;
+    return true;
+}
+
+//
+// ScanBookmarkedFrequenciesInRange
+// Bookmarks between min_freq and max_freq (all of them if equal), until interrupted
+//
+bool ScanBookmarkedFrequenciesInRange(ENGINE *en)
+{
+    SCANNER *sc = &en->sc;
+    int      sockfd = en->sockfd;
+    freq_t   freq_min = en->opt.min_freq;
+    freq_t   freq_max = en->opt.max_freq;
+    double   squelch_delta = en->opt.squelch_delta;
+
+    freq_t freq = 0;
+    GetCurrentFreq(sockfd, &freq);
+    double level = 0;
+    GetSignalLevel(sockfd, &level );
+    double squelch = 0;
+    double squelch_backup = 0;
+    GetSquelchLevel(sockfd, &squelch);
+
+    freq_t current_freq = freq_min;
+
+    bool skip = false;
+    long sleep_cycle_active = 500000;   // skipping from active frequency need more time to wait squelch level to kick in
+    long sleep_cyle_saved   = 85000 ;   // skipping freqeuency need more time to get signal level
+
+    long slow_scan_cycle    = 1000000;   // LWVMOBILE: Just doubling numbers to slow down scan time in bookmark search, 1,000,000 = 1 second. EDIT: DOES THIS VARIABLE DO ANYTHING?
+    long slow_cycle_saved   = 250000;  // LWVMOBILE: Just doubling numbers to slow down scan time in bookmark search. THIS ONE SEEMS TO ACTUALLY SLOW SCAN SPEED DOWN.
+    freq_t last_tuned = freq;
+    int visits = 0, next_priority = 0;
+    while (!EngineInterrupted(en))
+    {
+        clock_us_t pass_start = ClockNow();
+        uint64_t   pass_steps = 0;
+        CheckUserInput(en);
+
+        for (int k = 0; k < sc->freq_max && !EngineInterrupted(en); k++)
+        {
+            int i = k;
+            if (sc->priority_max > 0 && ++visits % PRIORITY_INTERVAL == 0)
+            {
+                // revisit a priority bookmark, the current one is next
+                i = sc->priority_index[next_priority++ % sc->priority_max];
+                k--;
+            }
+            Dispatch(en);
+
+            if (sc->freqs[i].noise_floor == 0)
+                sc->freqs[i].noise_floor = level;
+
+            //printf("\rNoise floor: %2.2f  ", sc->freqs[i].noise_floor);
+            //fflush(stdout);
+
+            if ((current_freq = FilterFrequency(sc, i)) == (freq_t) 0 )
+                continue;
+            if (IsBannedFreq(sc, &current_freq))
+                continue;
+            if ( ( ( current_freq >= freq_min) &&         // in the valid range
+                   ( current_freq <  freq_max)    ) ||
+                 (freq_min == freq_max)                )  // or using the entire frequencies
+                {
+                    // Found a bookmark in the range
+                    clock_us_t step = SpanBegin();
+                    SetFreq(sockfd, current_freq);
+                    Tuned(en, current_freq);
+                    MetricAdd(METRIC_STEPS, 1);
+                    pass_steps++;
+                    GetSquelchLevel(sockfd, &squelch);
+                    // en->opt.speed (or 1 sec after an active frequency) is now the upper bound of the dwell,
+                    // the actual time is the one learned for the bookmark, or predicted for the jump
+                    long dwell;
+                    bool settled = Dwell(en, &sc->freqs[i].settle, last_tuned, current_freq,
+                                         skip, (skip)?slow_scan_cycle:en->opt.speed, &dwell);
+                    last_tuned = current_freq;
+                    MetricSet(METRIC_SLEEP_CYCLE, dwell);
+                    if (en->opt.verbose)
+                    {
+                        char str[FREQ_STRING_SIZE];
+                        printf("\nFreq: %s dwell: %ld ms%s learned: %ld ms\n", FormatFreq(current_freq, str, sizeof(str)),
+                               dwell/1000, (settled) ? "" : " (timeout)", sc->freqs[i].settle/1000);
+                        fflush (stdout);
+                    }
+                    GetSignalLevelEx(sockfd, &level, 5 );
+                    bool detected = ScannerDetect(sc, i, level, squelch);
+                    if (detected && Rejected(en, current_freq, i))
+                    {
+                        // traffic for another tone or code
+                        skip = true;
+                        OccupancyMark(&en->occupancy, current_freq, time(NULL), true);
+                    }
+                    else if (detected)
+                    {
+                        if (en->opt.record)
+                        {
+                            StartRecording(sockfd);
+                        }
+                        time_t hit_time = time(NULL);
+                        freq_t hit_freq = current_freq;
+                        double squelch_set = sc->freqs[i].noise_floor + squelch_delta;
+                        double listen_squelch;
+                        bool   restore = false;
+                        if (en->opt.squelch_delta_auto)
+                        {
+                            squelch_backup = squelch;
+                            SetSquelchLevel(sockfd, squelch_set);
+                        }
+                        else if (ScannerListenSquelch(sc, i, &listen_squelch))
+                        {
+                            squelch_backup = squelch;
+                            restore = true;
+                            SetSquelchLevel(sockfd, listen_squelch);
+                        }
+                        double peak, mean;
+                        Hit(en, EVENT_HIT_START, hit_freq, i, sc->freqs[i].descr, level, squelch, squelch_set,
+                                hit_time, level, level);
+                        clock_us_t listen = SpanBegin();
+                        skip = WaitUserInputOrDelay(en, en->opt.delay, &current_freq, &peak, &mean);
+                        SpanEnd(SPAN_LISTEN, listen, hit_freq);
+                        if (en->opt.record)
+                        {
+                            StopRecording(sockfd);
+                        }
+                        Hit(en, EVENT_HIT_END, hit_freq, i, sc->freqs[i].descr, level, squelch, squelch_set,
+                                hit_time, peak, mean);
+                        OccupancyMarkBusy(&en->occupancy, hit_freq, hit_time, time(NULL));
+                        if (en->opt.squelch_delta_auto || restore) SetSquelchLevel(sockfd, squelch_backup);
+                    }
+                    else
+                    {
+                        sc->freqs[i].noise_floor = (sc->freqs[i].noise_floor + level)/2;
+                        skip = false;
+                        OccupancyMark(&en->occupancy, current_freq, time(NULL), false);
+                    }
+                    SpanEnd(SPAN_STEP, step, sc->freqs[i].freq);
+                }
+        }
+        SpanEnd(SPAN_PASS, pass_start, 0);
+        MetricAdd(METRIC_PASSES, 1);
+        MetricSet(METRIC_PASS_STEPS, pass_steps);
+        MetricSet(METRIC_PASS_DURATION, ClockNow() - pass_start);
+        if (en->opt.verbose)
+        {
+            printf("\nBookmarks pass (revisit time): %llu ms\n", (unsigned long long)(ClockNow() - pass_start)/1000);
+            fflush (stdout);
+        }
+
+    }
+    return true;
+}
+
+
+
+//
+// Debounce
+// Look again once the settle time of the tune from 'from' has passed once more
+//
+bool Debounce (ENGINE *en, freq_t from, freq_t current_freq, bool after_active, int bin, double level)
+{
+    SCANNER *sc = &en->sc;
+    int      sockfd = en->sockfd;
+    double current_level = level;
+    double squelch;
+    long   wait = SETTLE_SPAN * SettlePredict(&sc->settle, from, current_freq, after_active);
+    SleepFor((wait < DEBOUNCE_MAX) ? wait : DEBOUNCE_MAX);
+    GetSignalLevelEx( sockfd, &current_level, 5 );
+    GetSquelchLevel ( sockfd, &squelch );
+
+    if (!ScannerDetect(sc, bin, current_level, squelch))
+        return false; // signal lost or ghost
+    else
+        return true;
+
+}
+
+//
+// BacktrackFrequency
+// got a signal but lost it
+// move back to find it again more slowly
+//
+freq_t BacktrackFrequency(ENGINE *en, freq_t current_freq, freq_t freq_interval, int numberOfIntervals, freq_t freq_min, freq_t freq_max)
+{
+    SCANNER *sc = &en->sc;
+    int      sockfd = en->sockfd;
+    double squelch = 0;
+    double level = 0;
+    int i;
+
+    for (i=0 ; i < numberOfIntervals ; i++)
+    {
+        freq_t previous_freq = current_freq;
+        current_freq -= freq_interval;
+        if (current_freq < freq_min)
+            current_freq = freq_max - freq_interval ;
+        GetSquelchLevel(sockfd, &squelch);
+        SetFreq(sockfd, current_freq);
+        Tuned(en, current_freq);
+        long   measured;
+        SettleWait(sockfd, &sc->settle, previous_freq, current_freq, false, 0, TUNE_MAX, &measured);
+        // tries to average out spikes, 5 sample
+        GetSignalLevelEx( sockfd, &level, 5);
+        if (ScannerDetect(sc, (int)((current_freq - freq_min) / freq_interval), level, squelch))
+        {
+            //found it again
+            break;
+        }
+    }
+    return current_freq;
+}
+
+//
+// Tune
+// Set the frequency and wait for the level to settle as the model predicts, at most max_wait us
+//
+static void Tune (ENGINE *en, freq_t *tuned_freq, freq_t freq, long max_wait)
+{
+    long measured;
+
+    MetricAdd(METRIC_ADJUST_PROBES, 1);
+    SetFreq(en->sockfd, freq);
+    SettleWait(en->sockfd, &en->sc.settle, *tuned_freq, freq, false, 0, max_wait, &measured);
+    *tuned_freq = freq;
+}
+
+//
+// AdjustFrequency
+// Fine tuning to reach max level
+// Perform a sweep between -15+15Khz around current_freq with 5kHz steps
+// Return the found frequency
+//
+freq_t AdjustFrequency(ENGINE *en, freq_t current_freq, freq_t freq_interval)
+{
+    SCANNER *sc = &en->sc;
+    int      sockfd = en->sockfd;
+    freq_t freq_min   = current_freq - 10000;
+    freq_t freq_max   = current_freq + 10000;
+    freq_t freq_steps = freq_interval;
+    long max_levels = (freq_max - freq_min + freq_steps - 1) / freq_steps ; // rounded up, the loop probes every step below freq_max
+    typedef struct { double level; freq_t freq; } LEVELS;
+    LEVELS levels[max_levels];
+    int    l = 0;
+    double squelch = 0;
+    freq_t tuned_freq = current_freq;
+
+    GetSquelchLevel(sockfd, &squelch);
+
+    double level = 0;
+    for (current_freq = freq_min; current_freq < freq_max; current_freq += freq_steps)
+    {
+        Tune(en, &tuned_freq, current_freq, TUNE_MAX);
+        // tries to average out spikes, 5 sample
+        GetSignalLevelEx( sockfd, &level, 5);
+        levels[l].level = level;
+        levels[l].freq  = current_freq;
+        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
+        //fflush(stdout);
+        l++;
+    }
+
+    double current_level = levels[0].level;
+    double previous_level = current_level;
+    int    start = 0;
+    int    end   = max_levels;
+    for (l = 0; l < max_levels; l++)
+    {
+        if (levels[l].level >= current_level)
+        {
+            current_level = levels[l].level;
+            start = end = l;
+        }
+    }
+
+    l = start + (end-start)/2;
+    current_freq = levels[l].freq;
+    Tune(en, &tuned_freq, current_freq, TUNE_MAX);
+
+    // before second pass fine tuning we check if the frequency is already known (and tuned with a mean value computed)
+    // See SaveFreq
+    freq_t tollerance = 7000;
+    bool found = false;
+    for (int i = 0; i < sc->saved_max; i++)
+    {
+        // Find a previous hit with some tollerance
+        if (current_freq >= (sc->saved[i].freq - tollerance) &&
+            current_freq <  (sc->saved[i].freq + tollerance)   )
+        {
+            if (sc->saved[i].count > 4) // 4 fine tuned frequency is good enough to have a candidate freq
+            {
+                current_freq = sc->saved[i].freq;
+                found = true;
+                break;
+            }
+        }
+    }
+
+    if (found)
+    {
+        Tune(en, &tuned_freq, current_freq, TUNE_MAX);
+        // Cheating: here I return the rough value from the first pass to avoid stucking on possibly wrong freq.
+        return levels[l].freq;
+    }
+
+    // Second pass - Fine tuning + - 5Khz (freq_steps input) with 1 khz steps
+    // Dived in two half, follow one until the level decreases if so follow the second half
+    // (hopefully this reduces the num of steps), tries to average out spikes, 3 sample
+    double reference_level;
+    GetSignalLevelEx( sockfd, &reference_level, 5);
+    freq_t   reference_freq  = current_freq;
+    freq_min   = current_freq - 5000;
+    freq_max   = current_freq + 5000;
+    freq_steps = 1000; // 1 Khz fine tuning
+    max_levels = (freq_max - freq_min) / freq_steps ;
+    LEVELS levels2[max_levels];
+    l = 0;
+    // upper half
+    for (current_freq = reference_freq + freq_steps; current_freq < freq_max; current_freq += freq_steps)
+    {
+        Tune(en, &tuned_freq, current_freq, TUNE_MAX);
+        // tries to average out spikes, 5 sample
+        GetSignalLevelEx( sockfd, &level, 5);
+
+        if (level < reference_level)
+        {
+            // this way the signal is decreasing, stop
+            break;
+        }
+        levels2[l].level = level;
+        levels2[l].freq  = current_freq;
+        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
+        //fflush(stdout);
+        l++;
+    }
+    // lower half
+    for (current_freq = reference_freq - freq_steps; current_freq >= freq_min; current_freq-= freq_steps )
+    {
+        Tune(en, &tuned_freq, current_freq, TUNE_MAX);
+        // tries to average out spikes, 5 sample
+        GetSignalLevelEx( sockfd, &level, 5);
+
+        if (level < reference_level)
+        {
+            // this way signal is decreasing, stop
+            break;
+        }
+        levels2[l].level = level;
+        levels2[l].freq  = current_freq;
+        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
+        //fflush(stdout);
+        l++;
+    }
+    // If no candidates found
+    if (l == 0) // we are good, already in the middle
+    {
+        SetFreq(sockfd, reference_freq);
+        return reference_freq;
+    }
+
+    // Here we have levels2 from 0 to n the first half and from n to l the second half
+    // Find out the maximum level frequency
+    current_level = levels[0].level;
+    previous_level = current_level;
+    start = 0;
+    end   = max_levels;
+    for (int i = 0; i < l; i++)
+    {
+        if (levels2[i].level > current_level)
+        {
+            current_level = levels2[i].level;
+            start = end = i;
+        }
+    }
+    l = start;
+    current_freq = levels2[l].freq;
+    SetFreq(sockfd, current_freq);
+
+    return current_freq;
+
+}
+
+//
+// ScanFrequenciesInRange
+// Sweep from min_freq to max_freq by scan_bw, until interrupted
+//
+bool ScanFrequenciesInRange(ENGINE *en)
+{
+    SCANNER *sc = &en->sc;
+    int      sockfd = en->sockfd;
+    freq_t   freq_min = en->opt.min_freq;
+    freq_t   freq_max = en->opt.max_freq;
+    freq_t   freq_interval = en->opt.scan_bw;
+    double   squelch_delta = en->opt.squelch_delta;
+    freq_t freq = 0;
+    GetCurrentFreq(sockfd, &freq);
+    double level = 0;
+    GetSignalLevel(sockfd, &level );
+    double squelch = 0;
+    double squelch_backup = 0;
+    GetSquelchLevel(sockfd, &squelch);
+
+    size_t freqeuencies_count = ((freq_max-freq_min)/freq_interval); //for loop boundary
+
+    freq_t current_freq = freq_min;
+
+    SetFreq(sockfd, freq_min);
+    int saved_idx = 0, current_saved_idx = 0;
+    int sweep_count = 0;
+    freq_t last_freq = freq_min; // where the sweep resumes after the saved frequencies
+    bool saved_cycle = false;
+    // minimum hit threshold on frequency already seen (count): above this the freq is a candidate
+    int min_hit_threshold = 2;
+    // maximum miss threshold on frequencies not seen anymore: above this the candidate count is decremented
+    // note: during monitoring on active freq the counter can reach high values so this threshold should not be too high
+    // otherwise the chance to exclude the freq is very low and will continue to monitor even after prolonged inactive time
+    int max_miss_threshold = 20;
+    long sleep_cyle         = 0;      // wait after setting freq to get signal level, predicted by the settle time model
+    freq_t tuned_freq       = freq_min; // last frequency set, the settle time depends on the jump from it
+    freq_t tuned_from       = freq_min;
+    bool after_active       = false;
+    bool skip = false;   // user input
+    int  success_counter    = 0;  // number of correctly acquired signals, reset on bad signals or reaching success_factor
+    int  success_factor     = 5; // improving sleep cycle every success_factor of times
+
+    if (en->survey.fd >= 0)
+        SurveyRange(&en->survey, freq_min, freq_max, freq_interval);
+
+    while (!EngineInterrupted(en))
+    {
+        clock_us_t pass_start = ClockNow();
+        clock_us_t step = 0;
+        freq_t     step_freq = 0;
+        size_t     surveyed = 0; // bins skipped on the survey
+        SurveyPoll(&en->survey);
+        for ( size_t i = 0 ; i < freqeuencies_count && !EngineInterrupted(en); i++)
+        {
+            SpanEnd(SPAN_STEP, step, step_freq); // the previous step, whatever way it ended
+            step = 0;
+            CheckUserInput(en);
+
+            IsBannedFreq(sc, &current_freq); // test and change current_frequency to next available slot;
+            if (!saved_cycle && !SurveyCandidate(&en->survey, current_freq))
+            {
+                // no energy there in the survey, not worth a round trip
+                MetricAdd(METRIC_SURVEY_SKIPS, 1);
+                surveyed++;
+                current_freq+=freq_interval;
+                if (current_freq > freq_max)
+                    current_freq = freq_min;
+                continue;
+            }
+            step      = SpanBegin();
+            step_freq = current_freq;
+            clock_us_t tuned_at = ClockNow(); // the settle time (the sleep deadline) runs from the tune request
+            SetFreq(sockfd, current_freq);
+            clock_us_t settle = SpanBegin();  // the settle span starts where SPAN_TUNE ends
+            Tuned(en, current_freq);
+            MetricAdd(METRIC_STEPS, 1);
+            // skipping from active frequency need more time to wait squelch level to kick in,
+            // jumping to a saved frequency need more time to get signal level: the model knows both
+            after_active = skip;
+            tuned_from   = tuned_freq;
+            tuned_freq   = current_freq;
+            sleep_cyle   = SettlePredict(&sc->sweep, tuned_from, current_freq, after_active);
+            MetricSet(METRIC_SLEEP_CYCLE, sleep_cyle);
+            SleepUntil(tuned_at + sleep_cyle);
+            SpanEnd(SPAN_SETTLE, settle, current_freq);
+
+            GetSquelchLevel(sockfd, &squelch);
+            GetSignalLevelEx(sockfd, &level, 5 );
+            WaterfallSet(&en->waterfall, current_freq, level);
+
+            if (sc->freqs[i].noise_floor == 0)
+                sc->freqs[i].noise_floor = level;
+
+            //printf("\rNoise floor: %2.2f  ", sc->freqs[i].noise_floor);
+            //fflush(stdout);
+
+            if (en->opt.verbose)
+            {
+                char str[FREQ_STRING_SIZE];
+                printf("\nFreq: %s Signal: %2.2f Squelch: %2.2f\n", FormatFreq(current_freq, str, sizeof(str)),
+                       level, squelch);
+                fflush (stdout);
+            }
+
+            int bin = (int)((current_freq - freq_min) / freq_interval);
+            if (ScannerDetect(sc, bin, level, squelch))
+            {
+                // we have a possible match, but sometimes level oscillates after a squelch miss
+                clock_us_t debounce = SpanBegin();
+                bool still_good = Debounce(en, tuned_from, current_freq, after_active, bin, level);
+                SpanEnd(SPAN_DEBOUNCE, debounce, current_freq);
+                if (!still_good)
+                {
+                    MetricAdd(METRIC_DEBOUNCE_REJECTS, 1);
+                    // Signal lost
+                    // it could be a ghosts signal because we are running too fast, slow down a bit
+                    success_counter = 0; // stop incrementing sleep cycle for a while
+                    SettleFeedback(&sc->sweep, tuned_from, current_freq, after_active, 5000); // add penality
+                    if (en->opt.verbose)
+                    {
+                        printf("Missing signal. Slowing down: %ld ms wait time.\n",
+                               SettlePredict(&sc->sweep, tuned_from, current_freq, after_active)/1000);
+                        fflush (stdout);
+                    }
+                    // tries to recover to get back the signal, check our steps...
+                    if (!saved_cycle)
+                    {
+                        MetricAdd(METRIC_BACKTRACKS, 1);
+                        clock_us_t backtrack = SpanBegin();
+                        current_freq = BacktrackFrequency(en, current_freq, freq_interval, 4, freq_min, freq_max);
+                        SpanEnd(SPAN_BACKTRACK, backtrack, current_freq);
+                        tuned_freq = current_freq;
+                        if (IsBannedFreq(sc, &current_freq))
+                        {
+                            skip = true;
+                        }
+                    }
+                    continue;
+                }
+                else
+                {
+                    // Frequency acquired successfully
+                    // Or.. we could have jumped on another frequency with a valid signal nearby.
+                    success_counter++;
+                    if (success_counter > success_factor)
+                    {
+                        // Increase speed a little bit in order to compensates signal lost because of bad luck
+                        // while we moved the frequency (signal disappearing)
+                        SettleFeedback(&sc->sweep, tuned_from, current_freq, after_active, -1000); // add a reward
+                        if (en->opt.verbose)
+                        {
+                            printf("Signals acquired successfully. Speeding up: %ld ms wait time.\n",
+                                   SettlePredict(&sc->sweep, tuned_from, current_freq, after_active)/1000);
+                            fflush (stdout);
+                        }
+                        success_counter = 0; // stop decrementing sleep cycle for a while
+                    }
+                }
+                clock_us_t adjust = SpanBegin();
+                current_freq = AdjustFrequency(en, current_freq, freq_interval/2);
+                SpanEnd(SPAN_ADJUST, adjust, current_freq);
+                tuned_freq = current_freq;
+                if (IsBannedFreq(sc, &current_freq))
+                {
+                    skip = true;
+                }
+                else if (Rejected(en, current_freq, -1))
+                {
+                    // traffic for another tone or code, move past it
+                    OccupancyMark(&en->occupancy, current_freq, time(NULL), true);
+                    current_freq = ceil((current_freq + g_ban_tollerance) / (double)en->opt.scan_bw) * en->opt.scan_bw;
+                    skip = true;
+                }
+                else
+                {
+                    SaveFreq(sc, current_freq);
+                    if (en->opt.record)
+                    {
+                        StartRecording(sockfd);
+                    }
+                    double listen_squelch;
+                    bool   restore = false;
+                    if (en->opt.squelch_delta_auto){
+                        squelch_backup = squelch;
+                        SetSquelchLevel(sockfd, sc->freqs[i].noise_floor + squelch_delta);
+                    }
+                    else if (ScannerListenSquelch(sc, bin, &listen_squelch))
+                    {
+                        squelch_backup = squelch;
+                        restore = true;
+                        SetSquelchLevel(sockfd, listen_squelch);
+                    }
+
+                    time_t hit_time = time(NULL);
+                    freq_t hit_freq = current_freq;
+                    double peak, mean;
+                    Hit(en, EVENT_HIT_START, hit_freq, -1, NULL, level, squelch,
+                            sc->freqs[i].noise_floor + squelch_delta, hit_time, level, level);
+                    // Wait user input or delay time after signal lost
+                    clock_us_t listen = SpanBegin();
+                    skip = WaitUserInputOrDelay(en, en->opt.delay, &current_freq, &peak, &mean);
+                    SpanEnd(SPAN_LISTEN, listen, hit_freq);
+                    if (en->opt.record)
+                    {
+                        StopRecording(sockfd);
+                    }
+                    Hit(en, EVENT_HIT_END, hit_freq, -1, NULL, level, squelch,
+                            sc->freqs[i].noise_floor + squelch_delta, hit_time, peak, mean);
+                    OccupancyMarkBusy(&en->occupancy, hit_freq, hit_time, time(NULL));
+                    if (en->opt.squelch_delta_auto || restore) SetSquelchLevel(sockfd, squelch_backup);
+                }
+                if (skip)
+                {
+                    sweep_count = 0; // reactivate sweep scan
+                    continue; // go to the next freq set in current_freq
+                }
+            }
+            else
+            {
+                skip = false;
+                sc->freqs[i].noise_floor = (sc->freqs[i].noise_floor + level)/2;
+                OccupancyMark(&en->occupancy, current_freq, time(NULL), false);
+                // no activities
+                if (saved_cycle)
+                {
+                    // miss count on already seen frequency
+                    if (++sc->saved[current_saved_idx].miss > max_miss_threshold)
+                    {
+                        sc->saved[current_saved_idx].count--;
+                        sc->saved[current_saved_idx].miss = 0;
+                    }
+                }
+            }
+
+            // Loop saved freq after a while
+            if (sweep_count > 40)
+            {
+                if (!saved_cycle)
+                {
+                    // start cycling on saved frequencies
+                    last_freq = current_freq;
+                    saved_cycle = true;
+                }
+                // search candidates into saved frequencies
+                while ( (sc->saved[saved_idx].count < min_hit_threshold) && //hit threshold
+                        (saved_idx < sc->saved_max) )
+                {
+                    saved_idx++;
+                }
+                if (saved_idx >= sc->saved_max)
+                {
+                    saved_idx = 0;
+                    sweep_count = 0; // reactivates sweep scan
+                    saved_cycle = false;
+                    current_freq = last_freq;
+                    current_freq = ceil( current_freq / (double)en->opt.scan_bw ) * en->opt.scan_bw;
+                }
+                else // found one
+                {
+                    current_freq = sc->saved[saved_idx].freq;
+                    current_saved_idx = saved_idx;
+                    saved_idx++;
+                    if (saved_idx >= sc->saved_max)
+                        saved_idx = 0;
+                    continue;
+                }
+            }
+            current_freq+=freq_interval;
+            if (current_freq > freq_max)
+                current_freq = freq_min;
+            sweep_count++;
+        }
+        SpanEnd(SPAN_STEP, step, step_freq);
+        SpanEnd(SPAN_PASS, pass_start, 0);
+        WaterfallCommit(&en->waterfall);
+        MetricAdd(METRIC_PASSES, 1);
+        MetricSet(METRIC_PASS_STEPS, freqeuencies_count);
+        MetricSet(METRIC_PASS_DURATION, ClockNow() - pass_start);
+        if (en->opt.verbose)
+        {
+            printf("\nSweep pass: %llu ms\n", (unsigned long long)(ClockNow() - pass_start)/1000);
+            if (en->survey.fd >= 0)
+                printf("Survey: %zu bins skipped\n", surveyed);
+            fflush (stdout);
+        }
+        if (surveyed >= freqeuencies_count)
+            SleepFor(SURVEY_IDLE); // nothing to probe until the next snapshot
+    }
+    return true;
+}
+
+
+
@@ -0,0 +1,107 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_ENGINE_H_
+#define _GQRX_ENGINE_H_
+
+#include <stdbool.h>
+#include <signal.h>
+#include <time.h>
+#include "gqrx-prot.h"
+#include "gqrx-scanner.h"
+#include "gqrx-events.h"
+#include "gqrx-input.h"
+#include "gqrx-audio.h"
+#include "gqrx-hitlog.h"
+#include "gqrx-occupancy.h"
+#include "gqrx-survey.h"
+#include "gqrx-waterfall.h"
+
+//
+// Scan engine (libgqrxscan)
+//
+// The sweep and bookmark loops on a SCANNER context, with their options, their
+// sinks (hit log, occupancy, survey, waterfall), the pause and restart flags and
+// one connection to gqrx. What the loops need from a front end (keys, control
+// commands, hit output, audio) goes through the hooks, any of them can be NULL.
+// Everything is in the ENGINE, so several engines can scan on their own threads.
+//
+#define DEBOUNCE_MAX    300000  // 300 ms, the longest second look at a sweep detection
+#define TUNE_MAX        150000  // 150 ms, the longest settle of a backtrack or fine tuning step
+
+typedef struct ENGINE ENGINE;
+
+typedef struct {
+    freq_t  min_freq;
+    freq_t  max_freq;
+    freq_t  scan_bw;            // sweep step
+    double  squelch_delta;      // listening squelch above the noise floor
+    bool    squelch_delta_auto;
+    long    delay;              // us after the carrier is gone
+    long    speed;              // us, upper bound of a bookmark dwell
+    long    max_listen;         // us, 0 = no limit
+    bool    record;
+    bool    verbose;
+    bool    updates;            // hit updates every EVENTS_UPDATE while listening
+} ENGINE_OPTIONS;
+
+typedef struct {
+    void          (*dispatch)(ENGINE *en);                  // control commands, on the scan thread
+    INPUT_COMMAND (*input)(ENGINE *en, long timeout);       // next key, 0: poll, us or INPUT_FOREVER: wait
+    void          (*hit)(ENGINE *en, const EVENT *event);   // start, updates and end of a hit
+    void          (*tuned)(ENGINE *en, freq_t freq);        // after every retune
+    bool          (*rejected)(ENGINE *en, freq_t freq, int bookmark); // active, but not wanted (tones)
+    AUDIO_STATE   (*audio)(ENGINE *en);                     // activity from the audio stream
+} ENGINE_HOOKS;
+
+struct ENGINE {
+    SCANNER         sc;
+    ENGINE_OPTIONS  opt;
+    ENGINE_HOOKS    hooks;
+    void           *user;       // of the front end, for the hooks
+    int             sockfd;     // connection to gqrx
+    HIT_LOG         hitlog;     // written by the front end with the ended hits
+    OCCUPANCY       occupancy;
+    SURVEY          survey;     // sweep only
+    WATERFALL       waterfall;  // sweep only
+    volatile sig_atomic_t quit; // the loops return, may be set by a signal handler
+    bool            paused;     // by 'p' or the pause command
+    bool            restart;    // range, step or tags changed, the loops return
+    freq_t          freq;       // last frequency tuned by the loops
+    EVENT           listened;   // the hit being listened to, for the updates
+};
+
+void   EngineInit(ENGINE *en);
+void   EngineFree(ENGINE *en);
+bool   EngineInterrupted(const ENGINE *en);
+void   CheckUserInput(ENGINE *en);
+bool   WaitUserInputOrDelay(ENGINE *en, long delay, freq_t *current_freq, double *peak, double *mean);
+bool   Dwell(ENGINE *en, long *settle, freq_t from, freq_t to, bool after_active, long max_dwell, long *measured);
+bool   Debounce(ENGINE *en, freq_t from, freq_t current_freq, bool after_active, int bin, double level);
+freq_t BacktrackFrequency(ENGINE *en, freq_t current_freq, freq_t freq_interval, int numberOfIntervals,
+                          freq_t freq_min, freq_t freq_max);
+freq_t AdjustFrequency(ENGINE *en, freq_t current_freq, freq_t freq_interval);
+bool   ScanFrequenciesInRange(ENGINE *en);
+bool   ScanBookmarkedFrequenciesInRange(ENGINE *en);
+
+#endif /* _GQRX_ENGINE_H_ */
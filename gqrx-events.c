@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // pipe2
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "gqrx-events.h"
+
+static EVENT            ring[EVENTS_RING_SIZE];
+static atomic_ulong     ring_head;      // written by the producer
+static atomic_ulong     ring_tail;      // written by the consumer
+static atomic_ulong     dropped;
+static atomic_bool      running;
+static pthread_t        consumer;
+static EVENT_HANDLER    event_handler;
+static EVENT_IDLE       event_idle;
+static int              wake[2] = { -1, -1 };
+
+//
+// EventSetBookmark
+// Copy the description and the tags, truncated to the event sizes
+//
+void EventSetBookmark (EVENT *event, const char *descr, char **tags, int tag_max)
+{
+    snprintf(event->descr, sizeof(event->descr), "%s", (descr) ? descr : "");
+    event->tag_max = 0;
+    for (int k = 0; k < tag_max && k < EVENT_TAG_MAX; k++)
+        snprintf(event->tags[event->tag_max++], EVENT_TAG_SIZE, "%s", tags[k]);
+}
+
+//
+// EventPush
+// Never blocks: returns false if the ring is full and the event is dropped
+//
+bool EventPush (const EVENT *event)
+{
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_relaxed);
+    unsigned long tail = atomic_load_explicit(&ring_tail, memory_order_acquire);
+
+    if (head - tail >= EVENTS_RING_SIZE)
+    {
+        atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+        return false;
+    }
+    ring[head & (EVENTS_RING_SIZE - 1)] = *event;
+    atomic_store_explicit(&ring_head, head + 1, memory_order_release);
+    if (head == tail && wake[1] >= 0)
+    {
+        char c = 0;
+        if (write(wake[1], &c, 1) < 0) {} // full: the consumer is awake anyway
+    }
+    return true;
+}
+
+unsigned long EventsDropped (void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+//
+// Drain
+// Hand all the queued events to the handler, report new drops
+//
+static void Drain (unsigned long *reported)
+{
+    unsigned long tail = atomic_load_explicit(&ring_tail, memory_order_relaxed);
+    unsigned long head = atomic_load_explicit(&ring_head, memory_order_acquire);
+
+    while (tail != head)
+    {
+        event_handler(&ring[tail & (EVENTS_RING_SIZE - 1)]);
+        tail++;
+        atomic_store_explicit(&ring_tail, tail, memory_order_release);
+    }
+
+    unsigned long lost = EventsDropped();
+    if (lost != *reported)
+    {
+        printf ("\n[%lu events dropped, %lu total]\n", lost - *reported, lost);
+        *reported = lost;
+    }
+    fflush(stdout);
+}
+
+static void *Consumer (void *arg)
+{
+    unsigned long reported = 0;
+    (void) arg;
+
+    while (atomic_load(&running))
+    {
+        if (atomic_load_explicit(&ring_tail, memory_order_relaxed) ==
+            atomic_load_explicit(&ring_head, memory_order_acquire))
+        {
+            struct pollfd pfd = { wake[0], POLLIN, 0 };
+            char buf[64];
+            if (poll(&pfd, 1, EVENTS_POLL / 1000) > 0)
+                while (read(wake[0], buf, sizeof(buf)) > 0)
+                    ;
+            else if (event_idle != NULL)
+                event_idle();
+            continue;
+        }
+        Drain(&reported);
+    }
+    Drain(&reported);
+    return NULL;
+}
+
+//
+// EventsStart
+// Start the consumer thread calling handler for every event, and idle (if not NULL)
+// when no event came for EVENTS_POLL
+//
+bool EventsStart (EVENT_HANDLER handler, EVENT_IDLE idle)
+{
+    event_handler = handler;
+    event_idle    = idle;
+    if (pipe2(wake, O_CLOEXEC) != 0)
+        return false;
+    fcntl(wake[0], F_SETFL, O_NONBLOCK);
+    fcntl(wake[1], F_SETFL, O_NONBLOCK);
+    atomic_store(&running, true);
+    if (pthread_create(&consumer, NULL, Consumer, NULL) != 0)
+    {
+        atomic_store(&running, false);
+        return false;
+    }
+    return true;
+}
+
+//
+// EventsStop
+// Flush the pending events and stop the consumer thread
+//
+void EventsStop (void)
+{
+    if (!atomic_load(&running))
+        return;
+    atomic_store(&running, false);
+    pthread_join(consumer, NULL);
+    close(wake[0]);
+    close(wake[1]);
+    wake[0] = wake[1] = -1;
+}
@@ -0,0 +1,82 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_EVENTS_H_
+#define _GQRX_EVENTS_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include "gqrx-prot.h"
+
+//
+// Hit events
+//
+// The scan loop pushes fixed size records in a lock-free single producer /
+// single consumer ring; a consumer thread formats and writes them, so a slow
+// stdout never stalls the scan. When the ring is full events are dropped and counted.
+// A push on an empty ring wakes the consumer through a non-blocking pipe.
+//
+#define EVENTS_RING_SIZE    1024    // power of 2
+#define EVENTS_POLL         10000   // consumer poll time when idle, 10 ms
+#define EVENTS_UPDATE       1000000 // hit updates while listening, every second
+#define EVENT_DESCR_SIZE    128     // the bookmark strings are copied, a reload may free them
+#define EVENT_TAG_MAX       8
+#define EVENT_TAG_SIZE      32
+
+typedef enum
+{
+    EVENT_HIT_START,
+    EVENT_HIT_UPDATE,           // still active, level statistics so far
+    EVENT_HIT_END
+} EVENT_TYPE;
+
+typedef struct {
+    EVENT_TYPE  type;
+    time_t      time;           // wall clock time of the event
+    int64_t     stamp;          // the same in us
+    freq_t      freq;
+    double      level;
+    double      squelch;
+    double      squelch_set;    // listening squelch set by the auto squelch delta
+    bool        squelch_auto;
+    long        duration;       // seconds, for EVENT_HIT_END
+    time_t      start;          // wall clock time of the hit start
+    double      peak;           // level statistics while listening, for EVENT_HIT_END
+    double      mean;
+    int         bookmark;       // bookmark index, -1 in sweep mode
+    char        descr[EVENT_DESCR_SIZE];            // bookmark description, empty in sweep mode
+    char        tags[EVENT_TAG_MAX][EVENT_TAG_SIZE]; // bookmark tags
+    int         tag_max;
+} EVENT;
+
+typedef void (*EVENT_HANDLER)(const EVENT *event);
+typedef void (*EVENT_IDLE)(void);   // housekeeping on the consumer thread, at least every EVENTS_POLL when idle
+
+bool EventsStart(EVENT_HANDLER handler, EVENT_IDLE idle);
+void EventsStop(void);
+void EventSetBookmark(EVENT *event, const char *descr, char **tags, int tag_max);
+bool EventPush(const EVENT *event);
+unsigned long EventsDropped(void);
+
+#endif /* _GQRX_EVENTS_H_ */
@@ -0,0 +1,537 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include "gqrx-hitlog.h"
+
+#define ROW_SIZE    (sizeof(int64_t) * 2 + sizeof(uint64_t) + sizeof(float) * 3 + sizeof(int32_t))
+#define BLOCK_SIZE(rows) (sizeof(HITLOG_BLOCK) + (uint64_t)(rows) * ROW_SIZE)
+#define MAX_THREADS 16
+
+//
+// ValidEnd
+// Offset of the end of the last complete block
+//
+static uint64_t ValidEnd (const char *base, uint64_t size)
+{
+    uint64_t offset = sizeof(HITLOG_HEADER);
+    while (offset + sizeof(HITLOG_BLOCK) <= size)
+    {
+        const HITLOG_BLOCK *block = (const HITLOG_BLOCK *)(base + offset);
+        if (block->magic != HITLOG_BLOCK_MAGIC || block->rows == 0 || block->rows > HITLOG_BLOCK_ROWS ||
+            offset + BLOCK_SIZE(block->rows) > size)
+            break;
+        offset += BLOCK_SIZE(block->rows);
+    }
+    return offset;
+}
+
+static bool CheckHeader (const HITLOG_HEADER *header)
+{
+    return header->magic == HITLOG_MAGIC && header->version == HITLOG_VERSION;
+}
+
+//
+// HitLogOpen
+// Open or create the log for appending. A truncated last block is cut away.
+//
+bool HitLogOpen (HIT_LOG *log, const char *path)
+{
+    struct stat st;
+
+    memset(log, 0, sizeof(*log));
+    log->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (log->fd < 0)
+        return false;
+    if (fstat(log->fd, &st) != 0)
+        goto fail;
+
+    if (st.st_size == 0)
+    {
+        HITLOG_HEADER header = { HITLOG_MAGIC, HITLOG_VERSION, 0 };
+        if (write(log->fd, &header, sizeof(header)) != sizeof(header))
+            goto fail;
+    }
+    else
+    {
+        if ((size_t)st.st_size < sizeof(HITLOG_HEADER))
+            goto fail;
+        char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, log->fd, 0);
+        if (base == MAP_FAILED)
+            goto fail;
+        bool valid = CheckHeader((const HITLOG_HEADER *)base);
+        uint64_t end = ValidEnd(base, st.st_size);
+        munmap(base, st.st_size);
+        if (!valid)
+            goto fail;
+        if (end != (uint64_t)st.st_size && ftruncate(log->fd, end) != 0)
+            goto fail;
+    }
+    if (lseek(log->fd, 0, SEEK_END) < 0)
+        goto fail;
+    return true;
+
+fail:
+    close(log->fd);
+    log->fd = -1;
+    return false;
+}
+
+//
+// HitLogFlush
+// Write the buffered sessions as a block and sync it to disk. A short write (disk
+// full, I/O error) is cut back: the next blocks would follow the torn one, past the
+// end of the log for the reader and cut away by the next HitLogOpen. The rows are
+// kept for a retry while there is room for more.
+//
+bool HitLogFlush (HIT_LOG *log)
+{
+    if (log->fd < 0 || log->rows == 0)
+        return true;
+
+    HITLOG_BLOCK block = { HITLOG_BLOCK_MAGIC, log->rows, 0 };
+    struct iovec iov[8] = {
+        { &block,        sizeof(block) },
+        { log->start,    log->rows * sizeof(int64_t) },
+        { log->end,      log->rows * sizeof(int64_t) },
+        { log->freq,     log->rows * sizeof(uint64_t) },
+        { log->peak,     log->rows * sizeof(float) },
+        { log->mean,     log->rows * sizeof(float) },
+        { log->squelch,  log->rows * sizeof(float) },
+        { log->bookmark, log->rows * sizeof(int32_t) },
+    };
+    off_t at = lseek(log->fd, 0, SEEK_CUR);
+    ssize_t n = writev(log->fd, iov, 8);
+    if (n != (ssize_t)BLOCK_SIZE(block.rows))
+    {
+        if (at < 0 || ftruncate(log->fd, at) != 0 || lseek(log->fd, at, SEEK_SET) < 0)
+        {
+            // torn for good, nothing more is written after it
+            close(log->fd);
+            log->fd = -1;
+        }
+        if (log->rows == HITLOG_BLOCK_ROWS)
+            log->rows = 0;
+        return false;
+    }
+    log->rows = 0;
+    return fsync(log->fd) == 0;
+}
+
+//
+// HitLogAppend
+// Buffer a session, the block is written when full or old enough
+//
+bool HitLogAppend (HIT_LOG *log, const HIT_SESSION *session)
+{
+    uint32_t r = log->rows;
+
+    if (log->fd < 0)
+        return false;
+    if (r == 0)
+        log->oldest = time(NULL);
+    log->start[r]    = session->start;
+    log->end[r]      = session->end;
+    log->freq[r]     = session->freq;
+    log->peak[r]     = session->peak;
+    log->mean[r]     = session->mean;
+    log->squelch[r]  = session->squelch;
+    log->bookmark[r] = session->bookmark;
+    log->rows++;
+
+    if (log->rows == HITLOG_BLOCK_ROWS || time(NULL) - log->oldest >= HITLOG_FLUSH_AGE)
+        return HitLogFlush(log);
+    return true;
+}
+
+//
+// HitLogTick
+// Write the partial block once it is old enough, also when no session ends.
+// Called by the thread that appends, on its idle path
+//
+bool HitLogTick (HIT_LOG *log)
+{
+    if (log->fd < 0 || log->rows == 0 || time(NULL) - log->oldest < HITLOG_FLUSH_AGE)
+        return true;
+    return HitLogFlush(log);
+}
+
+void HitLogClose (HIT_LOG *log)
+{
+    if (log->fd < 0)
+        return;
+    HitLogFlush(log);
+    close(log->fd);
+    log->fd = -1;
+}
+
+//
+// Channel map: open addressing on the frequency
+//
+typedef struct {
+    CHANNEL_STATS *slots;
+    uint32_t       size;    // power of 2
+    uint32_t       used;
+} CHANNEL_MAP;
+
+static CHANNEL_STATS *ChannelFind (CHANNEL_MAP *map, freq_t freq)
+{
+    if ((map->used + 1) * 2 > map->size)
+    {
+        uint32_t new_size = (map->size) ? map->size * 2 : 1024;
+        CHANNEL_STATS *slots = calloc(new_size, sizeof(CHANNEL_STATS));
+        for (uint32_t i = 0; i < map->size; i++)
+        {
+            if (map->slots[i].freq == 0)
+                continue;
+            uint32_t h = (uint32_t)(map->slots[i].freq / 1000 * 2654435761u) & (new_size - 1);
+            while (slots[h].freq != 0)
+                h = (h + 1) & (new_size - 1);
+            slots[h] = map->slots[i];
+        }
+        free(map->slots);
+        map->slots = slots;
+        map->size  = new_size;
+    }
+    uint32_t h = (uint32_t)(freq / 1000 * 2654435761u) & (map->size - 1);
+    while (map->slots[h].freq != 0 && map->slots[h].freq != freq)
+        h = (h + 1) & (map->size - 1);
+    if (map->slots[h].freq == 0)
+    {
+        map->slots[h].freq = freq;
+        map->slots[h].peak = -1000;
+        map->used++;
+    }
+    return &map->slots[h];
+}
+
+typedef struct {
+    const char            *base;
+    const uint64_t        *blocks;  // block offsets
+    uint32_t               first, last;
+    const REPORT_OPTIONS  *options;
+    CHANNEL_MAP            map;
+    REPORT                 report;
+} REPORT_WORKER;
+
+static bool InWindow (const REPORT_OPTIONS *options, int minutes)
+{
+    if (options->from == options->to)
+        return true;
+    if (options->from < options->to)
+        return minutes >= options->from && minutes < options->to;
+    return minutes >= options->from || minutes < options->to; // across midnight
+}
+
+static void *ReportWorker (void *arg)
+{
+    REPORT_WORKER *w = arg;
+    time_t cached_hour = -1;
+    struct tm tm;
+
+    for (uint32_t b = w->first; b < w->last; b++)
+    {
+        const HITLOG_BLOCK *block = (const HITLOG_BLOCK *)(w->base + w->blocks[b]);
+        uint32_t rows = block->rows;
+        const int64_t  *start   = (const int64_t *)(block + 1);
+        const int64_t  *end     = start + rows;
+        const uint64_t *freq    = (const uint64_t *)(end + rows);
+        const float    *peak    = (const float *)(freq + rows);
+
+        for (uint32_t r = 0; r < rows; r++)
+        {
+            if (w->report.first == 0 || start[r] < w->report.first)
+                w->report.first = start[r];
+            if (end[r] > w->report.last)
+                w->report.last = end[r];
+
+            // localtime only once per hour of sessions
+            time_t t = (time_t)start[r];
+            if (t / 3600 != cached_hour)
+            {
+                time_t hour = t - t % 3600;
+                localtime_r(&hour, &tm);
+                cached_hour = t / 3600;
+            }
+            int minutes = tm.tm_hour * 60 + tm.tm_min + (int)((t % 3600) / 60);
+            if (minutes >= 24 * 60)
+                minutes -= 24 * 60;
+            if (!InWindow(w->options, minutes))
+                continue;
+
+            uint64_t busy = (end[r] > start[r]) ? (uint64_t)(end[r] - start[r]) : 0;
+            CHANNEL_STATS *ch = ChannelFind(&w->map, (freq[r] + 500) / 1000 * 1000);
+            ch->sessions++;
+            ch->busy += busy;
+            if (peak[r] > ch->peak)
+                ch->peak = peak[r];
+            w->report.sessions++;
+            w->report.busy += busy;
+            w->report.hour_sessions[minutes / 60]++;
+            w->report.hour_busy[minutes / 60] += busy;
+        }
+    }
+    return NULL;
+}
+
+static int CompareBusy (const void *a, const void *b)
+{
+    const CHANNEL_STATS *ca = a, *cb = b;
+    if (ca->busy != cb->busy)
+        return (ca->busy > cb->busy) ? -1 : 1;
+    return (ca->freq > cb->freq) - (ca->freq < cb->freq);
+}
+
+//
+// HitLogAnalyze
+// Map the log and compute per channel and per hour statistics,
+// blocks are split between worker threads
+//
+bool HitLogAnalyze (const char *path, const REPORT_OPTIONS *options, REPORT *report)
+{
+    struct stat st;
+    REPORT_WORKER workers[MAX_THREADS];
+    pthread_t     threads[MAX_THREADS];
+
+    memset(report, 0, sizeof(*report));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(HITLOG_HEADER))
+    {
+        close(fd);
+        return false;
+    }
+    const char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    if (!CheckHeader((const HITLOG_HEADER *)base))
+    {
+        munmap((void *)base, st.st_size);
+        return false;
+    }
+
+    // index the blocks
+    uint64_t end = ValidEnd(base, st.st_size);
+    uint32_t n_blocks = 0, size_blocks = 1024;
+    uint64_t *blocks = malloc(size_blocks * sizeof(uint64_t));
+    for (uint64_t offset = sizeof(HITLOG_HEADER); offset < end; )
+    {
+        if (n_blocks == size_blocks)
+        {
+            size_blocks *= 2;
+            blocks = realloc(blocks, size_blocks * sizeof(uint64_t));
+        }
+        blocks[n_blocks++] = offset;
+        offset += BLOCK_SIZE(((const HITLOG_BLOCK *)(base + offset))->rows);
+    }
+
+    int n_threads = (options->threads > 0) ? options->threads : (int)sysconf(_SC_NPROCESSORS_ONLN);
+    if (n_threads < 1)
+        n_threads = 1;
+    if (n_threads > MAX_THREADS)
+        n_threads = MAX_THREADS;
+    if ((uint32_t)n_threads > n_blocks)
+        n_threads = (n_blocks > 0) ? (int)n_blocks : 1;
+
+    for (int t = 0; t < n_threads; t++)
+    {
+        memset(&workers[t], 0, sizeof(REPORT_WORKER));
+        workers[t].base    = base;
+        workers[t].blocks  = blocks;
+        workers[t].first   = (uint32_t)((uint64_t)n_blocks * t / n_threads);
+        workers[t].last    = (uint32_t)((uint64_t)n_blocks * (t + 1) / n_threads);
+        workers[t].options = options;
+        if (n_threads == 1 || pthread_create(&threads[t], NULL, ReportWorker, &workers[t]) != 0)
+        {
+            ReportWorker(&workers[t]);
+            threads[t] = 0;
+        }
+    }
+
+    // merge
+    CHANNEL_MAP map = {0};
+    for (int t = 0; t < n_threads; t++)
+    {
+        REPORT_WORKER *w = &workers[t];
+        if (n_threads > 1 && threads[t] != 0)
+            pthread_join(threads[t], NULL);
+        report->sessions += w->report.sessions;
+        report->busy     += w->report.busy;
+        if (w->report.first != 0 && (report->first == 0 || w->report.first < report->first))
+            report->first = w->report.first;
+        if (w->report.last > report->last)
+            report->last = w->report.last;
+        for (int h = 0; h < 24; h++)
+        {
+            report->hour_sessions[h] += w->report.hour_sessions[h];
+            report->hour_busy[h]     += w->report.hour_busy[h];
+        }
+        for (uint32_t i = 0; i < w->map.size; i++)
+        {
+            const CHANNEL_STATS *src = &w->map.slots[i];
+            if (src->freq == 0)
+                continue;
+            CHANNEL_STATS *ch = ChannelFind(&map, src->freq);
+            ch->sessions += src->sessions;
+            ch->busy     += src->busy;
+            if (src->peak > ch->peak)
+                ch->peak = src->peak;
+        }
+        free(w->map.slots);
+    }
+
+    if (report->last > report->first)
+    {
+        int window = options->to - options->from;
+        if (window <= 0)
+            window += 24 * 60;
+        report->observed = (uint64_t)(report->last - report->first) * window / (24 * 60);
+        if (report->observed == 0)
+            report->observed = 1;
+    }
+
+    report->channels = malloc((map.used + 1) * sizeof(CHANNEL_STATS));
+    for (uint32_t i = 0; i < map.size; i++)
+        if (map.slots[i].freq != 0)
+            report->channels[report->n_channels++] = map.slots[i];
+    qsort(report->channels, report->n_channels, sizeof(CHANNEL_STATS), CompareBusy);
+
+    free(map.slots);
+    free(blocks);
+    munmap((void *)base, st.st_size);
+    return true;
+}
+
+void HitLogFreeReport (REPORT *report)
+{
+    free(report->channels);
+    memset(report, 0, sizeof(*report));
+}
+
+static bool ParseTimeOfDay (const char *str, int *minutes)
+{
+    int h, m = 0;
+    if (sscanf(str, "%d:%d", &h, &m) < 1 || h < 0 || h > 24 || m < 0 || m > 59)
+        return false;
+    *minutes = (h * 60 + m) % (24 * 60);
+    return true;
+}
+
+static void PrintDuration (uint64_t seconds)
+{
+    printf ("%4llu:%2.2llu:%2.2llu", (unsigned long long)(seconds / 3600),
+            (unsigned long long)(seconds / 60 % 60), (unsigned long long)(seconds % 60));
+}
+
+//
+// HitLogReportMain
+// gqrx-scanner report <log file> [--from hh:mm] [--to hh:mm] [--top n] [--threads n]
+//
+int HitLogReportMain (int argc, char **argv)
+{
+    REPORT_OPTIONS options = { 0, 0, 20, 0 };
+    REPORT report;
+    const char *path = NULL;
+
+    for (int i = 2; i < argc; i++)
+    {
+        bool ok = true;
+        if (strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+            ok = ParseTimeOfDay(argv[++i], &options.from);
+        else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+            ok = ParseTimeOfDay(argv[++i], &options.to);
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+            ok = (options.top = atoi(argv[++i])) > 0;
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+            ok = (options.threads = atoi(argv[++i])) > 0;
+        else if (argv[i][0] != '-' && path == NULL)
+            path = argv[i];
+        else
+            ok = false;
+        if (!ok)
+        {
+            printf ("Error: report: invalid option %s\n", argv[i]);
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL)
+    {
+        printf ("Usage:\n%s report <log file> [--from hh:mm] [--to hh:mm] [--top n] [--threads n]\n", argv[0]);
+        printf ("\tStatistics of the hit sessions in the log written with -o, --log.\n");
+        printf ("\t--from, --to restrict to the sessions starting in this time of day.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!HitLogAnalyze(path, &options, &report))
+    {
+        printf ("Error: cannot read hit log %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    printf ("Sessions: %llu, busy time: ", (unsigned long long)report.sessions);
+    PrintDuration(report.busy);
+    printf (", channels: %u\n\n", report.n_channels);
+
+    printf ("Top talkers:\n");
+    printf ("   Frequency MHz   Sessions       Busy  Occupancy   Share   Peak\n");
+    for (uint32_t i = 0; i < report.n_channels && i < (uint32_t)options.top; i++)
+    {
+        const CHANNEL_STATS *ch = &report.channels[i];
+        printf ("  %14.3f %10llu ", ch->freq / 1e6, (unsigned long long)ch->sessions);
+        PrintDuration(ch->busy);
+        printf (" %9.2f%% %6.1f%% %6.1f\n", (report.observed) ? 100.0 * ch->busy / report.observed : 0.0,
+                (report.busy) ? 100.0 * ch->busy / report.busy : 0.0, ch->peak);
+    }
+
+    printf ("\nBy hour of day:\n");
+    uint64_t max_busy = 1;
+    for (int h = 0; h < 24; h++)
+        if (report.hour_busy[h] > max_busy)
+            max_busy = report.hour_busy[h];
+    for (int h = 0; h < 24; h++)
+    {
+        if (report.hour_sessions[h] == 0)
+            continue;
+        printf ("  %2.2d:00 %10llu ", h, (unsigned long long)report.hour_sessions[h]);
+        PrintDuration(report.hour_busy[h]);
+        printf (" ");
+        for (int b = 0; b < (int)(40 * report.hour_busy[h] / max_busy); b++)
+            printf ("#");
+        printf ("\n");
+    }
+
+    HitLogFreeReport(&report);
+    return EXIT_SUCCESS;
+}
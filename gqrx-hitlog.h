@@ -0,0 +1,123 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_HITLOG_H_
+#define _GQRX_HITLOG_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include "gqrx-prot.h"
+
+//
+// Hit log
+//
+// Append-only binary log of the hit sessions. Sessions are buffered and
+// written in blocks, one array per field (columnar), each block followed by an fsync:
+//   header | block header | start[] | end[] | freq[] | peak[] | mean[] | squelch[] | bookmark[] | ...
+// A truncated last block (crash while writing) is ignored by the reader.
+//
+#define HITLOG_MAGIC        0x4c485147  // "GQHL"
+#define HITLOG_BLOCK_MAGIC  0x314b4c42  // "BLK1"
+#define HITLOG_VERSION      1
+#define HITLOG_BLOCK_ROWS   256
+#define HITLOG_FLUSH_AGE    60          // write a partial block when the oldest session is 60 sec old
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+} HITLOG_HEADER;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t rows;
+    uint64_t reserved;
+} HITLOG_BLOCK;
+
+typedef struct {
+    int64_t start;      // wall clock, seconds
+    int64_t end;
+    freq_t  freq;
+    float   peak;       // level, dBFS
+    float   mean;
+    float   squelch;
+    int32_t bookmark;   // index of the bookmark, -1 in sweep mode
+} HIT_SESSION;
+
+typedef struct {
+    int      fd;
+    uint32_t rows;
+    int64_t  start[HITLOG_BLOCK_ROWS];
+    int64_t  end[HITLOG_BLOCK_ROWS];
+    uint64_t freq[HITLOG_BLOCK_ROWS];
+    float    peak[HITLOG_BLOCK_ROWS];
+    float    mean[HITLOG_BLOCK_ROWS];
+    float    squelch[HITLOG_BLOCK_ROWS];
+    int32_t  bookmark[HITLOG_BLOCK_ROWS];
+    time_t   oldest;    // buffering time of the first row
+} HIT_LOG;
+
+typedef struct {
+    int     from;       // time of day window in minutes [from, to), sessions starting in it
+    int     to;
+    int     top;        // number of top talkers
+    int     threads;    // 0 = number of cpus
+} REPORT_OPTIONS;
+
+//
+// Writer
+//
+bool HitLogOpen(HIT_LOG *log, const char *path);
+bool HitLogAppend(HIT_LOG *log, const HIT_SESSION *session);
+bool HitLogFlush(HIT_LOG *log);
+bool HitLogTick(HIT_LOG *log);
+void HitLogClose(HIT_LOG *log);
+
+//
+// Report
+//
+typedef struct {
+    freq_t   freq;          // rounded to 1 kHz
+    uint64_t sessions;
+    uint64_t busy;          // seconds
+    float    peak;
+} CHANNEL_STATS;
+
+typedef struct {
+    uint64_t       sessions;
+    uint64_t       busy;
+    int64_t        first;       // span of the whole log
+    int64_t        last;
+    uint64_t       observed;    // seconds of the span in the time of day window
+    uint64_t       hour_sessions[24];
+    uint64_t       hour_busy[24];
+    CHANNEL_STATS *channels;    // sorted by busy time
+    uint32_t       n_channels;
+} REPORT;
+
+bool HitLogAnalyze(const char *path, const REPORT_OPTIONS *options, REPORT *report);
+void HitLogFreeReport(REPORT *report);
+int  HitLogReportMain(int argc, char **argv);
+
+#endif /* _GQRX_HITLOG_H_ */
@@ -0,0 +1,260 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <signal.h>
+#include <spawn.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include "gqrx-hooks.h"
+#include "gqrx-clock.h"
+#include "gqrx-metrics.h"
+
+extern char **environ;
+
+typedef struct {
+    const char *command;
+    char        vars[HOOKS_VARS][HOOKS_VAR_SIZE];
+    char        json[HOOKS_JSON_SIZE];
+} HOOK_JOB;
+
+static HOOK_JOB         jobs[HOOKS_QUEUE];
+static unsigned long    head, tail;
+static pthread_mutex_t  lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t   ready = PTHREAD_COND_INITIALIZER;
+static pthread_t        workers[HOOKS_QUEUE];
+static int              n_workers = 0;
+static bool             running = false;
+static const char      *commands[2];    // on start, on end
+static long             hook_timeout;
+static HOOKS_STATS      stats;
+
+//
+// Run
+// Spawn the hook, feed the JSON on its standard input and wait for it
+//
+static void Run (HOOK_JOB *job)
+{
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attr;
+    sigset_t signals;
+    int      fds[2], status = 0, env_max = 0;
+    pid_t    pid;
+    char    *argv[] = { "/bin/sh", "-c", (char *)job->command, NULL };
+
+    // a socket rather than a pipe: a hook not reading stdin is no SIGPIPE;
+    // close on exec, or the hook of another worker keeps it open past our close
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, fds) != 0)
+        goto failed;
+    while (environ[env_max] != NULL)
+        env_max++;
+    char **envp = malloc((env_max + HOOKS_VARS + 1) * sizeof(char *));
+    if (envp == NULL)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        goto failed;
+    }
+    memcpy(envp, environ, env_max * sizeof(char *));
+    for (int v = 0; v < HOOKS_VARS; v++)
+        envp[env_max + v] = job->vars[v];
+    envp[env_max + HOOKS_VARS] = NULL;
+
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, fds[1], STDIN_FILENO);
+    posix_spawn_file_actions_addclose(&actions, fds[0]);
+    posix_spawn_file_actions_addclose(&actions, fds[1]);
+    posix_spawnattr_init(&attr);
+    sigemptyset(&signals);
+    posix_spawnattr_setsigmask(&attr, &signals);
+    sigaddset(&signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attr, &signals);
+    posix_spawnattr_setpgroup(&attr, 0); // its own group, killed as a whole on timeout
+    posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF);
+    int rc = posix_spawn(&pid, argv[0], &actions, &attr, argv, envp);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attr);
+    free(envp);
+    close(fds[1]);
+    if (rc != 0)
+    {
+        close(fds[0]);
+        goto failed;
+    }
+    send(fds[0], job->json, strlen(job->json), MSG_NOSIGNAL | MSG_DONTWAIT);
+    close(fds[0]);
+
+    clock_us_t deadline = ClockNow() + hook_timeout;
+    while (waitpid(pid, &status, WNOHANG) == 0)
+    {
+        if (ClockNow() >= deadline)
+        {
+            kill(-pid, SIGKILL);
+            waitpid(pid, &status, 0);
+            pthread_mutex_lock(&lock);
+            stats.timeouts++;
+            pthread_mutex_unlock(&lock);
+            MetricAdd(METRIC_HOOK_TIMEOUTS, 1);
+            return;
+        }
+        SleepFor(HOOKS_POLL);
+    }
+    pthread_mutex_lock(&lock);
+    stats.run++;
+    pthread_mutex_unlock(&lock);
+    MetricAdd(METRIC_HOOK_RUNS, 1);
+    if (WIFEXITED(status) && WEXITSTATUS(status) == 0)
+        return;
+
+failed:
+    pthread_mutex_lock(&lock);
+    stats.failed++;
+    pthread_mutex_unlock(&lock);
+    MetricAdd(METRIC_HOOK_FAILURES, 1);
+}
+
+static void *Worker (void *arg)
+{
+    HOOK_JOB job;
+    (void) arg;
+
+    pthread_mutex_lock(&lock);
+    while (true)
+    {
+        while (running && head == tail)
+            pthread_cond_wait(&ready, &lock);
+        if (!running)
+            break;
+        job = jobs[tail % HOOKS_QUEUE];
+        tail++;
+        stats.queued = head - tail;
+        MetricSet(METRIC_HOOKS_QUEUED, stats.queued);
+        pthread_mutex_unlock(&lock);
+        Run(&job);
+        pthread_mutex_lock(&lock);
+    }
+    pthread_mutex_unlock(&lock);
+    return NULL;
+}
+
+//
+// HooksStart
+// on_start, on_end: shell commands, NULL for none; timeout in us
+//
+bool HooksStart (const char *on_start, const char *on_end, int n, long timeout)
+{
+    commands[0]  = on_start;
+    commands[1]  = on_end;
+    hook_timeout = timeout;
+    running      = true;
+    if (n > HOOKS_QUEUE)
+        n = HOOKS_QUEUE;
+    for (n_workers = 0; n_workers < n; n_workers++)
+    {
+        if (pthread_create(&workers[n_workers], NULL, Worker, NULL) != 0)
+        {
+            HooksStop();
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// HookQueue
+// Called by the events thread, never waits for a worker.
+// Returns false if there is no hook for the event, or the queue is full.
+//
+bool HookQueue (const EVENT *event, const char *json)
+{
+    static const char *names[] = { "start", "update", "end" };
+    const char *command = (event->type == EVENT_HIT_START) ? commands[0] :
+                          (event->type == EVENT_HIT_END)   ? commands[1] : NULL;
+
+    if (command == NULL)
+        return false;
+    pthread_mutex_lock(&lock);
+    if (!running || head - tail >= HOOKS_QUEUE)
+    {
+        stats.dropped++;
+        pthread_mutex_unlock(&lock);
+        MetricAdd(METRIC_HOOK_DROPS, 1);
+        return false;
+    }
+    HOOK_JOB *job = &jobs[head % HOOKS_QUEUE];
+    job->command = command;
+    snprintf(job->vars[0],  HOOKS_VAR_SIZE, "GQRX_EVENT=%s", names[event->type]);
+    snprintf(job->vars[1],  HOOKS_VAR_SIZE, "GQRX_FREQ=%llu", event->freq);
+    snprintf(job->vars[2],  HOOKS_VAR_SIZE, "GQRX_LEVEL=%.1f", event->level);
+    snprintf(job->vars[3],  HOOKS_VAR_SIZE, "GQRX_SQUELCH=%.1f", event->squelch);
+    snprintf(job->vars[4],  HOOKS_VAR_SIZE, "GQRX_TIME=%lld", (long long)event->time);
+    snprintf(job->vars[5],  HOOKS_VAR_SIZE, "GQRX_START=%lld", (long long)event->start);
+    snprintf(job->vars[6],  HOOKS_VAR_SIZE, "GQRX_DURATION=%ld", event->duration);
+    snprintf(job->vars[7],  HOOKS_VAR_SIZE, "GQRX_PEAK=%.1f", event->peak);
+    snprintf(job->vars[8],  HOOKS_VAR_SIZE, "GQRX_MEAN=%.1f", event->mean);
+    snprintf(job->vars[9],  HOOKS_VAR_SIZE, "GQRX_BOOKMARK=%d", event->bookmark);
+    snprintf(job->vars[10], HOOKS_VAR_SIZE, "GQRX_DESCR=%s", event->descr);
+    snprintf(job->vars[11], HOOKS_VAR_SIZE, "GQRX_TAGS=");
+    for (int k = 0; k < event->tag_max; k++)
+    {
+        size_t len = strlen(job->vars[11]);
+        snprintf(job->vars[11] + len, HOOKS_VAR_SIZE - len, "%s%s", (k) ? "|" : "", event->tags[k]);
+    }
+    snprintf(job->json, HOOKS_JSON_SIZE, "%s\n", json);
+    head++;
+    stats.queued = head - tail;
+    MetricSet(METRIC_HOOKS_QUEUED, stats.queued);
+    pthread_cond_signal(&ready);
+    pthread_mutex_unlock(&lock);
+    return true;
+}
+
+void HooksStats (HOOKS_STATS *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+//
+// HooksStop
+// The queued hooks are dropped, the running ones are waited for (at most the timeout)
+//
+void HooksStop (void)
+{
+    pthread_mutex_lock(&lock);
+    running = false;
+    stats.dropped += head - tail;
+    tail = head;
+    stats.queued = 0;
+    pthread_cond_broadcast(&ready);
+    pthread_mutex_unlock(&lock);
+    for (int w = 0; w < n_workers; w++)
+        pthread_join(workers[w], NULL);
+    n_workers = 0;
+}
@@ -0,0 +1,60 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_HOOKS_H_
+#define _GQRX_HOOKS_H_
+
+#include <stdbool.h>
+#include "gqrx-events.h"
+
+//
+// Hit hooks
+//
+// Commands run on hit start and end by a pool of worker threads, with
+// posix_spawn through /bin/sh -c. The hit is passed in GQRX_* environment
+// variables and as JSON on the standard input. Jobs are queued by the events
+// thread and dropped when the queue is full; a hook still running after the
+// timeout is killed with its process group.
+//
+#define HOOKS_QUEUE         64
+#define HOOKS_WORKERS       2
+#define HOOKS_TIMEOUT       10000000    // 10 sec
+#define HOOKS_POLL          10000       // check the running hook every 10 ms
+#define HOOKS_VARS          12
+#define HOOKS_VAR_SIZE      256
+#define HOOKS_JSON_SIZE     1400
+
+typedef struct {
+    unsigned long queued;   // waiting for a worker
+    unsigned long run;
+    unsigned long failed;   // not started, or exit status not 0
+    unsigned long timeouts;
+    unsigned long dropped;  // queue full
+} HOOKS_STATS;
+
+bool HooksStart(const char *on_start, const char *on_end, int workers, long timeout);
+bool HookQueue(const EVENT *event, const char *json);
+void HooksStats(HOOKS_STATS *stats);
+void HooksStop(void);
+
+#endif /* _GQRX_HOOKS_H_ */
@@ -0,0 +1,208 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // pipe2
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <termios.h>
+#include <stdatomic.h>
+#include "gqrx-input.h"
+
+static int            input_pipe[2] = { -1, -1 };    // commands to the scan loop
+static int            stop_pipe[2]  = { -1, -1 };    // stops the keyboard thread
+static atomic_int     pending;
+static pthread_t      input_thread;
+static bool           input_running = false;
+static bool           tty_saved     = false;
+static struct termios tty_state;
+
+//
+// InputPost
+// Queue a command as if its key was pressed, safe in a signal handler
+//
+void InputPost (INPUT_COMMAND cmd)
+{
+    char c = (char)cmd;
+    atomic_fetch_add(&pending, 1); // before the write, a reader never sees the byte uncounted
+    if (write(input_pipe[1], &c, 1) != 1)
+        atomic_fetch_sub(&pending, 1);
+}
+
+static void *InputThread (void *arg)
+{
+    struct pollfd fds[2] = { { STDIN_FILENO, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+    char c;
+
+    (void)arg;
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        if (read(STDIN_FILENO, &c, 1) != 1)
+            break; // hang up
+        switch (c)
+        {
+            case ' ':
+            case '\n':
+                InputPost(INPUT_SKIP);
+                break;
+            case 'b':
+                InputPost(INPUT_BAN);
+                break;
+            case 'c':
+                InputPost(INPUT_CLEAR);
+                break;
+            case 'p':
+                InputPost(INPUT_PAUSE);
+                break;
+            default:
+                break;
+        }
+    }
+    return NULL;
+}
+
+static void RestoreTerminal (void)
+{
+    if (tty_saved)
+    {
+        tcsetattr(STDIN_FILENO, TCSANOW, &tty_state);
+        tty_saved = false;
+    }
+}
+
+//
+// InputStart
+// Set up the terminal and start the keyboard thread, unless headless or
+// stdin is not a terminal
+//
+bool InputStart (bool headless)
+{
+    if (pipe2(input_pipe, O_CLOEXEC) != 0)
+        return false;
+    fcntl(input_pipe[0], F_SETFL, O_NONBLOCK);
+    fcntl(input_pipe[1], F_SETFL, O_NONBLOCK);
+    atomic_store(&pending, 0);
+
+    if (headless || !isatty(STDIN_FILENO))
+        return true;
+
+    if (tcgetattr(STDIN_FILENO, &tty_state) == 0)
+    {
+        struct termios raw = tty_state;
+        raw.c_lflag &= ~ICANON; // keys without <enter>
+        raw.c_cc[VMIN]  = 1;
+        raw.c_cc[VTIME] = 0;
+        tty_saved = tcsetattr(STDIN_FILENO, TCSANOW, &raw) == 0;
+        atexit(RestoreTerminal);
+    }
+    if (pipe2(stop_pipe, O_CLOEXEC) != 0)
+        return false;
+    input_running = pthread_create(&input_thread, NULL, InputThread, NULL) == 0;
+    return input_running;
+}
+
+void InputStop (void)
+{
+    if (input_running)
+    {
+        char c = 0;
+        if (write(stop_pipe[1], &c, 1) == 1)
+            pthread_join(input_thread, NULL);
+        input_running = false;
+    }
+    RestoreTerminal();
+    for (int i = 0; i < 2; i++)
+    {
+        if (input_pipe[i] >= 0)
+            close(input_pipe[i]);
+        if (stop_pipe[i] >= 0)
+            close(stop_pipe[i]);
+        input_pipe[i] = stop_pipe[i] = -1;
+    }
+}
+
+//
+// InputPoll
+// Next command, INPUT_NONE if there is none. No syscall when nothing is pending.
+//
+INPUT_COMMAND InputPoll (void)
+{
+    char c;
+
+    if (atomic_load(&pending) == 0)
+        return INPUT_NONE;
+    if (read(input_pipe[0], &c, 1) != 1)
+        return INPUT_NONE;
+    atomic_fetch_sub(&pending, 1);
+    return (INPUT_COMMAND)c;
+}
+
+//
+// InputWait
+// Block until a command, a wake up or the timeout (us, INPUT_FOREVER), rounded up
+// to the millisecond of poll: a shorter wait would not block at all
+//
+INPUT_COMMAND InputWait (long timeout)
+{
+    struct pollfd fd = { input_pipe[0], POLLIN, 0 };
+
+    if (input_pipe[0] < 0)
+        return INPUT_NONE;
+    if (atomic_load(&pending) == 0 &&
+        poll(&fd, 1, (timeout == INPUT_FOREVER) ? -1 : (int)((timeout + 999) / 1000)) <= 0)
+        return INPUT_NONE;
+    return InputPoll();
+}
+
+//
+// InputFlush
+// Discard the keys pressed so far
+//
+void InputFlush (void)
+{
+    while (InputPoll() != INPUT_NONE)
+        ;
+}
+
+//
+// InputWake
+// Wake up InputWait, safe in a signal handler
+//
+void InputWake (void)
+{
+    if (input_pipe[1] >= 0)
+        InputPost(INPUT_NONE);
+}
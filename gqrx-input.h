@@ -0,0 +1,57 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_INPUT_H_
+#define _GQRX_INPUT_H_
+
+#include <stdbool.h>
+
+//
+// Keyboard input
+//
+// The terminal is set to non canonical mode once, a thread reads the keys
+// and posts commands on a pipe. The scan loop polls a pending counter (no
+// syscall when idle) and can block on the pipe, e.g. while paused.
+// Without a TTY (or in headless mode) there is no keyboard thread and no
+// terminal setup at all.
+//
+typedef enum
+{
+    INPUT_NONE = 0,     // no command, or a wake up (see InputWake)
+    INPUT_SKIP,         // <space> or <enter>
+    INPUT_BAN,          // 'b'
+    INPUT_CLEAR,        // 'c'
+    INPUT_PAUSE         // 'p'
+} INPUT_COMMAND;
+
+#define INPUT_FOREVER   (-1)
+
+bool InputStart(bool headless);
+void InputStop(void);
+INPUT_COMMAND InputPoll(void);
+INPUT_COMMAND InputWait(long timeout);
+void InputFlush(void);
+void InputPost(INPUT_COMMAND cmd);
+void InputWake(void);
+
+#endif /* _GQRX_INPUT_H_ */
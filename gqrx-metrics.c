@@ -0,0 +1,306 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // pipe2, accept4
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gqrx-metrics.h"
+
+#define METRICS_BUFSIZE 16384
+
+typedef struct {
+    const char *name;
+    const char *help;
+} METRIC_INFO;
+
+static const METRIC_INFO counter_info[METRIC_COUNTERS] = {
+    { "steps_total",            "Frequencies tuned by the scan loops." },
+    { "passes_total",           "Full sweeps or bookmark passes." },
+    { "hits_total",             "Active frequencies listened to." },
+    { "debounce_rejects_total", "Signals lost at the debounce check." },
+    { "backtracks_total",       "Backtracks after a lost signal." },
+    { "adjust_probes_total",    "Frequencies probed by the fine tuning." },
+    { "connects_total",         "Connections to gqrx." },
+    { "state_hits_total",       "Queries answered by the receiver state shadow." },
+    { "survey_skips_total",     "Sweep bins skipped on the spectrum survey." },
+    { "hook_runs_total",        "Hit hooks completed." },
+    { "hook_failures_total",    "Hit hooks not started or exited with an error." },
+    { "hook_timeouts_total",    "Hit hooks killed after the timeout." },
+    { "hook_drops_total",       "Hit hooks dropped, queue full." },
+    { "audio_windows_total",    "Audio windows classified by the activity detector." },
+    { "tone_rejects_total",     "Active frequencies without the wanted CTCSS tone or DCS code." },
+    { "captures_total",         "Audio capture files written." },
+    { "capture_drops_total",    "Audio samples not captured, the writer was behind." },
+    { "publish_drops_total",    "Event datagrams dropped, the socket buffer was full." },
+};
+
+static const METRIC_INFO gauge_info[METRIC_GAUGES] = {
+    { "pass_steps",             "Bins of the last full sweep, or bookmarks of the last pass." },
+    { "pass_duration_seconds",  "Duration of the last full sweep or bookmark pass." },
+    { "sleep_cycle_seconds",    "Last predicted wait after a retune." },
+    { "bans",                   "Banned frequencies." },
+    { "saved",                  "Frequencies in the saved table." },
+    { "hooks_queued",           "Hit hooks waiting for a worker." },
+};
+
+static const char *command_names[CMD_COUNT] = { "F", "f", "l", "l SQL", "L SQL", "U RECORD" };
+
+// upper bounds of the RTT buckets in us, +Inf is the count
+static const uint64_t rtt_bounds[RTT_BUCKETS] = { 250, 500, 1000, 2000, 5000, 10000, 25000, 50000, 100000, 250000 };
+
+static atomic_ullong counters[METRIC_COUNTERS];
+static atomic_ullong gauges[METRIC_GAUGES];
+static atomic_ullong rtt_buckets[CMD_COUNT][RTT_BUCKETS];
+static atomic_ullong rtt_sum[CMD_COUNT];
+static atomic_ullong rtt_count[CMD_COUNT];
+
+static int       listen_fd = -1;
+static int       stop_pipe[2] = { -1, -1 };
+static pthread_t server_thread;
+static bool      running = false;
+
+void MetricAdd (METRIC_COUNTER counter, uint64_t value)
+{
+    atomic_fetch_add_explicit(&counters[counter], value, memory_order_relaxed);
+}
+
+void MetricSet (METRIC_GAUGE gauge, uint64_t value)
+{
+    atomic_store_explicit(&gauges[gauge], value, memory_order_relaxed);
+}
+
+//
+// MetricRtt
+// Round trip time of a gqrx command
+//
+void MetricRtt (PROT_COMMAND cmd, uint64_t us)
+{
+    for (int b = 0; b < RTT_BUCKETS; b++)
+    {
+        if (us <= rtt_bounds[b])
+        {
+            atomic_fetch_add_explicit(&rtt_buckets[cmd][b], 1, memory_order_relaxed);
+            break;
+        }
+    }
+    atomic_fetch_add_explicit(&rtt_sum[cmd], us, memory_order_relaxed);
+    atomic_fetch_add_explicit(&rtt_count[cmd], 1, memory_order_relaxed);
+}
+
+static uint64_t Load (atomic_ullong *value)
+{
+    return atomic_load_explicit(value, memory_order_relaxed);
+}
+
+//
+// MetricsFormat
+// Prometheus text exposition format, returns the length
+//
+size_t MetricsFormat (char *buf, size_t size)
+{
+    size_t n = 0;
+
+#define APPEND(...) do { if (n < size) n += snprintf(buf + n, size - n, __VA_ARGS__); } while (0)
+    for (int c = 0; c < METRIC_COUNTERS; c++)
+    {
+        APPEND("# HELP gqrx_scanner_%s %s\n", counter_info[c].name, counter_info[c].help);
+        APPEND("# TYPE gqrx_scanner_%s counter\n", counter_info[c].name);
+        APPEND("gqrx_scanner_%s %llu\n", counter_info[c].name, (unsigned long long)Load(&counters[c]));
+    }
+    uint64_t connects = Load(&counters[METRIC_CONNECTS]);
+    APPEND("# HELP gqrx_scanner_reconnects_total Connections to gqrx after the first one.\n");
+    APPEND("# TYPE gqrx_scanner_reconnects_total counter\n");
+    APPEND("gqrx_scanner_reconnects_total %llu\n", (unsigned long long)((connects) ? connects - 1 : 0));
+
+    for (int g = 0; g < METRIC_GAUGES; g++)
+    {
+        uint64_t value = Load(&gauges[g]);
+        APPEND("# HELP gqrx_scanner_%s %s\n", gauge_info[g].name, gauge_info[g].help);
+        APPEND("# TYPE gqrx_scanner_%s gauge\n", gauge_info[g].name);
+        if (g == METRIC_PASS_DURATION || g == METRIC_SLEEP_CYCLE)
+            APPEND("gqrx_scanner_%s %.6f\n", gauge_info[g].name, value / 1e6);
+        else
+            APPEND("gqrx_scanner_%s %llu\n", gauge_info[g].name, (unsigned long long)value);
+    }
+
+    APPEND("# HELP gqrx_scanner_command_rtt_seconds Round trip time of the gqrx remote control commands.\n");
+    APPEND("# TYPE gqrx_scanner_command_rtt_seconds histogram\n");
+    for (int cmd = 0; cmd < CMD_COUNT; cmd++)
+    {
+        uint64_t cumulative = 0;
+        for (int b = 0; b < RTT_BUCKETS; b++)
+        {
+            cumulative += Load(&rtt_buckets[cmd][b]);
+            APPEND("gqrx_scanner_command_rtt_seconds_bucket{command=\"%s\",le=\"%g\"} %llu\n",
+                   command_names[cmd], rtt_bounds[b] / 1e6, (unsigned long long)cumulative);
+        }
+        uint64_t count = Load(&rtt_count[cmd]);
+        APPEND("gqrx_scanner_command_rtt_seconds_bucket{command=\"%s\",le=\"+Inf\"} %llu\n",
+               command_names[cmd], (unsigned long long)count);
+        APPEND("gqrx_scanner_command_rtt_seconds_sum{command=\"%s\"} %.6f\n",
+               command_names[cmd], Load(&rtt_sum[cmd]) / 1e6);
+        APPEND("gqrx_scanner_command_rtt_seconds_count{command=\"%s\"} %llu\n",
+               command_names[cmd], (unsigned long long)count);
+    }
+#undef APPEND
+    return (n < size) ? n : size - 1;
+}
+
+static void WriteAll (int fd, const char *buf, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = send(fd, buf, len, MSG_NOSIGNAL);
+        if (n <= 0)
+            return;
+        buf += n;
+        len -= n;
+    }
+}
+
+//
+// Serve
+// One request per connection, only GET /metrics
+//
+static void Serve (int fd)
+{
+    char request[1024];
+    char header[256];
+    struct timeval timeout = { 1, 0 };
+
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    ssize_t n = recv(fd, request, sizeof(request) - 1, 0);
+    if (n <= 0)
+        return;
+    request[n] = '\0';
+
+    if (strncmp(request, "GET /metrics", 12) != 0 || (request[12] != ' ' && request[12] != '?'))
+    {
+        const char *not_found = "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+        WriteAll(fd, not_found, strlen(not_found));
+        return;
+    }
+    char *body = malloc(METRICS_BUFSIZE);
+    if (body == NULL)
+        return;
+    size_t len = MetricsFormat(body, METRICS_BUFSIZE);
+    int h = snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+                     "Content-Length: %zu\r\nConnection: close\r\n\r\n", len);
+    WriteAll(fd, header, h);
+    WriteAll(fd, body, len);
+    free(body);
+}
+
+static void *ServerThread (void *arg)
+{
+    struct pollfd fds[2] = { { listen_fd, POLLIN, 0 }, { stop_pipe[0], POLLIN, 0 } };
+
+    (void)arg;
+    while (true)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        if (fds[1].revents)
+            break;
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_CLOEXEC);
+        if (fd < 0)
+            continue;
+        Serve(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+//
+// MetricsStart
+// Serve the metrics on "[address:]port", localhost by default
+//
+bool MetricsStart (const char *listen_on)
+{
+    struct sockaddr_in addr;
+    char   host[64] = "127.0.0.1";
+    const char *port = strrchr(listen_on, ':');
+    int    one = 1;
+
+    if (port != NULL)
+    {
+        size_t len = port - listen_on;
+        if (len >= sizeof(host))
+            return false;
+        memcpy(host, listen_on, len);
+        host[len] = '\0';
+        port++;
+    }
+    else
+        port = listen_on;
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port   = htons(atoi(port));
+    if (atoi(port) <= 0 || inet_pton(AF_INET, host, &addr.sin_addr) != 1)
+        return false;
+
+    listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (listen_fd < 0)
+        return false;
+    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_fd, 8) != 0 ||
+        pipe2(stop_pipe, O_CLOEXEC) != 0)
+    {
+        close(listen_fd);
+        listen_fd = -1;
+        return false;
+    }
+    running = pthread_create(&server_thread, NULL, ServerThread, NULL) == 0;
+    return running;
+}
+
+void MetricsStop (void)
+{
+    if (!running)
+        return;
+    if (write(stop_pipe[1], "", 1) == 1)
+        pthread_join(server_thread, NULL);
+    running = false;
+    close(listen_fd);
+    close(stop_pipe[0]);
+    close(stop_pipe[1]);
+    listen_fd = stop_pipe[0] = stop_pipe[1] = -1;
+}
@@ -0,0 +1,92 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_METRICS_H_
+#define _GQRX_METRICS_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Metrics
+//
+// Counters and gauges updated by the scan loop with relaxed atomics, served
+// in the Prometheus text format by an HTTP thread on localhost (GET /metrics).
+//
+typedef enum
+{
+    METRIC_STEPS,               // frequencies tuned by the scan loops
+    METRIC_PASSES,              // full sweeps or bookmark passes
+    METRIC_HITS,
+    METRIC_DEBOUNCE_REJECTS,
+    METRIC_BACKTRACKS,
+    METRIC_ADJUST_PROBES,
+    METRIC_CONNECTS,
+    METRIC_STATE_HITS,          // queries answered by the receiver state shadow
+    METRIC_SURVEY_SKIPS,        // sweep bins skipped on the spectrum survey
+    METRIC_HOOK_RUNS,           // hit hooks completed
+    METRIC_HOOK_FAILURES,       // not started, or exit status not 0
+    METRIC_HOOK_TIMEOUTS,
+    METRIC_HOOK_DROPS,          // hook queue full
+    METRIC_AUDIO_WINDOWS,       // audio windows classified by the activity detector
+    METRIC_TONE_REJECTS,        // active frequencies without the wanted CTCSS/DCS
+    METRIC_CAPTURES,            // audio capture files
+    METRIC_CAPTURE_DROPS,       // samples not captured, writer behind
+    METRIC_PUBLISH_DROPS,       // event datagrams not queued by the socket
+    METRIC_COUNTERS
+} METRIC_COUNTER;
+
+typedef enum
+{
+    METRIC_PASS_STEPS,          // bins of the last full sweep, bookmarks of the last pass
+    METRIC_PASS_DURATION,       // us
+    METRIC_SLEEP_CYCLE,         // us, wait after a retune
+    METRIC_BANS,
+    METRIC_SAVED,
+    METRIC_HOOKS_QUEUED,        // hit hooks waiting for a worker
+    METRIC_GAUGES
+} METRIC_GAUGE;
+
+typedef enum
+{
+    CMD_SET_FREQ,               // F
+    CMD_GET_FREQ,               // f
+    CMD_GET_LEVEL,              // l
+    CMD_GET_SQUELCH,            // l SQL
+    CMD_SET_SQUELCH,            // L SQL
+    CMD_RECORD,                 // U RECORD
+    CMD_COUNT
+} PROT_COMMAND;
+
+#define RTT_BUCKETS 10
+
+void MetricAdd(METRIC_COUNTER counter, uint64_t value);
+void MetricSet(METRIC_GAUGE gauge, uint64_t value);
+void MetricRtt(PROT_COMMAND cmd, uint64_t us);
+size_t MetricsFormat(char *buf, size_t size);
+
+bool MetricsStart(const char *listen);
+void MetricsStop(void);
+
+#endif /* _GQRX_METRICS_H_ */
@@ -0,0 +1,548 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <pthread.h>
+#include "gqrx-occupancy.h"
+
+#define MAX_RUNS    (OCC_MINUTES / 2)
+// records are padded to 8 bytes, keeping the frequencies aligned
+#define RECORD_SIZE(rec) ((sizeof(OCC_RECORD) + ((uint64_t)(rec)->n_busy + (rec)->n_observed) * sizeof(OCC_RUN) + 7) & ~7ULL)
+
+//
+// ValidEnd
+// Offset of the end of the last complete record
+//
+static uint64_t ValidEnd (const char *base, uint64_t size)
+{
+    uint64_t offset = sizeof(OCC_HEADER);
+    while (offset + sizeof(OCC_RECORD) <= size)
+    {
+        const OCC_RECORD *rec = (const OCC_RECORD *)(base + offset);
+        if (rec->n_busy > MAX_RUNS || rec->n_observed > MAX_RUNS || offset + RECORD_SIZE(rec) > size)
+            break;
+        offset += RECORD_SIZE(rec);
+    }
+    return offset;
+}
+
+static bool CheckHeader (const OCC_HEADER *header)
+{
+    return header->magic == OCC_MAGIC && header->version == OCC_VERSION;
+}
+
+//
+// OccupancyOpen
+// Open or create the store for appending, a truncated last record is cut away.
+// Channels are rounded to 'resolution' Hz (the sweep step, 1 for bookmarks).
+//
+bool OccupancyOpen (OCCUPANCY *occ, const char *path, freq_t resolution)
+{
+    struct stat st;
+
+    memset(occ, 0, sizeof(*occ));
+    occ->resolution = (resolution) ? resolution : 1;
+    occ->day = -1;
+    occ->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (occ->fd < 0)
+        return false;
+    pthread_mutex_init(&occ->lock, NULL);
+    if (fstat(occ->fd, &st) != 0)
+        goto fail;
+
+    if (st.st_size == 0)
+    {
+        OCC_HEADER header = { OCC_MAGIC, OCC_VERSION, 0 };
+        if (write(occ->fd, &header, sizeof(header)) != sizeof(header))
+            goto fail;
+    }
+    else
+    {
+        if ((size_t)st.st_size < sizeof(OCC_HEADER))
+            goto fail;
+        char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, occ->fd, 0);
+        if (base == MAP_FAILED)
+            goto fail;
+        bool valid = CheckHeader((const OCC_HEADER *)base);
+        uint64_t end = ValidEnd(base, st.st_size);
+        munmap(base, st.st_size);
+        if (!valid)
+            goto fail;
+        if (end != (uint64_t)st.st_size && ftruncate(occ->fd, end) != 0)
+            goto fail;
+    }
+    if (lseek(occ->fd, 0, SEEK_END) < 0)
+        goto fail;
+    return true;
+
+fail:
+    pthread_mutex_destroy(&occ->lock);
+    close(occ->fd);
+    occ->fd = -1;
+    return false;
+}
+
+static uint32_t Hash (freq_t freq, uint32_t size)
+{
+    return (uint32_t)((freq ^ (freq >> 32)) * 2654435761u) & (size - 1);
+}
+
+static OCC_CHANNEL *ChannelFind (OCCUPANCY *occ, freq_t freq)
+{
+    if ((occ->used + 1) * 2 > occ->size)
+    {
+        uint32_t new_size = (occ->size) ? occ->size * 2 : 256;
+        OCC_CHANNEL *channels = calloc(new_size, sizeof(OCC_CHANNEL));
+        if (channels == NULL)
+            return NULL;
+        for (uint32_t i = 0; i < occ->size; i++)
+        {
+            if (occ->channels[i].freq == 0)
+                continue;
+            uint32_t h = Hash(occ->channels[i].freq, new_size);
+            while (channels[h].freq != 0)
+                h = (h + 1) & (new_size - 1);
+            channels[h] = occ->channels[i];
+        }
+        free(occ->channels);
+        occ->channels = channels;
+        occ->size     = new_size;
+    }
+    uint32_t h = Hash(freq, occ->size);
+    while (occ->channels[h].freq != 0 && occ->channels[h].freq != freq)
+        h = (h + 1) & (occ->size - 1);
+    if (occ->channels[h].freq == 0)
+    {
+        occ->channels[h].freq = freq;
+        occ->used++;
+    }
+    return &occ->channels[h];
+}
+
+//
+// HandOff
+// Queue the bitmaps in memory for the writer and start over with empty ones
+//
+static void HandOff (OCCUPANCY *occ)
+{
+    if (occ->used == 0)
+        return;
+    OCC_PENDING *node = malloc(sizeof(OCC_PENDING));
+    if (node == NULL)
+        return; // keep marking, the next hand off retries
+    node->day      = occ->day;
+    node->channels = occ->channels;
+    node->size     = occ->size;
+    node->next     = NULL;
+    occ->channels  = NULL;
+    occ->size      = 0;
+    occ->used      = 0;
+
+    pthread_mutex_lock(&occ->lock);
+    OCC_PENDING **tail = &occ->pending;
+    while (*tail != NULL)
+        tail = &(*tail)->next;
+    *tail = node;
+    pthread_mutex_unlock(&occ->lock);
+}
+
+//
+// OccupancyMark
+// Record a busy/idle decision on a channel. The bitmaps are handed off to the
+// writer every OCC_FLUSH_PERIOD and at midnight, they are not written here.
+//
+void OccupancyMark (OCCUPANCY *occ, freq_t freq, time_t t, bool busy)
+{
+    if (occ->fd < 0 || t < 0)
+        return;
+
+    int32_t day = (int32_t)(t / 86400);
+    if (day != occ->day || t >= occ->flush_at)
+    {
+        HandOff(occ);
+        occ->day      = day;
+        occ->flush_at = t - t % OCC_FLUSH_PERIOD + OCC_FLUSH_PERIOD;
+    }
+
+    freq = (freq + occ->resolution / 2) / occ->resolution * occ->resolution;
+    OCC_CHANNEL *ch = ChannelFind(occ, freq);
+    if (ch == NULL)
+        return;
+    int minute = (int)(t % 86400) / 60;
+    ch->observed[minute / 64] |= 1ULL << (minute % 64);
+    if (busy)
+        ch->busy[minute / 64] |= 1ULL << (minute % 64);
+}
+
+//
+// OccupancyMarkBusy
+// The channel has been busy from 'from' to 'to' (a listened hit)
+//
+void OccupancyMarkBusy (OCCUPANCY *occ, freq_t freq, time_t from, time_t to)
+{
+    for (time_t t = from - from % 60; t <= to; t += 60)
+        OccupancyMark(occ, freq, (t < from) ? from : t, true);
+}
+
+static uint16_t EncodeRuns (const uint64_t *bits, OCC_RUN *runs)
+{
+    uint16_t n = 0;
+    int      start = -1;
+
+    for (int m = 0; m <= OCC_MINUTES; m++)
+    {
+        bool set = (m < OCC_MINUTES) && (bits[m / 64] >> (m % 64) & 1);
+        if (set && start < 0)
+            start = m;
+        else if (!set && start >= 0)
+        {
+            runs[n].start  = (uint16_t)start;
+            runs[n].length = (uint16_t)(m - start);
+            n++;
+            start = -1;
+        }
+    }
+    return n;
+}
+
+//
+// WriteDay
+// Append one record per observed channel of the bitmaps of a day, and sync it
+//
+static bool WriteDay (int fd, const OCC_PENDING *node)
+{
+    size_t size = 0, used = 0;
+
+    for (uint32_t i = 0; i < node->size; i++)
+        used += (node->channels[i].freq != 0);
+    if (used == 0)
+        return true;
+    char *buffer = calloc(1, used * (sizeof(OCC_RECORD) + 2 * MAX_RUNS * sizeof(OCC_RUN)));
+    if (buffer == NULL)
+        return false;
+
+    for (uint32_t i = 0; i < node->size; i++)
+    {
+        const OCC_CHANNEL *ch = &node->channels[i];
+        if (ch->freq == 0)
+            continue;
+        OCC_RECORD *rec = (OCC_RECORD *)(buffer + size);
+        OCC_RUN    *runs = (OCC_RUN *)(rec + 1);
+        rec->day        = node->day;
+        rec->freq       = ch->freq;
+        rec->n_busy     = EncodeRuns(ch->busy, runs);
+        rec->n_observed = EncodeRuns(ch->observed, runs + rec->n_busy);
+        size += RECORD_SIZE(rec);
+    }
+
+    bool ok = write(fd, buffer, size) == (ssize_t)size && fsync(fd) == 0;
+    free(buffer);
+    return ok;
+}
+
+//
+// OccupancyWrite
+// Writer side: append the bitmaps handed off by OccupancyMark. Safe to call
+// from another thread than the one marking, e.g. on an idle path.
+//
+bool OccupancyWrite (OCCUPANCY *occ)
+{
+    bool ok = true;
+
+    if (occ->fd < 0)
+        return true;
+    pthread_mutex_lock(&occ->lock);
+    OCC_PENDING *node = occ->pending;
+    occ->pending = NULL;
+    pthread_mutex_unlock(&occ->lock);
+
+    while (node != NULL)
+    {
+        OCC_PENDING *next = node->next;
+        ok = WriteDay(occ->fd, node) && ok;
+        free(node->channels);
+        free(node);
+        node = next;
+    }
+    return ok;
+}
+
+//
+// OccupancyFlush
+// Hand off the bitmaps in memory and write everything now, on the caller thread
+//
+bool OccupancyFlush (OCCUPANCY *occ)
+{
+    if (occ->fd < 0)
+        return true;
+    HandOff(occ);
+    return OccupancyWrite(occ);
+}
+
+void OccupancyClose (OCCUPANCY *occ)
+{
+    if (occ->fd < 0)
+        return;
+    if (!OccupancyFlush(occ))
+        fprintf (stderr, "Warning: occupancy write failed\n");
+    close(occ->fd);
+    free(occ->channels);
+    occ->channels = NULL;
+    pthread_mutex_destroy(&occ->lock);
+    occ->fd = -1;
+}
+
+//
+// CountRuns
+// Minutes of the runs inside [from, to), minutes of the day
+//
+static uint64_t CountRuns (const OCC_RUN *runs, int n, int64_t from, int64_t to)
+{
+    uint64_t count = 0;
+    for (int r = 0; r < n; r++)
+    {
+        int64_t start = runs[r].start, end = start + runs[r].length;
+        if (start < from)
+            start = from;
+        if (end > to)
+            end = to;
+        if (end > start)
+            count += end - start;
+    }
+    return count;
+}
+
+typedef struct {
+    freq_t   freq;
+    int32_t  day;
+    const OCC_RECORD *rec;
+} RECORD_REF;
+
+static int CompareRef (const void *a, const void *b)
+{
+    const RECORD_REF *ra = a, *rb = b;
+    if (ra->freq != rb->freq)
+        return (ra->freq > rb->freq) ? 1 : -1;
+    return (ra->day > rb->day) - (ra->day < rb->day);
+}
+
+static void DecodeRuns (const OCC_RUN *runs, int n, uint64_t *bits)
+{
+    for (int r = 0; r < n; r++)
+        for (int m = runs[r].start; m < runs[r].start + runs[r].length && m < OCC_MINUTES; m++)
+            bits[m / 64] |= 1ULL << (m % 64);
+}
+
+static uint64_t CountBits (const uint64_t *bits, int64_t from, int64_t to)
+{
+    uint64_t count = 0;
+    for (int64_t m = (from < 0) ? 0 : from; m < to && m < OCC_MINUTES; m++)
+        count += bits[m / 64] >> (m % 64) & 1;
+    return count;
+}
+
+//
+// OccupancyQuery
+// Busy and observed minutes per channel in the window [from, to),
+// all the channels when freq is 0. The result is sorted by frequency.
+// Records of the same channel and day (scanner restarted) are merged.
+//
+bool OccupancyQuery (const char *path, freq_t freq, time_t from, time_t to, OCC_STATS **stats, uint32_t *n_stats)
+{
+    struct stat st;
+
+    *stats   = NULL;
+    *n_stats = 0;
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(OCC_HEADER))
+    {
+        close(fd);
+        return false;
+    }
+    const char *base = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+        return false;
+    if (!CheckHeader((const OCC_HEADER *)base))
+    {
+        munmap((void *)base, st.st_size);
+        return false;
+    }
+
+    // records in the window
+    int64_t  from_min = from / 60, to_min = (to + 59) / 60;
+    uint32_t n = 0, size = 1024;
+    RECORD_REF *refs = malloc(size * sizeof(RECORD_REF));
+    uint64_t end = ValidEnd(base, st.st_size);
+
+    for (uint64_t offset = sizeof(OCC_HEADER); offset < end; )
+    {
+        const OCC_RECORD *rec = (const OCC_RECORD *)(base + offset);
+        int64_t day_min = (int64_t)rec->day * OCC_MINUTES;
+        offset += RECORD_SIZE(rec);
+
+        if (day_min + OCC_MINUTES <= from_min || day_min >= to_min)
+            continue;
+        if (freq != 0 && rec->freq != freq)
+            continue;
+        if (n == size)
+        {
+            size *= 2;
+            refs = realloc(refs, size * sizeof(RECORD_REF));
+        }
+        refs[n].freq = rec->freq;
+        refs[n].day  = rec->day;
+        refs[n].rec  = rec;
+        n++;
+    }
+    qsort(refs, n, sizeof(RECORD_REF), CompareRef);
+
+    // count each channel and day
+    OCC_STATS *result = malloc((n + 1) * sizeof(OCC_STATS));
+    uint32_t   n_result = 0;
+    for (uint32_t i = 0, j; i < n; i = j)
+    {
+        int64_t  day_min = (int64_t)refs[i].day * OCC_MINUTES;
+        uint64_t busy, observed;
+
+        for (j = i + 1; j < n && refs[j].freq == refs[i].freq && refs[j].day == refs[i].day; j++)
+            ;
+        if (j == i + 1)
+        {
+            const OCC_RUN *runs = (const OCC_RUN *)(refs[i].rec + 1);
+            busy     = CountRuns(runs, refs[i].rec->n_busy, from_min - day_min, to_min - day_min);
+            observed = CountRuns(runs + refs[i].rec->n_busy, refs[i].rec->n_observed,
+                                 from_min - day_min, to_min - day_min);
+        }
+        else
+        {
+            uint64_t busy_bits[OCC_WORDS] = {0}, observed_bits[OCC_WORDS] = {0};
+            for (uint32_t k = i; k < j; k++)
+            {
+                const OCC_RUN *runs = (const OCC_RUN *)(refs[k].rec + 1);
+                DecodeRuns(runs, refs[k].rec->n_busy, busy_bits);
+                DecodeRuns(runs + refs[k].rec->n_busy, refs[k].rec->n_observed, observed_bits);
+            }
+            busy     = CountBits(busy_bits, from_min - day_min, to_min - day_min);
+            observed = CountBits(observed_bits, from_min - day_min, to_min - day_min);
+        }
+
+        if (n_result > 0 && result[n_result - 1].freq == refs[i].freq)
+        {
+            result[n_result - 1].busy     += busy;
+            result[n_result - 1].observed += observed;
+        }
+        else
+        {
+            result[n_result].freq     = refs[i].freq;
+            result[n_result].busy     = busy;
+            result[n_result].observed = observed;
+            n_result++;
+        }
+    }
+    free(refs);
+    munmap((void *)base, st.st_size);
+
+    *stats   = result;
+    *n_stats = n_result;
+    return true;
+}
+
+static bool ParseDate (const char *str, time_t *t)
+{
+    struct tm tm;
+    memset(&tm, 0, sizeof(tm));
+    if (sscanf(str, "%d-%d-%d %d:%d", &tm.tm_year, &tm.tm_mon, &tm.tm_mday, &tm.tm_hour, &tm.tm_min) < 3)
+        return false;
+    tm.tm_year -= 1900;
+    tm.tm_mon  -= 1;
+    tm.tm_isdst = -1;
+    *t = mktime(&tm);
+    return *t != (time_t)-1;
+}
+
+//
+// OccupancyMain
+// gqrx-scanner occupancy <file> [--from "YYYY-MM-DD hh:mm"] [--to "YYYY-MM-DD hh:mm"] [--freq <Hz>]
+//
+int OccupancyMain (int argc, char **argv)
+{
+    time_t from = 0, to = time(NULL) + 86400;
+    freq_t freq = 0;
+    const char *path = NULL;
+    OCC_STATS *stats;
+    uint32_t n_stats;
+
+    for (int i = 2; i < argc; i++)
+    {
+        bool ok = true;
+        if (strcmp(argv[i], "--from") == 0 && i + 1 < argc)
+            ok = ParseDate(argv[++i], &from);
+        else if (strcmp(argv[i], "--to") == 0 && i + 1 < argc)
+            ok = ParseDate(argv[++i], &to);
+        else if (strcmp(argv[i], "--freq") == 0 && i + 1 < argc)
+            ok = (freq = strtoull(argv[++i], NULL, 10)) > 0;
+        else if (argv[i][0] != '-' && path == NULL)
+            path = argv[i];
+        else
+            ok = false;
+        if (!ok)
+        {
+            printf ("Error: occupancy: invalid option %s\n", argv[i]);
+            path = NULL;
+            break;
+        }
+    }
+    if (path == NULL)
+    {
+        printf ("Usage:\n%s occupancy <file> [--from \"YYYY-MM-DD hh:mm\"] [--to \"YYYY-MM-DD hh:mm\"] [--freq <Hz>]\n", argv[0]);
+        printf ("\tDuty cycle per channel in the window, from the store written with --occupancy.\n");
+        return EXIT_FAILURE;
+    }
+
+    if (!OccupancyQuery(path, freq, from, to, &stats, &n_stats))
+    {
+        printf ("Error: cannot read occupancy store %s\n", path);
+        return EXIT_FAILURE;
+    }
+
+    printf ("   Frequency MHz   Observed h     Busy h    Duty\n");
+    for (uint32_t i = 0; i < n_stats; i++)
+    {
+        if (stats[i].observed == 0)
+            continue;
+        printf ("  %14.3f %12.1f %10.1f %6.2f%%\n", stats[i].freq / 1e6, stats[i].observed / 60.0,
+                stats[i].busy / 60.0, 100.0 * stats[i].busy / stats[i].observed);
+    }
+    free(stats);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,116 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_OCCUPANCY_H_
+#define _GQRX_OCCUPANCY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <time.h>
+#include <pthread.h>
+#include "gqrx-prot.h"
+
+//
+// Occupancy store
+//
+// Minute by minute occupancy of each channel (bookmark or sweep bin), one
+// record per channel and UTC day, appended every hour, when the day is over
+// and at exit. The records of a channel and day are merged by the query.
+// The scan loop only marks the bitmaps in memory and hands them off, the
+// records are encoded, written and synced by OccupancyWrite on another thread.
+// Busy and observed minutes are stored as run-length encoded lists:
+//   header | record | busy runs[] | observed runs[] | record | ...
+// The duty cycle of a window is busy minutes / observed minutes.
+//
+#define OCC_MAGIC           0x434f5147  // "GQOC"
+#define OCC_VERSION         1
+#define OCC_MINUTES         1440
+#define OCC_WORDS           ((OCC_MINUTES + 63) / 64)
+#define OCC_FLUSH_PERIOD    3600        // sec, a crash loses at most the last hour
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t reserved;
+} OCC_HEADER;
+
+typedef struct {
+    int32_t  day;           // days since the epoch, UTC
+    uint16_t n_busy;        // number of runs
+    uint16_t n_observed;
+    uint64_t freq;
+} OCC_RECORD;
+
+typedef struct {
+    uint16_t start;         // minute of the day
+    uint16_t length;
+} OCC_RUN;
+
+typedef struct {
+    freq_t   freq;          // 0 = free slot
+    uint64_t busy[OCC_WORDS];
+    uint64_t observed[OCC_WORDS];
+} OCC_CHANNEL;
+
+typedef struct OCC_PENDING {
+    int32_t             day;
+    OCC_CHANNEL        *channels;
+    uint32_t            size;
+    struct OCC_PENDING *next;
+} OCC_PENDING;
+
+typedef struct {
+    int             fd;
+    freq_t          resolution; // channels are rounded to this step
+    int32_t         day;        // day of the bitmaps in memory
+    time_t          flush_at;   // next hand off of the bitmaps
+    OCC_CHANNEL    *channels;   // open addressing on the frequency
+    uint32_t        size;
+    uint32_t        used;
+    pthread_mutex_t lock;       // the pending list, shared with the writer
+    OCC_PENDING    *pending;    // bitmaps handed off, not written yet
+} OCCUPANCY;
+
+typedef struct {
+    freq_t   freq;
+    uint64_t busy;          // minutes
+    uint64_t observed;
+} OCC_STATS;
+
+//
+// Writer
+//
+bool OccupancyOpen(OCCUPANCY *occ, const char *path, freq_t resolution);
+void OccupancyMark(OCCUPANCY *occ, freq_t freq, time_t t, bool busy);
+void OccupancyMarkBusy(OCCUPANCY *occ, freq_t freq, time_t from, time_t to);
+bool OccupancyWrite(OCCUPANCY *occ);
+bool OccupancyFlush(OCCUPANCY *occ);
+void OccupancyClose(OCCUPANCY *occ);
+
+//
+// Query
+//
+bool OccupancyQuery(const char *path, freq_t freq, time_t from, time_t to, OCC_STATS **stats, uint32_t *n_stats);
+int  OccupancyMain(int argc, char **argv);
+
+#endif /* _GQRX_OCCUPANCY_H_ */
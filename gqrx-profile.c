@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include "gqrx-profile.h"
+
+bool ProfileEnabled = false;
+
+static SPAN_EVENT *ring = NULL;
+static atomic_ullong count;    // spans recorded, the ring keeps the last PROFILE_RING
+static clock_us_t  origin;
+static char       *profile_path = NULL;
+
+static const char *span_names[SPAN_KINDS] = {
+    "pass", "step", "tune", "settle", "sample", "debounce", "backtrack", "adjust", "listen", "command"
+};
+
+static const char *command_names[CMD_COUNT] = { "F", "f", "l", "l SQL", "L SQL", "U RECORD" };
+
+static void Push (SPAN_KIND kind, uint16_t arg, clock_us_t start, uint64_t duration, freq_t freq)
+{
+    SPAN_EVENT *e = &ring[atomic_fetch_add_explicit(&count, 1, memory_order_relaxed) % PROFILE_RING];
+    e->start    = start;
+    e->duration = (duration > UINT32_MAX) ? UINT32_MAX : (uint32_t)duration;
+    e->kind     = kind;
+    e->arg      = arg;
+    e->freq     = freq;
+}
+
+void SpanEnd (SPAN_KIND kind, clock_us_t start, freq_t freq)
+{
+    if (!ProfileEnabled || start == 0)
+        return;
+    Push(kind, 0, start, ClockNow() - start, freq);
+}
+
+void SpanCommand (PROT_COMMAND cmd, clock_us_t start, uint64_t rtt)
+{
+    if (!ProfileEnabled)
+        return;
+    Push(SPAN_COMMAND, cmd, start, rtt, 0);
+}
+
+//
+// ProfileStart
+// Spans are recorded from now on and written to path by ProfileStop
+//
+bool ProfileStart (const char *path)
+{
+    FILE *fd = fopen(path, "w"); // fail early on a bad path
+    if (fd == NULL)
+        return false;
+    fclose(fd);
+    ring = calloc(PROFILE_RING, sizeof(SPAN_EVENT));
+    profile_path = strdup(path);
+    if (ring == NULL || profile_path == NULL)
+    {
+        free(ring);
+        free(profile_path);
+        ring = NULL;
+        profile_path = NULL;
+        return false;
+    }
+    count  = 0;
+    origin = ClockNow();
+    ProfileEnabled = true;
+    return true;
+}
+
+//
+// ProfileStop
+// Write the spans in the ring as Chrome trace events ("X", complete events)
+//
+bool ProfileStop (void)
+{
+    if (!ProfileEnabled)
+        return true;
+    ProfileEnabled = false;
+
+    bool  ok = false;
+    FILE *fd = fopen(profile_path, "w");
+    if (fd != NULL)
+    {
+        uint64_t spans = atomic_load(&count);
+        uint64_t first = (spans > PROFILE_RING) ? spans - PROFILE_RING : 0;
+        fprintf(fd, "{\"displayTimeUnit\":\"ms\",\"otherData\":{\"spans\":%llu,\"dropped\":%llu},\"traceEvents\":[\n",
+                (unsigned long long)spans, (unsigned long long)first);
+        fprintf(fd, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"gqrx-scanner\"}}");
+        for (uint64_t i = first; i < spans; i++)
+        {
+            const SPAN_EVENT *e = &ring[i % PROFILE_RING];
+            long long ts = (long long)(e->start - origin);
+            if (e->kind == SPAN_COMMAND)
+                fprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"protocol\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":1,\"tid\":1}",
+                        command_names[e->arg], ts, e->duration);
+            else if (e->freq != 0)
+                fprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"scan\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":1,\"tid\":1,"
+                        "\"args\":{\"freq\":%llu}}", span_names[e->kind], ts, e->duration, (unsigned long long)e->freq);
+            else
+                fprintf(fd, ",\n{\"name\":\"%s\",\"cat\":\"scan\",\"ph\":\"X\",\"ts\":%lld,\"dur\":%u,\"pid\":1,\"tid\":1}",
+                        span_names[e->kind], ts, e->duration);
+        }
+        fprintf(fd, "\n]}\n");
+        ok = (fclose(fd) == 0);
+    }
+    free(ring);
+    free(profile_path);
+    ring = NULL;
+    profile_path = NULL;
+    return ok;
+}
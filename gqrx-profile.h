@@ -0,0 +1,81 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_PROFILE_H_
+#define _GQRX_PROFILE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gqrx-prot.h"
+#include "gqrx-clock.h"
+#include "gqrx-metrics.h"
+
+//
+// Profile
+//
+// Optional spans of the scan phases and of the protocol commands, kept in an
+// in-memory ring (the oldest are overwritten) and written at exit as Chrome
+// trace events, to be opened in chrome://tracing or ui.perfetto.dev.
+// A span is taken as SpanBegin() ... SpanEnd(kind, start, freq); both are a
+// test of ProfileEnabled when profiling is off. Any thread can take spans, each
+// one gets its own slot of the ring.
+//
+#define PROFILE_RING        (1 << 18)   // spans kept, 24 bytes each
+
+typedef enum
+{
+    SPAN_PASS,
+    SPAN_STEP,          // one frequency of the sweep or one bookmark
+    SPAN_TUNE,          // SetFreq
+    SPAN_SETTLE,        // wait for the level to settle after a retune
+    SPAN_SAMPLE,        // GetSignalLevelEx
+    SPAN_DEBOUNCE,
+    SPAN_BACKTRACK,
+    SPAN_ADJUST,
+    SPAN_LISTEN,        // WaitUserInputOrDelay
+    SPAN_COMMAND,       // a protocol round trip, the command is the arg
+    SPAN_KINDS
+} SPAN_KIND;
+
+typedef struct {
+    uint64_t start;     // us
+    uint32_t duration;  // us
+    uint16_t kind;
+    uint16_t arg;
+    uint64_t freq;
+} SPAN_EVENT;
+
+extern bool ProfileEnabled;
+
+static inline clock_us_t SpanBegin (void)
+{
+    return (ProfileEnabled) ? ClockNow() : 0;
+}
+
+void SpanEnd(SPAN_KIND kind, clock_us_t start, freq_t freq);
+void SpanCommand(PROT_COMMAND cmd, clock_us_t start, uint64_t rtt);
+
+bool ProfileStart(const char *path);
+bool ProfileStop(void);
+
+#endif /* _GQRX_PROFILE_H_ */
@@ -41,6 +41,35 @@ SOFTWARE.
 #endif
 #include <math.h>
 #include "gqrx-prot.h"
+#include "gqrx-clock.h"
+#include "gqrx-metrics.h"
+#include "gqrx-trace.h"
+#include "gqrx-profile.h"
+
+//
+// Receiver state shadow
+// What the scanner last set or read, with the time it was confirmed (0 = unknown).
+// Per thread: each scan engine runs on its own thread with its own connection.
+//
+static __thread struct {
+    freq_t     freq;
+    double     squelch;
+    bool       recording;
+    clock_us_t freq_at, squelch_at, recording_at;
+} State;
+
+void StateInvalidate (void)
+{
+    State.freq_at = State.squelch_at = State.recording_at = 0;
+}
+
+static bool StateFresh (clock_us_t at)
+{
+    if (at == 0 || ClockNow() - at >= STATE_TTL)
+        return false;
+    MetricAdd(METRIC_STATE_HITS, 1);
+    return true;
+}
 
 //
 // error - wrapper for perror
@@ -60,7 +89,7 @@ int Connect (char *hostname, int portno)
     struct hostent *server;
 
     /* socket: create the socket */
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
+    sockfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
     if (sockfd < 0)
         error("ERROR opening socket");
 
@@ -82,6 +111,8 @@ int Connect (char *hostname, int portno)
     if (connect(sockfd, (const struct sockaddr *) &serveraddr, sizeof(serveraddr)) < 0)
       error("ERROR connecting");
 
+    MetricAdd(METRIC_CONNECTS, 1);
+    StateInvalidate();
     return sockfd;
 }
 //
@@ -112,6 +143,79 @@ bool Recv(int sockfd, char *buf)
 }
 
 
+//
+// Command
+// Send a command and receive the reply, or take it from the replayed trace.
+// The round trip time goes to the metrics and to the recorded trace.
+//
+static void Command(int sockfd, PROT_COMMAND cmd, char *request, char *reply)
+{
+    clock_us_t start = ClockNow();
+
+    if (!TraceReplay(request, reply))
+    {
+        Send(sockfd, request);
+        Recv(sockfd, reply);
+    }
+    uint64_t rtt = ClockNow() - start;
+    MetricRtt(cmd, rtt);
+    SpanCommand(cmd, start, rtt);
+    TraceRecord(request, reply, start, rtt);
+}
+
+//
+// Pipeline
+// Send n commands in one write and read the n replies, one per line.
+// Every command is accounted with the round trip of the whole batch.
+//
+static bool Pipeline(int sockfd, int n, const PROT_COMMAND *cmds, char **requests, char replies[][BUFSIZE])
+{
+    char batch[BUFSIZE], buf[BUFSIZE];
+    clock_us_t start = ClockNow();
+    bool replayed = false;
+
+    batch[0] = '\0';
+    for (int i = 0; i < n; i++)
+    {
+        replayed = TraceReplay(requests[i], replies[i]); // all or none, replaying or not
+        strcat(batch, requests[i]);
+    }
+    if (!replayed)
+    {
+        int len = 0, lines = 0;
+        Send(sockfd, batch);
+        while (lines < n)
+        {
+            int r = read(sockfd, buf + len, BUFSIZE - 1 - len);
+            if (r <= 0)
+                return false;
+            for (int i = len; i < len + r; i++)
+                lines += (buf[i] == '\n');
+            len += r;
+            if (len >= BUFSIZE - 1)
+                return false;
+        }
+        buf[len] = '\0';
+        char *line = buf;
+        for (int i = 0; i < n; i++)
+        {
+            char *end = strchr(line, '\n');
+            size_t size = end - line + 1;
+            memcpy(replies[i], line, size);
+            replies[i][size] = '\0';
+            line = end + 1;
+        }
+    }
+    uint64_t rtt = ClockNow() - start;
+    for (int i = 0; i < n; i++)
+    {
+        MetricRtt(cmds[i], rtt);
+        SpanCommand(cmds[i], start, rtt);
+        TraceRecord(requests[i], replies[i], start, rtt);
+    }
+    return true;
+}
+
 //
 // GQRX Protocol
 //
@@ -119,32 +223,43 @@ bool GetCurrentFreq(int sockfd, freq_t *freq)
 {
     char buf[BUFSIZE];
 
-    Send(sockfd, "f\n");
-    Recv(sockfd, buf);
+    if (StateFresh(State.freq_at))
+    {
+        *freq = State.freq;
+        return true;
+    }
+    Command(sockfd, CMD_GET_FREQ, "f\n", buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
+    {
+        StateInvalidate();
         return false;
+    }
 
     sscanf(buf, "%llu", freq);
+    State.freq = *freq;
+    State.freq_at = ClockNow();
     return true;
 }
 bool SetFreq(int sockfd, freq_t freq)
 {
+    char request[64];
     char buf[BUFSIZE];
+    clock_us_t span = SpanBegin();
 
-    sprintf (buf, "F %llu\n", freq);
-    Send(sockfd, buf);
-    Recv(sockfd, buf);
+    sprintf (request, "F %llu\n", freq);
+    Command(sockfd, CMD_SET_FREQ, request, buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
-        return false;
-
-    freq_t freq_current = 0;
-    do
     {
-        GetCurrentFreq(sockfd, &freq_current);
-    } while (freq_current != freq);
+        StateInvalidate();
+        return false;
+    }
 
+    // gqrx has retuned when it replies, no need to read the frequency back
+    State.freq = freq;
+    State.freq_at = ClockNow();
+    SpanEnd(SPAN_TUNE, span, freq);
     return true;
 }
 
@@ -152,8 +267,7 @@ bool GetSignalLevel(int sockfd, double *dBFS)
 {
     char buf[BUFSIZE];
 
-    Send(sockfd, "l\n");
-    Recv(sockfd, buf);
+    Command(sockfd, CMD_GET_LEVEL, "l\n", buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
         return false;
@@ -166,33 +280,99 @@ bool GetSignalLevel(int sockfd, double *dBFS)
     return true;
 }
 
+//
+// MonitorLevel
+// The signal level, pipelined with the frequency and the squelch level
+// when freq and squelch are not NULL: a single round trip either way.
+// The frequency and squelch read revalidate the state shadow.
+//
+bool MonitorLevel(int sockfd, freq_t *freq, double *squelch, double *dBFS)
+{
+    static const PROT_COMMAND cmds[3] = { CMD_GET_FREQ, CMD_GET_SQUELCH, CMD_GET_LEVEL };
+    char *requests[3] = { "f\n", "l SQL\n", "l\n" };
+    char replies[3][BUFSIZE];
+    int  first = (freq != NULL && squelch != NULL) ? 0 : 2;
+
+    if (!Pipeline(sockfd, 3 - first, cmds + first, requests + first, replies))
+        return false;
+    if (first == 0)
+    {
+        clock_us_t now = ClockNow();
+        if (strcmp(replies[0], "RPRT 1") != 0 && sscanf(replies[0], "%llu", freq) == 1)
+        {
+            State.freq = *freq;
+            State.freq_at = now;
+        }
+        if (sscanf(replies[1], "%lf", squelch) == 1)
+        {
+            *squelch = round((*squelch) * 10)/10;
+            State.squelch = *squelch;
+            State.squelch_at = now;
+        }
+    }
+    if (sscanf(replies[2 - first], "%lf", dBFS) != 1)
+        return false;
+    *dBFS = round((*dBFS) * 10)/10;
+    return *dBFS != 0.0;
+}
+
+//
+// MonitorInterval
+// Poll interval of an active channel, given how long ago (us) the level
+// last crossed the squelch
+//
+long MonitorInterval(double level, double squelch, long since_crossing)
+{
+    if (fabs(level - squelch) < MONITOR_MARGIN || since_crossing < MONITOR_SETTLED)
+        return MONITOR_FAST;
+    if (level > squelch && since_crossing >= MONITOR_STEADY)
+        return MONITOR_SLOW;
+    return MONITOR_NORMAL;
+}
+
 bool GetSquelchLevel(int sockfd, double *dBFS)
 {
     char buf[BUFSIZE];
 
-    Send(sockfd, "l SQL\n");
-    Recv(sockfd, buf);
+    if (StateFresh(State.squelch_at))
+    {
+        *dBFS = State.squelch;
+        return true;
+    }
+    Command(sockfd, CMD_GET_SQUELCH, "l SQL\n", buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
+    {
+        StateInvalidate();
         return false;
+    }
 
     sscanf(buf, "%lf", dBFS);
     *dBFS = round((*dBFS) * 10)/10;
+    State.squelch = *dBFS;
+    State.squelch_at = ClockNow();
 
     return true;
 }
 
 bool SetSquelchLevel(int sockfd, double dBFS)
 {
+    char request[64];
     char buf[BUFSIZE];
 
-    sprintf (buf, "L SQL %f\n", dBFS);
-    Send(sockfd, buf);
-    Recv(sockfd, buf);
+    if (State.squelch == round(dBFS * 10)/10 && StateFresh(State.squelch_at))
+        return true;
+    sprintf (request, "L SQL %f\n", dBFS);
+    Command(sockfd, CMD_SET_SQUELCH, request, buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
+    {
+        StateInvalidate();
         return false;
+    }
 
+    State.squelch = round(dBFS * 10)/10;
+    State.squelch_at = ClockNow();
     return true;
 }
 //
@@ -204,18 +384,66 @@ bool GetSignalLevelEx(int sockfd, double *dBFS, int n_samp)
     double temp_level;
     *dBFS = 0;
     int errors = 0;
+    clock_us_t span = SpanBegin();
     for (int i = 0; i < n_samp; i++)
     {
         if ( GetSignalLevel(sockfd, &temp_level) )
             *dBFS = *dBFS + temp_level;
         else
             errors++;
-        usleep(1000);
+        SleepFor(1000);
     }
     *dBFS = *dBFS / (n_samp - errors);
+    SpanEnd(SPAN_SAMPLE, span, 0);
     return true;
 }
 
+//
+// WaitSignalSettle
+// Poll the signal level every 'poll' us until three consecutive samples are within
+// 'tolerance' dB, or 'max_wait' us have elapsed.
+// Returns true if the level settled. elapsed (us) is the time to the first sample
+// of the stable run, not the two confirming polls, or the time spent on a timeout.
+//
+bool WaitSignalSettle(int sockfd, double tolerance, long poll, long max_wait, double *dBFS, long *elapsed)
+{
+    double previous = 0, level = 0;
+    int    stable = -1; // no sample yet
+    long   run_at = 0;  // first sample of the current stable run
+    clock_us_t start = ClockNow();
+    clock_us_t deadline = start + ((max_wait > 0) ? max_wait : 0);
+    TICKER ticker;
+
+    TickerStart(&ticker, poll);
+    *elapsed = 0;
+    while (ClockNow() < deadline)
+    {
+        if (GetSignalLevel(sockfd, &level))
+        {
+            if (stable >= 0 && fabs(level - previous) <= tolerance)
+                stable++;
+            else
+            {
+                stable = 0;
+                run_at = (long)(ClockNow() - start);
+            }
+            previous = level;
+        }
+        if (stable >= 2)
+        {
+            *elapsed = run_at;
+            *dBFS = level;
+            return true;
+        }
+        if (ticker.next >= deadline)
+            break;
+        TickerWait(&ticker);
+    }
+    *elapsed = (long)(ClockNow() - start);
+    *dBFS = level;
+    return false;
+}
+
 //
 // StartRecording
 // Start recording audio stream to a file
@@ -224,12 +452,18 @@ bool StartRecording(int sockfd)
 {
     char buf[BUFSIZE];
 
-    Send(sockfd, "U RECORD 1\n");
-    Recv(sockfd, buf);
+    if (State.recording == true && StateFresh(State.recording_at))
+        return true;
+    Command(sockfd, CMD_RECORD, "U RECORD 1\n", buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
+    {
+        StateInvalidate();
         return false;
+    }
 
+    State.recording = true;
+    State.recording_at = ClockNow();
     return true;
 }
 
@@ -241,11 +475,17 @@ bool StopRecording(int sockfd)
 {
     char buf[BUFSIZE];
 
-    Send(sockfd, "U RECORD 0\n");
-    Recv(sockfd, buf);
+    if (State.recording == false && StateFresh(State.recording_at))
+        return true;
+    Command(sockfd, CMD_RECORD, "U RECORD 0\n", buf);
 
     if (strcmp(buf, "RPRT 1") == 0 )
+    {
+        StateInvalidate();
         return false;
+    }
 
+    State.recording = false;
+    State.recording_at = ClockNow();
     return true;
 }
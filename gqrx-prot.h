@@ -29,6 +29,20 @@ SOFTWARE.
 #define SAVED_FREQ_MAX  1000
 #define TAG_MAX         100
 
+// monitoring an active channel: the level is polled at an interval adapted to
+// the signal, the frequency and the squelch are checked every MONITOR_CHECK
+#define MONITOR_FAST    20000   // near the squelch or just after a crossing
+#define MONITOR_NORMAL  100000
+#define MONITOR_SLOW    250000  // in the middle of a long, strong carrier
+#define MONITOR_MARGIN  6.0     // dB from the squelch considered a transition
+#define MONITOR_SETTLED 500000  // a crossing is recent for 500 ms
+#define MONITOR_STEADY  2000000 // a carrier is long after 2 sec
+#define MONITOR_CHECK   1000000
+
+// the receiver state set by the scanner is answered locally, until it is
+// older than STATE_TTL or invalidated (errors, reconnects, restarts)
+#define STATE_TTL       1000000
+
 typedef unsigned long long freq_t;
 
 
@@ -55,12 +69,16 @@ bool Recv(int sockfd, char *buf);
 //
 // GQRX Protocol
 //
+void StateInvalidate(void);
 bool GetCurrentFreq(int sockfd, freq_t *freq);
 bool SetFreq(int sockfd, freq_t freq);
 bool GetSignalLevel(int sockfd, double *dBFS);
 bool GetSquelchLevel(int sockfd, double *dBFS);
 bool SetSquelchLevel(int sockfd, double dBFS);
 bool GetSignalLevelEx(int sockfd, double *dBFS, int n_samp);
+bool MonitorLevel(int sockfd, freq_t *freq, double *squelch, double *dBFS);
+long MonitorInterval(double level, double squelch, long since_crossing);
+bool WaitSignalSettle(int sockfd, double tolerance, long poll, long max_wait, double *dBFS, long *elapsed);
 bool StartRecording(int sockfd);
 bool StopRecording(int sockfd);
 
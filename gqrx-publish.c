@@ -0,0 +1,160 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+#include "gqrx-publish.h"
+#include "gqrx-metrics.h"
+
+static int              endpoints[PUBLISH_MAX]; // connected datagram sockets
+static int              n_endpoints = 0;
+static atomic_ulong     dropped;
+
+//
+// Endpoint
+// Connect a non-blocking datagram socket to "[addr:]port", 127.0.0.1 by default.
+// An IPv6 address goes in brackets: "[ff02::1]:5000"
+//
+static int Endpoint (const char *endpoint, size_t len)
+{
+    struct addrinfo hints, *ai;
+    char   spec[64], *host = "127.0.0.1", *port;
+    int    hops = 1; // multicast stays on the local network
+
+    if (len >= sizeof(spec))
+        return -1;
+    memcpy(spec, endpoint, len);
+    spec[len] = '\0';
+    if (spec[0] == '[')
+    {
+        char *close_bracket = strchr(spec, ']');
+        if (close_bracket == NULL || close_bracket[1] != ':')
+            return -1;
+        *close_bracket = '\0';
+        host = spec + 1;
+        port = close_bracket + 2;
+    }
+    else if ((port = strrchr(spec, ':')) != NULL)
+    {
+        *port++ = '\0';
+        host = spec;
+    }
+    else
+        port = spec;
+    if (atoi(port) <= 0)
+        return -1;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_DGRAM;
+    hints.ai_flags    = AI_NUMERICHOST | AI_NUMERICSERV;
+    if (getaddrinfo(host, port, &hints, &ai) != 0)
+        return -1;
+
+    int fd = socket(ai->ai_family, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd >= 0)
+    {
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        if (ai->ai_family == AF_INET &&
+            IN_MULTICAST(ntohl(((struct sockaddr_in *)ai->ai_addr)->sin_addr.s_addr)))
+        {
+            unsigned char ttl = hops;
+            setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+        }
+        else if (ai->ai_family == AF_INET6 &&
+                 IN6_IS_ADDR_MULTICAST(&((struct sockaddr_in6 *)ai->ai_addr)->sin6_addr))
+            setsockopt(fd, IPPROTO_IPV6, IPV6_MULTICAST_HOPS, &hops, sizeof(hops));
+        if (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)
+        {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(ai);
+    return fd;
+}
+
+//
+// PublishStart
+// endpoints: "[addr:]port[,[addr:]port...]", addr is numeric IPv4 or [IPv6]
+//
+bool PublishStart (const char *list)
+{
+    const char *start = list;
+
+    while (*start != '\0')
+    {
+        size_t len = strcspn(start, ",");
+        if (n_endpoints >= PUBLISH_MAX)
+            break;
+        int fd = Endpoint(start, len);
+        if (fd < 0)
+        {
+            PublishStop();
+            return false;
+        }
+        endpoints[n_endpoints++] = fd;
+        start += len + (start[len] == ',');
+    }
+    return n_endpoints > 0;
+}
+
+//
+// PublishSend
+// One datagram to every endpoint, never blocks
+//
+void PublishSend (const char *buf, size_t len)
+{
+    for (int e = 0; e < n_endpoints; e++)
+    {
+        if (send(endpoints[e], buf, len, MSG_DONTWAIT) < 0 &&
+            (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS || errno == EMSGSIZE))
+        {
+            atomic_fetch_add_explicit(&dropped, 1, memory_order_relaxed);
+            MetricAdd(METRIC_PUBLISH_DROPS, 1);
+        }
+        // ECONNREFUSED and the like: nobody is listening right now
+    }
+}
+
+unsigned long PublishDropped (void)
+{
+    return atomic_load_explicit(&dropped, memory_order_relaxed);
+}
+
+void PublishStop (void)
+{
+    for (int e = 0; e < n_endpoints; e++)
+        close(endpoints[e]);
+    n_endpoints = 0;
+}
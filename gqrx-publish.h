@@ -0,0 +1,45 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_PUBLISH_H_
+#define _GQRX_PUBLISH_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+
+//
+// Event publisher
+//
+// Datagrams sent to UDP endpoints, unicast or multicast, IPv4 or IPv6.
+// The sockets are non-blocking: a datagram that cannot be queued at once
+// is dropped and counted, a missing subscriber is not an error.
+//
+#define PUBLISH_MAX         8       // endpoints
+#define PUBLISH_DATAGRAM    1400    // fits in an ethernet frame
+
+bool PublishStart(const char *endpoints);
+void PublishSend(const char *buf, size_t len);
+unsigned long PublishDropped(void);
+void PublishStop(void);
+
+#endif /* _GQRX_PUBLISH_H_ */
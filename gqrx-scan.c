@@ -32,10 +32,6 @@ SOFTWARE.
  */
 #define _GNU_SOURCE // strcasestr
 #include <stdio.h>
-#ifndef OSX
-#include <stdio_ext.h>
-#else
-#endif
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
@@ -54,50 +50,43 @@ SOFTWARE.
 #else
 #include <sys/syslimits.h>
 #endif
-#include <termios.h>
 #include <time.h>
 #include <getopt.h>
 #include <ctype.h>
 #include <string.h>
 #include <errno.h>
+#include <signal.h>
 #include "gqrx-prot.h"
-
-#define NB_ENABLE    true
-#define NB_DISABLE   false
+#include "gqrx-scanner.h"
+#include "gqrx-engine.h"
+#include "gqrx-clock.h"
+#include "gqrx-events.h"
+#include "gqrx-hitlog.h"
+#include "gqrx-occupancy.h"
+#include "gqrx-input.h"
+#include "gqrx-control.h"
+#include "gqrx-metrics.h"
+#include "gqrx-trace.h"
+#include "gqrx-profile.h"
+#include "gqrx-survey.h"
+#include "gqrx-waterfall.h"
+#include "gqrx-publish.h"
+#include "gqrx-hooks.h"
+#include "gqrx-audio.h"
+#include "gqrx-capture.h"
 
 //
 // Globals definitions
 //
-typedef struct {
-    freq_t freq; // frequency in Mhz
-    double noise_floor; // averages noise floor of frequency
-    int count; // hit count on sweep scan
-    int miss;  // miss count on sweep scan
-    char descr[BUFSIZE]; // ugly buffer for descriptions: TODO convert it in a pointer
-    char *tags[TAG_MAX]; // tags
-    int   tag_max;
-}FREQ;
-
 typedef enum
 {
     sweep,
     bookmark
 } SCAN_MODE;
 
-// Stores
-/*FREQ Frequencies[FREQ_MAX] = {0};*/
-FREQ* Frequencies; //if user would exceed 4096 different frequencies counter it would be bad
-                   //I've took liberty of changing it to dynamic array
-                   //implementation in main after ParseInputOptions()
-int  Frequencies_Max = 0;
-
-FREQ SavedFrequencies[SAVED_FREQ_MAX] = {0};
-int  SavedFreq_Max = 0;
-
-FREQ BannedFrequencies[SAVED_FREQ_MAX] = {0};
-int  BannedFreq_Max = 0;
-
-static char freq_string[BUFSIZE] = {0};
+// the engine driven by the keyboard and the control socket: bookmarks, hits, bans, tags,
+// the scan options and the outputs of the scan loops
+ENGINE Engine;
 
 
 //
@@ -107,8 +96,8 @@ const char     *g_hostname          = "localhost";
 const int       g_portno            = 7356;
 const freq_t    g_freq_delta        = 1000000; // +- 1Mhz default bandwidth to scan from tuned freq.
 const freq_t    g_default_scan_bw   = 10000;   // default scan frequency steps (10Khz)
-const freq_t    g_ban_tollerance    = 10000;   // +- 10Khz bandwidth to ban from current freq.
 const long      g_delay             = 2500000; // 2.5 sec in microseconds
+const long      g_speed             = 250000;  // bookmark dwell upper bound, 250 ms
 const char     *g_bookmarksfile     = "~/.config/gqrx/bookmarks.csv";
 //
 // Input options
@@ -116,32 +105,75 @@ const char     *g_bookmarksfile     = "~/.config/gqrx/bookmarks.csv";
 char           *opt_hostname = NULL;
 int             opt_port = 0;
 freq_t          opt_freq = 0;
-freq_t          opt_min_freq = 0;
-freq_t          opt_max_freq = 0;
-freq_t          opt_scan_bw = g_default_scan_bw;
-long            opt_delay = 0; //LWVMOBILE: Changing this variable from 0 to 250 attempt to fix 'no delay argument given' stoppage on bookmark scan
+// range, step, delay, speed, max listen time, record, verbose and squelch delta: Engine.opt
 //LWVMOBILE: New variables inserted here
-long            opt_speed = 250000;
 long            opt_date = 0;
 //LWVMOBILE; End new variables.
 SCAN_MODE       opt_scan_mode = sweep;
-bool            opt_tag_search = false;
-char           *opt_tags[TAG_MAX] = {0};
-int             opt_tag_max = 0;
-long            opt_max_listen = 0;
-bool            opt_record = false;
-// only for debug
-bool            opt_verbose = false;
-
-// set squelch delta
-double          opt_squelch_delta = 0.0;
-bool            opt_squelch_delta_auto_enable = false;
-//
-// Local Prototypes
-//
-bool BanFreq (freq_t freq_current);
-bool IsBannedFreq (freq_t *freq_current);
-void ClearAllBans ( void );
+
+// bookmark sources and compiled cache
+char           *opt_bookmarks[CACHE_SOURCES_MAX] = {0};
+int             opt_bookmarks_max = 0;
+char           *opt_cache = NULL;
+bool            opt_compile = false;
+BOOKMARK_CACHE  BookmarkCache = {0};
+
+// settle time calibration at start
+bool            opt_calibrate = true;
+
+// hit sessions log
+char           *opt_log = NULL;
+
+// per minute channel occupancy store
+char           *opt_occupancy = NULL;
+
+// power survey of the band from another tool, sweep mode only probes the bins with energy
+char           *opt_survey = NULL;
+double          opt_survey_threshold = SURVEY_THRESHOLD;
+
+// levels of every sweep pass, in a memory mapped ring for external viewers
+char           *opt_waterfall = NULL;
+
+// hit events as JSON datagrams to UDP endpoints, [address:]port list
+char           *opt_publish = NULL;
+
+// per bin detection thresholds instead of the gqrx squelch, 0 = off
+double          opt_cfar = 0;
+double          opt_cfar_hysteresis = CFAR_HYSTERESIS;
+
+// commands run on hit start and end by a worker pool
+char           *opt_hook_start = NULL;
+char           *opt_hook_end = NULL;
+int             opt_hook_workers = HOOKS_WORKERS;
+long            opt_hook_timeout = HOOKS_TIMEOUT;
+
+// activity from the gqrx UDP audio stream while listening, [address:]port
+char           *opt_audio = NULL;
+
+// CTCSS tones or DCS codes wanted per frequency, tag or *, decoded on the audio stream
+char           *opt_tone = NULL;
+TONE_RULES      ToneRules;
+
+// per hit WAV files of the audio stream with a pre-roll, in this directory
+char           *opt_capture = NULL;
+
+// no keyboard, no terminal setup (also when stdin is not a terminal)
+bool            opt_headless = false;
+
+// control socket, pause and restart of the scan loops: Engine.paused, Engine.restart
+char           *opt_control = NULL;
+
+// metrics endpoint, [address:]port
+char           *opt_metrics = NULL;
+
+// spans of the scan phases, written as Chrome trace events
+char           *opt_profile = NULL;
+
+// protocol trace, recorded or replayed instead of connecting to gqrx
+char           *opt_trace = NULL;
+char           *opt_replay = NULL;
+double          opt_replay_speed = 1.0;
+
 
 //
 // ParseInputOptions
@@ -157,6 +189,16 @@ void print_usage ( char *name )
     printf ("\t\t[-t|--tags <\"tag1|tag2|...\">]\n");
     printf ("\t\t[-v|--verbose]\n");
     printf ("\t\t[-r|--record]\n");
+    printf ("\t\t[-k|--bookmarks <file>] [-c|--cache <file>] [-C|--compile]\n");
+    printf ("\t\t[-N|--no-calibrate] [-o|--log <file>] [-O|--occupancy <file>]\n");
+    printf ("\t\t[-H|--headless] [-S|--control <path>] [-M|--metrics <[address:]port>]\n");
+    printf ("\t\t[-T|--trace <file>] [-R|--replay <file>] [-X|--replay-speed <factor>] [-P|--profile <file>]\n");
+    printf ("\t\t[-W|--survey <file>] [-Y|--survey-threshold <dB>] [-F|--waterfall <file>]\n");
+    printf ("\t\t[-U|--publish <[address:]port,...>] [-A|--on-hit-start <command>] [-E|--on-hit-end <command>]\n");
+    printf ("\t\t[-J|--hook-workers <n>] [-K|--hook-timeout <time>] [-Q|--cfar <factor>] [-G|--cfar-hysteresis <dB>]\n");
+    printf ("\t\t[-a|--audio <[address:]port>] [-Z|--tone <rules>] [-I|--capture <directory>]\n");
+    printf ("%s report <log file> [--from hh:mm] [--to hh:mm] [--top n] [--threads n]\n", name);
+    printf ("%s occupancy <file> [--from \"YYYY-MM-DD hh:mm\"] [--to \"YYYY-MM-DD hh:mm\"] [--freq <Hz>]\n", name);
     printf ("\n");
     printf ("-h, --host <host>            Name of the host to connect. Default: localhost\n");
     printf ("-p, --port <port>            The number of the port to connect. Default: 7356\n");
@@ -169,7 +211,8 @@ void print_usage ( char *name )
     printf ("-s, --step <freq>            Frequency step <freq> in Hz. Default: %llu\n", g_default_scan_bw);
     printf ("-d, --delay <time>           Lingering time in milliseconds before the scanner reactivates. Default 2000\n");
     printf ("-l, --max-listen <time>      Maximum time to listen to an active frequency. Default 0, no maximum\n");
-    printf ("-x, --speed <time>           Time in milliseconds for bookmark scan speed. Default 250 milliseconds.\n");
+    printf ("-x, --speed <time>           Maximum dwell time in milliseconds on a bookmark. Default 250 milliseconds.\n");
+    printf ("                               The dwell is learned per bookmark, waiting for the level to settle.\n");
     printf ("                               If scan lands on wrong bookmark during search, use -x 500 (ms) to slow down speed\n");
     printf ("-y  --date                   Date Format, default is 0.\n");
     printf ("                               0 = mm-dd-yy\n");
@@ -187,6 +230,53 @@ void print_usage ( char *name )
     printf ("                               tags are case insensitive and match also for partial string contained in a tag\n");
     printf ("                               Works only with -m bookmark scan mode\n");
     printf ("-r, --record                  Enable recording of detected signals\n");
+    printf ("-k, --bookmarks <file>       Bookmarks file to use in bookmark mode. Default: %s\n", g_bookmarksfile);
+    printf ("                               Can be repeated (max %d) to merge several files\n", CACHE_SOURCES_MAX);
+    printf ("-c, --cache <file>           Compiled bookmarks cache. Used in bookmark mode if up to date with the\n");
+    printf ("                               bookmark files, otherwise the bookmark files are parsed\n");
+    printf ("-C, --compile                Compile the bookmark files into the cache file given with -c and exit\n");
+    printf ("-N, --no-calibrate           Skip the startup calibration of the settle time after tuning.\n");
+    printf ("                               The settle time is still learned during the scan\n");
+    printf ("-o, --log <file>             Append every hit session to a binary log, see the report command\n");
+    printf ("-O, --occupancy <file>       Keep the per minute occupancy of each channel, see the occupancy command\n");
+    printf ("-H, --headless               No keyboard commands and no terminal setup, e.g. running as a service.\n");
+    printf ("                               Implied when the standard input is not a terminal\n");
+    printf ("-S, --control <path>         Accept commands on a Unix socket: skip, ban, clear, pause, resume,\n");
+    printf ("                               range, step, tags, priority, state. Send \"help\" for the syntax\n");
+    printf ("-M, --metrics <[addr:]port>  Serve Prometheus metrics on http://<addr>:<port>/metrics.\n");
+    printf ("                               Default address: 127.0.0.1\n");
+    printf ("-T, --trace <file>           Record the commands, replies and timings of the gqrx session\n");
+    printf ("-R, --replay <file>          Replay a recorded trace instead of connecting to gqrx.\n");
+    printf ("                               The scan stops at the end of the trace\n");
+    printf ("-X, --replay-speed <factor>  Speed of the replayed round trips, 0 for no wait. Default: 1\n");
+    printf ("-P, --profile <file>         Write the time spent in each scan phase and protocol command\n");
+    printf ("                               as Chrome trace events (chrome://tracing, ui.perfetto.dev)\n");
+    printf ("-W, --survey <file>          Power survey of the band in rtl_power CSV format, from a file or a FIFO.\n");
+    printf ("                               Sweep mode only probes the bins above the threshold or not surveyed\n");
+    printf ("                               in the last %d minutes\n", SURVEY_STALE / 60000000);
+    printf ("-Y, --survey-threshold <dB>  Level above the median of each survey hop. Default: %.1f\n", SURVEY_THRESHOLD);
+    printf ("-F, --waterfall <file>       Write the levels of the last %d sweep passes to a memory mapped ring\n", WATERFALL_ROWS);
+    printf ("-U, --publish <endpoints>    Send hit start, update and end events as JSON datagrams to UDP\n");
+    printf ("                               endpoints: [address:]port, comma separated, up to %d. Multicast\n", PUBLISH_MAX);
+    printf ("                               addresses are allowed, IPv6 in brackets: [ff02::1]:5555.\n");
+    printf ("                               Default address: 127.0.0.1\n");
+    printf ("-A, --on-hit-start <command> Shell command run when a hit starts, without waiting for it.\n");
+    printf ("                               The hit is in GQRX_* environment variables and as JSON on stdin\n");
+    printf ("-E, --on-hit-end <command>   Shell command run when a hit ends\n");
+    printf ("-J, --hook-workers <n>       Hooks run at the same time, the others are queued (max %d). Default: %d\n",
+            HOOKS_QUEUE, HOOKS_WORKERS);
+    printf ("-K, --hook-timeout <time>    Milliseconds before a hook is killed. Default: %d\n", HOOKS_TIMEOUT / 1000);
+    printf ("-Q, --cfar <factor>          Detect with a threshold per bin or bookmark instead of the gqrx squelch:\n");
+    printf ("                               <factor> deviations above the noise learned on the bin and its neighbours.\n");
+    printf ("                               The squelch is set to the close threshold while listening. Ex.: %.1f\n", CFAR_FACTOR);
+    printf ("-G, --cfar-hysteresis <dB>   Below the open threshold to close a bin. Default: %.1f\n", CFAR_HYSTERESIS);
+    printf ("-a, --audio <[addr:]port>    Tell the end of a hit from the gqrx UDP audio stream (port %d in gqrx)\n", AUDIO_PORT);
+    printf ("                               instead of the level, within tens of milliseconds. Default address: 127.0.0.1\n");
+    printf ("-Z, --tone <rules>           Listen only to traffic with a CTCSS tone or DCS code, decoded on the audio\n");
+    printf ("                               stream: <key>=<tone>, comma separated, where <key> is a frequency in Hz,\n");
+    printf ("                               a tag or * and <tone> is in Hz or a DCS code. Ex.: \"Repeaters=88.5,*=D023\"\n");
+    printf ("-I, --capture <directory>    Write the audio stream of every hit to <freq>_<date>_<time>.wav, starting\n");
+    printf ("                               up to %d seconds before the hit, from the tune\n", CAPTURE_PREROLL);
     printf ("-v, --verbose                Output more information during scan (used for debug). Default: false\n");
     printf ("--help                       This help message.\n");
     printf ("\n");
@@ -197,38 +287,16 @@ void print_usage ( char *name )
     printf ("%s --min 430000000 --max 431000000 -d 3000\n", name);
     printf ("\tPerforms a sweep scan from frequency 430MHz to 431MHz, using a delay of \n");
     printf ("\t3 secs as idle time after a signal is lost, restarting the sweep loop when this time expires\n");
+    printf ("%s report hits.log --from 06:00 --to 09:00\n", name);
+    printf ("\tBusiest channels and hourly activity of the sessions logged with -o hits.log between 6 and 9 AM\n");
+    printf ("%s occupancy busy.occ --from \"2025-06-01 00:00\" --to \"2025-07-01 00:00\"\n", name);
+    printf ("\tDuty cycle of each channel in June, from the store written with -O busy.occ\n");
     printf ("\n");
     printf ("Full documentation available at <https://github.com/neural75/gqrx-scanner>\n");
 
     exit (EXIT_FAILURE);
 }
 
-
-bool ParseTags (char *tags)
-{
-    char *tag = NULL;
-
-    tag = strtok (tags, "|");
-
-    int k = 0;
-    while (tag != NULL && k < TAG_MAX)
-    {
-        int len =  strlen(tag) + 1 ;
-        opt_tags[k] = calloc(sizeof(char), len);
-        strncpy(opt_tags[k], tag, len);
-
-        tag = strtok(NULL, "|");
-        k++;
-    }
-    opt_tag_max = k;
-    if (k == 0) // wtf
-    {
-        printf ("Error: -t option requires a '|' separator for list of tags.\n");
-        return false;
-    }
-    return true;
-}
-
 bool ParseInputOptions (int argc, char **argv)
 {
   int c;
@@ -257,12 +325,38 @@ bool ParseInputOptions (int argc, char **argv)
           {"squelch_delta",    required_argument, 0, 'q'},
           {"max-listen",       required_argument, 0, 'l'},
           {"record", no_argument, 0, 'r'},
+          {"bookmarks",        required_argument, 0, 'k'},
+          {"cache",            required_argument, 0, 'c'},
+          {"compile",          no_argument,       0, 'C'},
+          {"no-calibrate",     no_argument,       0, 'N'},
+          {"log",              required_argument, 0, 'o'},
+          {"occupancy",        required_argument, 0, 'O'},
+          {"headless",         no_argument,       0, 'H'},
+          {"control",          required_argument, 0, 'S'},
+          {"metrics",          required_argument, 0, 'M'},
+          {"trace",            required_argument, 0, 'T'},
+          {"replay",           required_argument, 0, 'R'},
+          {"replay-speed",     required_argument, 0, 'X'},
+          {"profile",          required_argument, 0, 'P'},
+          {"survey",           required_argument, 0, 'W'},
+          {"survey-threshold", required_argument, 0, 'Y'},
+          {"waterfall",        required_argument, 0, 'F'},
+          {"publish",          required_argument, 0, 'U'},
+          {"on-hit-start",     required_argument, 0, 'A'},
+          {"on-hit-end",       required_argument, 0, 'E'},
+          {"hook-workers",     required_argument, 0, 'J'},
+          {"hook-timeout",     required_argument, 0, 'K'},
+          {"cfar",             required_argument, 0, 'Q'},
+          {"cfar-hysteresis",  required_argument, 0, 'G'},
+          {"audio",            required_argument, 0, 'a'},
+          {"tone",             required_argument, 0, 'Z'},
+          {"capture",          required_argument, 0, 'I'},
           {0, 0, 0, 0}
         };
         /* getopt_long stores the option index here. */
         int option_index = 0;
 
-        c = getopt_long (argc, argv, "vwh:p:m:f:b:e:s:t:d:x:y:q:l:r",
+        c = getopt_long (argc, argv, "vwh:p:m:f:b:e:s:t:d:x:y:q:l:rk:c:CNo:O:HS:M:T:R:X:P:W:Y:F:U:A:E:J:K:Q:G:a:Z:I:",
                         long_options, &option_index);
 
         // warning: I don't know why but required argument are not so "required"
@@ -286,7 +380,7 @@ bool ParseInputOptions (int argc, char **argv)
                 printf ("\n");
             break;
             case 'v':
-                opt_verbose = true;
+                Engine.opt.verbose = true;
             break;
             case 'h':
                 if (optarg[0] == '-')
@@ -340,8 +434,8 @@ bool ParseInputOptions (int argc, char **argv)
                 }
                 if (opt_freq > g_freq_delta)
                 {
-                    opt_min_freq = opt_freq - g_freq_delta;
-                    opt_max_freq = opt_freq + g_freq_delta;
+                    Engine.opt.min_freq = opt_freq - g_freq_delta;
+                    Engine.opt.max_freq = opt_freq + g_freq_delta;
                 }
                 else
                 {
@@ -356,7 +450,7 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_min_freq = atoll(optarg)) == 0)
+                if ((Engine.opt.min_freq = atoll(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid frequency\n", c);
                     print_usage(argv[0]);
@@ -370,7 +464,7 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_max_freq = atoll(optarg)) == 0)
+                if ((Engine.opt.max_freq = atoll(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid frequency\n", c);
                     print_usage(argv[0]);
@@ -383,12 +477,12 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_delay = atol(optarg)) == 0)
+                if ((Engine.opt.delay = atol(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid delay\n", c);
                     print_usage(argv[0]);
                 }
-                opt_delay *= 1000; // in microsec
+                Engine.opt.delay *= 1000; // in microsec
             break;
 
             case 'l':
@@ -398,12 +492,12 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_max_listen = atol(optarg)) == 0)
+                if ((Engine.opt.max_listen = atol(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid time\n", c);
                     print_usage(argv[0]);
                 }
-                opt_max_listen *= 1000; // in microsec
+                Engine.opt.max_listen *= 1000; // in microsec
             break;
 
             case 'x':
@@ -413,12 +507,12 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_speed = atol(optarg)) == 0)
+                if ((Engine.opt.speed = atol(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid speed\n", c);
                     print_usage(argv[0]);
                 }
-                opt_speed *= 1000; // in microsec //LWVMOBILE: Made new opt_speed variable. Implemented and working for bookmark mode.
+                Engine.opt.speed *= 1000; // in microsec //LWVMOBILE: Made new Engine.opt.speed variable. Implemented and working for bookmark mode.
             break;
 
             case 'y':
@@ -445,22 +539,22 @@ bool ParseInputOptions (int argc, char **argv)
                 }
                 if (optarg[0] == 'a')
                 {
-                    if ((opt_squelch_delta = atof(optarg+1)) == 0)
+                    if ((Engine.opt.squelch_delta = atof(optarg+1)) == 0)
                     {
                         printf ("Error: -%c: Invalid squelch level\n", c);
                         print_usage(argv[0]);
                     }
-                    opt_squelch_delta_auto_enable = true;
+                    Engine.opt.squelch_delta_auto = true;
                 }
                 else
                 {
-                    if ((opt_squelch_delta = atof(optarg)) == 0)
+                    if ((Engine.opt.squelch_delta = atof(optarg)) == 0)
                     {
                         printf ("Error: -%c: Invalid squelch level\n", c);
                         print_usage(argv[0]);
                     }
                 }
-                printf("Squelch delta set: %f\n", opt_squelch_delta);
+                printf("Squelch delta set: %f\n", Engine.opt.squelch_delta);
             break;
 
             case 't':
@@ -471,10 +565,10 @@ bool ParseInputOptions (int argc, char **argv)
                 }
 
                 optind--;
-                if (!ParseTags(argv[optind]))
+                if (!ParseTags(&Engine.sc, argv[optind]))
                     print_usage(argv[0]);
                 optind++;
-                opt_tag_search = true;
+                Engine.sc.tag_search = true;
             break;
 
             case 's':
@@ -484,14 +578,202 @@ bool ParseInputOptions (int argc, char **argv)
                     print_usage(argv[0]);
                 }
 
-                if ((opt_scan_bw = atoll(optarg)) == 0)
+                if ((Engine.opt.scan_bw = atoll(optarg)) == 0)
                 {
                     printf ("Error: -%c: Invalid frequency step\n", c);
                     print_usage(argv[0]);
                 }
                 break;
             case 'r':
-                opt_record = true;
+                Engine.opt.record = true;
+                break;
+            case 'k':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                if (opt_bookmarks_max >= CACHE_SOURCES_MAX)
+                {
+                    printf ("Error: -%c: too many bookmark files, max %d\n", c, CACHE_SOURCES_MAX);
+                    print_usage(argv[0]);
+                }
+                opt_bookmarks[opt_bookmarks_max++] = optarg;
+                break;
+            case 'c':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_cache = optarg;
+                break;
+            case 'C':
+                opt_compile = true;
+                break;
+            case 'N':
+                opt_calibrate = false;
+                break;
+            case 'o':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_log = optarg;
+                break;
+            case 'O':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_occupancy = optarg;
+                break;
+            case 'H':
+                opt_headless = true;
+                break;
+            case 'S':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_control = optarg;
+                break;
+            case 'M':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_metrics = optarg;
+                break;
+            case 'T':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_trace = optarg;
+                break;
+            case 'R':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_replay = optarg;
+                break;
+            case 'P':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_profile = optarg;
+                break;
+            case 'W':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_survey = optarg;
+                break;
+            case 'F':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_waterfall = optarg;
+                break;
+            case 'U':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_publish = optarg;
+                break;
+            case 'A':
+                opt_hook_start = optarg;
+                break;
+            case 'E':
+                opt_hook_end = optarg;
+                break;
+            case 'J':
+                opt_hook_workers = atoi(optarg);
+                if (opt_hook_workers <= 0 || opt_hook_workers > HOOKS_QUEUE)
+                {
+                    printf ("Error: -%c: Invalid number of workers\n", c);
+                    print_usage(argv[0]);
+                }
+                break;
+            case 'K':
+                opt_hook_timeout = atol(optarg) * 1000;
+                if (opt_hook_timeout <= 0)
+                {
+                    printf ("Error: -%c: Invalid timeout\n", c);
+                    print_usage(argv[0]);
+                }
+                break;
+            case 'Q':
+                opt_cfar = atof(optarg);
+                if (opt_cfar <= 0)
+                {
+                    printf ("Error: -%c: Invalid factor\n", c);
+                    print_usage(argv[0]);
+                }
+                break;
+            case 'G':
+                opt_cfar_hysteresis = atof(optarg);
+                if (opt_cfar_hysteresis < 0)
+                {
+                    printf ("Error: -%c: Invalid hysteresis\n", c);
+                    print_usage(argv[0]);
+                }
+                break;
+            case 'a':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_audio = optarg;
+                break;
+            case 'Z':
+                if (!ToneParseRules(optarg, &ToneRules))
+                {
+                    printf ("Error: -%c: Invalid tone rules\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_tone = optarg;
+                break;
+            case 'I':
+                if (optarg[0] == '-')
+                {
+                    printf ("Error: -%c: option requires an argument\n", c);
+                    print_usage(argv[0]);
+                }
+                opt_capture = optarg;
+                break;
+            case 'Y':
+                opt_survey_threshold = atof(optarg);
+                if (opt_survey_threshold <= 0)
+                {
+                    printf ("Error: -%c: Invalid threshold\n", c);
+                    print_usage(argv[0]);
+                }
+                break;
+            case 'X':
+                opt_replay_speed = atof(optarg);
+                if (opt_replay_speed < 0)
+                {
+                    printf ("Error: -%c: Invalid speed\n", c);
+                    print_usage(argv[0]);
+                }
                 break;
             case '?':
             /* getopt_long already printed an error message. */
@@ -500,92 +782,35 @@ bool ParseInputOptions (int argc, char **argv)
                 print_usage(argv[0]);
         }
     }
-    return true;
-}
-
-
-
-
-//
-// Utilities
-//
-// return a statically allocated string of the freq to be printed out.
-char * print_freq (freq_t freq)
-{
-    // fist round up to khz
-    freq = round ( freq / 1000.0 ) * 1000.0;
-    long Ghz = freq/1000000000;
-    long Mhz = (freq/1000000)%1000;
-    long Khz = (freq/1000)%1000;
-
-    freq_string[0] = '\0';
-    char temp[256];
-    if (Ghz)
+    if (opt_tone != NULL && opt_audio == NULL)
     {
-        sprintf (temp, "%ld.%3.3ld.%3.3ld GHz", Ghz, Mhz, Khz);
-        strcat(freq_string, temp);
-        return freq_string;
+        printf ("Error: -Z: the tones are decoded on the audio stream, use -a\n");
+        print_usage(argv[0]);
     }
-    if (Mhz)
+    if (opt_capture != NULL && opt_audio == NULL)
     {
-        sprintf (temp, "%ld.%3.3ld MHz", Mhz, Khz);
-        strcat(freq_string, temp);
-        return freq_string;
+        printf ("Error: -I: the captures are taken from the audio stream, use -a\n");
+        print_usage(argv[0]);
     }
-
-    sprintf (temp, "%ld KHz", Khz);
-    strcat(freq_string, temp);
-    return freq_string;
+    return true;
 }
 
 
+
+
 //
-// Wait a key press
-//
-int kbhit(void)
-{
-    struct timeval tv;
-    fd_set fds;
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
-    FD_ZERO(&fds);
-    FD_SET(STDIN_FILENO, &fds); //STDIN_FILENO is 0
-    select(STDIN_FILENO+1, &fds, NULL, NULL, &tv);
-    return FD_ISSET(STDIN_FILENO, &fds);
-}
-//
-// Set/Reset non blocking mode
+// Utilities
 //
-void nonblock(int state)
-{
-    struct termios ttystate;
 
-    //get the terminal state
-    tcgetattr(STDIN_FILENO, &ttystate);
 
-    if (state==NB_ENABLE)
-    {
-        //turn off canonical mode
-        ttystate.c_lflag &= ~ICANON;
-        //minimum of number input read.
-        ttystate.c_cc[VMIN] = 1;
-    }
-    else if (state==NB_DISABLE)
-    {
-        //turn on canonical mode
-        ttystate.c_lflag |= ICANON;
-    }
-    //set the terminal attributes.
-    tcsetattr(STDIN_FILENO, TCSANOW, &ttystate);
-}
 //
-// GetTime
-// Get the time stamp dd-mm-yy hh:mm:ss
+// FormatTime
+// Format the time stamp dd-mm-yy hh:mm:ss
 //
-time_t GetTime(char *timestamp)
+void FormatTime(time_t etime, char *timestamp)
 {
-    time_t etime = time(NULL);
-    struct tm *ltime = localtime (&etime);
+    struct tm tm;
+    struct tm *ltime = localtime_r (&etime, &tm);
     switch (opt_date)
     {
 	    case 0:
@@ -597,32 +822,37 @@ time_t GetTime(char *timestamp)
         	        ltime->tm_hour, ltime->tm_min, ltime->tm_sec);
 		break;
     }
-    return etime;
 }
 
-// Calculate difference in time in [dd days][hh:][mm:][ss secs]
-time_t DiffTime(char *timestamp, time_t start_time)
+//
+// GetTime
+// Get the time stamp dd-mm-yy hh:mm:ss
+//
+time_t GetTime(char *timestamp)
 {
-    double seconds;
-    time_t etime = time (NULL);
-    seconds = difftime(etime , start_time);
+    time_t etime = time(NULL);
+    FormatTime(etime, timestamp);
+    return etime;
+}
 
-    // casting to time_t, someone with better idea may change this to be more consistent
-    time_t elapsed = (time_t)seconds;
-    struct tm *ltime = localtime(&elapsed);
+// Format elapsed seconds in [dd days][hh:][mm:][ss secs]
+void FormatElapsed(time_t elapsed, char *timestamp)
+{
+    struct tm tm;
+    struct tm *ltime = localtime_r(&elapsed, &tm);
     timestamp[0] = '\0';
 
 
     if (ltime->tm_mday > 1)
     {
-          char days[10];
-          sprintf(days, "%2d days ", ltime->tm_mday);
+          char days[20];
+          snprintf(days, sizeof(days), "%2d days ", ltime->tm_mday);
           strcat(timestamp, days);
     }
     if (ltime->tm_hour > (int)(ltime->tm_gmtoff/3600))
     {
-          char hours[10];
-          sprintf(hours, "%2.2d:", (int)(ltime->tm_hour - (ltime->tm_gmtoff/3600)) );
+          char hours[16];
+          snprintf(hours, sizeof(hours), "%2.2d:", (int)(ltime->tm_hour - (ltime->tm_gmtoff/3600)) );
           strcat(timestamp, hours);
     }
 
@@ -635,991 +865,536 @@ time_t DiffTime(char *timestamp, time_t start_time)
         char sec[16];
         sprintf(sec, "%2.2d sec", ltime->tm_sec);
         strcat(timestamp, sec);
+}
+
+// Calculate difference in time in [dd days][hh:][mm:][ss secs]
+time_t DiffTime(char *timestamp, time_t start_time)
+{
+    double seconds;
+    time_t etime = time (NULL);
+    seconds = difftime(etime , start_time);
+
+    // casting to time_t, someone with better idea may change this to be more consistent
+    time_t elapsed = (time_t)seconds;
+    FormatElapsed(elapsed, timestamp);
     return elapsed;
 }
 
 //
-// CheckUserInput
-//
-// Clear the bans if 'c' is pressed during the scan cycles
+// PrintEvent
+// Hit output, called by the events thread
 //
-void CheckUserInput (void)
+void PrintEvent (const EVENT *event)
 {
-    int     hit = 0;
-    char    c;
-    bool    pause = false;
-    long    sleep = 100000; // 100 ms
-#ifndef OSX
-    __fpurge(stdin);
-#else
-    fpurge(stdin);
-#endif
-    nonblock(NB_ENABLE);
-    do
+    char timestamp[BUFSIZE];
+    char freq[FREQ_STRING_SIZE];
+
+    switch (event->type)
     {
-        hit = kbhit();
-        if (hit !=  0)
-        {
-            c = fgetc(stdin);
-            switch (c)
+        case EVENT_HIT_START:
+            FormatTime(event->time, timestamp);
+            if (event->squelch_auto)
             {
-                case 'c':
-                {
-                    // Clear all bans
-                    ClearAllBans();
-                    continue;
-                }
-                case 'p':
-                {
-                    // pause until another 'p'
-                    pause ^= true; // switch pause mode
-                    break;
-                }
-                default:
-                    break;
+                if (event->bookmark >= 0)
+                    printf ("\n[%s] Freq: %s active [%s],\nLevel: %2.2f/%2.2f, Squelch set: %2.2f ",
+                            timestamp, FormatFreq(event->freq, freq, sizeof(freq)),
+                            event->descr, event->level, event->squelch, event->squelch_set);
+                else
+                    printf ("\n[%s] Freq: %s active,\nLevel: %2.2f/%2.2f, Squelch set: %2.2f ",
+                            timestamp, FormatFreq(event->freq, freq, sizeof(freq)),
+                            event->level, event->squelch, event->squelch_set);
             }
-        }
-        if (pause)
-        {
-            usleep (sleep);
-            continue;
-        }
-
-    } while ( hit != 0 || pause );
-
-    nonblock(NB_DISABLE);
-    return;
+            else
+            {
+                if (event->bookmark >= 0)
+                    printf ("[%s] Freq: %s active [%s], Level: %2.2f/%2.2f ",
+                            timestamp, FormatFreq(event->freq, freq, sizeof(freq)),
+                            event->descr, event->level, event->squelch);
+                else
+                    printf ("[%s] Freq: %s active, Level: %2.2f/%2.2f ",
+                            timestamp, FormatFreq(event->freq, freq, sizeof(freq)),
+                            event->level, event->squelch );
+            }
+            break;
+        case EVENT_HIT_UPDATE:
+            break;
+        case EVENT_HIT_END:
+            FormatElapsed(event->duration, timestamp);
+            printf (" [elapsed time %s]\n", timestamp);
+            break;
+    }
 }
 
+static void JsonString (char *out, size_t size, const char *str)
+{
+    size_t n = 0;
+    out[n++] = '"';
+    for (; *str && n + 3 < size; str++)
+    {
+        if (*str == '"' || *str == '\\')
+            out[n++] = '\\';
+        out[n++] = ((unsigned char)*str < 0x20) ? ' ' : *str; // UTF-8 is kept as is
+    }
+    out[n++] = '"';
+    out[n] = '\0';
+}
 
 //
-// WaitUserInputOrDelay
-// Waits for user input or a delay after the carrier is gone
-// Returns if the user has pressed <space> or <enter> to skip frequency
+// FormatEventJson
+// One line JSON object of a hit event, as published. Returns the length.
+// The tags that do not fit are dropped, the object is always closed.
 //
-bool WaitUserInputOrDelay (int sockfd, long delay, freq_t *current_freq)
+size_t FormatEventJson (const EVENT *event, unsigned long seq, char *buf, size_t size)
 {
-    double    squelch;
-    double  level;
-    long    sleep_time = 0, listen_time = 0, sleep = 100000; // 100 ms
-    int     exit = 0;
-    char    c;
-    bool    skip = false;
-    bool    pause = false;
-
-#ifndef OSX
-    __fpurge(stdin);
-#else
-    fpurge(stdin);
-#endif
-    nonblock(NB_ENABLE);
-
-    do
+    static const char *names[] = { "start", "update", "end" };
+    char   str[256];
+    size_t n;
+
+    n = snprintf (buf, size, "{\"seq\":%lu,\"event\":\"%s\",\"ts\":%lld,\"freq\":%llu,\"level\":%.1f,"
+                  "\"squelch\":%.1f,\"start\":%lld",
+                  seq, names[event->type], (long long)event->stamp, event->freq, event->level,
+                  event->squelch, (long long)event->start);
+    if (event->squelch_auto && n < size)
+        n += snprintf (buf + n, size - n, ",\"squelch_set\":%.1f", event->squelch_set);
+    if (event->type != EVENT_HIT_START && n < size)
+        n += snprintf (buf + n, size - n, ",\"peak\":%.1f,\"mean\":%.1f", event->peak, event->mean);
+    if (event->type == EVENT_HIT_END && n < size)
+        n += snprintf (buf + n, size - n, ",\"duration\":%ld", event->duration);
+    if (event->bookmark >= 0 && n < size)
     {
-        GetCurrentFreq(sockfd,  current_freq);
-        GetSquelchLevel(sockfd, &squelch);
-        GetSignalLevel(sockfd,  &level );
-        exit = kbhit();
-        if (exit !=  0)
+        JsonString(str, sizeof(str), event->descr);
+        n += snprintf (buf + n, size - n, ",\"bookmark\":%d,\"descr\":%s,\"tags\":[", event->bookmark, str);
+        for (int k = 0; k < event->tag_max && n < size; k++)
         {
-            c = fgetc(stdin);
-            switch (c)
-            {
-                case ' ':
-                case '\n':
-                {
-                    exit = 1; // exit
-                    skip = true;
-                    break;
-                }
-                case 'b':
-                {
-                    // Ban a frequency
-                    BanFreq(*current_freq);
-                    exit = 1;
-                    skip = true;
-                    break;
-                }
-                case 'c':
-                {
-                    // Clear all bans
-                    ClearAllBans();
-                    exit = 0;
-                    break;
-                }
-                case 'p':
-                {
-                    // pause until another 'p'
-                    pause ^= true; // switch pause mode
-                    exit = 0;
-                    break;
-                }
-                default:
-                    exit = 0;
-
-            }
-            if (exit == 1)
+            JsonString(str, sizeof(str), event->tags[k]);
+            if (n + (k > 0) + strlen(str) + 2 >= size) // room for "]}"
                 break;
+            n += snprintf (buf + n, size - n, "%s%s", (k) ? "," : "", str);
         }
-
-        if (pause)
-        {
-            usleep (sleep);
-            continue;
-        }
-
-        listen_time += sleep;
-        if (opt_max_listen != 0 && opt_max_listen <= listen_time) {
-            exit = 1;
-            skip = true;
-        }
-
-        // exit = 0
-        if (level < squelch )
-        {
-
-
-            // Signal drop below the threshold, start counting sleep time
-            sleep_time += sleep;
-            if (sleep_time > delay)
-            {
-
-                exit = 1;
-                skip = false;
-            }
-        }
-        else
-        {
-            sleep_time = 0; //
-        }
-        // someone is tx'ing
-        usleep(sleep);
-    } while ( !exit ) ;
-
-    nonblock(NB_DISABLE);
-
-
-    // restart scanning
-    *current_freq+=g_ban_tollerance;
-    // round up to next near tenth of khz  145892125 -> 145900000
-    *current_freq = ceil( *current_freq / (double)opt_scan_bw ) * opt_scan_bw;
-
-#ifndef OSX
-    __fpurge(stdin);
-#else
-    fpurge(stdin);
-#endif
-    return skip;
+        if (n < size)
+            n += snprintf (buf + n, size - n, "]");
+    }
+    if (n < size)
+        n += snprintf (buf + n, size - n, "}");
+    return (n < size) ? n : size - 1;
 }
 
 //
-// Open
+// EventsIdle
+// Events thread, no event for a while: the hit log ages out its partial block,
+// the occupancy handed off by the scan loop is written
 //
-FILE * Open (const char * filename)
-{
-    FILE * filefd;
-    const char *homedir;
-    char filename2[PATH_MAX];
-
-    if (filename[0] == '~')
-    {
-        struct passwd *pw = getpwuid(getuid());
-        homedir = pw->pw_dir;
-        sprintf(filename2, "%s%s", homedir, filename+1);
-    }
-    else
-        sprintf(filename2, "%s", filename);
-
-
-    filefd = fopen (filename2, "r");
-    if (filefd == (FILE *)NULL)
-        error("ERROR opening gqrx bookmarks file");
-
-    return filefd;
-}
-
-bool prefix(const char *pre, const char *str)
+void EventsIdle (void)
 {
-    return strncmp(pre, str, strlen(pre)) == 0;
+    if (Engine.hitlog.fd >= 0 && !HitLogTick(&Engine.hitlog))
+        fprintf (stderr, "Warning: hit log write failed\n");
+    if (!OccupancyWrite(&Engine.occupancy))
+        fprintf (stderr, "Warning: occupancy write failed\n");
 }
 
 //
-// LoadFrequencies from gqrx file format
+// HandleEvent
+// Events thread: output, and the ended sessions go to the hit log
 //
-bool LoadFrequencies (FILE *bookmarksfd)
+void HandleEvent (const EVENT *event)
 {
-    char buf[BUFSIZE];
-    char *line;
-    bool start = false;
-    char *freq, *other;
-    int i = 0;
+    static unsigned long seq = 0; // lets the subscribers spot lost datagrams
 
-    while (1)
+    if (opt_publish != NULL || opt_hook_start != NULL || opt_hook_end != NULL)
     {
-        line = fgets(buf, BUFSIZE, bookmarksfd );
-        if (line == (char *) NULL)
-            break;
-
-        if (prefix("# Frequency ;", line))
-        {
-            start = true;
-            continue;
-        }
-
-        if (start)
-        {
-            char * token = strtok(line, ";"); // freq
-            if ((token == NULL) || (sscanf(token, "%llu", &Frequencies[i].freq) < 0))
-              continue; // skip empty lines
-            if ((token = strtok(NULL, ";")) == NULL) // descr
-              continue; // skip invalid lines
-            strncpy(Frequencies[i].descr, token , BUFSIZE);
-            token = strtok(NULL, ";"); // mode
-            token = strtok(NULL, ";"); // bw
-            token = strtok(NULL, ";"); // tags, comma separated
-            if (token == NULL) continue; // skip invalid lines
-            char * tag = strtok(token,",\n");
-            int k = 0;
-            while (tag != NULL && k < TAG_MAX)
-            {
-                int len =  strlen(tag) + 1 ;
-                Frequencies[i].tags[k] = calloc(sizeof(char), len);
-                // exclude initial spaces
-                int s;
-                for (s = 0; isspace(tag[s]) ; s++);
-                strncpy(Frequencies[i].tags[k], &tag[s], len);
-
-                k++;
-                tag = strtok (NULL, ",\n");
-            }
-            Frequencies[i].tag_max = k;
-            //printf(":%llu: %s\n", Frequencies[i].freq, Frequencies[i].descr); //$$$
-            i++;
-            if (i >= FREQ_MAX)
-            {
-                printf("Warning: Too many frequencies in bookmarks file, max %d\n", FREQ_MAX);
-                break;
-            }
-        }
+        char   buf[PUBLISH_DATAGRAM];
+        size_t len = FormatEventJson(event, seq++, buf, sizeof(buf));
+        if (opt_publish != NULL)
+            PublishSend(buf, len);
+        HookQueue(event, buf);
     }
-    Frequencies_Max = i;
-    return true;
-}
-
-//
-// FilterFrequency
-// Use specified tags (if any) to return the frequency matching the tag
-// return 0 otherwise
-freq_t FilterFrequency (int idx)
-{
-    freq_t current_freq = Frequencies[idx].freq;
-    if (!opt_tag_search)
-        return current_freq;
-
-    bool found = false;
-    for (int i = 0; i < Frequencies[idx].tag_max ; i++)
+    PrintEvent(event);
+    if (event->type == EVENT_HIT_END && Engine.hitlog.fd >= 0)
     {
-        char *tag = Frequencies[idx].tags[i]; // tag to search
-        for (int k = 0; k < opt_tag_max; k++)
-        {
-            if (strcasestr(tag , opt_tags[k]) != NULL) // ignore case
-            {
-                found = true;
-                break;
-            }
-        }
-        if (found)
-            break;
+        HIT_SESSION session;
+        session.start    = event->start;
+        session.end      = event->time;
+        session.freq     = event->freq;
+        session.peak     = (float)event->peak;
+        session.mean     = (float)event->mean;
+        session.squelch  = (float)event->squelch;
+        session.bookmark = event->bookmark;
+        if (!HitLogAppend(&Engine.hitlog, &session))
+            fprintf (stderr, "Warning: hit log write failed\n");
     }
-    if (!found)
-        return (freq_t) 0;
-
-    return current_freq;
 }
 
-bool ScanBookmarkedFrequenciesInRange(int sockfd, freq_t freq_min, freq_t freq_max, double squelch_delta)
+//
+// DispatchControl
+// Engine hook: the commands of the control socket, between the scan steps
+//
+void DispatchControl (ENGINE *en)
 {
-
-    freq_t freq = 0;
-    GetCurrentFreq(sockfd, &freq);
-    double level = 0;
-    GetSignalLevel(sockfd, &level );
-    double squelch = 0;
-    double squelch_backup = 0;
-    GetSquelchLevel(sockfd, &squelch);
-
-    freq_t current_freq = freq_min;
-
-    bool skip = false;
-    long sleep_cycle_active = 500000;   // skipping from active frequency need more time to wait squelch level to kick in
-    long sleep_cyle_saved   = 85000 ;   // skipping freqeuency need more time to get signal level
-
-    long slow_scan_cycle    = 1000000;   // LWVMOBILE: Just doubling numbers to slow down scan time in bookmark search, 1,000,000 = 1 second. EDIT: DOES THIS VARIABLE DO ANYTHING?
-    long slow_cycle_saved   = 250000;  // LWVMOBILE: Just doubling numbers to slow down scan time in bookmark search. THIS ONE SEEMS TO ACTUALLY SLOW SCAN SPEED DOWN.
-    char timestamp[BUFSIZE] = {0};
-    while (true)
-    {
-        CheckUserInput();
-
-        for (int i = 0; i < Frequencies_Max; i++)
-        {
-            if (Frequencies[i].noise_floor == 0)
-                Frequencies[i].noise_floor = level;
-
-            //printf("\rNoise floor: %2.2f  ", Frequencies[i].noise_floor);
-            //fflush(stdout);
-
-            if ((current_freq = FilterFrequency(i)) == (freq_t) 0 )
-                continue;
-            if (IsBannedFreq(&current_freq))
-                continue;
-            if ( ( ( current_freq >= freq_min) &&         // in the valid range
-                   ( current_freq <  freq_max)    ) ||
-                 (freq_min == freq_max)                )  // or using the entire frequencies
-                {
-                    // Found a bookmark in the range
-                    SetFreq(sockfd, current_freq);
-                    GetSquelchLevel(sockfd, &squelch);
-                    //usleep((skip)?sleep_cycle_active:sleep_cyle_saved);       //LWVMOBILE: Perhaps place a small sleep here of 1000ms, slow scan to prevent 'slipping' issue in bookmark search.
-                    //usleep((skip)?slow_scan_cycle:slow_cycle_saved);          //LWVMOBILE: Find a way to implement these variables as a command line option -s 'slow scan' and input time in milli-seconds.
-                    usleep((skip)?slow_scan_cycle:opt_speed);                   //LWVMOBILE: Using new variable set by default and also by user switch. Seems to work. GJ ME.
-                    // LWVMOBILE: Scan stoppage due to no delay argument given has been fixed, was a variable set way too high.
-                    GetSignalLevelEx(sockfd, &level, 5 );
-                    if (level >= squelch)
-                    {
-                        if (opt_record)
-                        {
-                            StartRecording(sockfd);
-                        }
-                        time_t hit_time = GetTime(timestamp);
-                        if (opt_squelch_delta_auto_enable)
-                        {
-                            squelch_backup = squelch;
-                            SetSquelchLevel(sockfd, Frequencies[i].noise_floor + squelch_delta);
-                            printf ("\n[%s] Freq: %s active [%s],\nLevel: %2.2f/%2.2f, Squelch set: %2.2f ",
-                                    timestamp, print_freq(current_freq),
-                                    Frequencies[i].descr, level, squelch, Frequencies[i].noise_floor + squelch_delta);
-                        }
-                        else
-                        {
-                            printf ("[%s] Freq: %s active [%s], Level: %2.2f/%2.2f ",
-                                    timestamp, print_freq(current_freq),
-                                    Frequencies[i].descr, level, squelch);
-                        }
-                        fflush(stdout);
-                        skip = WaitUserInputOrDelay(sockfd, opt_delay, &current_freq);
-                        time_t elapsed = DiffTime(timestamp, hit_time);
-                        if (opt_record)
-                        {
-                            StopRecording(sockfd);
-                        }
-                        printf (" [elapsed time %s]\n", timestamp);
-                        if (opt_squelch_delta_auto_enable) SetSquelchLevel(sockfd, squelch_backup);
-                        fflush(stdout);
-                    }
-                    else
-                    {
-                        Frequencies[i].noise_floor = (Frequencies[i].noise_floor + level)/2;
-                        skip = false;
-                    }
-                }
-        }
-
-    }
-
+    (void)en;
+    ControlDispatch();
 }
 
 //
-// Save frequency found
+// ReadKey
+// Engine hook: the keyboard, polled (timeout 0) or waited for
 //
-bool SaveFreq(freq_t freq_current)
+INPUT_COMMAND ReadKey (ENGINE *en, long timeout)
 {
-    bool found = false;
-    freq_t tollerance = 5000; // 5Khz tolerance (±5 KHz)
-
-    int  temp_count = 0;
-    freq_t temp_delta = tollerance;
-    int  temp_i     = 0;
-
-    for (int i = 0; i < SavedFreq_Max; i++)
-    {
-        // Find a previous hit with some tollerance
-        if (freq_current >= (SavedFrequencies[i].freq - tollerance) &&
-            freq_current <  (SavedFrequencies[i].freq + tollerance)   )
-        {
-            // found match, loop for minimum delta
-            // Use absolute value to handle both positive and negative differences
-            freq_t delta;
-            if (freq_current >= SavedFrequencies[i].freq)
-                delta = freq_current - SavedFrequencies[i].freq;
-            else
-                delta = SavedFrequencies[i].freq - freq_current;
-            
-            if ( delta < temp_delta )
-            {
-                // Found a better match
-                temp_delta = delta;
-                temp_count = SavedFrequencies[i].count;
-                temp_i     = i;
-            }
-            found = true;
-        }
-    }
-    if (!found)
-    {
-        SavedFrequencies[SavedFreq_Max].freq  = freq_current;
-        SavedFrequencies[SavedFreq_Max].count = 1;
-        SavedFrequencies[SavedFreq_Max].miss  = 0;
-        SavedFreq_Max++;
-        if (SavedFreq_Max >= SAVED_FREQ_MAX)
-            SavedFreq_Max = 0; // restart from scratch ?
-        return true;
-    }
-
-
-    // calculate a better one for the next time
-    int count = temp_count;
-    SavedFrequencies[temp_i].freq = (( ((freq_t)SavedFrequencies[temp_i].freq * count ) + freq_current ) / (count + 1));
-    SavedFrequencies[temp_i].count++;
-    SavedFrequencies[temp_i].miss = 0;// reset miss count
-
-
-    return true;
+    (void)en;
+    return (timeout == 0) ? InputPoll() : InputWait(timeout);
 }
 
 //
-// Ban a frequency found
+// PushHit
+// Engine hook: hit events to the events thread. The audio of a hit is
+// captured from the start, with the pre-roll that covers the detection.
 //
-bool BanFreq (freq_t freq_current)
+void PushHit (ENGINE *en, const EVENT *event)
 {
-    int i = BannedFreq_Max;
-    if (i >= SAVED_FREQ_MAX)
-        return false;
-
-    BannedFrequencies[i].freq  = freq_current;
-    BannedFreq_Max++;
+    char path[CAPTURE_PATH_SIZE];
 
-    for (i = 0; i < SavedFreq_Max; i++)
+    if (opt_capture != NULL && event->type == EVENT_HIT_START)
     {
-        // Find a previous hit with some tollerance
-        if (freq_current >= (SavedFrequencies[i].freq - g_ban_tollerance) &&
-            freq_current <  (SavedFrequencies[i].freq + g_ban_tollerance)   )
+        if (!CaptureOpen(event->freq, event->start, path, sizeof(path)))
+            printf ("Error: cannot capture the hit\n");
+        else if (en->opt.verbose)
         {
-            SavedFrequencies[i].count = 0;
+            printf ("\nCapture: %s\n", path);
+            fflush (stdout);
         }
     }
-
-    return true;
+    else if (opt_capture != NULL && event->type == EVENT_HIT_END)
+        CaptureClose();
+    EventPush(event);
 }
+
 //
-// ClearAllBans
+// Retuned
+// Engine hook: the pre-roll of a capture starts at the last retune
 //
-void ClearAllBans ( void )
+void Retuned (ENGINE *en, freq_t freq)
 {
-    BannedFreq_Max = 0; // quick and dirty
+    (void)en;
+    (void)freq;
+    CaptureTuned();
 }
 
 //
-// IsBannedFreq
-// Test whether a frequency is banned or not
+// AudioActivity
+// Engine hook: activity from the audio stream, AUDIO_NONE without one
 //
-bool IsBannedFreq (freq_t *freq_current)
+AUDIO_STATE AudioActivity (ENGINE *en)
 {
-    int i;
-    for (i = 0; i < BannedFreq_Max; i++)
-    {
-        if (*freq_current >= (BannedFrequencies[i].freq - g_ban_tollerance) &&
-            *freq_current <  (BannedFrequencies[i].freq + g_ban_tollerance)   )
-        {
-            // scanning
-            *freq_current+= (g_ban_tollerance * 2); // avoid jumping neearby a carrier
-            // round up to next near tenth of khz  145892125 -> 145900000
-            *freq_current = ceil( *freq_current / 10000.0 ) * 10000.0;
-            IsBannedFreq (freq_current);
-            return true;
-        }
-    }
-
-    return false;
+    (void)en;
+    return AudioState(NULL);
 }
 
-
 //
-// Debounce
+// ToneRejected
+// Traffic on an active frequency without the CTCSS tone or DCS code wanted
+// for it (-Z), decided on the audio stream in 0.25 to 0.75 s. The traffic is
+// accepted without a rule, without audio or when the decoder cannot decide.
+// A reject is remembered for TONE_REJECT_TTL: the next passes skip the
+// frequency at once instead of decoding the same traffic again.
 //
-bool Debounce (int sockfd, freq_t current_freq, double level)
+bool ToneRejected (ENGINE *en, freq_t freq, int bookmark)
 {
-    double current_level = level;
-    double squelch;
-    usleep(300000); // 300 ms wait, hope it's good enough
-    GetSignalLevelEx( sockfd, &current_level, 5 );
-    GetSquelchLevel ( sockfd, &squelch );
-
-    if (current_level < squelch )
-        return false; // signal lost or ghost
-    else
+    TONE_MATCH_RESULT result = TONE_PENDING;
+    const TONE *want;
+
+    if (opt_tone == NULL)
+        return false;
+    want = ToneRuleFor(&ToneRules, freq, g_ban_tollerance,
+                       (bookmark >= 0) ? en->sc.freqs[bookmark].tags : NULL,
+                       (bookmark >= 0) ? en->sc.freqs[bookmark].tag_max : 0);
+    if (want == NULL)
+        return false;
+    if (ToneRejectCached(&en->sc, freq, ClockNow()))
+    {
+        MetricAdd(METRIC_TONE_REJECTS, 1);
         return true;
+    }
 
+    clock_us_t deadline = ClockNow() + TONE_DECIDE;
+    AudioToneReset();
+    while (result == TONE_PENDING && AudioState(NULL) != AUDIO_NONE && ClockNow() < deadline &&
+           !EngineInterrupted(en))
+    {
+        SleepFor(TONE_POLL);
+        result = AudioToneMatch(want);
+    }
+    if (en->opt.verbose)
+    {
+        char str[FREQ_STRING_SIZE], tone[16];
+        printf("\nFreq: %s tone %s: %s\n", FormatFreq(freq, str, sizeof(str)), FormatTone(want, tone, sizeof(tone)),
+               (result == TONE_MATCH) ? "match" : (result == TONE_MISMATCH) ? "mismatch" : "undecided");
+        fflush (stdout);
+    }
+    if (result != TONE_MISMATCH)
+        return false;
+    ToneRejectAdd(&en->sc, freq, ClockNow());
+    MetricAdd(METRIC_TONE_REJECTS, 1);
+    return true;
 }
 
 //
-// BacktrackFrequency
-// got a signal but lost it
-// move back to find it again more slowly
+// ControlState
+// State dump as a JSON object
 //
-freq_t BacktrackFrequency(int sockfd, freq_t current_freq, freq_t freq_interval, int numberOfIntervals, freq_t freq_min, freq_t freq_max)
+void ControlState (char *reply, size_t size)
 {
-    double squelch = 0;
-    double level = 0;
-    int i;
-
-    for (i=0 ; i < numberOfIntervals ; i++)
+    char   str[256];
+    size_t n;
+
+    n = snprintf (reply, size,
+                  "{\"mode\":\"%s\",\"min\":%llu,\"max\":%llu,\"step\":%llu,\"freq\":%llu,\"paused\":%s,"
+                  "\"bookmarks\":%d,\"bans\":%d,\"saved\":%d,\"tags\":[",
+                  (opt_scan_mode == sweep) ? "sweep" : "bookmark", Engine.opt.min_freq, Engine.opt.max_freq, Engine.opt.scan_bw,
+                  Engine.freq, (Engine.paused) ? "true" : "false",
+                  (opt_scan_mode == bookmark) ? Engine.sc.freq_max : 0, Engine.sc.banned_max, Engine.sc.saved_max);
+    for (int k = 0; Engine.sc.tag_search && k < Engine.sc.tag_max && n < size; k++)
     {
-        current_freq -= freq_interval;
-        if (current_freq < freq_min)
-            current_freq = freq_max - freq_interval ;
-        GetSquelchLevel(sockfd, &squelch);
-        SetFreq(sockfd, current_freq);
-        usleep(150000);
-        // tries to average out spikes, 5 sample
-        GetSignalLevelEx( sockfd, &level, 5);
-        if (level >= squelch)
-        {
-            //found it again
-            break;
-        }
+        JsonString(str, sizeof(str), Engine.sc.tags[k]);
+        n += snprintf (reply + n, size - n, "%s%s", (k) ? "," : "", str);
     }
-    return current_freq;
+    if (n < size)
+        n += snprintf (reply + n, size - n, "],\"priority\":[");
+    for (int p = 0; p < Engine.sc.priority_max && n < size; p++)
+        n += snprintf (reply + n, size - n, "%s%llu", (p) ? "," : "", Engine.sc.priority_freqs[p]);
+    if (n < size)
+        snprintf (reply + n, size - n, "]}");
 }
 
 //
-// AdjustFrequency
-// Fine tuning to reach max level
-// Perform a sweep between -15+15Khz around current_freq with 5kHz steps
-// Return the found frequency
+// ControlCommand
+// Commands of the control socket, run on the scan thread by ControlDispatch
 //
-freq_t AdjustFrequency(int sockfd, freq_t current_freq, freq_t freq_interval)
+void ControlCommand (char *line, char *reply, size_t size)
 {
-    freq_t freq_min   = current_freq - 10000;
-    freq_t freq_max   = current_freq + 10000;
-    freq_t freq_steps = freq_interval;
-    long max_levels = (freq_max - freq_min) / freq_steps ;
-    typedef struct { double level; freq_t freq; } LEVELS;
-    LEVELS levels[max_levels];
-    int    l = 0;
-    double squelch = 0;
-
-    GetSquelchLevel(sockfd, &squelch);
-
-    double level = 0;
-    for (current_freq = freq_min; current_freq < freq_max; current_freq += freq_steps)
+    static char tags[1024];
+    char  *cmd  = strtok(line, " \t");
+    char  *args = strtok(NULL, "");
+    freq_t f1 = 0, f2 = 0;
+    char   op[16] = "";
+
+    snprintf (reply, size, "OK");
+    if (cmd == NULL)
+        snprintf (reply, size, "ERR empty command");
+    else if (strcmp(cmd, "skip") == 0)
+        InputPost(INPUT_SKIP);
+    else if (strcmp(cmd, "ban") == 0)
     {
-        SetFreq(sockfd, current_freq);
-        usleep(150000);
-        // tries to average out spikes, 5 sample
-        GetSignalLevelEx( sockfd, &level, 5);
-        levels[l].level = level;
-        levels[l].freq  = current_freq;
-        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
-        //fflush(stdout);
-        l++;
+        // the given frequency, or the one listened to
+        if (args == NULL)
+            InputPost(INPUT_BAN);
+        else if (sscanf(args, "%llu", &f1) != 1 || f1 == 0 || !BanFreq(&Engine.sc, f1))
+            snprintf (reply, size, "ERR ban <freq>: invalid frequency or ban table full");
     }
-
-    double current_level = levels[0].level;
-    double previous_level = current_level;
-    int    start = 0;
-    int    end   = max_levels;
-    for (l = 0; l < max_levels; l++)
+    else if (strcmp(cmd, "clear") == 0)
+        ClearAllBans(&Engine.sc);
+    else if (strcmp(cmd, "pause") == 0)
+        Engine.paused = true;
+    else if (strcmp(cmd, "resume") == 0)
     {
-        if (levels[l].level >= current_level)
-        {
-            current_level = levels[l].level;
-            start = end = l;
-        }
+        Engine.paused = false;
+        InputWake();
     }
-
-    l = start + (end-start)/2;
-    current_freq = levels[l].freq;
-    SetFreq(sockfd, current_freq);
-    usleep(150000);
-
-    // before second pass fine tuning we check if the frequency is already known (and tuned with a mean value computed)
-    // See SaveFreq
-    freq_t tollerance = 7000;
-    bool found = false;
-    for (int i = 0; i < SavedFreq_Max; i++)
+    else if (strcmp(cmd, "range") == 0)
     {
-        // Find a previous hit with some tollerance
-        if (current_freq >= (SavedFrequencies[i].freq - tollerance) &&
-            current_freq <  (SavedFrequencies[i].freq + tollerance)   )
+        if (args == NULL || sscanf(args, "%llu %llu", &f1, &f2) != 2 || f1 == 0 || f1 >= f2)
+            snprintf (reply, size, "ERR range <min> <max>: invalid range");
+        else
         {
-            if (SavedFrequencies[i].count > 4) // 4 fine tuned frequency is good enough to have a candidate freq
-            {
-                current_freq = SavedFrequencies[i].freq;
-                found = true;
-                break;
-            }
+            Engine.opt.min_freq = f1;
+            Engine.opt.max_freq = f2;
+            Engine.restart = true;
         }
     }
-
-    if (found)
-    {
-        SetFreq(sockfd, current_freq);
-        usleep(150000);
-        // Cheating: here I return the rough value from the first pass to avoid stucking on possibly wrong freq.
-        return levels[l].freq;
-    }
-
-    // Second pass - Fine tuning + - 5Khz (freq_steps input) with 1 khz steps
-    // Dived in two half, follow one until the level decreases if so follow the second half
-    // (hopefully this reduces the num of steps), tries to average out spikes, 3 sample
-    double reference_level;
-    GetSignalLevelEx( sockfd, &reference_level, 5);
-    freq_t   reference_freq  = current_freq;
-    freq_min   = current_freq - 5000;
-    freq_max   = current_freq + 5000;
-    freq_steps = 1000; // 1 Khz fine tuning
-    max_levels = (freq_max - freq_min) / freq_steps ;
-    LEVELS levels2[max_levels];
-    l = 0;
-    // upper half
-    for (current_freq = reference_freq + freq_steps; current_freq < freq_max; current_freq += freq_steps)
+    else if (strcmp(cmd, "step") == 0)
     {
-        SetFreq(sockfd, current_freq);
-        usleep(150000);
-        // tries to average out spikes, 5 sample
-        GetSignalLevelEx( sockfd, &level, 5);
-
-        if (level < reference_level)
+        if (opt_scan_mode != sweep)
+            snprintf (reply, size, "ERR step: sweep mode only");
+        else if (args == NULL || sscanf(args, "%llu", &f1) != 1 || f1 == 0)
+            snprintf (reply, size, "ERR step <freq>: invalid step");
+        else
         {
-            // this way the signal is decreasing, stop
-            break;
+            Engine.opt.scan_bw = f1;
+            Engine.occupancy.resolution = f1;
+            Engine.restart = true;
         }
-        levels2[l].level = level;
-        levels2[l].freq  = current_freq;
-        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
-        //fflush(stdout);
-        l++;
     }
-    // lower half
-    for (current_freq = reference_freq - freq_steps; current_freq >= freq_min; current_freq-= freq_steps )
+    else if (strcmp(cmd, "tags") == 0)
     {
-        SetFreq(sockfd, current_freq);
-        usleep(150000);
-        // tries to average out spikes, 5 sample
-        GetSignalLevelEx( sockfd, &level, 5);
-
-        if (level < reference_level)
+        if (opt_scan_mode != bookmark)
         {
-            // this way signal is decreasing, stop
-            break;
+            snprintf (reply, size, "ERR tags: bookmark mode only");
+            return;
         }
-        levels2[l].level = level;
-        levels2[l].freq  = current_freq;
-        //printf ("Freq:%ld Level:%.2f\t", current_freq, level);
-        //fflush(stdout);
-        l++;
-    }
-    // If no candidates found
-    if (l == 0) // we are good, already in the middle
-    {
-        SetFreq(sockfd, reference_freq);
-        return reference_freq;
+        ClearTags(&Engine.sc);
+        if (args != NULL && strcmp(args, "none") != 0)
+        {
+            // "tag1|tag2", quotes are optional
+            snprintf (tags, sizeof(tags), "%s", args + (args[0] == '"'));
+            if (tags[0] != '\0' && tags[strlen(tags) - 1] == '"')
+                tags[strlen(tags) - 1] = '\0';
+            Engine.sc.tag_search = tags[0] != '\0' && ParseTags(&Engine.sc, tags);
+        }
+        Engine.restart = true;
     }
-
-    // Here we have levels2 from 0 to n the first half and from n to l the second half
-    // Find out the maximum level frequency
-    current_level = levels[0].level;
-    previous_level = current_level;
-    start = 0;
-    end   = max_levels;
-    for (int i = 0; i < l; i++)
+    else if (strcmp(cmd, "priority") == 0)
     {
-        if (levels2[i].level > current_level)
+        if (opt_scan_mode != bookmark)
+            snprintf (reply, size, "ERR priority: bookmark mode only");
+        else if (args == NULL || sscanf(args, "%15s %llu", op, &f1) < 1)
+            snprintf (reply, size, "ERR priority add|del <freq> or priority clear");
+        else if (strcmp(op, "clear") == 0)
+            Engine.sc.priority_max = 0;
+        else if (strcmp(op, "add") == 0 && Engine.sc.priority_max < PRIORITY_MAX)
         {
-            current_level = levels2[i].level;
-            start = end = i;
+            Engine.sc.priority_freqs[Engine.sc.priority_max++] = f1;
+            int n = Engine.sc.priority_max;
+            ResolvePriorities(&Engine.sc);
+            if (Engine.sc.priority_max < n)
+                snprintf (reply, size, "ERR priority add: %llu is not a loaded bookmark", f1);
         }
+        else if (strcmp(op, "del") == 0)
+        {
+            for (int p = 0; p < Engine.sc.priority_max; p++)
+                if (Engine.sc.priority_freqs[p] == f1)
+                    Engine.sc.priority_freqs[p] = 0;
+            ResolvePriorities(&Engine.sc);
+        }
+        else
+            snprintf (reply, size, "ERR priority add|del <freq> or priority clear");
     }
-    l = start;
-    current_freq = levels2[l].freq;
-    SetFreq(sockfd, current_freq);
+    else if (strcmp(cmd, "state") == 0)
+        ControlState(reply, size);
+    else if (strcmp(cmd, "help") == 0)
+        snprintf (reply, size, "OK skip | ban [freq] | clear | pause | resume | range <min> <max> | step <freq> | "
+                               "tags <tag1|tag2>|none | priority add|del <freq> | priority clear | state");
+    else
+        snprintf (reply, size, "ERR unknown command %s", cmd);
+}
 
-    return current_freq;
+#ifndef TESTING_BUILD
+//
+// DetectorInit
+// CFAR cells for the sweep bins (with neighbours) or the bookmarks, the noise is learned again
+//
+static void DetectorInit (void)
+{
+    CfarFree(&Engine.sc.cfar);
+    if (opt_cfar <= 0)
+        return;
+    if (opt_scan_mode == sweep)
+        CfarInit(&Engine.sc.cfar, (int)((Engine.opt.max_freq - Engine.opt.min_freq) / Engine.opt.scan_bw), CFAR_TRAIN,
+                 opt_cfar, opt_cfar_hysteresis);
+    else
+        CfarInit(&Engine.sc.cfar, Engine.sc.freq_max, 0, opt_cfar, opt_cfar_hysteresis);
+}
 
+static void Quit (int sig)
+{
+    (void)sig;
+    Engine.quit = 1;
+    InputWake();
 }
 
-bool ScanFrequenciesInRange(int sockfd, freq_t freq_min, freq_t freq_max, freq_t freq_interval, double squelch_delta)
+//
+// Setup
+// Bookmark sources, cache compilation, checks of the options, connection to
+// gqrx (or the replayed trace), scan range, calibration and frequencies
+//
+static void Setup (char *argv0)
 {
-    freq_t freq = 0;
-    GetCurrentFreq(sockfd, &freq);
-    double level = 0;
-    GetSignalLevel(sockfd, &level );
-    double squelch = 0;
-    double squelch_backup = 0;
-    GetSquelchLevel(sockfd, &squelch);
-
-    size_t freqeuencies_count = ((opt_max_freq-opt_min_freq)/opt_scan_bw); //for loop boundary
-
-    freq_t current_freq = freq_min;
-
-    SetFreq(sockfd, freq_min);
-    int saved_idx = 0, current_saved_idx = 0;
-    int sweep_count = 0;
-    freq_t last_freq;
-    bool saved_cycle = false;
-    // minimum hit threshold on frequency already seen (count): above this the freq is a candidate
-    int min_hit_threshold = 2;
-    // maximum miss threshold on frequencies not seen anymore: above this the candidate count is decremented
-    // note: during monitoring on active freq the counter can reach high values so this threshold should not be too high
-    // otherwise the chance to exclude the freq is very low and will continue to monitor even after prolonged inactive time
-    int max_miss_threshold = 20;
-    long sleep_cyle         = 10000 ; // wait 10ms after setting freq to get signal level
-    long sleep_cyle_saved   = 85000 ; // skipping freqeuency need more time to get signal level
-    long sleep_cycle_active = 500000; // skipping from active frequency need more time to wait squelch level to kick in
-    bool skip = false;   // user input
-    char timestamp[BUFSIZE] = {0};
-    int  success_counter    = 0;  // number of correctly acquired signals, reset on bad signals or reaching success_factor
-    int  success_factor     = 5; // improving sleep cycle every success_factor of times
+    FILE *bookmarksfd;
 
-    while (true)
+    // bookmark sources, with the home dir expanded
+    static char bookmarks_path[CACHE_SOURCES_MAX][PATH_MAX];
+    const char *bookmarks[CACHE_SOURCES_MAX];
+    if (opt_bookmarks_max == 0)
+        opt_bookmarks[opt_bookmarks_max++] = (char *) g_bookmarksfile;
+    for (int s = 0; s < opt_bookmarks_max; s++)
+        bookmarks[s] = ExpandPath(opt_bookmarks[s], bookmarks_path[s]);
+
+    if (opt_compile)
     {
-        for ( size_t i = 0 ; i < freqeuencies_count; i++)
+        if (opt_cache == NULL)
         {
-            CheckUserInput();
-
-            IsBannedFreq(&current_freq); // test and change current_frequency to next available slot;
-            SetFreq(sockfd, current_freq);
-            if (saved_cycle)
-                usleep((skip)?sleep_cycle_active:sleep_cyle_saved);
-            else
-                usleep((skip)?sleep_cycle_active:sleep_cyle);
-
-            GetSquelchLevel(sockfd, &squelch);
-            GetSignalLevelEx(sockfd, &level, 5 );
-
-            if (Frequencies[i].noise_floor == 0)
-                Frequencies[i].noise_floor = level;
-
-            //printf("\rNoise floor: %2.2f  ", Frequencies[i].noise_floor);
-            //fflush(stdout);
-
-            if (opt_verbose)
-            {
-                printf("\nFreq: %s Signal: %2.2f Squelch: %2.2f\n", print_freq(current_freq), level, squelch);
-                fflush (stdout);
-            }
-
-            if (level >= squelch)
-            {
-                // we have a possible match, but sometimes level oscillates after a squelch miss
-                bool still_good = Debounce(sockfd, current_freq, level);
-                if (!still_good)
-                {
-                    // Signal lost
-                    // it could be a ghosts signal because we are running too fast, slow down a bit
-                    success_counter = 0; // stop incrementing sleep cycle for a while
-                    sleep_cyle+= 5000;   // add penality
-                    if (sleep_cyle > 50000)
-                        sleep_cyle = 50000;
-                    if (opt_verbose)
-                    {
-                        printf("Missing signal. Slowing down: %ld ms wait time.\n", sleep_cyle/1000);
-                        fflush (stdout);
-                    }
-                    // tries to recover to get back the signal, check our steps...
-                    if (!saved_cycle)
-                    {
-                        current_freq = BacktrackFrequency(sockfd, current_freq, freq_interval, 4, freq_min, freq_max);
-                        if (IsBannedFreq(&current_freq))
-                        {
-                            skip = true;
-                        }
-                    }
-                    continue;
-                }
-                else
-                {
-                    // Frequency acquired successfully
-                    // Or.. we could have jumped on another frequency with a valid signal nearby.
-                    success_counter++;
-                    if (success_counter > success_factor)
-                    {
-                        // Increase speed a little bit in order to compensates signal lost because of bad luck
-                        // while we moved the frequency (signal disappearing)
-                        sleep_cyle-= 1000; // add a reward
-                        if (sleep_cyle < 10000)
-                            sleep_cyle = 10000;
-                        if (opt_verbose)
-                        {
-                            printf("Signals acquired successfully. Speeding up: %ld ms wait time.\n", sleep_cyle/1000);
-                            fflush (stdout);
-                        }
-                        success_counter = 0; // stop decrementing sleep cycle for a while
-                    }
-                }
-                current_freq = AdjustFrequency(sockfd, current_freq, freq_interval/2);
-                if (IsBannedFreq(&current_freq))
-                {
-                    skip = true;
-                }
-                else
-                {
-                    SaveFreq(current_freq);
-                    if (opt_record)
-                    {
-                        StartRecording(sockfd);
-                    }
-                    if (opt_squelch_delta_auto_enable){
-                        squelch_backup = squelch;
-                        SetSquelchLevel(sockfd, Frequencies[i].noise_floor + squelch_delta);
-                    }
-
-                    time_t hit_time = GetTime(timestamp);
-                    if (opt_squelch_delta_auto_enable)
-                    {
-                        printf ("\n[%s] Freq: %s active,\nLevel: %2.2f/%2.2f, Squelch set: %2.2f ",
-                                timestamp, print_freq(current_freq),
-                                level, squelch, Frequencies[i].noise_floor + squelch_delta);
-                    }
-                    else
-                    {
-                        printf ("[%s] Freq: %s active, Level: %2.2f/%2.2f ",
-                                timestamp, print_freq(current_freq),
-                                level, squelch );
-                    }
-                    fflush(stdout);
-                    // Wait user input or delay time after signal lost
-                    skip = WaitUserInputOrDelay(sockfd, opt_delay, &current_freq);
-                    time_t elapsed = DiffTime(timestamp, hit_time);
-                    if (opt_record)
-                    {
-                        StopRecording(sockfd);
-                    }
-                    printf (" [elapsed time %s]\n", timestamp);
-                    fflush(stdout);
-                    if (opt_squelch_delta_auto_enable) SetSquelchLevel(sockfd, squelch_backup);
-                }
-                if (skip)
-                {
-                    sweep_count = 0; // reactivate sweep scan
-                    continue; // go to the next freq set in current_freq
-                }
-            }
-            else
-            {
-                skip = false;
-                Frequencies[i].noise_floor = (Frequencies[i].noise_floor + level)/2;
-                // no activities
-                if (saved_cycle)
-                {
-                    // miss count on already seen frequency
-                    if (++SavedFrequencies[current_saved_idx].miss > max_miss_threshold)
-                    {
-                        SavedFrequencies[current_saved_idx].count--;
-                        SavedFrequencies[current_saved_idx].miss = 0;
-                    }
-                }
-            }
-
-            // Loop saved freq after a while
-            if (sweep_count > 40)
-            {
-                if (!saved_cycle)
-                {
-                    // start cycling on saved frequencies
-                    last_freq = current_freq;
-                    saved_cycle = true;
-                }
-                // search candidates into saved frequencies
-                while ( (SavedFrequencies[saved_idx].count < min_hit_threshold) && //hit threshold
-                        (saved_idx < SavedFreq_Max) )
-                {
-                    saved_idx++;
-                }
-                if (saved_idx >= SavedFreq_Max)
-                {
-                    saved_idx = 0;
-                    sweep_count = 0; // reactivates sweep scan
-                    saved_cycle = false;
-                    current_freq = last_freq;
-                    current_freq = ceil( current_freq / (double)opt_scan_bw ) * opt_scan_bw;
-                }
-                else // found one
-                {
-                    current_freq = SavedFrequencies[saved_idx].freq;
-                    current_saved_idx = saved_idx;
-                    saved_idx++;
-                    if (saved_idx >= SavedFreq_Max)
-                        saved_idx = 0;
-                    continue;
-                }
-            }
-            current_freq+=freq_interval;
-            if (current_freq > freq_max)
-                current_freq = freq_min;
-            sweep_count++;
+            printf ("Error: -C, --compile requires the cache file: -c <file>\n");
+            print_usage(argv0);
         }
+        if (!CompileBookmarkCache(opt_cache, bookmarks, opt_bookmarks_max))
+        {
+            printf ("Error: failed to compile bookmarks cache %s\n", opt_cache);
+            exit (EXIT_FAILURE);
+        }
+        exit (EXIT_SUCCESS);
     }
-    return true;
-}
-
-
-#ifndef TESTING_BUILD
-int main(int argc, char **argv) {
-    int sockfd, portno, n;
-    char *hostname;
-    char buf[BUFSIZE];
-    FILE *bookmarksfd;
-
-    opt_hostname = (char *) g_hostname;
-    opt_port     = g_portno;
-    opt_delay    = g_delay;
-    ParseInputOptions(argc, argv);
 
     // post validating
-    if (opt_tag_search && (opt_scan_mode == sweep) )
+    if (Engine.sc.tag_search && (opt_scan_mode == sweep) )
     {
         // Not supported yet
         printf ("Error: Optional tag based search is not supported in sweep mode.\n");
         printf ("       Please specify '-m bookmark' mode.\n");
-        print_usage(argv[0]);
+        print_usage(argv0);
     }
 
     char from[256], to[256];
 
     if (
-        (opt_min_freq > opt_max_freq)                        || // bad range or only min specified
-        (opt_min_freq == 0 && opt_max_freq > 0)              || // or  only max specified
-        ((opt_min_freq != 0 && opt_max_freq != 0) &&            // or they are equal but different from 0
-         (opt_min_freq == opt_max_freq)                  )
+        (Engine.opt.min_freq > Engine.opt.max_freq)                        || // bad range or only min specified
+        (Engine.opt.min_freq == 0 && Engine.opt.max_freq > 0)              || // or  only max specified
+        ((Engine.opt.min_freq != 0 && Engine.opt.max_freq != 0) &&            // or they are equal but different from 0
+         (Engine.opt.min_freq == Engine.opt.max_freq)                  )
        ) // or only max specified
     {
-        strcpy (from, print_freq(opt_min_freq));
-        strcpy (to,   print_freq(opt_max_freq));
+        FormatFreq(Engine.opt.min_freq, from, sizeof(from));
+        FormatFreq(Engine.opt.max_freq, to, sizeof(to));
         printf ("Error: Invalid frequency range: begin:%s, end=%s.\n", from, to);
         printf ("       Please specify '-f <freq>' or '-b <begin_freq> -e <end_freq>.\n");
-        print_usage(argv[0]);
+        print_usage(argv0);
     }
 
 
     // here min & max could be equal to 0 because the user specified -f flag
-    sockfd = Connect(opt_hostname, opt_port);
+    if (opt_replay != NULL)
+    {
+        if (!TraceReplayOpen(opt_replay, opt_replay_speed))
+        {
+            printf ("Error: cannot replay trace %s\n", opt_replay);
+            exit (EXIT_FAILURE);
+        }
+        Engine.sockfd = -1;
+    }
+    else
+        Engine.sockfd = Connect(opt_hostname, opt_port);
+    if (opt_trace != NULL && !TraceRecordOpen(opt_trace))
+    {
+        printf ("Error: cannot write trace %s\n", opt_trace);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_profile != NULL && !ProfileStart(opt_profile))
+    {
+        printf ("Error: cannot write profile %s\n", opt_profile);
+        exit (EXIT_FAILURE);
+    }
 
-    if (!opt_tag_search) // sweep or bookmark
+    if (!Engine.sc.tag_search) // sweep or bookmark
     {
-        if (opt_min_freq == 0 && opt_max_freq == 0)
+        if (Engine.opt.min_freq == 0 && Engine.opt.max_freq == 0)
         {
             freq_t current_freq;
-            GetCurrentFreq(sockfd, &current_freq);
-            opt_min_freq = current_freq - g_freq_delta;
-            opt_max_freq = current_freq + g_freq_delta;
+            GetCurrentFreq(Engine.sockfd, &current_freq);
+            Engine.opt.min_freq = current_freq - g_freq_delta;
+            Engine.opt.max_freq = current_freq + g_freq_delta;
         }
     }
     else
     {
         // more tollerating with tags (bookmark mode)
-        if (opt_min_freq == opt_max_freq) // user has not set values or has set equals.
+        if (Engine.opt.min_freq == Engine.opt.max_freq) // user has not set values or has set equals.
         {
             printf ("Warning: search tags on the entire frequency range!\n");
         }
@@ -1628,43 +1403,71 @@ int main(int argc, char **argv) {
 
     if (opt_scan_mode == sweep)
     {
-        // FIXME: Neural: this is a sweep scan and should not use the Frequencies array structure designed for bookmarks (just to save a "noise_floor" value)!
+        // FIXME: Neural: this is a sweep scan and should not use the Engine.sc.freqs array structure designed for bookmarks (just to save a "noise_floor" value)!
         //        what if the range is big and the bw is small?  It will allocate a lot of memory for nothing
         //        The noise_floor level could have been calculated on the fly with a moving average on the spectrum and not per single frequency.
         //        Infact, it is not a noise floor but the signal level at the current frequency below the squelch, integrated by previous runs.
         //        It is also an overkill to change the squelch level dinamically (a frigging user option on gqrx): the user should set it manually of whatever value he/she wants to avoid false positives, lowering it if neccessary.
-        size_t freqeuencies_count = (size_t)(((opt_max_freq-opt_min_freq)/opt_scan_bw)+1);
-        Frequencies = malloc(freqeuencies_count*sizeof(FREQ));
+        size_t freqeuencies_count = (size_t)(((Engine.opt.max_freq-Engine.opt.min_freq)/Engine.opt.scan_bw)+1);
+        Engine.sc.freqs = calloc(freqeuencies_count, sizeof(FREQ));
     }
     else {
-        Frequencies = malloc(FREQ_MAX * sizeof(FREQ));
+        Engine.sc.freqs = calloc(FREQ_MAX, sizeof(FREQ));
     }
 
-    strcpy (from, print_freq(opt_min_freq));
-    strcpy (to,   print_freq(opt_max_freq));
+    FormatFreq(Engine.opt.min_freq, from, sizeof(from));
+    FormatFreq(Engine.opt.max_freq, to, sizeof(to));
     printf ("Frequency range set from %s to %s.\n", from, to);
 
+    if (opt_calibrate && Engine.opt.min_freq != Engine.opt.max_freq)
+    {
+        printf ("Calibrating settle time...\n");
+        freq_t tuned;
+        GetCurrentFreq(Engine.sockfd, &tuned);
+        SettleCalibrate(Engine.sockfd, &Engine.sc.settle, Engine.opt.min_freq, Engine.opt.max_freq, 3);
+        Engine.sc.sweep = Engine.sc.settle; // the starting point of the sweep step wait
+        SetFreq(Engine.sockfd, tuned);
+        if (Engine.opt.verbose)
+            SettlePrint(&Engine.sc.settle);
+    }
+
     if (opt_scan_mode == bookmark)
     {
-        bookmarksfd = Open(g_bookmarksfile);
-        LoadFrequencies (bookmarksfd);
+        if (opt_cache != NULL && CacheOpen(&BookmarkCache, opt_cache, bookmarks, opt_bookmarks_max))
+        {
+            LoadFrequenciesFromCache(&Engine.sc, &BookmarkCache, Engine.opt.min_freq, Engine.opt.max_freq);
+            printf ("Bookmarks loaded from cache %s.\n", opt_cache);
+        }
+        else
+        {
+            if (opt_cache != NULL)
+                printf ("Warning: bookmarks cache %s is missing or out of date, parsing bookmark files.\n", opt_cache);
+            for (int s = 0; s < opt_bookmarks_max; s++)
+            {
+                bookmarksfd = Open(bookmarks[s]);
+                LoadFrequenciesEx(&Engine.sc, bookmarksfd, Engine.sc.freq_max);
+                fclose (bookmarksfd);
+            }
+        }
     }
 
-    if (opt_tag_search)
+    DetectorInit();
+
+    if (Engine.sc.tag_search)
     {
         char str [1024];
         printf ("Tags to search: ");
-        for (int i = 0; i < opt_tag_max ; i++)
+        for (int i = 0; i < Engine.sc.tag_max ; i++)
         {
-            printf ("[%s] ", opt_tags[i] );
+            printf ("[%s] ", Engine.sc.tags[i] );
         }
         printf ("\n");
 
         // Check if there are any
         int count = 0;
-        for (int i = 0 ; i < Frequencies_Max; i++ )
+        for (int i = 0 ; i < Engine.sc.freq_max; i++ )
         {
-            if (FilterFrequency(i) != (freq_t) 0 )
+            if (FilterFrequency(&Engine.sc, i) != (freq_t) 0 )
                 count++;
         }
         if (count == 0)
@@ -1674,19 +1477,189 @@ int main(int argc, char **argv) {
         }
         printf ("%d candidate frequencies found.\n", count);
     }
+}
+
+//
+// OpenOutputs
+// Hit log, occupancy store, survey and waterfall of the engine
+//
+static void OpenOutputs (void)
+{
+    if (opt_log != NULL && !HitLogOpen(&Engine.hitlog, opt_log))
+    {
+        printf ("Error: cannot open hit log %s\n", opt_log);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_occupancy != NULL &&
+        !OccupancyOpen(&Engine.occupancy, opt_occupancy, (opt_scan_mode == sweep) ? Engine.opt.scan_bw : 1))
+    {
+        printf ("Error: cannot open occupancy store %s\n", opt_occupancy);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_survey != NULL && opt_scan_mode == sweep && !SurveyOpen(&Engine.survey, opt_survey, opt_survey_threshold))
+    {
+        printf ("Error: cannot open survey %s\n", opt_survey);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_waterfall != NULL && opt_scan_mode == sweep &&
+        !WaterfallOpen(&Engine.waterfall, opt_waterfall, Engine.opt.min_freq, Engine.opt.max_freq, Engine.opt.scan_bw, WATERFALL_ROWS))
+    {
+        printf ("Error: cannot open waterfall %s: %s\n", opt_waterfall,
+                (errno == EINVAL) ? "not a waterfall file" : strerror(errno));
+        exit (EXIT_FAILURE);
+    }
+}
 
+//
+// StartServices
+// Events, keyboard, control socket, metrics, publishing, hooks, capture and audio
+//
+static void StartServices (void)
+{
+    if (!EventsStart(HandleEvent, EventsIdle))
+        error("ERROR starting events thread");
+    if (!InputStart(opt_headless))
+        error("ERROR starting keyboard input");
+
+    if (opt_control != NULL && !ControlStart(opt_control, ControlCommand))
+    {
+        printf ("Error: cannot listen on control socket %s\n", opt_control);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_metrics != NULL && !MetricsStart(opt_metrics))
+    {
+        printf ("Error: cannot serve metrics on %s\n", opt_metrics);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_publish != NULL && !PublishStart(opt_publish))
+    {
+        printf ("Error: cannot publish events to %s\n", opt_publish);
+        exit (EXIT_FAILURE);
+    }
+    if ((opt_hook_start != NULL || opt_hook_end != NULL) &&
+        !HooksStart(opt_hook_start, opt_hook_end, opt_hook_workers, opt_hook_timeout))
+        error("ERROR starting hook workers");
+    if (opt_capture != NULL && !CaptureStart(opt_capture))
+    {
+        printf ("Error: cannot capture audio to %s\n", opt_capture);
+        exit (EXIT_FAILURE);
+    }
+    if (opt_audio != NULL && !AudioStart(opt_audio, InputWake))
+    {
+        printf ("Error: cannot receive audio on %s\n", opt_audio);
+        exit (EXIT_FAILURE);
+    }
+}
+
+//
+// Restart
+// New range, step or tags from the control socket: the learned state is kept,
+// the receiver state is read again
+//
+static void Restart (void)
+{
+    char from[256], to[256];
+
+    Engine.restart = false;
+    StateInvalidate();
     if (opt_scan_mode == sweep)
     {
-        ScanFrequenciesInRange(sockfd, opt_min_freq, opt_max_freq, opt_scan_bw, opt_squelch_delta);
+        free(Engine.sc.freqs);
+        Engine.sc.freqs = calloc((size_t)(((Engine.opt.max_freq-Engine.opt.min_freq)/Engine.opt.scan_bw)+1), sizeof(FREQ));
+        if (Engine.waterfall.header != NULL)
+        {
+            // new bins, new rows
+            WaterfallClose(&Engine.waterfall);
+            if (!WaterfallOpen(&Engine.waterfall, opt_waterfall, Engine.opt.min_freq, Engine.opt.max_freq, Engine.opt.scan_bw, WATERFALL_ROWS))
+                printf ("Error: cannot open waterfall %s: %s\n", opt_waterfall,
+                        (errno == EINVAL) ? "not a waterfall file" : strerror(errno));
+        }
     }
-    else
+    else if (BookmarkCache.base != NULL)
+    {
+        LoadFrequenciesFromCache(&Engine.sc, &BookmarkCache, Engine.opt.min_freq, Engine.opt.max_freq);
+        ResolvePriorities(&Engine.sc);
+    }
+    DetectorInit();
+    FormatFreq(Engine.opt.min_freq, from, sizeof(from));
+    FormatFreq(Engine.opt.max_freq, to, sizeof(to));
+    printf ("Frequency range set from %s to %s.\n", from, to);
+}
+
+//
+// StopServices
+// Threads stopped, summaries printed, trace, profile and connection closed
+//
+static void StopServices (void)
+{
+    MetricsStop();
+    AudioStop();
+    CaptureStop();
+    ControlStop();
+    InputStop();
+    EventsStop();
+    PublishStop();
+    if (opt_publish != NULL && PublishDropped() > 0)
+        printf ("Events: %lu datagrams dropped\n", PublishDropped());
+    if (opt_hook_start != NULL || opt_hook_end != NULL)
+    {
+        HOOKS_STATS stats;
+        HooksStop();
+        HooksStats(&stats);
+        printf ("Hooks: %lu run, %lu failed, %lu timed out, %lu dropped\n",
+                stats.run, stats.failed, stats.timeouts, stats.dropped);
+    }
+    CacheClose(&BookmarkCache);
+    if (opt_replay != NULL)
+    {
+        TRACE_STATS stats;
+        TraceStats(&stats);
+        printf ("Replay: %llu commands, %llu replies from the trace, %llu records skipped, %llu made up\n",
+                (unsigned long long)stats.commands, (unsigned long long)stats.served,
+                (unsigned long long)stats.skipped, (unsigned long long)stats.diverged);
+    }
+    TraceClose();
+    if (!ProfileStop())
+        printf ("Error: cannot write profile %s\n", opt_profile);
+    if (Engine.sockfd >= 0)
+        close(Engine.sockfd);
+}
+
+int main(int argc, char **argv)
+{
+    if (argc > 1 && strcmp(argv[1], "report") == 0)
+        return HitLogReportMain(argc, argv);
+    if (argc > 1 && strcmp(argv[1], "occupancy") == 0)
+        return OccupancyMain(argc, argv);
+    EngineInit(&Engine);
+    opt_hostname       = (char *) g_hostname;
+    opt_port           = g_portno;
+    Engine.opt.scan_bw = g_default_scan_bw;
+    Engine.opt.delay   = g_delay;
+    Engine.opt.speed   = g_speed;
+    ParseInputOptions(argc, argv);
+
+    Setup(argv[0]);
+    OpenOutputs();
+    signal(SIGINT,  Quit);
+    signal(SIGTERM, Quit);
+    StartServices();
+
+    Engine.opt.updates = opt_publish != NULL;
+    Engine.hooks = (ENGINE_HOOKS){ DispatchControl, ReadKey, PushHit, Retuned, ToneRejected, AudioActivity };
+    while (true)
     {
-        ScanBookmarkedFrequenciesInRange(sockfd, opt_min_freq, opt_max_freq, opt_squelch_delta);
+        if (opt_scan_mode == sweep)
+            ScanFrequenciesInRange(&Engine);
+        else
+            ScanBookmarkedFrequenciesInRange(&Engine);
+        if (Engine.quit || !Engine.restart || TraceReplayDone())
+            break;
+        Restart();
     }
 
-    fclose (bookmarksfd);
-    close(sockfd);
-    free(Frequencies);
+    StopServices();
+    EngineFree(&Engine);
     return 0;
 }
 #endif /* TESTING_BUILD */
@@ -0,0 +1,638 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <unistd.h>
+#include <pwd.h>
+#include <ctype.h>
+#ifndef OSX
+#include <linux/limits.h>
+#else
+#include <sys/syslimits.h>
+#endif
+#include "gqrx-scanner.h"
+
+const freq_t g_ban_tollerance = 10000; // +- 10Khz bandwidth to ban from current freq.
+
+//
+// ScannerInit
+// Empty context: no bookmarks, hits, bans, tags or priorities, settle time fallbacks
+//
+void ScannerInit (SCANNER *sc)
+{
+    memset(sc, 0, sizeof(*sc));
+    SettleModelInit(&sc->settle);
+    SettleModelInit(&sc->sweep);
+}
+
+//
+// ScannerClearFrequencies
+// Release the strings of the loaded bookmarks, the array is kept
+//
+void ScannerClearFrequencies (SCANNER *sc)
+{
+    if (sc->tag_pool != NULL)
+    {
+        free(sc->tag_pool); // strings point into the cache
+        sc->tag_pool = NULL;
+    }
+    else
+    {
+        for (int i = 0; i < sc->freq_max; i++)
+        {
+            free(sc->freqs[i].descr);
+            for (int t = 0; t < sc->freqs[i].tag_max; t++)
+                free(sc->freqs[i].tags[t]);
+            free(sc->freqs[i].tags);
+        }
+    }
+    for (int i = 0; i < sc->freq_max; i++)
+        sc->freqs[i] = (FREQ){ 0 };
+    sc->freq_max = 0;
+}
+
+void ScannerFree (SCANNER *sc)
+{
+    ScannerClearFrequencies(sc);
+    free(sc->freqs);
+    sc->freqs = NULL;
+    ClearTags(sc);
+    CfarFree(&sc->cfar);
+}
+
+//
+// ExpandPath
+// Replace the leading '~' with the user home directory
+//
+char * ExpandPath (const char * filename, char *expanded)
+{
+    const char *homedir;
+
+    if (filename[0] == '~')
+    {
+        struct passwd *pw = getpwuid(getuid());
+        homedir = pw->pw_dir;
+        snprintf(expanded, PATH_MAX, "%s%s", homedir, filename+1);
+    }
+    else
+        snprintf(expanded, PATH_MAX, "%s", filename);
+    return expanded;
+}
+
+//
+// Open
+//
+FILE * Open (const char * filename)
+{
+    FILE * filefd;
+    char filename2[PATH_MAX];
+
+    ExpandPath(filename, filename2);
+
+    filefd = fopen (filename2, "r");
+    if (filefd == (FILE *)NULL)
+        error("ERROR opening gqrx bookmarks file");
+
+    return filefd;
+}
+
+bool prefix(const char *pre, const char *str)
+{
+    return strncmp(pre, str, strlen(pre)) == 0;
+}
+
+//
+// ParseBookmarkLine
+// Split a bookmark line of the gqrx file format in place.
+// descr and tags point into line.
+//
+bool ParseBookmarkLine (char *line, freq_t *freq, char **descr, char **tags, int *tag_max)
+{
+    char *save, *tag_save;
+    char * token = strtok_r(line, ";", &save); // freq
+    if ((token == NULL) || (sscanf(token, "%llu", freq) < 0))
+        return false; // skip empty lines
+    if ((token = strtok_r(NULL, ";", &save)) == NULL) // descr
+        return false; // skip invalid lines
+    *descr = token;
+    token = strtok_r(NULL, ";", &save); // mode
+    token = strtok_r(NULL, ";", &save); // bw
+    token = strtok_r(NULL, ";", &save); // tags, comma separated
+    if (token == NULL) return false; // skip invalid lines
+    char * tag = strtok_r(token, ",\n", &tag_save);
+    int k = 0;
+    while (tag != NULL && k < TAG_MAX)
+    {
+        // exclude initial spaces
+        while (isspace(*tag))
+            tag++;
+        tags[k++] = tag;
+        tag = strtok_r(NULL, ",\n", &tag_save);
+    }
+    *tag_max = k;
+    return true;
+}
+
+//
+// LoadFrequenciesEx from gqrx file format
+// Bookmarks are stored starting from index first
+//
+bool LoadFrequenciesEx (SCANNER *sc, FILE *bookmarksfd, int first)
+{
+    char buf[BUFSIZE];
+    char *line;
+    bool start = false;
+    char *descr, *tags[TAG_MAX];
+    int i = first;
+
+    while (i < FREQ_MAX)
+    {
+        line = fgets(buf, BUFSIZE, bookmarksfd );
+        if (line == (char *) NULL)
+            break;
+
+        if (prefix("# Frequency ;", line))
+        {
+            start = true;
+            continue;
+        }
+
+        if (start)
+        {
+            int k;
+            if (!ParseBookmarkLine(line, &sc->freqs[i].freq, &descr, tags, &k))
+                continue;
+            sc->freqs[i].descr = strdup(descr);
+            sc->freqs[i].tags  = calloc(k + 1, sizeof(char *));
+            for (int t = 0; t < k; t++)
+                sc->freqs[i].tags[t] = strdup(tags[t]);
+            sc->freqs[i].tag_max = k;
+            //printf(":%llu: %s\n", sc->freqs[i].freq, sc->freqs[i].descr); //$$$
+            i++;
+            if (i >= FREQ_MAX)
+                printf("Warning: Too many frequencies in bookmarks file, max %d\n", FREQ_MAX);
+        }
+    }
+    sc->freq_max = i;
+    return true;
+}
+
+//
+// LoadFrequencies from gqrx file format
+//
+bool LoadFrequencies (SCANNER *sc, FILE *bookmarksfd)
+{
+    return LoadFrequenciesEx(sc, bookmarksfd, 0);
+}
+
+//
+// CompileBookmarkCache
+// Parse the bookmark files and write the binary image to cache_file
+//
+bool CompileBookmarkCache (const char *cache_file, const char **sources, int n_sources)
+{
+    char buf[BUFSIZE];
+    char *descr, *tags[TAG_MAX];
+    int  tag_max;
+    freq_t freq;
+
+    CACHE_BUILDER *builder = CacheBuilderCreate();
+    if (builder == NULL)
+        return false;
+
+    for (int s = 0; s < n_sources; s++)
+    {
+        FILE *fd = fopen(sources[s], "r");
+        bool start = false;
+        if (fd == NULL)
+        {
+            printf ("Error: cannot open bookmarks file %s\n", sources[s]);
+            CacheBuilderFree(builder);
+            return false;
+        }
+        while (fgets(buf, BUFSIZE, fd) != NULL)
+        {
+            if (prefix("# Frequency ;", buf))
+            {
+                start = true;
+                continue;
+            }
+            if (start && ParseBookmarkLine(buf, &freq, &descr, tags, &tag_max))
+            {
+                if (!CacheBuilderAdd(builder, freq, descr, tags, tag_max))
+                {
+                    fclose(fd);
+                    CacheBuilderFree(builder);
+                    return false;
+                }
+            }
+        }
+        fclose(fd);
+    }
+
+    bool ok = CacheBuilderWrite(builder, cache_file, sources, n_sources);
+    if (ok)
+        printf ("%d bookmarks compiled into %s\n", CacheBuilderCount(builder), cache_file);
+    CacheBuilderFree(builder);
+    return ok;
+}
+
+static int CompareFreq (const void *a, const void *b)
+{
+    const FREQ *fa = a, *fb = b;
+    return (fa->freq > fb->freq) - (fa->freq < fb->freq);
+}
+
+//
+// LoadFrequenciesFromCache
+// Fill the sc->freqs array with the bookmarks of the mapped cache in the range [freq_min, freq_max),
+// or all of them if freq_min == freq_max. When searching for tags only the matching ones are loaded,
+// using the precomputed tag bitsets.
+// Descriptions and tags are not copied: they point into the mapped image.
+// On a reload the learned noise floor, settle time and counts of the bookmarks
+// whose frequency is still there are kept.
+//
+bool LoadFrequenciesFromCache (SCANNER *sc, BOOKMARK_CACHE *cache, freq_t freq_min, freq_t freq_max)
+{
+    const CACHE_HEADER *h = cache->header;
+    uint32_t first = 0, last = h->n_freqs;
+    uint64_t *mask = NULL;
+
+    if (freq_min != freq_max)
+    {
+        first = CacheLowerBound(cache, freq_min);
+        last  = CacheLowerBound(cache, freq_max);
+    }
+
+    if (sc->tag_search)
+    {
+        // match the interned tags once instead of every bookmark
+        mask = calloc(h->bitset_words + 1, sizeof(uint64_t));
+        for (uint32_t t = 0; t < h->n_tags; t++)
+        {
+            for (int k = 0; k < sc->tag_max; k++)
+            {
+                if (strcasestr(CacheTagName(cache, t), sc->tags[k]) != NULL)
+                {
+                    mask[t / 64] |= 1ULL << (t % 64);
+                    break;
+                }
+            }
+        }
+    }
+
+    // only the numbers are used, the strings go with ScannerClearFrequencies
+    int   n_learned = sc->freq_max;
+    FREQ *learned   = NULL;
+    if (n_learned > 0 && (learned = malloc(n_learned * sizeof(FREQ))) != NULL)
+    {
+        memcpy(learned, sc->freqs, n_learned * sizeof(FREQ));
+        qsort(learned, n_learned, sizeof(FREQ), CompareFreq);
+    }
+
+    ScannerClearFrequencies(sc);
+    free(sc->freqs);
+    sc->freqs = calloc((last - first) + 1, sizeof(FREQ));
+    char **tag_pool = calloc(h->n_tag_refs + (last - first) + 1, sizeof(char *));
+    sc->tag_pool = tag_pool;
+    int i = 0;
+    for (uint32_t idx = first; idx < last; idx++)
+    {
+        const CACHE_FREQ *f = &cache->freqs[idx];
+        if (mask != NULL && !CacheMatchTags(cache, idx, mask))
+            continue;
+        sc->freqs[i].freq    = f->freq;
+        const FREQ *was = (learned) ? bsearch(&sc->freqs[i], learned, n_learned, sizeof(FREQ), CompareFreq) : NULL;
+        if (was != NULL)
+        {
+            sc->freqs[i].noise_floor = was->noise_floor;
+            sc->freqs[i].settle      = was->settle;
+            sc->freqs[i].count       = was->count;
+            sc->freqs[i].miss        = was->miss;
+        }
+        sc->freqs[i].descr   = (char *) CacheString(cache, f->descr);
+        sc->freqs[i].tags    = tag_pool;
+        sc->freqs[i].tag_max = f->tag_count;
+        for (uint32_t k = 0; k < f->tag_count; k++)
+            *tag_pool++ = (char *) CacheTagName(cache, cache->tag_refs[f->tag_first + k]);
+        tag_pool++;
+        i++;
+    }
+    sc->freq_max = i;
+    free(learned);
+    free(mask);
+    return true;
+}
+
+//
+// FilterFrequency
+// Use specified tags (if any) to return the frequency matching the tag
+// return 0 otherwise
+freq_t FilterFrequency (const SCANNER *sc, int idx)
+{
+    freq_t current_freq = sc->freqs[idx].freq;
+    if (!sc->tag_search)
+        return current_freq;
+
+    bool found = false;
+    for (int i = 0; i < sc->freqs[idx].tag_max ; i++)
+    {
+        char *tag = sc->freqs[idx].tags[i]; // tag to search
+        for (int k = 0; k < sc->tag_max; k++)
+        {
+            if (strcasestr(tag , sc->tags[k]) != NULL) // ignore case
+            {
+                found = true;
+                break;
+            }
+        }
+        if (found)
+            break;
+    }
+    if (!found)
+        return (freq_t) 0;
+
+    return current_freq;
+}
+
+//
+// ParseTags
+// Tags to search, '|' separated. tags is modified.
+//
+bool ParseTags (SCANNER *sc, char *tags)
+{
+    char *tag = NULL, *save;
+
+    tag = strtok_r(tags, "|", &save);
+
+    int k = 0;
+    while (tag != NULL && k < TAG_MAX)
+    {
+        int len =  strlen(tag) + 1 ;
+        sc->tags[k] = calloc(sizeof(char), len);
+        strncpy(sc->tags[k], tag, len);
+
+        tag = strtok_r(NULL, "|", &save);
+        k++;
+    }
+    sc->tag_max = k;
+    if (k == 0) // wtf
+    {
+        printf ("Error: -t option requires a '|' separator for list of tags.\n");
+        return false;
+    }
+    return true;
+}
+
+void ClearTags (SCANNER *sc)
+{
+    for (int k = 0; k < sc->tag_max; k++)
+        free(sc->tags[k]);
+    sc->tag_max = 0;
+    sc->tag_search = false;
+}
+
+//
+// ResolvePriorities
+// Index of the priority frequencies in the bookmarks, the ones not loaded are dropped
+//
+void ResolvePriorities (SCANNER *sc)
+{
+    int n = 0;
+    for (int p = 0; p < sc->priority_max; p++)
+    {
+        for (int i = 0; i < sc->freq_max; i++)
+        {
+            if (sc->freqs[i].freq == sc->priority_freqs[p])
+            {
+                sc->priority_freqs[n]   = sc->priority_freqs[p];
+                sc->priority_index[n++] = i;
+                break;
+            }
+        }
+    }
+    sc->priority_max = n;
+}
+
+//
+// Save frequency found
+//
+bool SaveFreq(SCANNER *sc, freq_t freq_current)
+{
+    bool found = false;
+    freq_t tollerance = 5000; // 5Khz tolerance (±5 KHz)
+
+    int  temp_count = 0;
+    freq_t temp_delta = tollerance;
+    int  temp_i     = 0;
+
+    for (int i = 0; i < sc->saved_max; i++)
+    {
+        // Find a previous hit with some tollerance
+        if (freq_current >= (sc->saved[i].freq - tollerance) &&
+            freq_current <  (sc->saved[i].freq + tollerance)   )
+        {
+            // found match, loop for minimum delta
+            // Use absolute value to handle both positive and negative differences
+            freq_t delta;
+            if (freq_current >= sc->saved[i].freq)
+                delta = freq_current - sc->saved[i].freq;
+            else
+                delta = sc->saved[i].freq - freq_current;
+            
+            if ( delta < temp_delta )
+            {
+                // Found a better match
+                temp_delta = delta;
+                temp_count = sc->saved[i].count;
+                temp_i     = i;
+            }
+            found = true;
+        }
+    }
+    if (!found)
+    {
+        sc->saved[sc->saved_max].freq  = freq_current;
+        sc->saved[sc->saved_max].count = 1;
+        sc->saved[sc->saved_max].miss  = 0;
+        sc->saved_max++;
+        if (sc->saved_max >= SAVED_FREQ_MAX)
+            sc->saved_max = 0; // restart from scratch ?
+        return true;
+    }
+
+
+    // calculate a better one for the next time
+    int count = temp_count;
+    sc->saved[temp_i].freq = (( ((freq_t)sc->saved[temp_i].freq * count ) + freq_current ) / (count + 1));
+    sc->saved[temp_i].count++;
+    sc->saved[temp_i].miss = 0;// reset miss count
+
+
+    return true;
+}
+
+//
+// Ban a frequency found
+//
+bool BanFreq (SCANNER *sc, freq_t freq_current)
+{
+    int i = sc->banned_max;
+    if (i >= SAVED_FREQ_MAX)
+        return false;
+
+    sc->banned[i].freq  = freq_current;
+    sc->banned_max++;
+
+    for (i = 0; i < sc->saved_max; i++)
+    {
+        // Find a previous hit with some tollerance
+        if (freq_current >= (sc->saved[i].freq - g_ban_tollerance) &&
+            freq_current <  (sc->saved[i].freq + g_ban_tollerance)   )
+        {
+            sc->saved[i].count = 0;
+        }
+    }
+
+    return true;
+}
+//
+// ClearAllBans
+//
+void ClearAllBans (SCANNER *sc)
+{
+    sc->banned_max = 0; // quick and dirty
+}
+
+//
+// IsBannedFreq
+// Test whether a frequency is banned or not
+//
+bool IsBannedFreq (const SCANNER *sc, freq_t *freq_current)
+{
+    int i;
+    for (i = 0; i < sc->banned_max; i++)
+    {
+        if (*freq_current >= (sc->banned[i].freq - g_ban_tollerance) &&
+            *freq_current <  (sc->banned[i].freq + g_ban_tollerance)   )
+        {
+            // scanning
+            *freq_current+= (g_ban_tollerance * 2); // avoid jumping neearby a carrier
+            // round up to next near tenth of khz  145892125 -> 145900000
+            *freq_current = ceil( *freq_current / 10000.0 ) * 10000.0;
+            IsBannedFreq (sc, freq_current);
+            return true;
+        }
+    }
+
+    return false;
+}
+
+//
+// ToneRejectAdd
+// Remember that the traffic on freq is for another tone, for TONE_REJECT_TTL.
+// The oldest entry makes room when all are in use.
+//
+void ToneRejectAdd (SCANNER *sc, freq_t freq, clock_us_t now)
+{
+    TONE_REJECT *slot = &sc->tone_rejects[0];
+
+    for (int i = 0; i < TONE_REJECT_MAX; i++)
+    {
+        TONE_REJECT *r = &sc->tone_rejects[i];
+        if (r->until <= now || (freq >= r->freq - g_ban_tollerance && freq < r->freq + g_ban_tollerance))
+        {
+            slot = r;
+            break;
+        }
+        if (r->until < slot->until)
+            slot = r;
+    }
+    slot->freq  = freq;
+    slot->until = now + TONE_REJECT_TTL;
+}
+
+//
+// ToneRejectCached
+// Whether the traffic on freq was rejected for its tone in the last TONE_REJECT_TTL
+//
+bool ToneRejectCached (const SCANNER *sc, freq_t freq, clock_us_t now)
+{
+    for (int i = 0; i < TONE_REJECT_MAX; i++)
+    {
+        const TONE_REJECT *r = &sc->tone_rejects[i];
+        if (r->until > now && freq >= r->freq - g_ban_tollerance && freq < r->freq + g_ban_tollerance)
+            return true;
+    }
+    return false;
+}
+
+//
+// ScannerDetect
+// Whether the level of a bin is a signal: above the CFAR threshold of the bin
+// when the detector is on, above the gqrx squelch otherwise
+//
+bool ScannerDetect (SCANNER *sc, int bin, double level, double squelch)
+{
+    if (sc->cfar.cells == NULL || bin < 0 || bin >= sc->cfar.n)
+        return level >= squelch;
+    return CfarDetect(&sc->cfar, bin, level, squelch);
+}
+
+//
+// ScannerListenSquelch
+// Squelch to set while listening to a bin detected by the CFAR detector: its
+// close threshold, so that gqrx opens the audio and the hit ends with the hysteresis
+//
+bool ScannerListenSquelch (const SCANNER *sc, int bin, double *squelch)
+{
+    double open;
+    if (sc->cfar.cells == NULL || bin < 0 || bin >= sc->cfar.n)
+        return false;
+    return CfarThreshold(&sc->cfar, bin, &open, squelch);
+}
+
+//
+// FormatFreq
+// Frequency rounded to kHz with its unit, in buf
+//
+char * FormatFreq (freq_t freq, char *buf, size_t size)
+{
+    // fist round up to khz
+    freq = round ( freq / 1000.0 ) * 1000.0;
+    long Ghz = freq/1000000000;
+    long Mhz = (freq/1000000)%1000;
+    long Khz = (freq/1000)%1000;
+
+    if (Ghz)
+        snprintf (buf, size, "%ld.%3.3ld.%3.3ld GHz", Ghz, Mhz, Khz);
+    else if (Mhz)
+        snprintf (buf, size, "%ld.%3.3ld MHz", Mhz, Khz);
+    else
+        snprintf (buf, size, "%ld KHz", Khz);
+    return buf;
+}
@@ -0,0 +1,126 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_SCANNER_H_
+#define _GQRX_SCANNER_H_
+
+#include <stdio.h>
+#include <stdbool.h>
+#include "gqrx-prot.h"
+#include "gqrx-cache.h"
+#include "gqrx-settle.h"
+#include "gqrx-cfar.h"
+#include "gqrx-clock.h"
+
+//
+// Scanner core (libgqrxscan)
+//
+// Everything a scan engine learns and filters on lives in a SCANNER context:
+// the bookmarks (or the sweep bins), the hits saved and banned, the tag filter,
+// the priority bookmarks, the settle time model and the detector. The functions only touch
+// the context they are given, so independent engines can run on their own
+// threads, each with its own connection to gqrx.
+//
+#define PRIORITY_MAX        16
+#define PRIORITY_INTERVAL   8   // priority bookmarks are revisited every 8 bookmarks
+#define FREQ_STRING_SIZE    32
+#define TONE_REJECT_MAX     16
+#define TONE_REJECT_TTL     10000000    // us, traffic for another tone is not decoded again for 10 s
+
+typedef struct {
+    freq_t freq; // frequency in Mhz
+    double noise_floor; // averages noise floor of frequency
+    int count; // hit count on sweep scan
+    int miss;  // miss count on sweep scan
+    long settle; // learned settle time in microseconds after tuning, the dwell on the bookmark; 0 = unknown
+    char *descr; // description, owned or pointing into the bookmark cache
+    char **tags; // tags
+    int   tag_max;
+} FREQ;
+
+typedef struct {
+    freq_t       freq;
+    clock_us_t   until;
+} TONE_REJECT;
+
+typedef struct {
+    FREQ        *freqs;         // bookmarks, or the noise floor of the sweep bins
+    int          freq_max;
+    char       **tag_pool;      // tags of bookmarks loaded from the cache, NULL if the strings are owned
+    FREQ         saved[SAVED_FREQ_MAX];     // sweep hits
+    int          saved_max;
+    FREQ         banned[SAVED_FREQ_MAX];
+    int          banned_max;
+    bool         tag_search;
+    char        *tags[TAG_MAX];
+    int          tag_max;
+    freq_t       priority_freqs[PRIORITY_MAX];
+    int          priority_index[PRIORITY_MAX];  // in freqs
+    int          priority_max;
+    SETTLE_MODEL settle;        // measured settle times, tunes and bookmark dwells
+    SETTLE_MODEL sweep;         // blind wait of a sweep step: the calibration, then the detection feedback
+    CFAR         cfar;          // per bin thresholds, no cells: the gqrx squelch
+    TONE_REJECT  tone_rejects[TONE_REJECT_MAX]; // recent traffic without the wanted tone, expired: until 0
+} SCANNER;
+
+extern const freq_t g_ban_tollerance;
+
+void   ScannerInit(SCANNER *sc);
+void   ScannerClearFrequencies(SCANNER *sc);
+void   ScannerFree(SCANNER *sc);
+
+//
+// Bookmarks
+//
+char  *ExpandPath(const char *filename, char *expanded);
+FILE  *Open(const char *filename);
+bool   prefix(const char *pre, const char *str);
+bool   ParseBookmarkLine(char *line, freq_t *freq, char **descr, char **tags, int *tag_max);
+bool   LoadFrequenciesEx(SCANNER *sc, FILE *bookmarksfd, int first);
+bool   LoadFrequencies(SCANNER *sc, FILE *bookmarksfd);
+bool   CompileBookmarkCache(const char *cache_file, const char **sources, int n_sources);
+bool   LoadFrequenciesFromCache(SCANNER *sc, BOOKMARK_CACHE *cache, freq_t freq_min, freq_t freq_max);
+bool   ParseTags(SCANNER *sc, char *tags);
+void   ClearTags(SCANNER *sc);
+freq_t FilterFrequency(const SCANNER *sc, int idx);
+void   ResolvePriorities(SCANNER *sc);
+
+//
+// Sweep hits
+//
+bool   SaveFreq(SCANNER *sc, freq_t freq_current);
+bool   BanFreq(SCANNER *sc, freq_t freq_current);
+void   ClearAllBans(SCANNER *sc);
+bool   IsBannedFreq(const SCANNER *sc, freq_t *freq_current);
+void   ToneRejectAdd(SCANNER *sc, freq_t freq, clock_us_t now);
+bool   ToneRejectCached(const SCANNER *sc, freq_t freq, clock_us_t now);
+
+//
+// Detection
+//
+bool   ScannerDetect(SCANNER *sc, int bin, double level, double squelch);
+bool   ScannerListenSquelch(const SCANNER *sc, int bin, double *squelch);
+
+char  *FormatFreq(freq_t freq, char *buf, size_t size);
+
+#endif /* _GQRX_SCANNER_H_ */
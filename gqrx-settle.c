@@ -0,0 +1,282 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gqrx-settle.h"
+#include "gqrx-clock.h"
+#include "gqrx-profile.h"
+
+// upper limits of the bands, in Hz
+static const freq_t band_limits[SETTLE_BANDS - 1] = {
+    30000000,   // HF
+    88000000,   // VHF low
+    174000000,  // VHF
+    300000000,  // VHF high
+    470000000,  // UHF
+    1000000000, // UHF high
+    3000000000ULL
+};
+
+// representative jump of each bucket, used for calibration
+static const freq_t bucket_jumps[JUMP_BUCKETS] = { 12500, 250000, 2500000, 25000000, 250000000 };
+
+//
+// SettleModelInit
+// Fallback values are the old fixed waits: 10 ms between sweep steps,
+// 85 ms for longer jumps and 500 ms leaving an active frequency
+//
+void SettleModelInit (SETTLE_MODEL *model)
+{
+    memset(model, 0, sizeof(*model));
+    for (int b = 0; b < JUMP_BUCKETS; b++)
+    {
+        model->fallback[0][b] = (b == 0) ? 10000 : 85000;
+        model->fallback[1][b] = 500000;
+    }
+}
+
+int SettleBand (freq_t freq)
+{
+    int b;
+    for (b = 0; b < SETTLE_BANDS - 1; b++)
+        if (freq < band_limits[b])
+            break;
+    return b;
+}
+
+//
+// JumpBucket
+// Classify the distance of a retune in decades: <100kHz, <1MHz, <10MHz, <100MHz, more
+//
+int JumpBucket (freq_t from, freq_t to)
+{
+    freq_t jump = (from > to) ? from - to : to - from;
+    freq_t limit = 100000;
+    int b;
+    for (b = 0; b < JUMP_BUCKETS - 1; b++, limit *= 10)
+        if (jump < limit)
+            break;
+    return b;
+}
+
+static long Clamp (long settle)
+{
+    if (settle < SETTLE_MIN)
+        return SETTLE_MIN;
+    if (settle > SETTLE_MAX)
+        return SETTLE_MAX;
+    return settle;
+}
+
+//
+// SettlePredict
+// Expected settle time for a retune. A learned cell is used as is, otherwise
+// the time is fitted on the learned jumps of the same band (least squares on
+// the jump decade), or taken from the nearest learned jump, or from the fallback.
+//
+long SettlePredict (const SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active)
+{
+    int a = after_active ? 1 : 0;
+    int band = SettleBand(to);
+    int bucket = JumpBucket(from, to);
+    const SETTLE_CELL *row = model->cell[a][band];
+
+    if (row[bucket].samples > 0)
+        return row[bucket].settle;
+
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    int    n = 0, nearest = -1;
+    for (int b = 0; b < JUMP_BUCKETS; b++)
+    {
+        if (row[b].samples == 0)
+            continue;
+        sx  += b;
+        sy  += row[b].settle;
+        sxx += b * b;
+        sxy += b * (double)row[b].settle;
+        n++;
+        if (nearest < 0 || abs(b - bucket) < abs(nearest - bucket))
+            nearest = b;
+    }
+    if (n >= 2)
+    {
+        double slope = (n * sxy - sx * sy) / (n * sxx - sx * sx);
+        double icept = (sy - slope * sx) / n;
+        return Clamp((long)(icept + slope * bucket));
+    }
+    if (nearest >= 0)
+        return row[nearest].settle;
+    return model->fallback[a][bucket];
+}
+
+//
+// SettleUpdate
+// Refine the model with a measured settle time
+//
+void SettleUpdate (SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active, long measured)
+{
+    SETTLE_CELL *cell = &model->cell[after_active ? 1 : 0][SettleBand(to)][JumpBucket(from, to)];
+
+    measured = Clamp(measured);
+    cell->settle = (cell->samples) ? (3 * cell->settle + measured) / 4 : measured;
+    cell->samples++;
+}
+
+//
+// SettleFeedback
+// Adjust the model when a detection shows the wait was too short (delta > 0)
+// or has been reliably long enough (delta < 0)
+//
+void SettleFeedback (SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active, long delta)
+{
+    SETTLE_CELL *cell = &model->cell[after_active ? 1 : 0][SettleBand(to)][JumpBucket(from, to)];
+
+    if (cell->samples == 0)
+        cell->settle = SettlePredict(model, from, to, after_active);
+    cell->settle = Clamp(cell->settle + delta);
+    cell->samples++;
+}
+
+//
+// Limits
+// First poll and give up time of a wait expected to take 'expected' us, at most max_wait:
+// half of it, then up to SETTLE_SPAN times it plus the two polls confirming a stable level
+//
+static void Limits (long expected, long max_wait, long *first, long *limit)
+{
+    *first = expected / 2;
+    *limit = SETTLE_SPAN * expected + 2 * SETTLE_POLL;
+    if (*limit > max_wait)
+        *limit = max_wait;
+    if (*first > *limit)
+        *first = *limit;
+}
+
+//
+// SettleWait
+// Wait for the signal level to settle after tuning 'to', within the limits of the
+// expected settle time (0: predicted by the model) and at most max_wait us. measured is the time from the tune
+// to the first sample of the stable run, or the time spent on a timeout. Only a
+// settled level is learned, a busy or fading channel that times out says nothing
+// of the receiver. Returns true if the level settled.
+//
+bool SettleWait (int sockfd, SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active,
+                 long expected, long max_wait, long *measured)
+{
+    double level;
+    long   first, limit;
+    clock_us_t start = ClockNow();
+
+    if (expected <= 0)
+        expected = SettlePredict(model, from, to, after_active);
+    Limits(expected, max_wait, &first, &limit);
+    SleepFor(first);
+    bool settled = WaitSignalSettle(sockfd, SETTLE_TOLERANCE, SETTLE_POLL, limit - first, &level, measured);
+    *measured += first;
+    if (settled)
+        SettleUpdate(model, from, to, after_active, *measured);
+    SpanEnd(SPAN_SETTLE, start, to);
+    return settled;
+}
+
+//
+// Measure
+// Retune from 'from' (already tuned and settled) to 'to' and learn the settle time.
+// Leaving an active frequency is reproduced with the squelch open on 'from',
+// closed back to 'squelch' with the retune.
+//
+static void Measure (int sockfd, SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active, double squelch)
+{
+    double level;
+    long   elapsed;
+
+    if (after_active)
+    {
+        SetSquelchLevel(sockfd, SETTLE_OPEN);
+        WaitSignalSettle(sockfd, SETTLE_TOLERANCE, SETTLE_POLL, SETTLE_MAX, &level, &elapsed);
+        SetSquelchLevel(sockfd, squelch);
+    }
+    SetFreq(sockfd, to);
+    if (WaitSignalSettle(sockfd, SETTLE_TOLERANCE, SETTLE_POLL, SETTLE_MAX, &level, &elapsed))
+        SettleUpdate(model, from, to, after_active, elapsed);
+}
+
+//
+// SettleCalibrate
+// Measure the settle time of jumps of increasing distance that fit in the range,
+// from a quiet and from an active receiver. Each jump is repeated 'rounds' times
+// in both directions. The squelch is left as it was.
+//
+bool SettleCalibrate (int sockfd, SETTLE_MODEL *model, freq_t freq_min, freq_t freq_max, int rounds)
+{
+    double level, squelch = 0;
+    long   elapsed;
+    bool   done = false;
+
+    if (!GetSquelchLevel(sockfd, &squelch))
+        return false;
+    for (int b = 0; b < JUMP_BUCKETS; b++)
+    {
+        freq_t from = freq_min, to = freq_min + bucket_jumps[b];
+        if (to > freq_max)
+            break;
+        for (int r = 0; r < rounds; r++)
+        {
+            for (int a = 0; a < 2; a++)
+            {
+                SetFreq(sockfd, from);
+                WaitSignalSettle(sockfd, SETTLE_TOLERANCE, SETTLE_POLL, SETTLE_MAX, &level, &elapsed);
+                Measure(sockfd, model, from, to, a, squelch);
+                Measure(sockfd, model, to, from, a, squelch);
+            }
+        }
+        done = true;
+    }
+    return done;
+}
+
+void SettlePrint (const SETTLE_MODEL *model)
+{
+    printf ("Settle time model (ms) by band and jump: <100K <1M <10M <100M more\n");
+    for (int row = 0; row < 2 * SETTLE_BANDS; row++)
+    {
+        int a = row / SETTLE_BANDS, band = row % SETTLE_BANDS;
+        bool learned = false;
+        for (int b = 0; b < JUMP_BUCKETS; b++)
+            learned |= model->cell[a][band][b].samples > 0;
+        if (!learned)
+            continue;
+        printf ("  band %d%s:", band, (a) ? " after active" : "");
+        for (int b = 0; b < JUMP_BUCKETS; b++)
+        {
+            const SETTLE_CELL *cell = &model->cell[a][band][b];
+            if (cell->samples)
+                printf (" %6.1f", cell->settle / 1000.0);
+            else
+                printf ("      -");
+        }
+        printf ("\n");
+    }
+}
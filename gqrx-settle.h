@@ -0,0 +1,71 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_SETTLE_H_
+#define _GQRX_SETTLE_H_
+
+#include <stdbool.h>
+#include "gqrx-prot.h"
+
+//
+// Settle time model
+//
+// How long the signal level takes to stabilise after a retune, learned by
+// band, distance of the jump (in decades) and whether the receiver is leaving
+// an active frequency (the squelch needs more time to kick in). Every wait after
+// a tune is seeded by the model: the first poll at half the prediction, so a
+// shorter settle time is still seen, and no poll past SETTLE_SPAN times it.
+//
+#define SETTLE_BANDS        8
+#define JUMP_BUCKETS        5
+#define SETTLE_MIN          1000    // 1 ms
+#define SETTLE_MAX          1000000 // 1 sec
+#define SETTLE_TOLERANCE    1.0     // level is settled when samples are within 1 dB
+#define SETTLE_POLL         10000   // poll the level every 10 ms while settling
+#define SETTLE_SPAN         2       // a wait gives up at twice the prediction
+#define SETTLE_OPEN         -150.0  // squelch open on anything: the receiver is active
+
+typedef struct {
+    long settle;    // moving average of the settle time in microseconds
+    int  samples;
+} SETTLE_CELL;
+
+typedef struct {
+    SETTLE_CELL cell[2][SETTLE_BANDS][JUMP_BUCKETS]; // [after active][band][jump]
+    long        fallback[2][JUMP_BUCKETS];           // used until something is learned
+} SETTLE_MODEL;
+
+void SettleModelInit(SETTLE_MODEL *model);
+int  SettleBand(freq_t freq);
+int  JumpBucket(freq_t from, freq_t to);
+
+long SettlePredict(const SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active);
+void SettleUpdate(SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active, long measured);
+void SettleFeedback(SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active, long delta);
+
+bool SettleWait(int sockfd, SETTLE_MODEL *model, freq_t from, freq_t to, bool after_active,
+                long expected, long max_wait, long *measured);
+bool SettleCalibrate(int sockfd, SETTLE_MODEL *model, freq_t freq_min, freq_t freq_max, int rounds);
+void SettlePrint(const SETTLE_MODEL *model);
+
+#endif /* _GQRX_SETTLE_H_ */
@@ -0,0 +1,212 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <getopt.h>
+#include <signal.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include "gqrx-spectrum.h"
+
+//
+// gqrx-sim
+// A gqrx stand-in for benchmarks: answers the remote control protocol from a
+// simulated spectrum on localhost and scores the scan when it exits.
+//
+static volatile sig_atomic_t QuitRequested = false;
+
+static void Quit (int sig)
+{
+    (void)sig;
+    QuitRequested = true;
+}
+
+void print_usage (char *name)
+{
+    printf ("Usage:\n");
+    printf ("%s [-p|--port <port>] [-s|--seed <n>] [-d|--duration <seconds>]\n", name);
+    printf ("\t\t[-l|--latency <us>] [-t|--settle <us>] <scenario file>\n\n");
+    printf ("-p, --port <port>            Port to listen on, localhost only. Default: 7356\n");
+    printf ("-s, --seed <n>               Seed of the bursts and noise, overrides the scenario\n");
+    printf ("-d, --duration <seconds>     Exit after this time from the first connection.\n");
+    printf ("                               Default: 0, until SIGINT or SIGTERM\n");
+    printf ("-l, --latency <us>           Reply latency, overrides the scenario\n");
+    printf ("-t, --settle <us>            Settle time constant after a retune, overrides the scenario\n");
+    printf ("\nThe scan is scored at exit: steps, bursts detected and missed, false detections,\n");
+    printf ("time to detect and revisit latency of the emitter channels.\n");
+    exit(EXIT_FAILURE);
+}
+
+static int Listen (int port)
+{
+    struct sockaddr_in addr;
+    int one = 1;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0)
+        return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family      = AF_INET;
+    addr.sin_port        = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(fd, 1) != 0)
+    {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+//
+// Serve
+// Answer the lines of a client until it disconnects, the time is up or quit
+//
+static void Serve (SPECTRUM *sp, int fd, clock_us_t deadline)
+{
+    char   line[BUFSIZE], reply[BUFSIZE];
+    size_t len = 0;
+
+    while (!QuitRequested)
+    {
+        clock_us_t now = ClockNow();
+        if (deadline != 0 && now >= deadline)
+            return;
+        struct pollfd pfd = { fd, POLLIN, 0 };
+        int timeout = (deadline != 0) ? (int)((deadline - now) / 1000) + 1 : -1;
+        int r = poll(&pfd, 1, timeout);
+        if (r < 0 && errno != EINTR)
+            return;
+        if (r <= 0)
+            continue;
+        ssize_t n = recv(fd, line + len, sizeof(line) - 1 - len, 0);
+        if (n <= 0)
+            return;
+        len += n;
+        line[len] = '\0';
+
+        char *start = line, *end;
+        while ((end = strchr(start, '\n')) != NULL)
+        {
+            *end = '\0';
+            if (end > start && end[-1] == '\r')
+                end[-1] = '\0';
+            SpectrumCommand(sp, start, reply, sizeof(reply), ClockNow());
+            SleepFor(SpectrumLatency(sp));
+            if (send(fd, reply, strlen(reply), MSG_NOSIGNAL) < 0)
+                return;
+            start = end + 1;
+        }
+        len -= start - line;
+        memmove(line, start, len);
+        if (len == sizeof(line) - 1)
+            len = 0; // no newline in a full buffer, drop it
+    }
+}
+
+int main (int argc, char **argv)
+{
+    SPECTRUM sp;
+    int    port = 7356;
+    long   duration = 0;
+    long   seed = -1, latency = -1, settle = -1;
+    int    c;
+    static struct option long_options[] =
+    {
+        {"port",     required_argument, 0, 'p'},
+        {"seed",     required_argument, 0, 's'},
+        {"duration", required_argument, 0, 'd'},
+        {"latency",  required_argument, 0, 'l'},
+        {"settle",   required_argument, 0, 't'},
+        {"help",     no_argument,       0, 'q'},
+        {0, 0, 0, 0}
+    };
+
+    while ((c = getopt_long(argc, argv, "p:s:d:l:t:", long_options, NULL)) != -1)
+    {
+        switch (c)
+        {
+            case 'p': port     = atoi(optarg); break;
+            case 's': seed     = atol(optarg); break;
+            case 'd': duration = atol(optarg); break;
+            case 'l': latency  = atol(optarg); break;
+            case 't': settle   = atol(optarg); break;
+            default:  print_usage(argv[0]);
+        }
+    }
+    if (optind != argc - 1 || port <= 0)
+        print_usage(argv[0]);
+
+    SpectrumInit(&sp);
+    if (!SpectrumLoad(&sp, argv[optind]))
+        exit(EXIT_FAILURE);
+    if (seed >= 0)
+        sp.seed = seed;
+    if (latency >= 0)
+        sp.latency = latency;
+    if (settle >= 0)
+        sp.settle = settle;
+
+    int listen_fd = Listen(port);
+    if (listen_fd < 0)
+    {
+        printf ("Error: cannot listen on port %d\n", port);
+        exit(EXIT_FAILURE);
+    }
+    signal(SIGINT,  Quit);
+    signal(SIGTERM, Quit);
+    printf ("Listening on 127.0.0.1:%d, %d emitters\n", port, sp.n_emitters);
+    fflush(stdout);
+
+    // the clock starts with the first connection, then reconnections go on
+    clock_us_t deadline = 0;
+    bool       started = false;
+    while (!QuitRequested && (deadline == 0 || ClockNow() < deadline))
+    {
+        struct pollfd pfd = { listen_fd, POLLIN, 0 };
+        int timeout = (deadline != 0) ? (int)((deadline - ClockNow()) / 1000) + 1 : -1;
+        if (poll(&pfd, 1, timeout) <= 0)
+            continue;
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0)
+            continue;
+        if (!started)
+        {
+            started = true;
+            SpectrumStart(&sp, ClockNow());
+            if (duration > 0)
+                deadline = ClockNow() + (clock_us_t)duration * 1000000;
+        }
+        Serve(&sp, fd, deadline);
+        close(fd);
+    }
+    close(listen_fd);
+    if (started)
+        SpectrumReport(&sp, ClockNow(), stdout);
+    return 0;
+}
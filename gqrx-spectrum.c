@@ -0,0 +1,404 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gqrx-spectrum.h"
+
+//
+// Random numbers: splitmix64 to seed, xorshift64* to draw
+//
+static uint64_t SplitMix (uint64_t x)
+{
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+static double Uniform (uint64_t *state)
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return ((*state * 0x2545f4914f6cdd1dULL) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+static double Gauss (uint64_t *state)
+{
+    double u = Uniform(state), v = Uniform(state);
+    return sqrt(-2.0 * log(u + 1e-300)) * cos(2 * M_PI * v);
+}
+
+// exponential time with the given mean in ms, in us
+static clock_us_t Exponential (uint64_t *state, long mean)
+{
+    return (clock_us_t)(-log(1.0 - Uniform(state)) * mean * 1000.0) + 1;
+}
+
+void SpectrumInit (SPECTRUM *sp)
+{
+    memset(sp, 0, sizeof(*sp));
+    sp->seed         = 1;
+    sp->noise_floor  = -75.0;
+    sp->noise_sigma  = 1.0;
+    sp->latency      = 200;
+    sp->settle       = 20000;
+    sp->squelch      = -50.0;
+    sp->width        = 6000;
+    sp->hit_time     = 1000000;
+    sp->freq         = 145000000;
+    sp->stay_emitter = -1;
+}
+
+bool SpectrumAddEmitter (SPECTRUM *sp, freq_t freq, double level, long on, long off, long drift)
+{
+    if (sp->n_emitters >= SPECTRUM_EMITTERS)
+        return false;
+    SPECTRUM_EMITTER *e = &sp->emitter[sp->n_emitters++];
+    memset(e, 0, sizeof(*e));
+    e->freq  = freq;
+    e->level = level;
+    e->on    = on;
+    e->off   = (off > 0) ? off : 1;
+    e->drift = drift;
+    return true;
+}
+
+bool SpectrumLoad (SPECTRUM *sp, const char *path)
+{
+    char line[BUFSIZE];
+    int  n = 0;
+    FILE *f = fopen(path, "r");
+    if (f == NULL)
+    {
+        printf ("Error: cannot open %s\n", path);
+        return false;
+    }
+    while (fgets(line, sizeof(line), f) != NULL)
+    {
+        char   *comment = strchr(line, '#');
+        char   key[32];
+        double a, b;
+        long   on, off, drift = 0;
+        unsigned long long u, freq;
+        bool   ok = true;
+
+        n++;
+        if (comment != NULL)
+            *comment = '\0';
+        if (sscanf(line, "%31s", key) != 1)
+            continue;
+        if (strcmp(key, "seed") == 0)
+            ok = sscanf(line, "%*s %llu", &u) == 1 && (sp->seed = u, true);
+        else if (strcmp(key, "noise") == 0)
+            ok = sscanf(line, "%*s %lf %lf", &a, &b) == 2 && (sp->noise_floor = a, sp->noise_sigma = b, true);
+        else if (strcmp(key, "latency") == 0)
+        {
+            b = 0;
+            ok = sscanf(line, "%*s %lf %lf", &a, &b) >= 1 && (sp->latency = (long)a, sp->jitter = (long)b, true);
+        }
+        else if (strcmp(key, "settle") == 0)
+            ok = sscanf(line, "%*s %lf", &a) == 1 && (sp->settle = (long)a, true);
+        else if (strcmp(key, "squelch") == 0)
+            ok = sscanf(line, "%*s %lf", &a) == 1 && (sp->squelch = a, true);
+        else if (strcmp(key, "width") == 0)
+            ok = sscanf(line, "%*s %lf", &a) == 1 && a > 0 && (sp->width = (long)a, true);
+        else if (strcmp(key, "hit") == 0)
+            ok = sscanf(line, "%*s %lf", &a) == 1 && a > 0 && (sp->hit_time = (long)(a * 1000), true);
+        else if (strcmp(key, "emitter") == 0)
+            ok = sscanf(line, "%*s %llu %lf %ld %ld %ld", &freq, &a, &on, &off, &drift) >= 4 &&
+                 SpectrumAddEmitter(sp, freq, a, on, off, drift);
+        else
+            ok = false;
+        if (!ok)
+        {
+            printf ("Error: %s:%d: invalid line\n", path, n);
+            fclose(f);
+            return false;
+        }
+    }
+    fclose(f);
+    return true;
+}
+
+static double EmitterFreq (const SPECTRUM *sp, const SPECTRUM_EMITTER *e, clock_us_t now)
+{
+    if (e->drift == 0)
+        return (double)e->freq;
+    return e->freq + e->drift * sin(2 * M_PI * (double)(now - sp->start) / SPECTRUM_DRIFT + e->phase);
+}
+
+//
+// ChannelOf
+// The emitter whose channel contains freq, -1 if none
+//
+static int ChannelOf (const SPECTRUM *sp, freq_t freq, clock_us_t now)
+{
+    int    found = -1;
+    double best = 0;
+    for (int i = 0; i < sp->n_emitters; i++)
+    {
+        double df = fabs((double)freq - EmitterFreq(sp, &sp->emitter[i], now));
+        if (df <= sp->width && (found < 0 || df < best))
+        {
+            found = i;
+            best  = df;
+        }
+    }
+    return found;
+}
+
+// noise free level of a frequency, an emitter falls off 12 dB at the channel edge
+static double Target (const SPECTRUM *sp, freq_t freq, clock_us_t now)
+{
+    double level = sp->noise_floor;
+    for (int i = 0; i < sp->n_emitters; i++)
+    {
+        const SPECTRUM_EMITTER *e = &sp->emitter[i];
+        if (!e->active)
+            continue;
+        double df = fabs((double)freq - EmitterFreq(sp, e, now)) / sp->width;
+        if (df < 3 && e->level - 12 * df * df > level)
+            level = e->level - 12 * df * df;
+    }
+    return level;
+}
+
+// noise free level read by the receiver, still settling after a retune
+static double Reported (const SPECTRUM *sp, clock_us_t now)
+{
+    double target = Target(sp, sp->freq, now);
+    if (sp->settle <= 0)
+        return target;
+    return target + (sp->from_level - target) * exp(-(double)(now - sp->tuned_at) / sp->settle);
+}
+
+void SpectrumStart (SPECTRUM *sp, clock_us_t now)
+{
+    sp->start      = now;
+    sp->tuned_at   = now;
+    sp->from_level = sp->noise_floor;
+    sp->rng        = SplitMix(sp->seed) | 1;
+    for (int i = 0; i < sp->n_emitters; i++)
+    {
+        SPECTRUM_EMITTER *e = &sp->emitter[i];
+        e->rng   = SplitMix(sp->seed + 1 + i) | 1;
+        e->phase = 2 * M_PI * Uniform(&e->rng);
+        if (e->on == 0)
+        {
+            e->active      = true;
+            e->burst_start = now;
+            e->toggle      = 0;
+            sp->stats.bursts++;
+        }
+        else
+            e->toggle = now + Exponential(&e->rng, e->off);
+    }
+    sp->stay_start   = now;
+    sp->stay_emitter = ChannelOf(sp, sp->freq, now);
+    sp->stay_freq    = sp->freq;
+    sp->stay_scored  = false;
+}
+
+//
+// ScoreStay
+// Once the receiver has stayed hit_time on a frequency the scanner is listening:
+// a detection if the emitter of the channel transmitted during the stay
+//
+static void ScoreStay (SPECTRUM *sp, clock_us_t now)
+{
+    if (sp->stay_scored || now - sp->stay_start < (clock_us_t)sp->hit_time)
+        return;
+    sp->stay_scored = true;
+    if (sp->stay_emitter < 0)
+    {
+        sp->stats.false_hits++;
+        return;
+    }
+    SPECTRUM_EMITTER *e = &sp->emitter[sp->stay_emitter];
+    if (!e->active && (e->burst_end < sp->stay_start || e->burst_end == 0))
+    {
+        sp->stats.false_hits++;
+        return;
+    }
+    if (e->detected)
+        return;
+    uint64_t delay = (sp->stay_start > e->burst_start) ? sp->stay_start - e->burst_start : 0;
+    e->detected = true;
+    e->pending  = false;
+    sp->stats.detected++;
+    sp->stats.detect_sum += delay;
+    if (delay > sp->stats.detect_max)
+        sp->stats.detect_max = delay;
+}
+
+//
+// SpectrumAdvance
+// Run the bursts up to now
+//
+void SpectrumAdvance (SPECTRUM *sp, clock_us_t now)
+{
+    for (int i = 0; i < sp->n_emitters; i++)
+    {
+        SPECTRUM_EMITTER *e = &sp->emitter[i];
+        while (e->toggle != 0 && e->toggle <= now)
+        {
+            clock_us_t t = e->toggle;
+            if (e->active)
+            {
+                e->active    = false;
+                e->burst_end = t;
+                // the receiver may be about to score this burst
+                if (!e->detected)
+                {
+                    if (sp->stay_emitter == i && !sp->stay_scored && sp->stay_start <= t)
+                        e->pending = true;
+                    else
+                        sp->stats.missed++;
+                }
+                e->toggle = t + Exponential(&e->rng, e->off);
+            }
+            else
+            {
+                if (e->pending)
+                    sp->stats.missed++;
+                e->pending     = false;
+                e->active      = true;
+                e->detected    = false;
+                e->burst_start = t;
+                e->toggle      = t + Exponential(&e->rng, e->on);
+                sp->stats.bursts++;
+            }
+        }
+    }
+    ScoreStay(sp, now);
+}
+
+double SpectrumLevel (SPECTRUM *sp, clock_us_t now)
+{
+    SpectrumAdvance(sp, now);
+    double level = Reported(sp, now) + Gauss(&sp->rng) * sp->noise_sigma;
+    return (level > -0.1) ? -0.1 : level; // 0.0 is a read error for the scanner
+}
+
+//
+// SpectrumTune
+// Retune, closing the stay on the previous frequency
+//
+void SpectrumTune (SPECTRUM *sp, freq_t freq, clock_us_t now)
+{
+    SpectrumAdvance(sp, now);
+    sp->from_level = Reported(sp, now);
+    sp->freq       = freq;
+    sp->tuned_at   = now;
+    sp->stats.tunes++;
+
+    int channel = ChannelOf(sp, freq, now);
+    if (channel == sp->stay_emitter && (channel >= 0 || freq == sp->stay_freq))
+        return;
+
+    if (sp->stay_emitter >= 0 && sp->emitter[sp->stay_emitter].pending)
+    {
+        sp->emitter[sp->stay_emitter].pending = false;
+        sp->stats.missed++;
+    }
+    sp->stay_start   = now;
+    sp->stay_emitter = channel;
+    sp->stay_freq    = freq;
+    sp->stay_scored  = false;
+    if (channel >= 0)
+    {
+        SPECTRUM_EMITTER *e = &sp->emitter[channel];
+        if (e->visited != 0)
+        {
+            uint64_t revisit = now - e->visited;
+            sp->stats.revisits++;
+            sp->stats.revisit_sum += revisit;
+            if (revisit > sp->stats.revisit_max)
+                sp->stats.revisit_max = revisit;
+        }
+        e->visited = now;
+    }
+}
+
+//
+// SpectrumCommand
+// Reply to a line of the gqrx remote protocol
+//
+void SpectrumCommand (SPECTRUM *sp, const char *line, char *reply, size_t size, clock_us_t now)
+{
+    unsigned long long freq;
+    double value;
+    int    on;
+
+    if (sscanf(line, "F %llu", &freq) == 1)
+    {
+        SpectrumTune(sp, freq, now);
+        snprintf(reply, size, "RPRT 0\n");
+    }
+    else if (strcmp(line, "f") == 0)
+        snprintf(reply, size, "%llu\n", sp->freq);
+    else if (strcmp(line, "l") == 0)
+        snprintf(reply, size, "%.1f\n", SpectrumLevel(sp, now));
+    else if (strcmp(line, "l SQL") == 0)
+        snprintf(reply, size, "%.1f\n", sp->squelch);
+    else if (sscanf(line, "L SQL %lf", &value) == 1)
+    {
+        sp->squelch = value;
+        snprintf(reply, size, "RPRT 0\n");
+    }
+    else if (sscanf(line, "U RECORD %d", &on) == 1)
+    {
+        sp->recording = (on != 0);
+        snprintf(reply, size, "RPRT 0\n");
+    }
+    else
+        snprintf(reply, size, "RPRT 1\n");
+}
+
+long SpectrumLatency (SPECTRUM *sp)
+{
+    return sp->latency + (long)(sp->jitter * Uniform(&sp->rng));
+}
+
+void SpectrumReport (SPECTRUM *sp, clock_us_t now, FILE *out)
+{
+    SPECTRUM_STATS *s = &sp->stats;
+    double secs = (now - sp->start) / 1e6;
+
+    SpectrumAdvance(sp, now);
+    fprintf(out, "seed:              %llu\n", (unsigned long long)sp->seed);
+    fprintf(out, "duration:          %.1f s\n", secs);
+    fprintf(out, "steps:             %llu (%.1f/s)\n", (unsigned long long)s->tunes,
+            (secs > 0) ? s->tunes / secs : 0);
+    fprintf(out, "bursts:            %llu (detected %llu, missed %llu)\n", (unsigned long long)s->bursts,
+            (unsigned long long)s->detected, (unsigned long long)s->missed);
+    fprintf(out, "false detections:  %llu\n", (unsigned long long)s->false_hits);
+    fprintf(out, "time to detect:    mean %.0f ms, max %.0f ms\n",
+            (s->detected) ? s->detect_sum / 1000.0 / s->detected : 0, s->detect_max / 1000.0);
+    fprintf(out, "revisit latency:   mean %.0f ms, max %.0f ms\n",
+            (s->revisits) ? s->revisit_sum / 1000.0 / s->revisits : 0, s->revisit_max / 1000.0);
+}
@@ -0,0 +1,123 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_SPECTRUM_H_
+#define _GQRX_SPECTRUM_H_
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include "gqrx-prot.h"
+#include "gqrx-clock.h"
+
+//
+// Simulated spectrum
+//
+// The band seen by gqrx-sim: a noise floor and emitters transmitting in bursts
+// (exponential on and off times) with a slow drift. The level read after a
+// retune moves from the old level to the new one with the settle time constant.
+// The tuning is scored against the bursts: a stay of hit_time on the channel of
+// an emitter that is on is a detection, on a quiet frequency a false detection,
+// and a burst that ends undetected is missed.
+//
+// Scenario file, one setting per line, '#' comments:
+//   seed <n>
+//   noise <floor dBFS> <sigma dB>
+//   latency <us> [jitter us]
+//   settle <us>
+//   squelch <dBFS>
+//   width <Hz>                      half bandwidth of the emitters
+//   hit <ms>                        stay counted as a detection
+//   emitter <freq> <dBFS> <on ms> <off ms> [drift Hz]   on 0: always on
+//
+#define SPECTRUM_EMITTERS   256
+#define SPECTRUM_DRIFT      60000000    // period of the drift, us
+
+typedef struct {
+    freq_t      freq;
+    double      level;
+    long        on, off;        // mean burst and gap, ms
+    long        drift;          // amplitude, Hz
+    double      phase;
+    uint64_t    rng;
+    bool        active;
+    clock_us_t  toggle;         // next on/off change, 0: never
+    clock_us_t  burst_start;
+    clock_us_t  burst_end;      // end of the last burst
+    bool        detected;       // the current or last burst
+    bool        pending;        // burst over while the receiver is still on it
+    clock_us_t  visited;        // start of the last visit
+} SPECTRUM_EMITTER;
+
+typedef struct {
+    uint64_t tunes;
+    uint64_t bursts;
+    uint64_t detected;
+    uint64_t missed;
+    uint64_t false_hits;
+    uint64_t detect_sum, detect_max;    // us
+    uint64_t revisits;
+    uint64_t revisit_sum, revisit_max;  // us
+} SPECTRUM_STATS;
+
+typedef struct {
+    uint64_t    seed;
+    double      noise_floor;
+    double      noise_sigma;
+    long        latency, jitter;        // us
+    long        settle;                 // us
+    double      squelch;
+    long        width;                  // Hz
+    long        hit_time;               // us
+    int         n_emitters;
+    SPECTRUM_EMITTER emitter[SPECTRUM_EMITTERS];
+
+    // receiver
+    uint64_t    rng;
+    freq_t      freq;
+    clock_us_t  tuned_at;
+    double      from_level;
+    bool        recording;
+
+    // scoring
+    clock_us_t  start;
+    clock_us_t  stay_start;
+    int         stay_emitter;           // -1: quiet frequency
+    freq_t      stay_freq;
+    bool        stay_scored;
+    SPECTRUM_STATS stats;
+} SPECTRUM;
+
+void   SpectrumInit(SPECTRUM *sp);
+bool   SpectrumLoad(SPECTRUM *sp, const char *path);
+bool   SpectrumAddEmitter(SPECTRUM *sp, freq_t freq, double level, long on, long off, long drift);
+void   SpectrumStart(SPECTRUM *sp, clock_us_t now);
+void   SpectrumAdvance(SPECTRUM *sp, clock_us_t now);
+double SpectrumLevel(SPECTRUM *sp, clock_us_t now);
+void   SpectrumTune(SPECTRUM *sp, freq_t freq, clock_us_t now);
+void   SpectrumCommand(SPECTRUM *sp, const char *line, char *reply, size_t size, clock_us_t now);
+long   SpectrumLatency(SPECTRUM *sp);
+void   SpectrumReport(SPECTRUM *sp, clock_us_t now, FILE *out);
+
+#endif /* _GQRX_SPECTRUM_H_ */
@@ -0,0 +1,214 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "gqrx-survey.h"
+
+bool SurveyOpen (SURVEY *survey, const char *path, double threshold)
+{
+    memset(survey, 0, sizeof(*survey));
+    survey->fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC); // a FIFO opens without a writer
+    if (survey->fd < 0)
+        return false;
+    survey->threshold = threshold;
+    survey->line   = malloc(SURVEY_LINE);
+    survey->values = malloc(2 * SURVEY_VALUES * sizeof(float));
+    if (survey->line == NULL || survey->values == NULL)
+    {
+        SurveyClose(survey);
+        return false;
+    }
+    return true;
+}
+
+//
+// SurveyRange
+// Sweep bins of the scan, everything surveyed so far is dropped.
+// A regular file is read again from the start.
+//
+bool SurveyRange (SURVEY *survey, freq_t freq_min, freq_t freq_max, freq_t interval)
+{
+    struct stat st;
+
+    free(survey->excess);
+    free(survey->updated);
+    survey->freq_min = freq_min;
+    survey->interval = interval;
+    survey->bins     = (freq_max - freq_min) / interval + 1;
+    survey->excess   = calloc(survey->bins, sizeof(float));
+    survey->updated  = calloc(survey->bins, sizeof(clock_us_t));
+    survey->stamp[0] = '\0';
+    survey->len      = 0;
+    survey->overflow = false;
+    if (fstat(survey->fd, &st) == 0 && S_ISREG(st.st_mode))
+        lseek(survey->fd, 0, SEEK_SET);
+    return survey->excess != NULL && survey->updated != NULL;
+}
+
+static int CompareFloat (const void *a, const void *b)
+{
+    float x = *(const float *)a, y = *(const float *)b;
+    return (x > y) - (x < y);
+}
+
+static char *Field (char **save)
+{
+    char *field = strtok_r(NULL, ",", save);
+    if (field != NULL)
+        field += strspn(field, " ");
+    return field;
+}
+
+//
+// SurveyFeed
+// Parse one rtl_power line (one hop of the survey)
+//
+bool SurveyFeed (SURVEY *survey, char *line)
+{
+    char  *save, *field, *end;
+    char   stamp[sizeof(survey->stamp)];
+    int    n = 0;
+
+    char *date = strtok_r(line, ",", &save);
+    char *time = Field(&save);
+    char *low  = Field(&save);
+    char *high = Field(&save);
+    char *step = Field(&save);
+    if (date == NULL || time == NULL || low == NULL || high == NULL || step == NULL || Field(&save) == NULL)
+    {
+        survey->rejected++;
+        return false;
+    }
+    double freq_low = strtod(low, NULL), freq_high = strtod(high, NULL), freq_step = strtod(step, NULL);
+    while (n < SURVEY_VALUES && (field = Field(&save)) != NULL)
+    {
+        survey->values[n] = strtof(field, &end);
+        if (end != field)
+            n++;
+    }
+    if (n == 0 || freq_step <= 0 || freq_low >= freq_high)
+    {
+        survey->rejected++;
+        return false;
+    }
+
+    // a snapshot is all the hops with the same date and time
+    snprintf(stamp, sizeof(stamp), "%s %s", date, time);
+    clock_us_t now = ClockNow();
+    if (strcmp(stamp, survey->stamp) != 0)
+    {
+        strcpy(survey->stamp, stamp);
+        survey->snapshot = now;
+    }
+
+    float *sorted = survey->values + SURVEY_VALUES;
+    memcpy(sorted, survey->values, n * sizeof(float));
+    qsort(sorted, n, sizeof(float), CompareFloat);
+    float median = sorted[n / 2];
+
+    for (int k = 0; k < n; k++)
+    {
+        double offset = freq_low + k * freq_step - (double)survey->freq_min + survey->interval / 2.0;
+        if (offset < 0)
+            continue;
+        size_t idx = (size_t)(offset / survey->interval);
+        if (idx >= survey->bins)
+            break;
+        float excess = survey->values[k] - median;
+        if (survey->updated[idx] < survey->snapshot || excess > survey->excess[idx])
+            survey->excess[idx] = excess;
+        survey->updated[idx] = now;
+    }
+    survey->lines++;
+    return true;
+}
+
+//
+// SurveyPoll
+// Parse the complete lines available, returns their number
+//
+int SurveyPoll (SURVEY *survey)
+{
+    int     lines = 0;
+    ssize_t n;
+
+    if (survey->fd < 0 || survey->excess == NULL)
+        return 0;
+    while ((n = read(survey->fd, survey->line + survey->len, SURVEY_LINE - 1 - survey->len)) > 0)
+    {
+        char *start = survey->line, *nl;
+        survey->len += n;
+        survey->line[survey->len] = '\0';
+        while ((nl = strchr(start, '\n')) != NULL)
+        {
+            *nl = '\0';
+            if (survey->overflow)
+                survey->overflow = false;
+            else if (SurveyFeed(survey, start))
+                lines++;
+            start = nl + 1;
+        }
+        survey->len -= start - survey->line;
+        memmove(survey->line, start, survey->len);
+        if (survey->len == SURVEY_LINE - 1)
+        {
+            // no end of line in sight
+            survey->rejected++;
+            survey->overflow = true;
+            survey->len = 0;
+        }
+    }
+    return lines;
+}
+
+//
+// SurveyCandidate
+// A bin is probed when the survey saw energy there, or knows nothing recent about it
+//
+bool SurveyCandidate (const SURVEY *survey, freq_t freq)
+{
+    if (survey->fd < 0 || survey->excess == NULL || freq < survey->freq_min)
+        return true;
+    size_t idx = (freq - survey->freq_min + survey->interval / 2) / survey->interval;
+    if (idx >= survey->bins || survey->updated[idx] == 0 || ClockNow() - survey->updated[idx] > SURVEY_STALE)
+        return true;
+    return survey->excess[idx] >= survey->threshold;
+}
+
+void SurveyClose (SURVEY *survey)
+{
+    if (survey->fd >= 0)
+        close(survey->fd);
+    free(survey->line);
+    free(survey->values);
+    free(survey->excess);
+    free(survey->updated);
+    memset(survey, 0, sizeof(*survey));
+    survey->fd = -1;
+}
@@ -0,0 +1,72 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_SURVEY_H_
+#define _GQRX_SURVEY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gqrx-prot.h"
+#include "gqrx-clock.h"
+
+//
+// Spectrum survey
+//
+// Power snapshots of the band from another tool (rtl_power CSV lines:
+// date, time, Hz low, Hz high, Hz step, samples, dB, dB, ...) read from a
+// file or a FIFO without blocking. Each sweep bin keeps the strongest level
+// above the median of its hop; only bins above the threshold, or not
+// surveyed recently, are worth a round trip to gqrx.
+//
+#define SURVEY_LINE         65536
+#define SURVEY_VALUES       (SURVEY_LINE / 2)   // a value takes at least 2 chars
+#define SURVEY_STALE        300000000   // 5 min, older snapshots are ignored
+#define SURVEY_THRESHOLD    6.0         // dB above the hop median
+#define SURVEY_IDLE         100000      // wait for new snapshots when no bin is a candidate
+
+typedef struct {
+    int         fd;
+    double      threshold;
+    freq_t      freq_min;
+    freq_t      interval;
+    size_t      bins;
+    float      *excess;         // dB above the hop median, strongest of the snapshot
+    clock_us_t *updated;        // 0 = not surveyed
+    clock_us_t  snapshot;       // start of the snapshot being read
+    char        stamp[32];      // its date and time
+    char       *line;           // partial line, SURVEY_LINE bytes
+    size_t      len;
+    bool        overflow;       // dropping a line too long, up to its end
+    float      *values;         // dB of the hop being parsed, then sorted
+    uint64_t    lines;
+    uint64_t    rejected;
+} SURVEY;
+
+bool SurveyOpen(SURVEY *survey, const char *path, double threshold);
+bool SurveyRange(SURVEY *survey, freq_t freq_min, freq_t freq_max, freq_t interval);
+bool SurveyFeed(SURVEY *survey, char *line);
+int  SurveyPoll(SURVEY *survey);
+bool SurveyCandidate(const SURVEY *survey, freq_t freq);
+void SurveyClose(SURVEY *survey);
+
+#endif /* _GQRX_SURVEY_H_ */
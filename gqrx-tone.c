@@ -0,0 +1,373 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#define _GNU_SOURCE // strcasestr
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <math.h>
+#include "gqrx-tone.h"
+
+// EIA/TIA-603 tones and the common extensions, in Hz
+const double g_ctcss_tones[CTCSS_TONES] = {
+     67.0,  69.3,  71.9,  74.4,  77.0,  79.7,  82.5,  85.4,  88.5,  91.5,
+     94.8,  97.4, 100.0, 103.5, 107.2, 110.9, 114.8, 118.8, 123.0, 127.3,
+    131.8, 136.5, 141.3, 146.2, 151.4, 156.7, 159.8, 162.2, 165.5, 167.9,
+    171.3, 173.8, 177.3, 179.9, 183.5, 186.2, 189.9, 192.8, 196.6, 199.5,
+    203.5, 206.5, 210.7, 218.1, 225.7, 229.1, 233.6, 241.8, 250.3, 254.1
+};
+
+void ToneInit (TONE_DECODER *dec)
+{
+    memset(dec, 0, sizeof(*dec));
+    // the lanes past the last tone stay at 0 and decode nothing
+    for (int t = 0; t < CTCSS_TONES; t++)
+        dec->coeff[t] = (float)(2 * cos(2 * M_PI * g_ctcss_tones[t] / TONE_RATE));
+    dec->ctcss = -1;
+}
+
+//
+// ToneReset
+// Forget what was decoded, e.g. after tuning another channel.
+// The filters keep their state.
+//
+void ToneReset (TONE_DECODER *dec)
+{
+    memset(dec->s1, 0, sizeof(dec->s1));
+    memset(dec->s2, 0, sizeof(dec->s2));
+    dec->sum = dec->sum2 = 0;
+    dec->n = 0;
+    dec->ctcss = -1;
+    dec->blocks = 0;
+    dec->word = 0;
+    dec->dcs_max = 0;
+}
+
+//
+// DcsWord
+// 23 bit word of a code as sent, the first bit in bit 0: the 9 bit code,
+// the 100 flag and the 11 Golay (23,12) parity bits
+//
+uint32_t DcsWord (int code, bool inverted)
+{
+    uint32_t data = (code & 0x1FF) | 0x800;
+    uint32_t word = data;
+
+    for (int i = 0; i < 12; i++)
+    {
+        word <<= 1;
+        if (word & 0x1000)
+            word ^= 0x08EA;
+    }
+    word = data | ((word & 0x0FFE) << 11);
+    return (inverted) ? word ^ 0x7FFFFF : word;
+}
+
+static bool DcsValid (uint32_t word, int *code)
+{
+    if ((word & 0xE00) != 0x800 || DcsWord(word & 0x1FF, false) != word)
+        return false;
+    *code = word & 0x1FF;
+    return true;
+}
+
+static void DcsSeen (TONE_DECODER *dec, int code)
+{
+    for (int s = 0; s < dec->dcs_max; s++)
+    {
+        if (dec->dcs_code[s] == code)
+        {
+            dec->dcs_count[s]++;
+            return;
+        }
+    }
+    if (dec->dcs_max < DCS_SEEN)
+    {
+        dec->dcs_code[dec->dcs_max]  = code;
+        dec->dcs_count[dec->dcs_max] = 1;
+        dec->dcs_max++;
+    }
+}
+
+//
+// DcsSample
+// Slice the low passed audio and sample it in the middle of the bits
+//
+static void DcsSample (TONE_DECODER *dec, float x)
+{
+    float phase = dec->phase + (float)(DCS_BAUD / TONE_RATE);
+    bool  sign;
+    int   code;
+
+    dec->dc += (float)DCS_DC * (x - dec->dc);
+    sign = x > dec->dc;
+    if (sign != dec->sign)
+    {
+        // transitions are expected at phase 0
+        float error = (phase >= 0.5f) ? phase - 1 : phase;
+        phase -= (float)DCS_PULL * error;
+        dec->sign = sign;
+    }
+    if (dec->phase < 0.5f && phase >= 0.5f)
+    {
+        dec->word = (dec->word >> 1) | ((uint32_t)sign << 22);
+        if (DcsValid(dec->word, &code))
+            DcsSeen(dec, code);
+        else if (DcsValid(dec->word ^ 0x7FFFFF, &code))
+            DcsSeen(dec, code | DCS_INVERTED);
+    }
+    if (phase >= 1)
+        phase -= 1;
+    else if (phase < 0)
+        phase += 1;
+    dec->phase = phase;
+}
+
+//
+// CtcssBlock
+// Decide the tone of a complete block and start the next one
+//
+static void CtcssBlock (TONE_DECODER *dec)
+{
+    double energy = dec->sum2 - dec->sum * dec->sum / dec->n; // without the DC
+    double best = 0, second = 0;
+    int    tone = -1;
+
+    for (int t = 0; t < CTCSS_TONES; t++)
+    {
+        double power = (double)dec->s1[t] * dec->s1[t] + (double)dec->s2[t] * dec->s2[t] -
+                       (double)dec->coeff[t] * dec->s1[t] * dec->s2[t];
+        if (power > best)
+        {
+            second = best;
+            best   = power;
+            tone   = t;
+        }
+        else if (power > second)
+            second = power;
+    }
+    // a tone alone in the block has a power of energy * n / 2
+    if (energy / dec->n < TONE_SILENCE || best < CTCSS_FRACTION * energy * dec->n / 2 ||
+        best < CTCSS_DOMINANCE * second)
+        tone = -1;
+    dec->ctcss = tone;
+    dec->blocks++;
+    memset(dec->s1, 0, sizeof(dec->s1));
+    memset(dec->s2, 0, sizeof(dec->s2));
+    dec->sum = dec->sum2 = 0;
+    dec->n = 0;
+}
+
+//
+// ToneFeed
+// Samples at TONE_INPUT_RATE. The Goertzel filters of all the tones are
+// updated together, one lane each, a loop the compiler vectorizes.
+//
+void ToneFeed (TONE_DECODER *dec, const int16_t *samples, int n)
+{
+    for (int i = 0; i < n; i++)
+    {
+        dec->acc += samples[i];
+        if (++dec->acc_count < TONE_DECIMATE)
+            continue;
+        float x = dec->acc / TONE_DECIMATE;
+        dec->acc = 0;
+        dec->acc_count = 0;
+        dec->lp1 += (float)TONE_LOWPASS * (x - dec->lp1);
+        dec->lp2 += (float)TONE_LOWPASS * (dec->lp1 - dec->lp2);
+        x = dec->lp2;
+
+        for (int t = 0; t < TONE_LANES; t++)
+        {
+            float s0 = x + dec->coeff[t] * dec->s1[t] - dec->s2[t];
+            dec->s2[t] = dec->s1[t];
+            dec->s1[t] = s0;
+        }
+        dec->sum  += x;
+        dec->sum2 += (double)x * x;
+        if (++dec->n == ((dec->blocks == 0) ? TONE_FIRST_BLOCK : TONE_BLOCK))
+            CtcssBlock(dec);
+        DcsSample(dec, x);
+    }
+}
+
+//
+// ToneMatch
+// Does the audio since the reset carry the wanted tone or code. A CTCSS
+// tone is known after a block, a DCS code after two words; without them
+// the answer is a mismatch after two blocks (0.75 s). A decoded DCS code is
+// a mismatch for a CTCSS tone.
+//
+TONE_MATCH_RESULT ToneMatch (const TONE_DECODER *dec, const TONE *want)
+{
+    bool other = false;
+
+    switch (want->type)
+    {
+        case TONE_CTCSS:
+            // the lines of a repeated DCS word can pass for a tone
+            for (int s = 0; s < dec->dcs_max; s++)
+                if (dec->dcs_count[s] >= DCS_REPEAT)
+                    return TONE_MISMATCH;
+            if (dec->blocks == 0)
+                return TONE_PENDING;
+            if (dec->ctcss == want->ctcss)
+                return TONE_MATCH;
+            return (dec->ctcss >= 0 || dec->blocks >= 2) ? TONE_MISMATCH : TONE_PENDING;
+        case TONE_DCS:
+            for (int s = 0; s < dec->dcs_max; s++)
+            {
+                if (dec->dcs_count[s] < DCS_REPEAT)
+                    continue;
+                bool inverted = (dec->dcs_code[s] & DCS_INVERTED) != 0;
+                if ((dec->dcs_code[s] & 0x1FF) == want->dcs &&
+                    (want->polarity == 0 || (want->polarity < 0) == inverted))
+                    return TONE_MATCH;
+                other = true;
+            }
+            return ((other && dec->blocks >= 1) || dec->blocks >= 2) ? TONE_MISMATCH : TONE_PENDING;
+        default:
+            return TONE_MATCH;
+    }
+}
+
+//
+// ToneParse
+// A CTCSS tone in Hz (88.5) or a DCS code in octal (D023, D023N normal, D023I inverted)
+//
+bool ToneParse (const char *str, TONE *tone)
+{
+    char *end;
+
+    memset(tone, 0, sizeof(*tone));
+    if (toupper((unsigned char)str[0]) == 'D')
+    {
+        long code = strtol(str + 1, &end, 8);
+        if (end == str + 1 || code < 0 || code > 0777)
+            return false;
+        if (toupper((unsigned char)*end) == 'N')
+            tone->polarity = 1, end++;
+        else if (toupper((unsigned char)*end) == 'I')
+            tone->polarity = -1, end++;
+        if (*end != '\0')
+            return false;
+        tone->type = TONE_DCS;
+        tone->dcs  = (int)code;
+        return true;
+    }
+    double hz = strtod(str, &end);
+    if (end == str || *end != '\0')
+        return false;
+    for (int t = 0; t < CTCSS_TONES; t++)
+    {
+        if (fabs(g_ctcss_tones[t] - hz) < 0.2)
+        {
+            tone->type  = TONE_CTCSS;
+            tone->ctcss = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char *FormatTone (const TONE *tone, char *buf, size_t size)
+{
+    if (tone->type == TONE_CTCSS)
+        snprintf(buf, size, "%.1f", g_ctcss_tones[tone->ctcss]);
+    else if (tone->type == TONE_DCS)
+        snprintf(buf, size, "D%03o%s", tone->dcs, (tone->polarity > 0) ? "N" : (tone->polarity < 0) ? "I" : "");
+    else
+        snprintf(buf, size, "off");
+    return buf;
+}
+
+//
+// ToneParseRules
+// "key=tone,..." where the key is a frequency in Hz, a tag (partial and case
+// insensitive, as -t) or * for every frequency
+//
+bool ToneParseRules (const char *spec, TONE_RULES *rules)
+{
+    char  copy[TONE_RULES_MAX * (TONE_KEY_SIZE + 16)];
+    char *saveptr, *item;
+
+    rules->max = 0;
+    if (strlen(spec) >= sizeof(copy))
+        return false;
+    strcpy(copy, spec);
+    for (item = strtok_r(copy, ",", &saveptr); item != NULL; item = strtok_r(NULL, ",", &saveptr))
+    {
+        char *eq = strrchr(item, '=');
+        if (eq == NULL || eq == item || rules->max == TONE_RULES_MAX || (size_t)(eq - item) >= TONE_KEY_SIZE)
+            return false;
+        *eq = '\0';
+
+        TONE_RULE *rule = &rules->rule[rules->max];
+        if (!ToneParse(eq + 1, &rule->tone))
+            return false;
+        strcpy(rule->key, item);
+        rule->freq = (strspn(item, "0123456789") == strlen(item)) ? strtoull(item, NULL, 10) : 0;
+        rules->max++;
+    }
+    return rules->max > 0;
+}
+
+//
+// ToneRuleFor
+// The tone wanted on a frequency: a rule on the frequency first, then on
+// one of its tags, then *. NULL when any traffic is fine.
+//
+const TONE *ToneRuleFor (const TONE_RULES *rules, freq_t freq, freq_t tolerance, char **tags, int tag_max)
+{
+    const TONE *any = NULL;
+    const TONE *tagged = NULL;
+
+    for (int r = 0; r < rules->max; r++)
+    {
+        const TONE_RULE *rule = &rules->rule[r];
+        if (rule->freq != 0)
+        {
+            freq_t delta = (freq > rule->freq) ? freq - rule->freq : rule->freq - freq;
+            if (delta <= tolerance)
+                return &rule->tone;
+        }
+        else if (strcmp(rule->key, "*") == 0)
+        {
+            if (any == NULL)
+                any = &rule->tone;
+        }
+        else if (tagged == NULL)
+        {
+            for (int t = 0; t < tag_max; t++)
+            {
+                if (strcasestr(tags[t], rule->key) != NULL)
+                {
+                    tagged = &rule->tone;
+                    break;
+                }
+            }
+        }
+    }
+    return (tagged != NULL) ? tagged : any;
+}
@@ -0,0 +1,134 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_TONE_H_
+#define _GQRX_TONE_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stddef.h>
+#include "gqrx-prot.h"
+
+//
+// Sub-audible tone decoder
+//
+// The 48 kHz audio is averaged down to 4 kHz and low passed below ~300 Hz.
+// CTCSS: a bank of Goertzel filters, one lane per tone, run over blocks of
+// 0.5 s after a first block of 0.25 s; a tone is decoded when it holds most
+// of the sub-audible energy and dominates the other tones. The first block
+// has half the resolution: the tone it decodes is trusted only if it still
+// dominates its neighbours, which settles the common case of another tone
+// quickly and leaves close tones to the full blocks. DCS: the 134.4 bit/s NRZ stream is sliced and
+// clocked by a simple DPLL, the last 23 bits are checked as a Golay word with
+// the 100 flag after the 9 bit code, in both polarities.
+//
+#define CTCSS_TONES         50
+#define TONE_LANES          56      // CTCSS_TONES rounded up to 8 lanes
+#define TONE_INPUT_RATE     48000
+#define TONE_DECIMATE       12      // to 4 kHz
+#define TONE_RATE           (TONE_INPUT_RATE / TONE_DECIMATE)
+#define TONE_BLOCK          2000    // samples at TONE_RATE, 0.5 s: 2 Hz resolution
+#define TONE_FIRST_BLOCK    1000    // 0.25 s: 4 Hz resolution
+#define TONE_LOWPASS        0.376   // one pole coefficient, 300 Hz at TONE_RATE
+#define CTCSS_FRACTION      0.03    // of the sub-audible energy in the tone
+#define CTCSS_DOMINANCE     4.0     // power over the second best tone
+#define TONE_SILENCE        100.0   // mean square of a block without any tone
+#define DCS_BAUD            134.4
+#define DCS_SEEN            8       // different codes counted since the reset
+#define DCS_REPEAT          2       // words to decode a code
+#define DCS_PULL            0.25    // share of the phase error corrected on a bit transition
+#define DCS_DC              0.001   // slicer level tracking, 250 ms at TONE_RATE
+#define DCS_INVERTED        0x1000  // flag of the codes decoded inverted
+#define TONE_DECIDE         1200000 // us, the scanner waits at most for a decision
+#define TONE_POLL           20000
+#define TONE_RULES_MAX      32
+#define TONE_KEY_SIZE       64
+
+typedef enum
+{
+    TONE_OFF = 0,
+    TONE_CTCSS,
+    TONE_DCS
+} TONE_TYPE;
+
+typedef struct {
+    TONE_TYPE type;
+    int       ctcss;        // index in the tone table
+    int       dcs;          // 9 bit code, 023 octal for D023
+    int       polarity;     // DCS: 0 either, 1 normal, -1 inverted
+} TONE;
+
+typedef enum
+{
+    TONE_PENDING = 0,
+    TONE_MATCH,
+    TONE_MISMATCH
+} TONE_MATCH_RESULT;
+
+typedef struct {
+    // decimation and low pass
+    float    acc;
+    int      acc_count;
+    float    lp1, lp2;
+    // CTCSS Goertzel bank over the current block
+    float    coeff[TONE_LANES];
+    float    s1[TONE_LANES], s2[TONE_LANES];
+    double   sum, sum2;
+    int      n;
+    int      ctcss;         // tone of the last block, -1 none
+    int      blocks;        // complete blocks since the reset
+    // DCS
+    float    dc;
+    float    phase;
+    bool     sign;
+    uint32_t word;          // last 23 bits, the oldest in bit 0
+    int      dcs_code[DCS_SEEN];    // code, with DCS_INVERTED
+    int      dcs_count[DCS_SEEN];
+    int      dcs_max;
+} TONE_DECODER;
+
+typedef struct {
+    char   key[TONE_KEY_SIZE];  // tag, or "*" for any frequency
+    freq_t freq;                // or a frequency, 0 for a key
+    TONE   tone;
+} TONE_RULE;
+
+typedef struct {
+    TONE_RULE rule[TONE_RULES_MAX];
+    int       max;
+} TONE_RULES;
+
+extern const double g_ctcss_tones[CTCSS_TONES];
+
+void ToneInit(TONE_DECODER *dec);
+void ToneReset(TONE_DECODER *dec);
+void ToneFeed(TONE_DECODER *dec, const int16_t *samples, int n);
+TONE_MATCH_RESULT ToneMatch(const TONE_DECODER *dec, const TONE *want);
+uint32_t DcsWord(int code, bool inverted);
+
+bool ToneParse(const char *str, TONE *tone);
+const char *FormatTone(const TONE *tone, char *buf, size_t size);
+bool ToneParseRules(const char *spec, TONE_RULES *rules);
+const TONE *ToneRuleFor(const TONE_RULES *rules, freq_t freq, freq_t tolerance, char **tags, int tag_max);
+
+#endif /* _GQRX_TONE_H_ */
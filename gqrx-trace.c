@@ -0,0 +1,311 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include "gqrx-trace.h"
+
+// one trace for the engines of the process, their threads take the lock
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static FILE       *recording = NULL;
+static clock_us_t  last_sent;
+
+static const char *base = NULL;     // replayed trace
+static size_t      size;
+static size_t     *records = NULL;  // offsets of the records
+static freq_t     *freqs = NULL;    // frequency tuned when each record was made
+static size_t      n_records;
+static size_t      next;
+static double      speed;
+static freq_t      tuned;           // last F request, for the made up replies
+static char        last_level[BUFSIZE];
+static freq_t      last_level_freq;
+static char        last_squelch[BUFSIZE];
+static int         made_up_run;     // consecutive made up replies
+static TRACE_STATS stats;
+
+static void Close (void);
+
+//
+// TraceRecordOpen
+// Start a new trace, an existing file is replaced
+//
+bool TraceRecordOpen (const char *path)
+{
+    TRACE_HEADER header = { TRACE_MAGIC, TRACE_VERSION, (int64_t)time(NULL) };
+    bool ok = true;
+
+    pthread_mutex_lock(&lock);
+    recording = fopen(path, "wbe");
+    if (recording != NULL && fwrite(&header, sizeof(header), 1, recording) != 1)
+    {
+        fclose(recording);
+        recording = NULL;
+    }
+    if (recording == NULL)
+        ok = false;
+    else
+        last_sent = ClockNow();
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
+
+void TraceRecord (const char *request, const char *reply, clock_us_t sent, uint64_t rtt)
+{
+    pthread_mutex_lock(&lock);
+    if (recording == NULL)
+    {
+        pthread_mutex_unlock(&lock);
+        return;
+    }
+    TRACE_RECORD record;
+    record.delta   = (sent - last_sent > UINT32_MAX) ? UINT32_MAX : (uint32_t)(sent - last_sent);
+    record.rtt     = (rtt > UINT32_MAX) ? UINT32_MAX : (uint32_t)rtt;
+    record.request = (uint16_t)strlen(request);
+    record.reply   = (uint16_t)strlen(reply);
+    last_sent = sent;
+    fwrite(&record, sizeof(record), 1, recording);
+    fwrite(request, 1, record.request, recording);
+    fwrite(reply, 1, record.reply, recording);
+    pthread_mutex_unlock(&lock);
+}
+
+//
+// ReplayOpen
+// Index the records of a trace, up to a truncated tail
+//
+static bool ReplayOpen (const char *path, double replay_speed)
+{
+    struct stat st;
+    size_t allocated = 0;
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TRACE_HEADER))
+    {
+        close(fd);
+        return false;
+    }
+    size = st.st_size;
+    base = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED)
+    {
+        base = NULL;
+        return false;
+    }
+    const TRACE_HEADER *header = (const TRACE_HEADER *)base;
+    if (header->magic != TRACE_MAGIC || header->version != TRACE_VERSION)
+    {
+        Close();
+        return false;
+    }
+
+    n_records = 0;
+    freq_t freq = 0;
+    for (size_t pos = sizeof(TRACE_HEADER); pos + sizeof(TRACE_RECORD) <= size; )
+    {
+        TRACE_RECORD record;
+        memcpy(&record, base + pos, sizeof(record));
+        size_t end = pos + sizeof(record) + record.request + record.reply;
+        if (end > size || record.request >= BUFSIZE || record.reply >= BUFSIZE)
+            break;
+        if (n_records == allocated)
+        {
+            allocated = (allocated) ? allocated * 2 : 1024;
+            size_t *grown = realloc(records, allocated * sizeof(size_t));
+            freq_t *grown_freqs = realloc(freqs, allocated * sizeof(freq_t));
+            if (grown != NULL)
+                records = grown;
+            if (grown_freqs != NULL)
+                freqs = grown_freqs;
+            if (grown == NULL || grown_freqs == NULL)
+            {
+                Close();
+                return false;
+            }
+        }
+        char request[BUFSIZE];
+        memcpy(request, base + pos + sizeof(record), record.request);
+        request[record.request] = '\0';
+        sscanf(request, "F %llu", &freq);
+        freqs[n_records] = freq;
+        records[n_records++] = pos;
+        pos = end;
+    }
+    next  = 0;
+    speed = replay_speed;
+    tuned = 0;
+    made_up_run = 0;
+    last_level_freq = 0;
+    strcpy(last_level, "-100.0\n");
+    strcpy(last_squelch, "-50.0\n");
+    memset(&stats, 0, sizeof(stats));
+    return true;
+}
+
+bool TraceReplayOpen (const char *path, double replay_speed)
+{
+    pthread_mutex_lock(&lock);
+    bool ok = ReplayOpen(path, replay_speed);
+    pthread_mutex_unlock(&lock);
+    return ok;
+}
+
+static TRACE_RECORD Record (size_t i, const char **request, const char **reply)
+{
+    TRACE_RECORD record;
+    memcpy(&record, base + records[i], sizeof(record));
+    *request = base + records[i] + sizeof(record);
+    *reply   = *request + record.request;
+    return record;
+}
+
+//
+// MadeUp
+// Reply to a request that is not in the trace: the tuned frequency, the last
+// level served on the tuned frequency (for a while, then nothing is there),
+// the last squelch served, or an acknowledge
+//
+static void MadeUp (const char *request, char *reply)
+{
+    if (strcmp(request, "f\n") == 0)
+        sprintf(reply, "%llu\n", tuned);
+    else if (strcmp(request, "l\n") == 0)
+        strcpy(reply, (last_level_freq == tuned && made_up_run < TRACE_LOOKAHEAD) ? last_level : "-100.0\n");
+    else if (strcmp(request, "l SQL\n") == 0)
+        strcpy(reply, last_squelch);
+    else
+        strcpy(reply, "RPRT 0\n");
+}
+
+//
+// Replay
+// Serve the reply of a request from the trace, false if not replaying.
+// wait is the recorded round trip time at the replay speed.
+//
+static bool Replay (const char *request, char *reply, long *wait)
+{
+    *wait = 0;
+    if (base == NULL)
+        return false;
+
+    stats.commands++;
+    sscanf(request, "F %llu", &tuned);
+    for (size_t i = next; i < n_records && i < next + TRACE_LOOKAHEAD; i++)
+    {
+        const char *req, *rep;
+        TRACE_RECORD record = Record(i, &req, &rep);
+        if (freqs[i] != tuned || record.request != strlen(request) || memcmp(req, request, record.request) != 0)
+            continue;
+        memcpy(reply, rep, record.reply);
+        reply[record.reply] = '\0';
+        stats.skipped += i - next;
+        next = i + 1;
+        if (speed > 0)
+            *wait = (long)(record.rtt / speed);
+        // a frequency different from the one tuned would loop SetFreq forever
+        if (strcmp(request, "f\n") == 0 && strtoull(reply, NULL, 10) != tuned && tuned != 0)
+        {
+            sprintf(reply, "%llu\n", tuned);
+            stats.diverged++;
+        }
+        else
+            stats.served++;
+        made_up_run = 0;
+        if (strcmp(request, "l\n") == 0)
+        {
+            strcpy(last_level, reply);
+            last_level_freq = tuned;
+        }
+        else if (strcmp(request, "l SQL\n") == 0)
+            strcpy(last_squelch, reply);
+        return true;
+    }
+    MadeUp(request, reply);
+    made_up_run++;
+    stats.diverged++;
+    return true;
+}
+
+bool TraceReplay (const char *request, char *reply)
+{
+    long wait;
+
+    pthread_mutex_lock(&lock);
+    bool replayed = Replay(request, reply, &wait);
+    pthread_mutex_unlock(&lock);
+    if (wait > 0)
+        SleepFor(wait); // not under the lock, the other engines are served meanwhile
+    return replayed;
+}
+
+bool TraceReplayDone (void)
+{
+    pthread_mutex_lock(&lock);
+    bool done = base != NULL && (next >= n_records || made_up_run >= TRACE_LOST);
+    pthread_mutex_unlock(&lock);
+    return done;
+}
+
+void TraceStats (TRACE_STATS *out)
+{
+    pthread_mutex_lock(&lock);
+    *out = stats;
+    pthread_mutex_unlock(&lock);
+}
+
+static void Close (void)
+{
+    if (recording != NULL)
+    {
+        fclose(recording);
+        recording = NULL;
+    }
+    if (base != NULL)
+    {
+        munmap((void *)base, size);
+        base = NULL;
+    }
+    free(records);
+    free(freqs);
+    records = NULL;
+    freqs = NULL;
+    n_records = next = 0;
+}
+
+void TraceClose (void)
+{
+    pthread_mutex_lock(&lock);
+    Close();
+    pthread_mutex_unlock(&lock);
+}
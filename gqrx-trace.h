@@ -0,0 +1,80 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_TRACE_H_
+#define _GQRX_TRACE_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gqrx-prot.h"
+#include "gqrx-clock.h"
+
+//
+// Protocol trace
+//
+// Every command sent to gqrx, its reply and its timing, recorded to a file:
+//   header | record | request | reply | record | request | reply | ...
+// A truncated last record (crash while writing) is ignored by the reader.
+//
+// Replaying serves the recorded replies instead of the socket, waiting the
+// recorded round trip time divided by the speed (0: no wait). A request that
+// is not the next one recorded is looked for a few records ahead; if it is not
+// there (the scan loop changed) a plausible reply is made up and counted as a
+// divergence. The replay is over at the end of the trace, or after TRACE_LOST
+// replies in a row are made up.
+// The trace is one per process: the engines on other threads share it under a lock.
+//
+#define TRACE_MAGIC         0x52545147  // "GQTR"
+#define TRACE_VERSION       1
+#define TRACE_LOOKAHEAD     64
+#define TRACE_LOST          4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    int64_t  start;     // wall clock, seconds
+} TRACE_HEADER;
+
+typedef struct {
+    uint32_t delta;     // us since the previous request was sent
+    uint32_t rtt;       // us
+    uint16_t request;   // length of the request that follows
+    uint16_t reply;     // length of the reply that follows the request
+} TRACE_RECORD;
+
+typedef struct {
+    uint64_t commands;
+    uint64_t served;    // replies taken from the trace
+    uint64_t skipped;   // records passed over to find a request
+    uint64_t diverged;  // replies made up
+} TRACE_STATS;
+
+bool TraceRecordOpen(const char *path);
+bool TraceReplayOpen(const char *path, double speed);
+void TraceRecord(const char *request, const char *reply, clock_us_t sent, uint64_t rtt);
+bool TraceReplay(const char *request, char *reply);
+bool TraceReplayDone(void);
+void TraceStats(TRACE_STATS *stats);
+void TraceClose(void);
+
+#endif /* _GQRX_TRACE_H_ */
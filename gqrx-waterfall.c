@@ -0,0 +1,169 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include "gqrx-waterfall.h"
+
+static WF_ROW *Row (const WF_HEADER *header, uint64_t n)
+{
+    return (WF_ROW *)((char *)header + sizeof(WF_HEADER) + (n % header->rows) * header->row_size);
+}
+
+//
+// Begin
+// Take the next row of the ring, unpublished until WaterfallCommit
+//
+static void Begin (WATERFALL *wf)
+{
+    wf->row = Row(wf->header, wf->header->head);
+    __atomic_store_n(&wf->row->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (uint32_t b = 0; b < wf->header->bins; b++)
+        wf->row->level[b] = NAN;
+}
+
+//
+// WaterfallOpen
+// Map the ring, the rows of a previous session are kept if the bins are the same.
+// An empty file or a waterfall of another range is (re)initialised, any other
+// file is refused with errno EINVAL rather than overwritten.
+//
+bool WaterfallOpen (WATERFALL *wf, const char *path, freq_t freq_min, freq_t freq_max, freq_t interval, uint32_t rows)
+{
+    WF_HEADER   header = { .magic = WF_MAGIC, .version = WF_VERSION };
+    struct stat st;
+
+    memset(wf, 0, sizeof(*wf));
+    header.bins     = (uint32_t)((freq_max - freq_min) / interval + 1);
+    header.rows     = rows;
+    header.freq_min = freq_min;
+    header.interval = interval;
+    header.row_size = (sizeof(WF_ROW) + header.bins * sizeof(float) + 7) & ~7ULL;
+    wf->size = sizeof(WF_HEADER) + (size_t)rows * header.row_size;
+
+    wf->fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (wf->fd < 0)
+        return false;
+    if (fstat(wf->fd, &st) != 0)
+        goto fail;
+    if (st.st_size > 0)
+    {
+        uint32_t magic = 0;
+        if (pread(wf->fd, &magic, sizeof(magic), 0) != (ssize_t)sizeof(magic) || magic != WF_MAGIC)
+        {
+            errno = EINVAL; // not ours
+            goto fail;
+        }
+    }
+    if ((size_t)st.st_size != wf->size && ftruncate(wf->fd, 0) != 0)
+        goto fail;
+    if (ftruncate(wf->fd, wf->size) != 0)
+        goto fail;
+    wf->header = mmap(NULL, wf->size, PROT_READ | PROT_WRITE, MAP_SHARED, wf->fd, 0);
+    if (wf->header == MAP_FAILED)
+    {
+        wf->header = NULL;
+        goto fail;
+    }
+    WF_HEADER *old = wf->header;
+    if (old->magic != header.magic || old->version != header.version || old->bins != header.bins ||
+        old->rows != header.rows || old->freq_min != header.freq_min || old->interval != header.interval)
+    {
+        // another range or step, the old rows mean nothing
+        memset(wf->header, 0, wf->size);
+        *wf->header = header;
+    }
+    Begin(wf);
+    return true;
+
+fail:
+    {
+        int err = errno;
+        WaterfallClose(wf);
+        errno = err;
+    }
+    return false;
+}
+
+void WaterfallSet (WATERFALL *wf, freq_t freq, float level)
+{
+    if (wf->row == NULL || freq < wf->header->freq_min)
+        return;
+    uint64_t bin = (freq - wf->header->freq_min + wf->header->interval / 2) / wf->header->interval;
+    if (bin < wf->header->bins)
+        wf->row->level[bin] = level;
+}
+
+//
+// WaterfallCommit
+// Publish the row of the pass and start the next one
+//
+void WaterfallCommit (WATERFALL *wf)
+{
+    struct timespec ts;
+
+    if (wf->row == NULL)
+        return;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    wf->row->time = (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+    uint64_t head = wf->header->head;
+    __atomic_store_n(&wf->row->seq, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&wf->header->head, head + 1, __ATOMIC_RELEASE);
+    Begin(wf);
+}
+
+//
+// WaterfallRead
+// Copy row n (0 = the first ever written), false if not written yet or already reused
+//
+bool WaterfallRead (const WF_HEADER *header, uint64_t n, int64_t *time, float *levels)
+{
+    const WF_ROW *row = Row(header, n);
+
+    if (__atomic_load_n(&row->seq, __ATOMIC_ACQUIRE) != n + 1)
+        return false;
+    *time = row->time;
+    memcpy(levels, row->level, header->bins * sizeof(float));
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n(&row->seq, __ATOMIC_RELAXED) == n + 1;
+}
+
+void WaterfallClose (WATERFALL *wf)
+{
+    if (wf->header != NULL)
+        munmap(wf->header, wf->size);
+    if (wf->fd >= 0)
+        close(wf->fd);
+    memset(wf, 0, sizeof(*wf));
+    wf->fd = -1;
+}
@@ -0,0 +1,74 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#ifndef _GQRX_WATERFALL_H_
+#define _GQRX_WATERFALL_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "gqrx-prot.h"
+
+//
+// Waterfall ring
+//
+// The level of every bin of each sweep pass, in a file mapped by the scanner
+// and by any viewer: header | row | row | ... (rows of a fixed size, a ring).
+// A row is published by its seq, written last; a reader copies the row and
+// checks seq again, the copy is torn if the scanner has reused the row.
+//
+#define WF_MAGIC            0x46575147  // "GQWF"
+#define WF_VERSION          1
+#define WATERFALL_ROWS      1024
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t bins;          // levels per row
+    uint32_t rows;          // capacity of the ring
+    uint64_t freq_min;      // Hz, of bin 0
+    uint64_t interval;      // Hz between bins
+    uint64_t row_size;      // bytes, WF_ROW and the levels, padded to 8
+    uint64_t head;          // rows written, the newest is (head - 1) % rows
+    uint64_t reserved[2];
+} WF_HEADER;
+
+typedef struct {
+    uint64_t seq;           // row number + 1 when complete, 0 while written
+    int64_t  time;          // us since the epoch, end of the pass
+    float    level[];       // dBFS, NAN if the bin was not measured
+} WF_ROW;
+
+typedef struct {
+    int        fd;
+    WF_HEADER *header;
+    size_t     size;
+    WF_ROW    *row;         // being filled
+} WATERFALL;
+
+bool WaterfallOpen(WATERFALL *wf, const char *path, freq_t freq_min, freq_t freq_max, freq_t interval, uint32_t rows);
+void WaterfallSet(WATERFALL *wf, freq_t freq, float level);
+void WaterfallCommit(WATERFALL *wf);
+bool WaterfallRead(const WF_HEADER *header, uint64_t n, int64_t *time, float *levels);
+void WaterfallClose(WATERFALL *wf);
+
+#endif /* _GQRX_WATERFALL_H_ */
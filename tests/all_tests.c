@@ -29,38 +29,49 @@ SOFTWARE.
 #include <string.h>
 #include <stdbool.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <math.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <signal.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <stdatomic.h>
 
 #include "../gqrx-prot.h"
-
-/* FREQ type definition from gqrx-scan.c */
-typedef struct {
-    freq_t freq;
-    double noise_floor;
-    int count;
-    int miss;
-    char descr[BUFSIZE];
-    char *tags[TAG_MAX];
-    int tag_max;
-} FREQ;
+#include "../gqrx-scanner.h"
+#include "../gqrx-engine.h"
+#include "../gqrx-cache.h"
+#include "../gqrx-settle.h"
+#include "../gqrx-clock.h"
+#include "../gqrx-events.h"
+#include "../gqrx-hitlog.h"
+#include "../gqrx-occupancy.h"
+#include "../gqrx-survey.h"
+#include "../gqrx-waterfall.h"
+#include "../gqrx-publish.h"
+#include "../gqrx-hooks.h"
+#include "../gqrx-audio.h"
+#include "../gqrx-capture.h"
+#include "../gqrx-input.h"
+#include "../gqrx-control.h"
+#include "../gqrx-metrics.h"
+#include "../gqrx-spectrum.h"
+#include "../gqrx-trace.h"
+#include "../gqrx-profile.h"
 
 /* External declarations from gqrx-scan.c */
-extern FREQ* Frequencies;
-extern int Frequencies_Max;
-extern FREQ SavedFrequencies[SAVED_FREQ_MAX];
-extern int SavedFreq_Max;
-extern FREQ BannedFrequencies[SAVED_FREQ_MAX];
-extern int BannedFreq_Max;
-extern char *opt_tags[TAG_MAX];
-extern int opt_tag_max;
-
-extern bool LoadFrequencies(FILE *bookmarksfd);
-extern bool prefix(const char *pre, const char *str);
-extern char *print_freq(freq_t freq);
-extern bool ParseTags(char *tags);
-extern bool SaveFreq(freq_t freq_current);
-extern bool BanFreq(freq_t freq_current);
-extern bool IsBannedFreq(freq_t *freq_current);
-extern void ClearAllBans(void);
+extern ENGINE Engine;
+void ControlCommand(char *line, char *reply, size_t size);
+size_t FormatEventJson(const EVENT *event, unsigned long seq, char *buf, size_t size);
+
+/* Context of the scanner core tests */
+static SCANNER sc;
 
 /* ========================================================================
  * Utility Tests (from test_utils.c)
@@ -94,192 +105,384 @@ static void test_prefix_exact_match(void **state)
 }
 
 /* ========================================================================
- * File Operations Tests (from test_file_ops.c)
+ * File Operations Tests
  * ======================================================================== */
 
 static void test_load_frequencies_from_file(void **state)
 {
     (void) state;
     
-    /* Allocate memory for Frequencies array */
-    Frequencies = malloc(FREQ_MAX * sizeof(FREQ));
-    assert_non_null(Frequencies);
+    /* Allocate memory for the bookmarks */
+    ScannerInit(&sc);
+    sc.freqs = malloc(FREQ_MAX * sizeof(FREQ));
+    assert_non_null(sc.freqs);
     
     FILE *fp = fopen("tests/fixtures/test_bookmarks.csv", "r");
     assert_non_null(fp);
     
-    LoadFrequencies(fp);
+    LoadFrequencies(&sc, fp);
     fclose(fp);
     
-    assert_int_equal(Frequencies_Max, 6);
-    assert_int_equal(Frequencies[0].freq, 430037000);
-    assert_string_equal(Frequencies[0].descr, " Beigua                   ");
+    assert_int_equal(sc.freq_max, 6);
+    assert_int_equal(sc.freqs[0].freq, 430037000);
+    assert_string_equal(sc.freqs[0].descr, " Beigua                   ");
     
     /* Clean up */
-    for (int i = 0; i < Frequencies_Max; i++) {
-        for (int k = 0; k < Frequencies[i].tag_max; k++) {
-            free(Frequencies[i].tags[k]);
-        }
-    }
-    free(Frequencies);
+    ScannerFree(&sc);
 }
 
 static void test_load_frequencies_empty_file(void **state)
 {
     (void) state;
     
-    /* Allocate memory for Frequencies array */
-    Frequencies = malloc(FREQ_MAX * sizeof(FREQ));
-    assert_non_null(Frequencies);
+    /* Allocate memory for the bookmarks */
+    ScannerInit(&sc);
+    sc.freqs = malloc(FREQ_MAX * sizeof(FREQ));
+    assert_non_null(sc.freqs);
     
     FILE *fp = tmpfile();
     assert_non_null(fp);
     
-    Frequencies_Max = 0;
-    LoadFrequencies(fp);
+    sc.freq_max = 0;
+    LoadFrequencies(&sc, fp);
     fclose(fp);
     
-    assert_int_equal(Frequencies_Max, 0);
+    assert_int_equal(sc.freq_max, 0);
     
     /* Clean up */
-    free(Frequencies);
+    ScannerFree(&sc);
 }
 
 static void test_frequency_tags_parsing(void **state)
 {
     (void) state;
     
-    /* Allocate memory for Frequencies array */
-    Frequencies = malloc(FREQ_MAX * sizeof(FREQ));
-    assert_non_null(Frequencies);
+    /* Allocate memory for the bookmarks */
+    ScannerInit(&sc);
+    sc.freqs = malloc(FREQ_MAX * sizeof(FREQ));
+    assert_non_null(sc.freqs);
     
     FILE *fp = fopen("tests/fixtures/test_bookmarks.csv", "r");
     assert_non_null(fp);
     
-    LoadFrequencies(fp);
+    LoadFrequencies(&sc, fp);
     fclose(fp);
     
     /* Test first frequency (430037000) with tags "DMR, VHF" */
-    assert_int_equal(Frequencies[0].tag_max, 2);
-    assert_string_equal(Frequencies[0].tags[0], "DMR");
-    assert_string_equal(Frequencies[0].tags[1], "VHF");
+    assert_int_equal(sc.freqs[0].tag_max, 2);
+    assert_string_equal(sc.freqs[0].tags[0], "DMR");
+    assert_string_equal(sc.freqs[0].tags[1], "VHF");
     
     /* Test second frequency (430288000) with tag "DMR" */
-    assert_int_equal(Frequencies[1].tag_max, 1);
-    assert_string_equal(Frequencies[1].tags[0], "DMR");
+    assert_int_equal(sc.freqs[1].tag_max, 1);
+    assert_string_equal(sc.freqs[1].tags[0], "DMR");
     
     /* Test fourth frequency (430900000) with tags "DMR, Radio Links" */
-    assert_int_equal(Frequencies[3].tag_max, 2);
-    assert_string_equal(Frequencies[3].tags[0], "DMR");
-    assert_string_equal(Frequencies[3].tags[1], "Radio Links");
+    assert_int_equal(sc.freqs[3].tag_max, 2);
+    assert_string_equal(sc.freqs[3].tags[0], "DMR");
+    assert_string_equal(sc.freqs[3].tags[1], "Radio Links");
     
     /* Test fifth frequency (144500000) with tag "VHF" */
-    assert_int_equal(Frequencies[4].tag_max, 1);
-    assert_string_equal(Frequencies[4].tags[0], "VHF");
+    assert_int_equal(sc.freqs[4].tag_max, 1);
+    assert_string_equal(sc.freqs[4].tags[0], "VHF");
     
     /* Clean up */
-    for (int i = 0; i < Frequencies_Max; i++) {
-        for (int k = 0; k < Frequencies[i].tag_max; k++) {
-            free(Frequencies[i].tags[k]);
-        }
-    }
-    free(Frequencies);
+    ScannerFree(&sc);
 }
 
 static void test_frequency_field_parsing(void **state)
 {
     (void) state;
     
-    /* Allocate memory for Frequencies array */
-    Frequencies = malloc(FREQ_MAX * sizeof(FREQ));
-    assert_non_null(Frequencies);
+    /* Allocate memory for the bookmarks */
+    ScannerInit(&sc);
+    sc.freqs = malloc(FREQ_MAX * sizeof(FREQ));
+    assert_non_null(sc.freqs);
     
     FILE *fp = fopen("tests/fixtures/test_bookmarks.csv", "r");
     assert_non_null(fp);
     
-    LoadFrequencies(fp);
+    LoadFrequencies(&sc, fp);
     fclose(fp);
     
     /* Verify correct number of frequencies loaded */
-    assert_int_equal(Frequencies_Max, 6);
+    assert_int_equal(sc.freq_max, 6);
     
     /* Test all frequencies are parsed correctly */
-    assert_int_equal(Frequencies[0].freq, 430037000);
-    assert_int_equal(Frequencies[1].freq, 430288000);
-    assert_int_equal(Frequencies[2].freq, 430887000);
-    assert_int_equal(Frequencies[3].freq, 430900000);
-    assert_int_equal(Frequencies[4].freq, 144500000);
-    assert_int_equal(Frequencies[5].freq, 145000000);
+    assert_int_equal(sc.freqs[0].freq, 430037000);
+    assert_int_equal(sc.freqs[1].freq, 430288000);
+    assert_int_equal(sc.freqs[2].freq, 430887000);
+    assert_int_equal(sc.freqs[3].freq, 430900000);
+    assert_int_equal(sc.freqs[4].freq, 144500000);
+    assert_int_equal(sc.freqs[5].freq, 145000000);
     
     /* Verify frequencies are 64-bit values (freq_t is unsigned long long) */
-    assert_true(sizeof(Frequencies[0].freq) == sizeof(unsigned long long));
+    assert_true(sizeof(sc.freqs[0].freq) == sizeof(unsigned long long));
     
     /* Test edge case: verify frequencies with leading spaces are trimmed */
     /* All frequencies in our test file have leading spaces before the number */
-    assert_true(Frequencies[0].freq > 0);
-    assert_true(Frequencies[0].freq < 1000000000000ULL); /* reasonable range check */
+    assert_true(sc.freqs[0].freq > 0);
+    assert_true(sc.freqs[0].freq < 1000000000000ULL); /* reasonable range check */
     
     /* Clean up */
-    for (int i = 0; i < Frequencies_Max; i++) {
-        for (int k = 0; k < Frequencies[i].tag_max; k++) {
-            free(Frequencies[i].tags[k]);
-        }
-    }
-    free(Frequencies);
+    ScannerFree(&sc);
 }
 
 /* ========================================================================
- * Utility Function Tests (print_freq, ParseTags, etc.)
+ * Utility Function Tests (FormatFreq, ParseTags, etc.)
  * ======================================================================== */
 
-static void test_print_freq_ghz_range(void **state)
+/* A gqrx per engine: the protocol served from a simulated band, one emitter always on */
+typedef struct {
+    int      fd;
+    SPECTRUM sp;
+} FAKE_GQRX;
+
+static void *FakeGqrx(void *arg)
+{
+    FAKE_GQRX *rx = arg;
+    char    buf[BUFSIZE], reply[BUFSIZE], replies[BUFSIZE];
+    size_t  len = 0;
+    ssize_t n;
+
+    while ((n = read(rx->fd, buf + len, sizeof(buf) - 1 - len)) > 0)
+    {
+        char *line = buf, *end;
+        len += n;
+        replies[0] = '\0';
+        while ((end = memchr(line, '\n', buf + len - line)) != NULL)
+        {
+            *end = '\0';
+            SpectrumCommand(&rx->sp, line, reply, sizeof(reply), ClockNow());
+            strcat(replies, reply);
+            line = end + 1;
+        }
+        len -= line - buf;
+        memmove(buf, line, len);
+        if (replies[0] != '\0' && write(rx->fd, replies, strlen(replies)) < 0)
+            break;
+    }
+    return NULL;
+}
+
+/* What an engine saw, through its own hooks */
+typedef struct {
+    int    starts, ends;
+    freq_t freqs[8];
+    int    bookmarks[8];
+    clock_us_t deadline;
+} ENGINE_SEEN;
+
+static void SeenHit(ENGINE *en, const EVENT *event)
+{
+    ENGINE_SEEN *seen = en->user;
+
+    if (event->type == EVENT_HIT_START && seen->starts < 8)
+    {
+        seen->freqs[seen->starts] = event->freq;
+        seen->bookmarks[seen->starts++] = event->bookmark;
+    }
+    else if (event->type == EVENT_HIT_END && ++seen->ends == 2)
+        en->quit = 1;
+}
+
+static void SeenDispatch(ENGINE *en)
+{
+    ENGINE_SEEN *seen = en->user;
+
+    if (ClockNow() > seen->deadline)
+        en->quit = 1;
+}
+
+static void *ScanEngine(void *arg)
+{
+    ENGINE *en = arg;
+
+    if (en->sc.freq_max > 0)
+        ScanBookmarkedFrequenciesInRange(en);
+    else
+    {
+        /* as the front end does: the blind wait of a sweep step starts from the calibration */
+        SettleCalibrate(en->sockfd, &en->sc.settle, en->opt.min_freq, en->opt.max_freq, 3);
+        en->sc.sweep = en->sc.settle;
+        ScanFrequenciesInRange(en);
+    }
+    return NULL;
+}
+
+static void test_scanner_contexts_concurrent(void **state)
+{
+    (void) state;
+    ENGINE      *engines = calloc(2, sizeof(ENGINE));
+    FAKE_GQRX   *gqrx = calloc(2, sizeof(FAKE_GQRX));
+    ENGINE_SEEN  seen[2];
+    pthread_t    threads[2], servers[2];
+    int          sv[2];
+    const freq_t emitter[2] = { 145050000, 430288000 };
+
+    memset(seen, 0, sizeof(seen));
+    for (int e = 0; e < 2; e++)
+    {
+        SpectrumInit(&gqrx[e].sp);
+        gqrx[e].sp.noise_sigma = 0;
+        gqrx[e].sp.settle      = 1000;
+        SpectrumAddEmitter(&gqrx[e].sp, emitter[e], -30, 0, 0, 0);
+        SpectrumStart(&gqrx[e].sp, ClockNow());
+        assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+        gqrx[e].fd = sv[1];
+
+        EngineInit(&engines[e]);
+        engines[e].sockfd         = sv[0];
+        engines[e].user           = &seen[e];
+        engines[e].hooks.hit      = SeenHit;
+        engines[e].hooks.dispatch = SeenDispatch;
+        engines[e].opt.delay      = 50000;
+        engines[e].opt.speed      = 250000;
+        engines[e].opt.max_listen = 200000;
+        seen[e].deadline = ClockNow() + 20000000;
+    }
+    /* Engine 0 sweeps 145.0-145.1 MHz, engine 1 scans the bookmarks */
+    engines[0].opt.min_freq = 145000000;
+    engines[0].opt.max_freq = 145100000;
+    engines[0].opt.scan_bw  = 12500;
+    engines[0].sc.freqs     = calloc(9, sizeof(FREQ));
+    FILE *fp = fopen("tests/fixtures/test_bookmarks.csv", "r");
+    assert_non_null(fp);
+    engines[1].sc.freqs = calloc(FREQ_MAX, sizeof(FREQ));
+    LoadFrequencies(&engines[1].sc, fp);
+    fclose(fp);
+    engines[1].opt.scan_bw = 12500;
+
+    for (int e = 0; e < 2; e++)
+    {
+        assert_int_equal(pthread_create(&servers[e], NULL, FakeGqrx, &gqrx[e]), 0);
+        assert_int_equal(pthread_create(&threads[e], NULL, ScanEngine, &engines[e]), 0);
+    }
+    for (int e = 0; e < 2; e++)
+    {
+        pthread_join(threads[e], NULL);
+        shutdown(engines[e].sockfd, SHUT_RDWR);
+        pthread_join(servers[e], NULL);
+        close(engines[e].sockfd);
+        close(gqrx[e].fd);
+    }
+
+    /* Each engine listened to its own emitter, with its own state */
+    for (int e = 0; e < 2; e++)
+    {
+        assert_int_equal(seen[e].ends, 2);
+        for (int h = 0; h < seen[e].starts; h++)
+            assert_true(seen[e].freqs[h] + 10000 > emitter[e] && seen[e].freqs[h] < emitter[e] + 10000);
+        assert_true(engines[e].freq + 1000000 > emitter[e] && engines[e].freq < emitter[e] + 1000000);
+        assert_true(gqrx[e].sp.stats.tunes > 0);
+    }
+    assert_int_equal(seen[0].bookmarks[0], -1);
+    assert_int_equal(engines[0].sc.saved_max, 1);
+    assert_int_equal(seen[1].bookmarks[0], 1);
+    assert_int_equal(seen[1].freqs[0], emitter[1]);
+    for (int e = 0; e < 2; e++)
+        EngineFree(&engines[e]);
+    free(engines);
+    free(gqrx);
+}
+
+static void test_cfar_thresholds(void **state)
+{
+    (void) state;
+    CFAR cfar;
+    double open, close;
+
+    assert_true(CfarInit(&cfar, 12, CFAR_TRAIN, CFAR_FACTOR, CFAR_HYSTERESIS));
+
+    /* Nothing learned yet: the squelch decides */
+    assert_false(CfarThreshold(&cfar, 5, &open, &close));
+    assert_true(CfarDetect(&cfar, 5, -45.0, -50.0));
+    assert_false(CfarDetect(&cfar, 5, -55.0, -50.0));
+
+    /* Quiet band at -80 dB, bin 8 has a local noise floor at -60 dB */
+    for (int pass = 0; pass < 20; pass++)
+        for (int b = 0; b < 12; b++)
+            assert_false(CfarDetect(&cfar, b, (b == 8) ? -60.0 + (pass % 2) : -80.0 + (pass % 2), -30.0));
+    assert_true(CfarThreshold(&cfar, 3, &open, &close));
+    assert_true(open > -77.0 && open < -70.0);
+    assert_true(fabs(open - close - CFAR_HYSTERESIS) < 1e-9);
+    /* The noisy bin keeps its own reference, its neighbours are not raised by it */
+    assert_true(CfarThreshold(&cfar, 8, &open, &close));
+    assert_true(open > -57.0);
+    assert_false(CfarDetect(&cfar, 8, -58.0, -90.0));
+    assert_true(CfarThreshold(&cfar, 7, &open, &close));
+    assert_true(open < -70.0);
+
+    /* A weak signal below the squelch opens a quiet bin, the hysteresis keeps it open */
+    assert_true(CfarThreshold(&cfar, 3, &open, &close));
+    assert_true(CfarDetect(&cfar, 3, open + 0.5, -30.0));
+    assert_true(CfarDetect(&cfar, 3, close + 0.5, -30.0));
+    assert_false(CfarDetect(&cfar, 3, close - 0.5, -30.0));
+    assert_false(CfarDetect(&cfar, 3, open - 0.5, -30.0));
+
+    /* Bookmarks: the own noise only */
+    CfarFree(&cfar);
+    assert_true(CfarInit(&cfar, 2, 0, CFAR_FACTOR, CFAR_HYSTERESIS));
+    for (int pass = 0; pass < CFAR_WARMUP; pass++)
+        CfarUpdate(&cfar, 0, -70.0);
+    assert_true(CfarThreshold(&cfar, 0, &open, &close));
+    assert_true(fabs(open - (-70.0 + CFAR_MARGIN)) < 1e-6);
+    assert_false(CfarThreshold(&cfar, 1, &open, &close));
+    CfarFree(&cfar);
+}
+
+static void test_format_freq_ghz_range(void **state)
 {
     (void) state;
     
     /* Test GHz range formatting */
     freq_t freq = 1234567890000ULL; /* 1234.567.890 GHz */
-    char *result = print_freq(freq);
+    char buf[FREQ_STRING_SIZE];
+    char *result = FormatFreq(freq, buf, sizeof(buf));
     
     assert_non_null(result);
     assert_string_equal(result, "1234.567.890 GHz");
 }
 
-static void test_print_freq_mhz_range(void **state)
+static void test_format_freq_mhz_range(void **state)
 {
     (void) state;
     
     /* Test MHz range formatting */
     freq_t freq = 145000000; /* 145.000 MHz */
-    char *result = print_freq(freq);
+    char buf[FREQ_STRING_SIZE];
+    char *result = FormatFreq(freq, buf, sizeof(buf));
     
     assert_non_null(result);
     assert_string_equal(result, "145.000 MHz");
     
     /* Test another MHz value */
     freq = 430037000; /* 430.037 MHz */
-    result = print_freq(freq);
+    result = FormatFreq(freq, buf, sizeof(buf));
     assert_string_equal(result, "430.037 MHz");
 }
 
-static void test_print_freq_khz_range(void **state)
+static void test_format_freq_khz_range(void **state)
 {
     (void) state;
     
     /* Test KHz range formatting */
     freq_t freq = 10000; /* 10 KHz */
-    char *result = print_freq(freq);
+    char buf[FREQ_STRING_SIZE];
+    char *result = FormatFreq(freq, buf, sizeof(buf));
     
     assert_non_null(result);
     assert_string_equal(result, "10 KHz");
 }
 
-static void test_print_freq_rounding(void **state)
+static void test_format_freq_rounding(void **state)
 {
     (void) state;
     
     /* Test rounding to nearest KHz */
     freq_t freq = 145000500; /* Should round to 145.001 MHz */
-    char *result = print_freq(freq);
+    char buf[FREQ_STRING_SIZE];
+    char *result = FormatFreq(freq, buf, sizeof(buf));
     
     assert_non_null(result);
     assert_string_equal(result, "145.001 MHz");
@@ -289,81 +492,81 @@ static void test_parse_tags_single(void **state)
 {
     (void) state;
     
-    /* Reset opt_tags */
-    for (int i = 0; i < opt_tag_max; i++) {
-        if (opt_tags[i]) {
-            free(opt_tags[i]);
-            opt_tags[i] = NULL;
+    /* Reset sc.tags */
+    for (int i = 0; i < sc.tag_max; i++) {
+        if (sc.tags[i]) {
+            free(sc.tags[i]);
+            sc.tags[i] = NULL;
         }
     }
-    opt_tag_max = 0;
+    sc.tag_max = 0;
     
     /* Test single tag */
     char tags[] = "VHF";
-    bool result = ParseTags(tags);
+    bool result = ParseTags(&sc, tags);
     
     assert_true(result);
-    assert_int_equal(opt_tag_max, 1);
-    assert_string_equal(opt_tags[0], "VHF");
+    assert_int_equal(sc.tag_max, 1);
+    assert_string_equal(sc.tags[0], "VHF");
     
     /* Clean up */
-    for (int i = 0; i < opt_tag_max; i++) {
-        free(opt_tags[i]);
-        opt_tags[i] = NULL;
+    for (int i = 0; i < sc.tag_max; i++) {
+        free(sc.tags[i]);
+        sc.tags[i] = NULL;
     }
-    opt_tag_max = 0;
+    sc.tag_max = 0;
 }
 
 static void test_parse_tags_multiple(void **state)
 {
     (void) state;
     
-    /* Reset opt_tags */
-    for (int i = 0; i < opt_tag_max; i++) {
-        if (opt_tags[i]) {
-            free(opt_tags[i]);
-            opt_tags[i] = NULL;
+    /* Reset sc.tags */
+    for (int i = 0; i < sc.tag_max; i++) {
+        if (sc.tags[i]) {
+            free(sc.tags[i]);
+            sc.tags[i] = NULL;
         }
     }
-    opt_tag_max = 0;
+    sc.tag_max = 0;
     
     /* Test multiple tags */
     char tags[] = "DMR|VHF|UHF";
-    bool result = ParseTags(tags);
+    bool result = ParseTags(&sc, tags);
     
     assert_true(result);
-    assert_int_equal(opt_tag_max, 3);
-    assert_string_equal(opt_tags[0], "DMR");
-    assert_string_equal(opt_tags[1], "VHF");
-    assert_string_equal(opt_tags[2], "UHF");
+    assert_int_equal(sc.tag_max, 3);
+    assert_string_equal(sc.tags[0], "DMR");
+    assert_string_equal(sc.tags[1], "VHF");
+    assert_string_equal(sc.tags[2], "UHF");
     
     /* Clean up */
-    for (int i = 0; i < opt_tag_max; i++) {
-        free(opt_tags[i]);
-        opt_tags[i] = NULL;
+    for (int i = 0; i < sc.tag_max; i++) {
+        free(sc.tags[i]);
+        sc.tags[i] = NULL;
     }
-    opt_tag_max = 0;
+    sc.tag_max = 0;
 }
 
 static void test_parse_tags_empty(void **state)
 {
     (void) state;
     
-    /* Reset opt_tags */
-    for (int i = 0; i < opt_tag_max; i++) {
-        if (opt_tags[i]) {
-            free(opt_tags[i]);
-            opt_tags[i] = NULL;
+    /* Reset sc.tags */
+    for (int i = 0; i < sc.tag_max; i++) {
+        if (sc.tags[i]) {
+            free(sc.tags[i]);
+            sc.tags[i] = NULL;
         }
     }
-    opt_tag_max = 0;
+    sc.tag_max = 0;
     
     /* Test empty string (should fail) */
     char tags[] = "";
-    bool result = ParseTags(tags);
+    bool result = ParseTags(&sc, tags);
     
     assert_false(result);
-    assert_int_equal(opt_tag_max, 0);
+    assert_int_equal(sc.tag_max, 0);
 }
 
 static void test_save_freq_new(void **state)
@@ -371,18 +574,18 @@ static void test_save_freq_new(void **state)
     (void) state;
     
     /* Reset saved frequencies */
-    SavedFreq_Max = 0;
-    memset(SavedFrequencies, 0, sizeof(SavedFrequencies));
+    sc.saved_max = 0;
+    memset(sc.saved, 0, sizeof(sc.saved));
     
     /* Save a new frequency */
     freq_t freq = 145000000;
-    bool result = SaveFreq(freq);
+    bool result = SaveFreq(&sc, freq);
     
     assert_true(result);
-    assert_int_equal(SavedFreq_Max, 1);
-    assert_int_equal(SavedFrequencies[0].freq, freq);
-    assert_int_equal(SavedFrequencies[0].count, 1);
-    assert_int_equal(SavedFrequencies[0].miss, 0);
+    assert_int_equal(sc.saved_max, 1);
+    assert_int_equal(sc.saved[0].freq, freq);
+    assert_int_equal(sc.saved[0].count, 1);
+    assert_int_equal(sc.saved[0].miss, 0);
 }
 
 static void test_save_freq_duplicate_within_tolerance(void **state)
@@ -390,20 +593,20 @@ static void test_save_freq_duplicate_within_tolerance(void **state)
     (void) state;
     
     /* Reset saved frequencies */
-    SavedFreq_Max = 0;
-    memset(SavedFrequencies, 0, sizeof(SavedFrequencies));
+    sc.saved_max = 0;
+    memset(sc.saved, 0, sizeof(sc.saved));
     
     /* Save initial frequency */
     freq_t freq1 = 145000000;
-    SaveFreq(freq1);
+    SaveFreq(&sc, freq1);
     
     /* Save frequency within tolerance (±5000 Hz) */
     freq_t freq2 = 145003000; /* 3 KHz away, within 5 KHz tolerance */
-    SaveFreq(freq2);
+    SaveFreq(&sc, freq2);
     
     /* Should still have only 1 entry, with updated count */
-    assert_int_equal(SavedFreq_Max, 1);
-    assert_int_equal(SavedFrequencies[0].count, 2);
+    assert_int_equal(sc.saved_max, 1);
+    assert_int_equal(sc.saved[0].count, 2);
 }
 
 static void test_save_freq_lower_within_tolerance(void **state)
@@ -411,21 +614,21 @@ static void test_save_freq_lower_within_tolerance(void **state)
     (void) state;
     
     /* Reset saved frequencies */
-    SavedFreq_Max = 0;
-    memset(SavedFrequencies, 0, sizeof(SavedFrequencies));
+    sc.saved_max = 0;
+    memset(sc.saved, 0, sizeof(sc.saved));
     
     /* Save initial HIGHER frequency */
     freq_t freq1 = 145003000;
-    SaveFreq(freq1);
+    SaveFreq(&sc, freq1);
     
     /* Save LOWER frequency within tolerance (this tests the negative delta bug) */
     freq_t freq2 = 145000000; /* 3 KHz lower, within 5 KHz tolerance */
-    SaveFreq(freq2);
+    SaveFreq(&sc, freq2);
     
     /* Should still have only 1 entry, with updated count */
     /* This will FAIL with the current buggy code due to unsigned underflow */
-    assert_int_equal(SavedFreq_Max, 1);
-    assert_int_equal(SavedFrequencies[0].count, 2);
+    assert_int_equal(sc.saved_max, 1);
+    assert_int_equal(sc.saved[0].count, 2);
 }
 
 static void test_ban_freq(void **state)
@@ -433,16 +636,16 @@ static void test_ban_freq(void **state)
     (void) state;
     
     /* Reset banned frequencies */
-    BannedFreq_Max = 0;
-    memset(BannedFrequencies, 0, sizeof(BannedFrequencies));
+    sc.banned_max = 0;
+    memset(sc.banned, 0, sizeof(sc.banned));
     
     /* Ban a frequency */
     freq_t freq = 145000000;
-    bool result = BanFreq(freq);
+    bool result = BanFreq(&sc, freq);
     
     assert_true(result);
-    assert_int_equal(BannedFreq_Max, 1);
-    assert_int_equal(BannedFrequencies[0].freq, freq);
+    assert_int_equal(sc.banned_max, 1);
+    assert_int_equal(sc.banned[0].freq, freq);
 }
 
 static void test_is_banned_freq(void **state)
@@ -450,16 +653,16 @@ static void test_is_banned_freq(void **state)
     (void) state;
     
     /* Reset banned frequencies */
-    BannedFreq_Max = 0;
-    memset(BannedFrequencies, 0, sizeof(BannedFrequencies));
+    sc.banned_max = 0;
+    memset(sc.banned, 0, sizeof(sc.banned));
     
     /* Ban a frequency */
     freq_t banned = 145000000;
-    BanFreq(banned);
+    BanFreq(&sc, banned);
     
     /* Test if banned frequency is detected */
     freq_t test_freq = 145000000;
-    bool result = IsBannedFreq(&test_freq);
+    bool result = IsBannedFreq(&sc, &test_freq);
     
     assert_true(result);
     /* Frequency should be adjusted past the banned range */
@@ -471,18 +674,1281 @@ static void test_clear_all_bans(void **state)
     (void) state;
     
     /* Reset and add some banned frequencies */
-    BannedFreq_Max = 0;
-    memset(BannedFrequencies, 0, sizeof(BannedFrequencies));
+    sc.banned_max = 0;
+    memset(sc.banned, 0, sizeof(sc.banned));
     
-    BanFreq(145000000);
-    BanFreq(430000000);
+    BanFreq(&sc, 145000000);
+    BanFreq(&sc, 430000000);
     
-    assert_int_equal(BannedFreq_Max, 2);
+    assert_int_equal(sc.banned_max, 2);
     
     /* Clear all bans */
-    ClearAllBans();
+    ClearAllBans(&sc);
     
-    assert_int_equal(BannedFreq_Max, 0);
+    assert_int_equal(sc.banned_max, 0);
+}
+
+static void test_jump_bucket(void **state)
+{
+    (void) state;
+
+    /* Retunes are classified in decades of distance, both directions */
+    assert_int_equal(JumpBucket(145000000, 145012500), 0);
+    assert_int_equal(JumpBucket(145012500, 145000000), 0);
+    assert_int_equal(JumpBucket(145000000, 145500000), 1);
+    assert_int_equal(JumpBucket(145000000, 150000000), 2);
+    assert_int_equal(JumpBucket(145000000, 200000000), 3);
+    assert_int_equal(JumpBucket(145000000, 430000000), 4);
+}
+
+static void test_settle_model_fallback(void **state)
+{
+    (void) state;
+    SETTLE_MODEL model;
+    SettleModelInit(&model);
+
+    /* Nothing learned: the old fixed waits */
+    assert_int_equal(SettlePredict(&model, 145000000, 145010000, false), 10000);
+    assert_int_equal(SettlePredict(&model, 145000000, 146000000, false), 85000);
+    assert_int_equal(SettlePredict(&model, 145000000, 145010000, true), 500000);
+}
+
+static void test_settle_model_learn_and_fit(void **state)
+{
+    (void) state;
+    SETTLE_MODEL model;
+    SettleModelInit(&model);
+
+    /* First sample is taken as is, then averaged */
+    SettleUpdate(&model, 145000000, 145010000, false, 20000);
+    assert_int_equal(SettlePredict(&model, 145000000, 145010000, false), 20000);
+    SettleUpdate(&model, 145000000, 145010000, false, 40000);
+    assert_int_equal(SettlePredict(&model, 145000000, 145010000, false), 25000);
+
+    /* Only one jump learned in the band: used for the other jumps */
+    assert_int_equal(SettlePredict(&model, 145000000, 145500000, false), 25000);
+
+    /* Two jumps learned: the others are fitted on the jump decade */
+    SettleUpdate(&model, 145000000, 145500000, false, 45000);
+    assert_int_equal(SettlePredict(&model, 145000000, 150000000, false), 65000);
+
+    /* Other bands are not affected */
+    assert_int_equal(SettlePredict(&model, 430000000, 430010000, false), 10000);
+
+    /* Feedback adjusts the learned value */
+    SettleFeedback(&model, 145000000, 145010000, false, 5000);
+    assert_int_equal(SettlePredict(&model, 145000000, 145010000, false), 30000);
+}
+
+static void test_settle_wait_and_calibrate(void **state)
+{
+    (void) state;
+    FAKE_GQRX    rx;
+    SETTLE_MODEL model;
+    pthread_t    server;
+    int          sv[2];
+    double       squelch;
+    long         measured;
+
+    SpectrumInit(&rx.sp);
+    rx.sp.noise_sigma = 0;
+    rx.sp.settle      = 2000;
+    SpectrumStart(&rx.sp, ClockNow());
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    rx.fd = sv[1];
+    assert_int_equal(pthread_create(&server, NULL, FakeGqrx, &rx), 0);
+    SettleModelInit(&model);
+
+    /* Both the quiet and the active receiver are calibrated, the squelch is put back */
+    assert_true(SettleCalibrate(sv[0], &model, 145000000, 146000000, 1));
+    for (int a = 0; a < 2; a++)
+    {
+        assert_true(model.cell[a][SettleBand(145000000)][0].samples > 0);
+        assert_true(model.cell[a][SettleBand(145000000)][1].samples > 0);
+        assert_int_equal(model.cell[a][SettleBand(145000000)][2].samples, 0);
+    }
+    assert_true(GetSquelchLevel(sv[0], &squelch));
+    assert_true(squelch == rx.sp.squelch);
+
+    /* The first poll is at half the prediction, a shorter settle time is learned */
+    SettleModelInit(&model);
+    SetFreq(sv[0], 145012500);
+    clock_us_t start = ClockNow();
+    assert_true(SettleWait(sv[0], &model, 145000000, 145012500, false, 0, 1000000, &measured));
+    assert_true(measured >= 5000 && measured < 10000);
+    assert_true(ClockNow() - start < 60000);
+    assert_true(SettlePredict(&model, 145000000, 145012500, false) < 10000);
+
+    /* A level that never settles is given up at twice the prediction, not at max_wait */
+    SettleModelInit(&model);
+    rx.sp.noise_sigma = 10;
+    SetFreq(sv[0], 145025000);
+    start = ClockNow();
+    assert_false(SettleWait(sv[0], &model, 145012500, 145025000, false, 0, 1000000, &measured));
+    assert_true(ClockNow() - start < 100000);
+    assert_int_equal(SettlePredict(&model, 145012500, 145025000, false), 10000);
+
+    shutdown(sv[0], SHUT_RDWR);
+    pthread_join(server, NULL);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_bookmark_dwell_learned(void **state)
+{
+    (void) state;
+    FAKE_GQRX rx;
+    ENGINE   *en = calloc(1, sizeof(ENGINE));
+    pthread_t server;
+    int       sv[2];
+    long      settle = 0, measured;
+
+    SpectrumInit(&rx.sp);
+    rx.sp.noise_sigma = 0;
+    rx.sp.settle      = 2000;
+    SpectrumStart(&rx.sp, ClockNow());
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    rx.fd = sv[1];
+    assert_int_equal(pthread_create(&server, NULL, FakeGqrx, &rx), 0);
+    EngineInit(en);
+    en->sockfd = sv[0];
+
+    /* Nothing learned for the bookmark: the model predicts 10 ms, the first poll is at 5 ms */
+    SetFreq(sv[0], 430037000);
+    assert_true(Dwell(en, &settle, 430000000, 430037000, false, 1000000, &measured));
+    assert_true(measured >= 5000 && measured < 10000);
+    assert_int_equal(settle, measured);
+
+    /* A bookmark known to be slow is first polled at half its own time */
+    settle = 200000;
+    SetFreq(sv[0], 430288000);
+    assert_true(Dwell(en, &settle, 430037000, 430288000, false, 1000000, &measured));
+    assert_true(measured >= 100000 && measured < 150000);
+    assert_true(settle < 200000);
+
+    /* and a level that does not settle is given up at twice it, not at the upper bound */
+    settle = 20000;
+    rx.sp.noise_sigma = 10;
+    SetFreq(sv[0], 430037000);
+    clock_us_t start = ClockNow();
+    assert_false(Dwell(en, &settle, 430288000, 430037000, false, 1000000, &measured));
+    assert_true(ClockNow() - start < 120000);
+    assert_int_equal(settle, 20000);
+
+    shutdown(sv[0], SHUT_RDWR);
+    pthread_join(server, NULL);
+    close(sv[0]);
+    close(sv[1]);
+    EngineFree(en);
+    free(en);
+}
+
+static void test_clock_ticker_schedule(void **state)
+{
+    (void) state;
+    TICKER ticker;
+
+    clock_us_t start = ClockNow();
+    SleepUntil(start + 5000);
+    assert_true(ClockNow() >= start + 5000);
+
+    /* Ticks stay on the schedule even if the loop body takes time */
+    TickerStart(&ticker, 10000);
+    start = ClockNow();
+    for (int i = 0; i < 5; i++)
+    {
+        SleepFor(3000);
+        TickerWait(&ticker);
+    }
+    clock_us_t elapsed = ClockNow() - start;
+    assert_true(elapsed >= 50000);
+    assert_true(elapsed < 65000);
+}
+
+static int events_handled = 0;
+static bool events_in_order = true;
+
+/* Runs in the events thread: only record, assertions are done by the test */
+static void count_event(const EVENT *event)
+{
+    if (event->freq != (freq_t)(145000000 + events_handled))
+        events_in_order = false;
+    events_handled++;
+}
+
+static void test_events_ring_drops_when_full(void **state)
+{
+    (void) state;
+    EVENT event = { .type = EVENT_HIT_START };
+
+    /* Without the consumer the ring fills up and the excess is dropped */
+    for (int i = 0; i < EVENTS_RING_SIZE + 5; i++)
+    {
+        event.freq = 145000000 + i;
+        EventPush(&event);
+    }
+    assert_int_equal(EventsDropped(), 5);
+
+    /* The consumer delivers the queued events in order */
+    events_handled = 0;
+    assert_true(EventsStart(count_event, NULL));
+    EventsStop();
+    assert_int_equal(events_handled, EVENTS_RING_SIZE);
+    assert_true(events_in_order);
+}
+
+static void test_input_headless_wait_and_wake(void **state)
+{
+    (void) state;
+
+    /* Headless: no keyboard, waits time out or are woken up */
+    assert_true(InputStart(true));
+    assert_int_equal(InputPoll(), INPUT_NONE);
+
+    clock_us_t start = ClockNow();
+    assert_int_equal(InputWait(20000), INPUT_NONE);
+    assert_true(ClockNow() - start >= 19000);
+    /* the end of a delay, under the millisecond, still blocks */
+    start = ClockNow();
+    assert_int_equal(InputWait(300), INPUT_NONE);
+    assert_true(ClockNow() - start >= 300);
+
+    InputWake();
+    start = ClockNow();
+    assert_int_equal(InputWait(INPUT_FOREVER), INPUT_NONE);
+    assert_true(ClockNow() - start < 10000);
+    InputStop();
+}
+
+static void test_control_commands(void **state)
+{
+    (void) state;
+    char line[CONTROL_LINE];
+    char reply[CONTROL_REPLY];
+
+    strcpy(line, "range 431000000 430000000");
+    ControlCommand(line, reply, sizeof(reply));
+    assert_string_equal(reply, "ERR range <min> <max>: invalid range");
+    assert_false(Engine.restart);
+
+    /* A new range restarts the scan loop */
+    strcpy(line, "range 430000000 431000000");
+    ControlCommand(line, reply, sizeof(reply));
+    assert_string_equal(reply, "OK");
+    assert_true(Engine.restart);
+    Engine.restart = false;
+
+    strcpy(line, "state");
+    ControlCommand(line, reply, sizeof(reply));
+    assert_non_null(strstr(reply, "\"min\":430000000,\"max\":431000000"));
+
+    strcpy(line, "bogus arg");
+    ControlCommand(line, reply, sizeof(reply));
+    assert_string_equal(reply, "ERR unknown command bogus");
+}
+
+static void test_metrics_format(void **state)
+{
+    (void) state;
+    char buf[16384];
+
+    MetricAdd(METRIC_HITS, 2);
+    MetricAdd(METRIC_CONNECTS, 3);
+    MetricSet(METRIC_PASS_DURATION, 1500000);
+    MetricRtt(CMD_GET_LEVEL, 800);
+    MetricRtt(CMD_GET_LEVEL, 30000);
+
+    size_t len = MetricsFormat(buf, sizeof(buf));
+    assert_int_equal(len, strlen(buf));
+    assert_non_null(strstr(buf, "\ngqrx_scanner_hits_total 2\n"));
+    assert_non_null(strstr(buf, "\ngqrx_scanner_reconnects_total 2\n"));
+    assert_non_null(strstr(buf, "\ngqrx_scanner_pass_duration_seconds 1.500000\n"));
+    /* Buckets are cumulative */
+    assert_non_null(strstr(buf, "{command=\"l\",le=\"0.0005\"} 0\n"));
+    assert_non_null(strstr(buf, "{command=\"l\",le=\"0.001\"} 1\n"));
+    assert_non_null(strstr(buf, "{command=\"l\",le=\"0.05\"} 2\n"));
+    assert_non_null(strstr(buf, "gqrx_scanner_command_rtt_seconds_count{command=\"l\"} 2\n"));
+
+    /* A short buffer is truncated, not overrun */
+    assert_int_equal(MetricsFormat(buf, 64), 63);
+}
+
+static void test_spectrum_scoring(void **state)
+{
+    (void) state;
+    SPECTRUM sp;
+    char reply[BUFSIZE];
+
+    SpectrumInit(&sp);
+    sp.noise_sigma = 0;
+    sp.settle      = 10000;
+    sp.freq        = 144000000;
+    SpectrumAddEmitter(&sp, 145000000, -30, 0, 0, 0);       /* always on */
+    SpectrumAddEmitter(&sp, 146000000, -30, 1000, 1000, 0); /* never visited */
+    SpectrumStart(&sp, 1000000);
+
+    /* The level settles from the noise floor to the emitter */
+    SpectrumTune(&sp, 145000000, 1500000);
+    double settling = SpectrumLevel(&sp, 1505000);
+    assert_true(settling > -75 && settling < -40);
+    assert_true(SpectrumLevel(&sp, 1600000) > -30.1);
+
+    /* A stay of hit_time on the channel is a detection */
+    SpectrumAdvance(&sp, 2600000);
+    assert_int_equal(sp.stats.detected, 1);
+    assert_int_equal(sp.stats.detect_max, 500000);
+
+    /* On a quiet frequency it is a false detection */
+    SpectrumTune(&sp, 144500000, 2700000);
+    SpectrumAdvance(&sp, 3800000);
+    assert_int_equal(sp.stats.false_hits, 1);
+
+    /* Coming back is a revisit, the burst is not detected twice */
+    SpectrumTune(&sp, 145002000, 4000000);
+    SpectrumAdvance(&sp, 5100000);
+    assert_int_equal(sp.stats.revisits, 1);
+    assert_int_equal(sp.stats.revisit_max, 2500000);
+    assert_int_equal(sp.stats.detected, 1);
+
+    SpectrumAdvance(&sp, 60000000);
+    assert_true(sp.stats.missed > 0);
+
+    SpectrumCommand(&sp, "F 145012500", reply, sizeof(reply), 60000000);
+    assert_string_equal(reply, "RPRT 0\n");
+    SpectrumCommand(&sp, "f", reply, sizeof(reply), 60000000);
+    assert_string_equal(reply, "145012500\n");
+    SpectrumCommand(&sp, "bogus", reply, sizeof(reply), 60000000);
+    assert_string_equal(reply, "RPRT 1\n");
+}
+
+static void test_trace_record_replay(void **state)
+{
+    (void) state;
+    char path[] = "/tmp/gqrx-trace-XXXXXX";
+    TRACE_STATS stats;
+    freq_t freq;
+    double level;
+
+    StateInvalidate();
+    close(mkstemp(path));
+    assert_true(TraceRecordOpen(path));
+    TraceRecord("F 145000000\n", "RPRT 0\n", ClockNow(), 500);
+    TraceRecord("f\n", "145000000\n", ClockNow(), 500);
+    TraceRecord("l\n", "-42.5\n", ClockNow(), 500);
+    TraceRecord("F 145012500\n", "RPRT 0\n", ClockNow(), 500);
+    TraceRecord("f\n", "145012500\n", ClockNow(), 500);
+    TraceClose();
+
+    /* Replies come from the trace, no socket */
+    assert_true(TraceReplayOpen(path, 0));
+    assert_true(SetFreq(-1, 145000000));
+    assert_true(GetSignalLevel(-1, &level));
+    assert_true(level == -42.5);
+    assert_false(TraceReplayDone());
+
+    /* Not recorded: made up */
+    GetSquelchLevel(-1, &level);
+    assert_true(level == -50.0);
+    assert_true(SetFreq(-1, 145012500));
+    assert_true(GetCurrentFreq(-1, &freq)); /* from the state shadow */
+    assert_int_equal(freq, 145012500);
+    assert_false(TraceReplayDone());
+    StateInvalidate();
+    assert_true(GetCurrentFreq(-1, &freq));
+    assert_int_equal(freq, 145012500);
+    assert_true(TraceReplayDone());
+
+    TraceStats(&stats);
+    assert_int_equal(stats.served, 4);
+    assert_int_equal(stats.skipped, 1);  /* f after F, not read back */
+    assert_int_equal(stats.diverged, 1);
+    TraceClose();
+    unlink(path);
+}
+
+static void test_monitor_level_pipelined(void **state)
+{
+    (void) state;
+    int    sv[2];
+    char   buf[BUFSIZE];
+    freq_t freq = 0;
+    double squelch = 0, level = 0;
+    ssize_t n;
+
+    /* Replies are queued upfront: one write, three lines back */
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    assert_true(write(sv[1], "145012500\n-52.0\n-31.4\n", 23) == 23);
+    assert_true(MonitorLevel(sv[0], &freq, &squelch, &level));
+    n = read(sv[1], buf, sizeof(buf) - 1);
+    buf[n] = '\0';
+    assert_string_equal(buf, "f\nl SQL\nl\n");
+    assert_int_equal(freq, 145012500);
+    assert_true(squelch == -52.0 && level == -31.4);
+
+    /* Level only */
+    assert_true(write(sv[1], "-33.0\n", 6) == 6);
+    assert_true(MonitorLevel(sv[0], NULL, NULL, &level));
+    n = read(sv[1], buf, sizeof(buf) - 1);
+    buf[n] = '\0';
+    assert_string_equal(buf, "l\n");
+    assert_true(level == -33.0);
+    close(sv[0]);
+    close(sv[1]);
+
+    /* Fast near the squelch or after a crossing, slow on a long carrier */
+    assert_int_equal(MonitorInterval(-48.0, -50.0, MONITOR_STEADY), MONITOR_FAST);
+    assert_int_equal(MonitorInterval(-20.0, -50.0, 0), MONITOR_FAST);
+    assert_int_equal(MonitorInterval(-20.0, -50.0, MONITOR_SETTLED), MONITOR_NORMAL);
+    assert_int_equal(MonitorInterval(-20.0, -50.0, MONITOR_STEADY), MONITOR_SLOW);
+    assert_int_equal(MonitorInterval(-80.0, -50.0, MONITOR_STEADY), MONITOR_NORMAL);
+}
+
+static void test_state_shadow(void **state)
+{
+    (void) state;
+    int    sv[2];
+    char   buf[BUFSIZE];
+    freq_t freq = 0;
+    double squelch = 0;
+    ssize_t n;
+
+    StateInvalidate();
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+    assert_true(write(sv[1], "RPRT 0\n", 7) == 7);
+    assert_true(SetFreq(sv[0], 145012500));
+    assert_true(write(sv[1], "RPRT 0\n", 7) == 7);
+    assert_true(SetSquelchLevel(sv[0], -52.0));
+    assert_true(write(sv[1], "RPRT 0\n", 7) == 7);
+    assert_true(StartRecording(sv[0]));
+
+    /* Answered locally: nothing else is sent */
+    assert_true(GetCurrentFreq(sv[0], &freq));
+    assert_true(GetSquelchLevel(sv[0], &squelch));
+    assert_true(SetSquelchLevel(sv[0], -52.0));
+    assert_true(StartRecording(sv[0]));
+    assert_int_equal(freq, 145012500);
+    assert_true(squelch == -52.0);
+    n = recv(sv[1], buf, sizeof(buf) - 1, MSG_DONTWAIT);
+    buf[n] = '\0';
+    assert_string_equal(buf, "F 145012500\nL SQL -52.000000\nU RECORD 1\n");
+
+    /* Invalidated: read from the receiver again */
+    StateInvalidate();
+    assert_true(write(sv[1], "-40.0\n", 6) == 6);
+    assert_true(GetSquelchLevel(sv[0], &squelch));
+    assert_true(squelch == -40.0);
+    n = recv(sv[1], buf, sizeof(buf) - 1, MSG_DONTWAIT);
+    buf[n] = '\0';
+    assert_string_equal(buf, "l SQL\n");
+    close(sv[0]);
+    close(sv[1]);
+    StateInvalidate();
+}
+
+static void test_survey_candidates(void **state)
+{
+    (void) state;
+    char   path[] = "/tmp/gqrx-survey-XXXXXX";
+    SURVEY survey;
+    int    fd;
+
+    /* A FIFO opens before the writer, lines are parsed as they complete */
+    close(mkstemp(path));
+    unlink(path);
+    assert_int_equal(mkfifo(path, 0600), 0);
+    assert_true(SurveyOpen(&survey, path, 6.0));
+    assert_true(SurveyRange(&survey, 145000000, 145100000, 12500));
+    assert_int_equal(SurveyPoll(&survey), 0);
+    assert_true(SurveyCandidate(&survey, 145025000)); /* not surveyed */
+
+    fd = open(path, O_WRONLY);
+    const char *hop1 = "2025-06-01, 12:00:00, 145000000, 145050000, 12500, 10, -70, -71, -50, -70, -69\n";
+    const char *hop2 = "2025-06-01, 12:00:00, 145062500, 145100000, 12500, 10, -72, -72, -60, -72\n";
+    assert_true(write(fd, hop1, 30) == 30);
+    assert_int_equal(SurveyPoll(&survey), 0);
+    assert_true(write(fd, hop1 + 30, strlen(hop1) - 30) == (ssize_t)(strlen(hop1) - 30));
+    assert_true(write(fd, hop2, strlen(hop2)) == (ssize_t)strlen(hop2));
+    assert_true(write(fd, "garbage\n", 8) == 8);
+    assert_int_equal(SurveyPoll(&survey), 2);
+    assert_int_equal(survey.rejected, 1);
+
+    /* 6 dB above the median of each hop */
+    assert_true(SurveyCandidate(&survey, 145025000));   /* -50 in -70 */
+    assert_false(SurveyCandidate(&survey, 145000000));
+    assert_false(SurveyCandidate(&survey, 145050000));
+    assert_true(SurveyCandidate(&survey, 145087500));   /* -60 in -72 */
+    assert_false(SurveyCandidate(&survey, 145100000));
+    assert_true(SurveyCandidate(&survey, 146000000));   /* out of the survey */
+
+    close(fd);
+    SurveyClose(&survey);
+    unlink(path);
+}
+
+static void test_waterfall_ring(void **state)
+{
+    (void) state;
+    char      path[] = "/tmp/gqrx-waterfall-XXXXXX";
+    WATERFALL wf = { .fd = -1 };
+    float     levels[5];
+    int64_t   time;
+
+    close(mkstemp(path));
+    assert_true(WaterfallOpen(&wf, path, 145000000, 145050000, 12500, 2));
+    assert_int_equal(wf.header->bins, 5);
+    WaterfallSet(&wf, 145000000, -70.0);
+    WaterfallSet(&wf, 145025000, -40.5);
+    WaterfallSet(&wf, 146000000, -10.0); /* out of range */
+    WaterfallCommit(&wf);
+
+    /* A viewer maps the file on its own */
+    int fd = open(path, O_RDONLY);
+    const WF_HEADER *header = mmap(NULL, wf.size, PROT_READ, MAP_SHARED, fd, 0);
+    assert_true(header != MAP_FAILED);
+    assert_int_equal(header->head, 1);
+    assert_true(WaterfallRead(header, 0, &time, levels));
+    assert_true(time > 0);
+    assert_true(levels[0] == -70.0f && levels[2] == -40.5f);
+    assert_true(isnan(levels[1]) && isnan(levels[4]));
+    assert_false(WaterfallRead(header, 1, &time, levels)); /* being written */
+
+    /* The ring wraps: row 0 is reused by the third pass */
+    WaterfallCommit(&wf);
+    WaterfallCommit(&wf);
+    assert_int_equal(header->head, 3);
+    assert_false(WaterfallRead(header, 0, &time, levels));
+    assert_true(WaterfallRead(header, 2, &time, levels));
+    munmap((void *)header, wf.size);
+    close(fd);
+
+    /* Same bins: the ring goes on, other bins: it starts over */
+    WaterfallClose(&wf);
+    assert_true(WaterfallOpen(&wf, path, 145000000, 145050000, 12500, 2));
+    assert_int_equal(wf.header->head, 3);
+    WaterfallClose(&wf);
+    assert_true(WaterfallOpen(&wf, path, 145000000, 145100000, 12500, 2));
+    assert_int_equal(wf.header->head, 0);
+    assert_int_equal(wf.header->bins, 9);
+    WaterfallClose(&wf);
+
+    /* Any other file is left alone */
+    FILE *other = fopen(path, "w");
+    fputs("not a waterfall\n", other);
+    fclose(other);
+    assert_false(WaterfallOpen(&wf, path, 145000000, 145050000, 12500, 2));
+    assert_int_equal(errno, EINVAL);
+    struct stat st;
+    assert_int_equal(stat(path, &st), 0);
+    assert_int_equal(st.st_size, 16);
+    unlink(path);
+}
+
+static void test_event_json_utf8_and_room(void **state)
+{
+    (void) state;
+    char  *tags[] = { "Répéteurs", "Zürich", "Ölands", "tag4" };
+    EVENT  event = { .type = EVENT_HIT_START, .stamp = 1750000000123456LL, .freq = 430100000,
+                     .level = -31.0, .squelch = -50.0, .start = 1750000000, .bookmark = 1 };
+    char   buf[PUBLISH_DATAGRAM];
+
+    /* Non-ASCII bookmark strings are published as they are, control characters are blanked */
+    EventSetBookmark(&event, "Relais Genève\tnord", tags, 4);
+    size_t n = FormatEventJson(&event, 1, buf, sizeof(buf));
+    assert_int_equal(n, strlen(buf));
+    assert_non_null(strstr(buf, "\"descr\":\"Relais Genève nord\""));
+    assert_non_null(strstr(buf, "\"tags\":[\"Répéteurs\",\"Zürich\",\"Ölands\",\"tag4\"]}"));
+
+    /* Out of room: the tags that do not fit are dropped, the object is still closed */
+    size_t full = n;
+    n = FormatEventJson(&event, 1, buf, full - 5);
+    assert_non_null(strstr(buf, "\"Zürich\",\"Ölands\"]}"));
+    assert_null(strstr(buf, "tag4"));
+    for (size_t size = full; size > full - 40; size--)
+    {
+        n = FormatEventJson(&event, 1, buf, size);
+        assert_int_equal(n, strlen(buf));
+        assert_true(n < size);
+        assert_string_equal(buf + n - 2, "]}");
+    }
+}
+
+static void test_publish_hit_event(void **state)
+{
+    (void) state;
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    socklen_t len = sizeof(addr);
+    char   *tags[] = { "Repeaters", "FM \"narrow\"" };
+    EVENT  event = { .type = EVENT_HIT_END, .stamp = 1750000000123456LL, .freq = 145600000,
+                     .level = -31.0, .squelch = -50.0, .start = 1750000000, .duration = 12,
+                     .peak = -29.5, .mean = -31.25, .bookmark = 3 };
+    char   buf[PUBLISH_DATAGRAM], endpoint[64];
+
+    /* A subscriber on an ephemeral port */
+    int sub = socket(AF_INET, SOCK_DGRAM, 0);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(sub, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    getsockname(sub, (struct sockaddr *)&addr, &len);
+    snprintf(endpoint, sizeof(endpoint), "127.0.0.1:%d,127.0.0.1:9", ntohs(addr.sin_port));
+    /* The event keeps its own copy of the bookmark strings, a reload may free them */
+    char  *descr = strdup("R0");
+    EventSetBookmark(&event, descr, tags, 2);
+    free(descr);
+    assert_false(PublishStart("localhost:9"));
+    assert_true(PublishStart(endpoint));
+
+    size_t n = FormatEventJson(&event, 7, buf, sizeof(buf));
+    PublishSend(buf, n);
+    PublishSend(buf, n); /* nobody on port 9: not a drop */
+    ssize_t r = recv(sub, buf, sizeof(buf) - 1, 0);
+    assert_int_equal(r, n);
+    buf[r] = '\0';
+    assert_string_equal(buf, "{\"seq\":7,\"event\":\"end\",\"ts\":1750000000123456,\"freq\":145600000,"
+                        "\"level\":-31.0,\"squelch\":-50.0,\"start\":1750000000,\"peak\":-29.5,\"mean\":-31.2,"
+                        "\"duration\":12,\"bookmark\":3,\"descr\":\"R0\",\"tags\":[\"Repeaters\",\"FM \\\"narrow\\\"\"]}");
+    assert_int_equal(PublishDropped(), 0);
+    PublishStop();
+    close(sub);
+
+    /* IPv6 in brackets */
+    struct sockaddr_in6 addr6 = { .sin6_family = AF_INET6, .sin6_addr = IN6ADDR_LOOPBACK_INIT };
+    len = sizeof(addr6);
+    sub = socket(AF_INET6, SOCK_DGRAM, 0);
+    if (sub >= 0 && bind(sub, (struct sockaddr *)&addr6, sizeof(addr6)) == 0)
+    {
+        getsockname(sub, (struct sockaddr *)&addr6, &len);
+        snprintf(endpoint, sizeof(endpoint), "[::1]:%d", ntohs(addr6.sin6_port));
+        assert_true(PublishStart(endpoint));
+        PublishSend("{}", 2);
+        assert_int_equal(recv(sub, buf, sizeof(buf), 0), 2);
+        PublishStop();
+    }
+    assert_false(PublishStart("[::1:9"));
+    if (sub >= 0)
+        close(sub);
+}
+
+static atomic_int audio_changes;
+
+static void CountAudioChange(void)
+{
+    atomic_fetch_add(&audio_changes, 1);
+}
+
+/* 100 ms of synthetic audio as gqrx sends it: s16le mono, 1024 byte datagrams */
+static void SendAudio(int fd, const struct sockaddr_in *to, int kind)
+{
+    int16_t samples[512];
+    for (int n = 0, t = 0; n < AUDIO_RATE / 10; n += 512)
+    {
+        for (int i = 0; i < 512; i++, t++)
+        {
+            if (kind == 0)
+                samples[i] = 0;                                         /* squelch closed */
+            else if (kind == 1)
+                samples[i] = (int16_t)(8000 * sin(2 * M_PI * 600 * t / AUDIO_RATE)); /* tone */
+            else
+                samples[i] = (int16_t)(rand() % 16001 - 8000);          /* hiss */
+        }
+        sendto(fd, samples, sizeof(samples), 0, (const struct sockaddr *)to, sizeof(*to));
+    }
+}
+
+static bool WaitAudioState(AUDIO_STATE expected, long timeout)
+{
+    clock_us_t deadline = ClockNow() + timeout;
+    while (AudioState(NULL) != expected)
+    {
+        if (ClockNow() >= deadline)
+            return false;
+        usleep(5000);
+    }
+    return true;
+}
+
+static void test_audio_activity(void **state)
+{
+    (void) state;
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    socklen_t len = sizeof(addr);
+    char     listen_on[32];
+    int16_t  tone[AUDIO_WINDOW];
+    double   energy, zcr;
+
+    /* Features of one window: a 600 Hz tone at -15 dBFS crosses zero 1200 times a second */
+    for (int i = 0; i < AUDIO_WINDOW; i++)
+        tone[i] = (int16_t)(8000 * sin(2 * M_PI * 600 * i / AUDIO_RATE));
+    AudioFeatures(tone, AUDIO_WINDOW, &energy, &zcr);
+    assert_true(fabs(energy - 20 * log10(8000 / sqrt(2) / 32768)) < 0.1);
+    assert_true(fabs(zcr - 0.025) < 0.003);
+    assert_true(AudioIsSignal(energy, zcr));
+    assert_false(AudioIsSignal(energy, 0.3));
+    assert_false(AudioIsSignal(-70, zcr));
+
+    /* A free port for the detector */
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    getsockname(fd, (struct sockaddr *)&addr, &len);
+    close(fd);
+    snprintf(listen_on, sizeof(listen_on), "127.0.0.1:%d", ntohs(addr.sin_port));
+    assert_false(AudioStart("localhost:7355", NULL));
+    assert_true(AudioStart(listen_on, CountAudioChange));
+    assert_int_equal(AudioState(NULL), AUDIO_NONE);
+
+    fd = socket(AF_INET, SOCK_DGRAM, 0);
+    SendAudio(fd, &addr, 0);
+    assert_true(WaitAudioState(AUDIO_IDLE, 200000));
+    SendAudio(fd, &addr, 1);
+    assert_true(WaitAudioState(AUDIO_ACTIVE, 200000));
+    assert_int_equal(AudioState(&energy), AUDIO_ACTIVE);
+    assert_true(fabs(energy + 15.3) < 0.5);
+    SendAudio(fd, &addr, 2);
+    assert_true(WaitAudioState(AUDIO_IDLE, 200000));
+
+    /* The stream stops: idle within tens of ms, then gone */
+    SendAudio(fd, &addr, 1);
+    assert_true(WaitAudioState(AUDIO_ACTIVE, 200000));
+    clock_us_t stopped = ClockNow();
+    assert_true(WaitAudioState(AUDIO_IDLE, 200000));
+    assert_true(ClockNow() - stopped < 100000);
+    assert_true(WaitAudioState(AUDIO_NONE, AUDIO_STALE + 200000));
+    assert_true(atomic_load(&audio_changes) >= 6);
+
+    AudioStop();
+    assert_int_equal(AudioState(NULL), AUDIO_NONE);
+    close(fd);
+}
+
+/* 0.6 s of audio: voice-like tones with a CTCSS tone (Hz) or a DCS word under it */
+static void ToneAudio(int16_t *buf, int n, double ctcss, int dcs, bool inverted)
+{
+    uint32_t word = (dcs >= 0) ? DcsWord(dcs, inverted) : 0;
+    for (int i = 0; i < n; i++)
+    {
+        double t = (double)i / TONE_INPUT_RATE;
+        double x = 3600 * sin(2 * M_PI * 500 * t) + 2400 * sin(2 * M_PI * 1200 * t);
+        if (ctcss > 0)
+            x += 600 * sin(2 * M_PI * ctcss * t);
+        if (dcs >= 0)
+            x += ((word >> ((long)(t * DCS_BAUD) % 23)) & 1) ? 1500 : -1500;
+        buf[i] = (int16_t)x;
+    }
+}
+
+static void test_tone_decoder(void **state)
+{
+    (void) state;
+    static int16_t buf[TONE_INPUT_RATE * 6 / 10];
+    int          n = TONE_INPUT_RATE * 6 / 10;
+    TONE_DECODER dec;
+    TONE_RULES   rules;
+    TONE         t885, t854, d023, d023i, bad;
+    char         str[16];
+    char        *tags[] = { "Repeaters", "FM" };
+
+    assert_true(ToneParse("88.5", &t885));
+    assert_true(ToneParse("85.4", &t854));
+    assert_true(ToneParse("d023", &d023));
+    assert_true(ToneParse("D023I", &d023i));
+    assert_false(ToneParse("88.0", &bad)); /* not a standard tone */
+    assert_false(ToneParse("D089", &bad)); /* octal */
+    assert_string_equal(FormatTone(&t885, str, sizeof(str)), "88.5");
+    assert_string_equal(FormatTone(&d023i, str, sizeof(str)), "D023I");
+
+    /* 023 normal is the same bit stream as 047 inverted, read from another bit */
+    uint32_t word = DcsWord(023, false), twin = DcsWord(047, true);
+    bool rotated = false;
+    for (int r = 0; r < 23; r++)
+        rotated |= (((word >> r) | (word << (23 - r))) & 0x7FFFFF) == twin;
+    assert_true(rotated);
+
+    /* CTCSS under the voice, decided after the first 0.25 s block */
+    ToneInit(&dec);
+    ToneAudio(buf, n, 88.5, -1, false);
+    ToneFeed(&dec, buf, TONE_INPUT_RATE / 5);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_PENDING);
+    ToneFeed(&dec, buf + TONE_INPUT_RATE / 5, TONE_INPUT_RATE / 20);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_MATCH);
+    assert_int_equal(ToneMatch(&dec, &t854), TONE_MISMATCH);
+
+    /* Another tone is a mismatch after the first block too */
+    ToneReset(&dec);
+    ToneAudio(buf, n, 131.8, -1, false);
+    ToneFeed(&dec, buf, TONE_INPUT_RATE / 4);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_MISMATCH);
+
+    /* DCS in both polarities, after two words */
+    ToneReset(&dec);
+    ToneAudio(buf, n, 0, 023, false);
+    ToneFeed(&dec, buf, n);
+    assert_int_equal(ToneMatch(&dec, &d023), TONE_MATCH);
+    assert_int_equal(ToneMatch(&dec, &d023i), TONE_MISMATCH);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_MISMATCH);
+    ToneReset(&dec);
+    ToneAudio(buf, n, 0, 023, true);
+    ToneFeed(&dec, buf, n);
+    assert_int_equal(ToneMatch(&dec, &d023i), TONE_MATCH);
+
+    /* Voice alone: no decision after one block, a mismatch after two (0.75 s) */
+    ToneReset(&dec);
+    ToneAudio(buf, n, 0, -1, false);
+    ToneFeed(&dec, buf, n);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_PENDING);
+    ToneFeed(&dec, buf, n);
+    assert_int_equal(ToneMatch(&dec, &t885), TONE_MISMATCH);
+    assert_int_equal(ToneMatch(&dec, &d023), TONE_MISMATCH);
+
+    /* Rules: the frequency first, then a tag, then * */
+    assert_false(ToneParseRules("Repeaters", &rules));
+    assert_false(ToneParseRules("Repeaters=88", &rules));
+    assert_true(ToneParseRules("*=D023,repeat=88.5,145600000=85.4", &rules));
+    assert_int_equal(rules.max, 3);
+    assert_int_equal(ToneRuleFor(&rules, 145605000, 10000, tags, 2)->ctcss, t854.ctcss);
+    assert_int_equal(ToneRuleFor(&rules, 145700000, 10000, tags, 2)->ctcss, t885.ctcss);
+    assert_int_equal(ToneRuleFor(&rules, 145700000, 10000, NULL, 0)->type, TONE_DCS);
+    assert_true(ToneParseRules("FM=88.5", &rules));
+    assert_null(ToneRuleFor(&rules, 145700000, 10000, NULL, 0));
+
+    /* A reject is remembered around the frequency, for a while */
+    SCANNER sc;
+    ScannerInit(&sc);
+    ToneRejectAdd(&sc, 145600000, 1000);
+    assert_true(ToneRejectCached(&sc, 145605000, 2000));
+    assert_false(ToneRejectCached(&sc, 145700000, 2000));
+    assert_false(ToneRejectCached(&sc, 145600000, 1000 + TONE_REJECT_TTL));
+    ScannerFree(&sc);
+}
+
+static void test_capture_preroll(void **state)
+{
+    (void) state;
+    char     dir[] = "/tmp/gqrx-capture-XXXXXX";
+    char     path[CAPTURE_PATH_SIZE], expected[CAPTURE_PATH_SIZE], stamp[32];
+    static int16_t second[CAPTURE_RATE];
+    uint8_t  header[44], sample[2];
+    time_t   hit_time = 1750000000;
+    struct tm tm;
+
+    assert_non_null(mkdtemp(dir));
+    assert_false(CaptureStart("/nonexistent"));
+    assert_true(CaptureStart(dir));
+    CaptureClose(); /* nothing to close */
+
+    /* 3 seconds of stream, the pre-roll keeps the last 2 */
+    for (int s = 0; s < 3; s++)
+    {
+        for (int i = 0; i < CAPTURE_RATE; i++)
+            second[i] = (int16_t)(s * 1000 + i % 100);
+        CaptureFeed(second, CAPTURE_RATE);
+    }
+    assert_true(CaptureOpen(145600000, hit_time, path, sizeof(path)));
+    localtime_r(&hit_time, &tm);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &tm);
+    snprintf(expected, sizeof(expected), "%s/145600000_%s.wav", dir, stamp);
+    assert_string_equal(path, expected);
+
+    /* half a second of live audio, then the hit ends: not captured */
+    for (int i = 0; i < CAPTURE_RATE / 2; i++)
+        second[i] = 7000;
+    CaptureFeed(second, CAPTURE_RATE / 2);
+    CaptureClose();
+    CaptureFeed(second, CAPTURE_RATE / 2);
+
+    /* Retuned a quarter of a second before the next hit: the pre-roll starts at the tune */
+    char tuned_path[CAPTURE_PATH_SIZE];
+    CaptureTuned();
+    for (int i = 0; i < CAPTURE_RATE / 4; i++)
+        second[i] = 9000;
+    CaptureFeed(second, CAPTURE_RATE / 4);
+    assert_true(CaptureOpen(145612500, hit_time, tuned_path, sizeof(tuned_path)));
+    CaptureClose();
+    CaptureStop();
+    assert_int_equal(CaptureDropped(), 0);
+
+    FILE *tuned = fopen(tuned_path, "rb");
+    assert_non_null(tuned);
+    assert_int_equal(fread(header, 1, sizeof(header), tuned), sizeof(header));
+    assert_int_equal(header[40] | header[41] << 8 | header[42] << 16, CAPTURE_RATE / 4 * 2);
+    assert_int_equal(fread(sample, 1, 2, tuned), 2);
+    assert_int_equal((int16_t)(sample[0] | sample[1] << 8), 9000);
+    fclose(tuned);
+    unlink(tuned_path);
+
+    FILE *file = fopen(path, "rb");
+    assert_non_null(file);
+    assert_int_equal(fread(header, 1, sizeof(header), file), sizeof(header));
+    assert_memory_equal(header, "RIFF", 4);
+    assert_memory_equal(header + 8, "WAVEfmt ", 8);
+    uint32_t data = header[40] | header[41] << 8 | header[42] << 16 | (uint32_t)header[43] << 24;
+    assert_int_equal(data, (CAPTURE_PREROLL * CAPTURE_RATE + CAPTURE_RATE / 2) * 2);
+    assert_int_equal(fread(sample, 1, 2, file), 2);
+    assert_int_equal((int16_t)(sample[0] | sample[1] << 8), 1000); /* the pre-roll starts at the 2nd second */
+    fseek(file, -2, SEEK_END);
+    assert_int_equal(fread(sample, 1, 2, file), 2);
+    assert_int_equal((int16_t)(sample[0] | sample[1] << 8), 7000);
+    fclose(file);
+    unlink(path);
+    rmdir(dir);
+}
+
+static void test_hooks_concurrent_stdin(void **state)
+{
+    (void) state;
+    EVENT  event = { .type = EVENT_HIT_START, .freq = 145600000, .level = -31.0, .bookmark = -1 };
+    HOOKS_STATS before, stats;
+
+    /* The start hook reads its JSON to EOF next to a slow end hook on the other worker */
+    HooksStats(&before);
+    assert_true(HooksStart("cat > /dev/null", "sleep 1", 2, 5000000));
+    clock_us_t queued = ClockNow();
+    assert_true(HookQueue(&event, "{\"event\":\"start\"}"));
+    event.type = EVENT_HIT_END;
+    assert_true(HookQueue(&event, "{\"event\":\"end\"}"));
+    for (int i = 0; i < 200; i++)
+    {
+        HooksStats(&stats);
+        if (stats.run > before.run)
+            break;
+        SleepFor(5000);
+    }
+    clock_us_t done = ClockNow();
+    HooksStop();
+    HooksStats(&stats);
+    assert_int_equal(stats.run - before.run, 2);
+    assert_int_equal(stats.failed - before.failed, 0);
+    /* not held until the sleep exits by an inherited end of the other stdin */
+    assert_true(done - queued < 500000);
+}
+
+static void test_hooks_run_and_timeout(void **state)
+{
+    (void) state;
+    char   path[] = "/tmp/gqrx-hook-XXXXXX";
+    char   on_start[128], buf[256];
+    char  *tags[] = { "Repeaters", "FM" };
+    EVENT  event = { .type = EVENT_HIT_START, .freq = 145600000, .level = -31.0, .bookmark = 3 };
+    HOOKS_STATS stats;
+
+    EventSetBookmark(&event, "R0", tags, 2);
+    close(mkstemp(path));
+    snprintf(on_start, sizeof(on_start), "cat > %s; echo \"$GQRX_EVENT $GQRX_FREQ $GQRX_TAGS\" >> %s", path, path);
+    assert_true(HooksStart(on_start, "sleep 5", 1, 200000));
+
+    /* Queued at once, run by the worker */
+    clock_us_t queued = ClockNow();
+    assert_true(HookQueue(&event, "{\"event\":\"start\"}"));
+    event.type = EVENT_HIT_UPDATE;
+    assert_false(HookQueue(&event, "{}")); /* no hook for updates */
+    event.type = EVENT_HIT_END;
+    assert_true(HookQueue(&event, "{\"event\":\"end\"}"));
+    assert_true(ClockNow() - queued < 10000);
+
+    /* The end hook is killed after 200 ms */
+    for (int i = 0; i < 300; i++)
+    {
+        HooksStats(&stats);
+        if (stats.timeouts == 1)
+            break;
+        SleepFor(10000);
+    }
+    HooksStop();
+    HooksStats(&stats);
+    assert_int_equal(stats.run, 1);
+    assert_int_equal(stats.failed, 0);
+    assert_int_equal(stats.timeouts, 1);
+
+    FILE *fd = fopen(path, "r");
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fd);
+    buf[n] = '\0';
+    fclose(fd);
+    unlink(path);
+    assert_string_equal(buf, "{\"event\":\"start\"}\nstart 145600000 Repeaters|FM\n");
+}
+
+static void test_profile_chrome_trace(void **state)
+{
+    (void) state;
+    char path[] = "/tmp/gqrx-profile-XXXXXX";
+    char buf[4096];
+
+    /* Nothing is recorded while profiling is off */
+    assert_int_equal(SpanBegin(), 0);
+
+    close(mkstemp(path));
+    assert_true(ProfileStart(path));
+    clock_us_t step = SpanBegin();
+    SleepFor(1000);
+    SpanCommand(CMD_GET_SQUELCH, step, 200);
+    SpanEnd(SPAN_STEP, step, 145000000);
+    assert_true(ProfileStop());
+    assert_false(ProfileEnabled);
+
+    FILE *fd = fopen(path, "r");
+    size_t n = fread(buf, 1, sizeof(buf) - 1, fd);
+    buf[n] = '\0';
+    fclose(fd);
+    unlink(path);
+    assert_non_null(strstr(buf, "\"traceEvents\":["));
+    assert_non_null(strstr(buf, "{\"name\":\"l SQL\",\"cat\":\"protocol\",\"ph\":\"X\",\"ts\":"));
+    assert_non_null(strstr(buf, "\"dur\":200,"));
+    assert_non_null(strstr(buf, "\"name\":\"step\""));
+    assert_non_null(strstr(buf, "\"args\":{\"freq\":145000000}"));
+    assert_non_null(strstr(buf, "\n]}\n"));
+}
+
+/* ========================================================================
+ * Bookmark Cache Tests
+ * ======================================================================== */
+
+static void test_cache_compile_and_load(void **state)
+{
+    (void) state;
+    const char *sources[] = { "tests/fixtures/test_bookmarks.csv" };
+    char cache_file[] = "/tmp/gqrx-cache-XXXXXX";
+    BOOKMARK_CACHE cache;
+
+    close(mkstemp(cache_file));
+    assert_true(CompileBookmarkCache(cache_file, sources, 1));
+    assert_true(CacheOpen(&cache, cache_file, sources, 1));
+
+    /* Bookmarks are sorted and tags interned */
+    assert_int_equal(cache.header->n_freqs, 6);
+    assert_int_equal(cache.header->n_tags, 3);
+    assert_int_equal(cache.freqs[0].freq, 144500000);
+    assert_int_equal(cache.freqs[5].freq, 430900000);
+    assert_int_equal(CacheLowerBound(&cache, 430000000), 2);
+
+    /* Only the bookmarks in range are loaded */
+    ScannerInit(&sc);
+    LoadFrequenciesFromCache(&sc, &cache, 430000000, 431000000);
+    assert_int_equal(sc.freq_max, 4);
+    assert_int_equal(sc.freqs[0].freq, 430037000);
+    assert_string_equal(sc.freqs[0].descr, " Beigua                   ");
+    assert_int_equal(sc.freqs[0].tag_max, 2);
+    assert_string_equal(sc.freqs[0].tags[1], "VHF");
+
+    /* A reload keeps what was learned on the bookmarks still there */
+    sc.freqs[0].settle      = 42000;
+    sc.freqs[0].noise_floor = -61.5;
+    LoadFrequenciesFromCache(&sc, &cache, 430030000, 431000000);
+    assert_int_equal(sc.freqs[0].freq, 430037000);
+    assert_int_equal(sc.freqs[0].settle, 42000);
+    assert_true(sc.freqs[0].noise_floor == -61.5);
+    assert_int_equal(sc.freqs[1].settle, 0);
+
+    /* Tag search uses the precomputed bitsets */
+    char tags[] = "radio";
+    ParseTags(&sc, tags);
+    sc.tag_search = true;
+    LoadFrequenciesFromCache(&sc, &cache, 0, 0);
+    assert_int_equal(sc.freq_max, 1);
+    assert_int_equal(sc.freqs[0].freq, 430900000);
+    ScannerFree(&sc);
+    CacheClose(&cache);
+    unlink(cache_file);
+}
+
+static void test_cache_stale_source(void **state)
+{
+    (void) state;
+    char source[] = "/tmp/gqrx-bookmarks-XXXXXX";
+    char cache_file[] = "/tmp/gqrx-cache-XXXXXX";
+    const char *sources[] = { source };
+    BOOKMARK_CACHE cache;
+
+    FILE *fp = fdopen(mkstemp(source), "w");
+    fprintf(fp, "# Frequency ; Name ; Modulation ; Bandwidth ; Tags\n");
+    fprintf(fp, "145000000 ; Station ; Narrow FM ; 12500 ; VHF\n");
+    fclose(fp);
+    close(mkstemp(cache_file));
+
+    assert_true(CompileBookmarkCache(cache_file, sources, 1));
+    assert_true(CacheOpen(&cache, cache_file, sources, 1));
+    CacheClose(&cache);
+
+    /* A different source list is rejected */
+    const char *other[] = { "tests/fixtures/test_bookmarks.csv" };
+    assert_false(CacheOpen(&cache, cache_file, other, 1));
+
+    /* Changing the content invalidates the cache */
+    fp = fopen(source, "a");
+    fprintf(fp, "146000000 ; Other ; Narrow FM ; 12500 ; VHF\n");
+    fclose(fp);
+    assert_false(CacheOpen(&cache, cache_file, sources, 1));
+
+    unlink(source);
+    unlink(cache_file);
+}
+
+/* ========================================================================
+ * Hit Log Tests
+ * ======================================================================== */
+
+static time_t local_time(int hour, int min)
+{
+    struct tm tm = { .tm_year = 125, .tm_mon = 5, .tm_mday = 10, .tm_hour = hour, .tm_min = min, .tm_isdst = -1 };
+    return mktime(&tm);
+}
+
+static void test_hitlog_report(void **state)
+{
+    (void) state;
+    char log_file[] = "/tmp/gqrx-hits-XXXXXX";
+    HIT_LOG log;
+    REPORT report;
+    REPORT_OPTIONS options = { 0, 0, 10, 2 };
+
+    close(mkstemp(log_file));
+    unlink(log_file);
+
+    /* 200 sessions of 10 sec at 7 AM, more than a block */
+    assert_true(HitLogOpen(&log, log_file));
+    for (int i = 0; i < 200; i++)
+    {
+        HIT_SESSION session = { local_time(7, i % 60), local_time(7, i % 60) + 10, 145500200, -20.0 - i % 5,
+                                -30.0, -50.0, 3 };
+        assert_true(HitLogAppend(&log, &session));
+    }
+    HitLogClose(&log);
+
+    /* A truncated block is dropped, the log can still be appended */
+    FILE *fp = fopen(log_file, "a");
+    fwrite("BLK1garbage", 1, 11, fp);
+    fclose(fp);
+    assert_true(HitLogOpen(&log, log_file));
+    for (int i = 0; i < 100; i++)
+    {
+        HIT_SESSION session = { local_time(12, i % 60), local_time(12, i % 60) + 5, 430100000, -10.0,
+                                -25.0, -50.0, -1 };
+        assert_true(HitLogAppend(&log, &session));
+    }
+    /* The partial block is written on the idle tick once old enough */
+    assert_true(HitLogTick(&log));
+    assert_int_equal(log.rows, 100);
+    log.oldest -= HITLOG_FLUSH_AGE;
+    assert_true(HitLogTick(&log));
+    assert_int_equal(log.rows, 0);
+    HitLogClose(&log);
+
+    assert_true(HitLogAnalyze(log_file, &options, &report));
+    assert_int_equal(report.sessions, 300);
+    assert_int_equal(report.busy, 2500);
+    assert_int_equal(report.n_channels, 2);
+    assert_int_equal(report.channels[0].freq, 145500000);  /* rounded to 1 kHz */
+    assert_int_equal(report.channels[0].sessions, 200);
+    assert_true(report.channels[0].peak == -20.0f);
+    assert_int_equal(report.hour_sessions[7], 200);
+    assert_int_equal(report.hour_busy[12], 500);
+    HitLogFreeReport(&report);
+
+    /* Time of day window */
+    options.from = 6 * 60;
+    options.to   = 9 * 60;
+    assert_true(HitLogAnalyze(log_file, &options, &report));
+    assert_int_equal(report.sessions, 200);
+    assert_int_equal(report.n_channels, 1);
+    HitLogFreeReport(&report);
+
+    unlink(log_file);
+}
+
+static void test_hitlog_short_write(void **state)
+{
+    (void) state;
+    char log_file[] = "/tmp/gqrx-hits-XXXXXX";
+    HIT_LOG log;
+    REPORT report;
+    REPORT_OPTIONS options = { 0, 0, 10, 1 };
+    HIT_SESSION session = { local_time(8, 0), local_time(8, 0) + 10, 145500000, -20.0, -30.0, -50.0, 3 };
+    struct rlimit limit, saved;
+    struct stat st;
+
+    close(mkstemp(log_file));
+    unlink(log_file);
+    assert_true(HitLogOpen(&log, log_file));
+    assert_true(HitLogAppend(&log, &session));
+    assert_true(HitLogFlush(&log));
+    assert_int_equal(stat(log_file, &st), 0);
+    off_t size = st.st_size;
+
+    /* The file size limit cuts the next block short: it is not left at the end */
+    signal(SIGXFSZ, SIG_IGN);
+    getrlimit(RLIMIT_FSIZE, &saved);
+    limit = saved;
+    limit.rlim_cur = size + 16;
+    assert_int_equal(setrlimit(RLIMIT_FSIZE, &limit), 0);
+    session.start += 60;
+    session.end   += 60;
+    assert_true(HitLogAppend(&log, &session));
+    assert_false(HitLogFlush(&log));
+    setrlimit(RLIMIT_FSIZE, &saved);
+    signal(SIGXFSZ, SIG_DFL);
+    assert_int_equal(stat(log_file, &st), 0);
+    assert_int_equal(st.st_size, size);
+    assert_int_equal(log.rows, 1);
+
+    /* The rows kept are written on the retry, the sessions after it are read back */
+    session.start += 60;
+    session.end   += 60;
+    assert_true(HitLogAppend(&log, &session));
+    assert_true(HitLogFlush(&log));
+    HitLogClose(&log);
+    assert_true(HitLogAnalyze(log_file, &options, &report));
+    assert_int_equal(report.sessions, 3);
+    HitLogFreeReport(&report);
+
+    unlink(log_file);
+}
+
+static void test_occupancy_duty_cycle(void **state)
+{
+    (void) state;
+    char occ_file[] = "/tmp/gqrx-occ-XXXXXX";
+    OCCUPANCY occ;
+    OCC_STATS *stats;
+    uint32_t n_stats;
+    time_t day = (time_t)20000 * 86400;
+
+    close(mkstemp(occ_file));
+    unlink(occ_file);
+
+    /* Two days observed every minute, channels rounded to the 12.5 kHz step */
+    assert_true(OccupancyOpen(&occ, occ_file, 12500));
+    for (time_t t = day; t < day + 2 * 86400; t += 60)
+    {
+        OccupancyMark(&occ, 145500100, t, false);
+        OccupancyMark(&occ, 430100000, t, false);
+    }
+    /* 60 busy minutes a day on the first channel, crossing midnight */
+    OccupancyMarkBusy(&occ, 145500000, day + 86400 - 1800, day + 86400 + 1799);
+
+    /* Handed off every hour, written by the writer side only */
+    struct stat st;
+    assert_non_null(occ.pending);
+    assert_int_equal(stat(occ_file, &st), 0);
+    assert_int_equal(st.st_size, sizeof(OCC_HEADER));
+    assert_true(OccupancyWrite(&occ));
+    assert_null(occ.pending);
+    assert_int_equal(stat(occ_file, &st), 0);
+    assert_true(st.st_size > (off_t)sizeof(OCC_HEADER));
+    OccupancyClose(&occ);
+
+    assert_true(OccupancyQuery(occ_file, 0, day, day + 2 * 86400, &stats, &n_stats));
+    assert_int_equal(n_stats, 2);
+    assert_int_equal(stats[0].freq, 145500000);
+    assert_int_equal(stats[0].observed, 2 * 1440);
+    assert_int_equal(stats[0].busy, 60);
+    assert_int_equal(stats[1].busy, 0);
+    free(stats);
+
+    /* Window of one hour around midnight, on one channel */
+    assert_true(OccupancyQuery(occ_file, 145500000, day + 86400 - 3600, day + 86400, &stats, &n_stats));
+    assert_int_equal(n_stats, 1);
+    assert_int_equal(stats[0].observed, 60);
+    assert_int_equal(stats[0].busy, 30);
+    free(stats);
+
+    unlink(occ_file);
 }
 
 /* ========================================================================
@@ -504,11 +1970,11 @@ int main(void)
         cmocka_unit_test(test_frequency_tags_parsing),
         cmocka_unit_test(test_frequency_field_parsing),
         
-        /* Utility function tests - print_freq */
-        cmocka_unit_test(test_print_freq_ghz_range),
-        cmocka_unit_test(test_print_freq_mhz_range),
-        cmocka_unit_test(test_print_freq_khz_range),
-        cmocka_unit_test(test_print_freq_rounding),
+        /* Utility function tests - FormatFreq */
+        cmocka_unit_test(test_format_freq_ghz_range),
+        cmocka_unit_test(test_format_freq_mhz_range),
+        cmocka_unit_test(test_format_freq_khz_range),
+        cmocka_unit_test(test_format_freq_rounding),
         
         /* Utility function tests - ParseTags */
         cmocka_unit_test(test_parse_tags_single),
@@ -522,6 +1988,41 @@ int main(void)
         cmocka_unit_test(test_ban_freq),
         cmocka_unit_test(test_is_banned_freq),
         cmocka_unit_test(test_clear_all_bans),
+        cmocka_unit_test(test_jump_bucket),
+        cmocka_unit_test(test_settle_model_fallback),
+        cmocka_unit_test(test_settle_model_learn_and_fit),
+        cmocka_unit_test(test_clock_ticker_schedule),
+        cmocka_unit_test(test_events_ring_drops_when_full),
+        cmocka_unit_test(test_input_headless_wait_and_wake),
+        cmocka_unit_test(test_control_commands),
+        cmocka_unit_test(test_metrics_format),
+        cmocka_unit_test(test_spectrum_scoring),
+        cmocka_unit_test(test_trace_record_replay),
+        cmocka_unit_test(test_monitor_level_pipelined),
+        cmocka_unit_test(test_settle_wait_and_calibrate),
+        cmocka_unit_test(test_bookmark_dwell_learned),
+        cmocka_unit_test(test_state_shadow),
+        cmocka_unit_test(test_survey_candidates),
+        cmocka_unit_test(test_waterfall_ring),
+        cmocka_unit_test(test_event_json_utf8_and_room),
+        cmocka_unit_test(test_publish_hit_event),
+        cmocka_unit_test(test_hooks_run_and_timeout),
+        cmocka_unit_test(test_hooks_concurrent_stdin),
+        cmocka_unit_test(test_audio_activity),
+        cmocka_unit_test(test_tone_decoder),
+        cmocka_unit_test(test_capture_preroll),
+        cmocka_unit_test(test_profile_chrome_trace),
+
+        /* Bookmark cache tests */
+        cmocka_unit_test(test_cache_compile_and_load),
+        cmocka_unit_test(test_cache_stale_source),
+        cmocka_unit_test(test_scanner_contexts_concurrent),
+        cmocka_unit_test(test_cfar_thresholds),
+
+        /* Hit log tests */
+        cmocka_unit_test(test_hitlog_report),
+        cmocka_unit_test(test_hitlog_short_write),
+        cmocka_unit_test(test_occupancy_duty_cycle),
     };
     
     return cmocka_run_group_tests(tests, NULL, NULL);
@@ -0,0 +1,374 @@
+/*
+MIT License
+
+Copyright (c) 2025 neural75
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../gqrx-scanner.h"
+
+//
+// Microbenchmarks
+// Cost of the bookmark, ban and saved table helpers of the scanner core as the
+// inputs grow, on synthetic data from fixed seeds. Each case reports ns and
+// heap allocations per operation, as a table or as JSON lines (-j) that can
+// be compared between commits.
+//
+// Usage: bench [-j] [name filter]
+//
+
+extern time_t GetTime(char *timestamp);
+
+#define MIN_TIME    100000000   // ns, each measure runs at least this long
+#define RUNS        5           // the best run is reported
+
+//
+// Allocation counter: malloc, calloc and realloc are interposed (glibc only)
+//
+static uint64_t allocations;
+static bool     counting = false;
+
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+void *malloc (size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_malloc(size);
+}
+
+void *calloc (size_t n, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_calloc(n, size);
+}
+
+void *realloc (void *ptr, size_t size)
+{
+    if (counting)
+        allocations++;
+    return __libc_realloc(ptr, size);
+}
+#define ALLOCATIONS_COUNTED true
+#else
+#define ALLOCATIONS_COUNTED false
+#endif
+
+static uint64_t rng = 0x9e3779b97f4a7c15ULL;
+
+static uint64_t Random (void)
+{
+    rng ^= rng >> 12;
+    rng ^= rng << 25;
+    rng ^= rng >> 27;
+    return rng * 0x2545f4914f6cdd1dULL;
+}
+
+static void Seed (uint64_t seed)
+{
+    rng = seed * 0x9e3779b97f4a7c15ULL + 1;
+}
+
+// a frequency on the 12.5 KHz raster between 100 MHz and 1 GHz
+static freq_t RandomFreq (void)
+{
+    return 100000000ULL + (Random() % 72000) * 12500;
+}
+
+static uint64_t Now (void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+//
+// Generators
+//
+static const char *tag_names[] = { "DMR", "VHF", "UHF", "Repeater", "Marine", "Air", "PMR", "Radio Links" };
+#define TAG_NAMES ((int)(sizeof(tag_names) / sizeof(tag_names[0])))
+
+static FILE *GenerateBookmarks (int n)
+{
+    FILE *fd = tmpfile();
+    if (fd == NULL)
+        return NULL;
+    Seed(n);
+    fprintf(fd, "# Tag name          ; Color\n");
+    for (int t = 0; t < TAG_NAMES; t++)
+        fprintf(fd, "%-20s; #c0c0c0\n", tag_names[t]);
+    fprintf(fd, "\n# Frequency ; Name                     ; Modulation          ; Bandwidth ; Tags\n");
+    for (int i = 0; i < n; i++)
+    {
+        int first = Random() % TAG_NAMES, count = 1 + Random() % 3;
+        fprintf(fd, "%llu   ; Bookmark %-16d ; Narrow FM           ; 12500     ; ", RandomFreq(), i);
+        for (int t = 0; t < count; t++)
+            fprintf(fd, "%s%s", (t) ? ", " : "", tag_names[(first + t) % TAG_NAMES]);
+        fprintf(fd, "\n");
+    }
+    return fd;
+}
+
+static SCANNER scanner;  // context of the measured helpers
+
+static void GenerateBans (int n)
+{
+    Seed(n + 1);
+    for (int i = 0; i < n; i++)
+        scanner.banned[i].freq = RandomFreq();
+    scanner.banned_max = n;
+}
+
+static void GenerateSaved (int n)
+{
+    Seed(n + 2);
+    for (int i = 0; i < n; i++)
+    {
+        scanner.saved[i].freq  = RandomFreq();
+        scanner.saved[i].count = 1;
+        scanner.saved[i].miss  = 0;
+    }
+    scanner.saved_max = n;
+}
+
+//
+// Cases: setup once for a size, then run 'iterations' operations
+//
+typedef struct {
+    const char *name;
+    int         sizes[4];
+    void      (*setup)(int n);
+    void      (*run)(int n, uint64_t iterations);
+    void      (*teardown)(void);
+} BENCH_CASE;
+
+static FILE   *bookmarks;
+static freq_t  queries[1024];
+static volatile uint64_t sink;
+
+static void SetupLoad (int n)
+{
+    bookmarks = GenerateBookmarks(n);
+}
+
+static void RunLoad (int n, uint64_t iterations)
+{
+    (void)n;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        rewind(bookmarks);
+        counting = true;
+        LoadFrequencies(&scanner, bookmarks);
+        counting = false;
+        ScannerClearFrequencies(&scanner);
+    }
+}
+
+static void TeardownLoad (void)
+{
+    fclose(bookmarks);
+}
+
+static void SetupFilter (int n)
+{
+    static char tags[] = "dmr|marine|links";
+    FILE *fd = GenerateBookmarks(n);
+    rewind(fd);
+    LoadFrequencies(&scanner, fd);
+    fclose(fd);
+    ParseTags(&scanner, tags);
+    scanner.tag_search = true;
+}
+
+static void RunFilter (int n, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += FilterFrequency(&scanner, i % n);
+}
+
+static void TeardownFilter (void)
+{
+    ClearTags(&scanner);
+    ScannerClearFrequencies(&scanner);
+}
+
+static void SetupBanned (int n)
+{
+    GenerateBans(n);
+    for (int i = 0; i < 1024; i++)
+        queries[i] = RandomFreq();
+}
+
+static void RunBanned (int n, uint64_t iterations)
+{
+    (void)n;
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        freq_t freq = queries[i % 1024];
+        sink += IsBannedFreq(&scanner, &freq);
+    }
+}
+
+static void SetupSaved (int n)
+{
+    GenerateSaved(n);
+    // half of the hits are near a saved frequency
+    for (int i = 0; i < 1024; i++)
+        queries[i] = (i % 2) ? scanner.saved[Random() % n].freq + 1000 : RandomFreq();
+}
+
+static void RunSaved (int n, uint64_t iterations)
+{
+    for (uint64_t i = 0; i < iterations; i++)
+    {
+        SaveFreq(&scanner, queries[i % 1024]);
+        if (scanner.saved_max != n)
+            scanner.saved_max = n; // keep the size of the table
+    }
+}
+
+static void SetupPrint (int n)
+{
+    (void)n;
+    Seed(3);
+    for (int i = 0; i < 1024; i++)
+        queries[i] = (i % 3 == 0) ? Random() % 1000000 : RandomFreq() * ((i % 3 == 1) ? 1 : 5);
+}
+
+static void RunPrint (int n, uint64_t iterations)
+{
+    char str[FREQ_STRING_SIZE];
+    (void)n;
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += FormatFreq(queries[i % 1024], str, sizeof(str))[0];
+}
+
+static void RunTime (int n, uint64_t iterations)
+{
+    char timestamp[64];
+    (void)n;
+    for (uint64_t i = 0; i < iterations; i++)
+        sink += GetTime(timestamp);
+}
+
+static void Nothing (int n)
+{
+    (void)n;
+}
+
+static void NothingToFree (void)
+{
+}
+
+static const BENCH_CASE cases[] = {
+    { "load_frequencies", { 100, 1000, 4000 },     SetupLoad,   RunLoad,   TeardownLoad },
+    { "filter_frequency", { 100, 1000, 4000 },     SetupFilter, RunFilter, TeardownFilter },
+    { "is_banned_freq",   { 10, 100, 1000 },       SetupBanned, RunBanned, NothingToFree },
+    { "save_freq",        { 10, 100, 999 },        SetupSaved,  RunSaved,  NothingToFree },
+    { "format_freq",      { 1 },                   SetupPrint,  RunPrint,  NothingToFree },
+    { "get_time",         { 1 },                   Nothing,     RunTime,   NothingToFree },
+};
+
+//
+// Measure
+// Double the iterations until a run lasts MIN_TIME, then keep the best of RUNS
+//
+static void Measure (const BENCH_CASE *c, int n, bool json)
+{
+    uint64_t iterations = 1, elapsed = 0, best = UINT64_MAX, allocs = 0;
+
+    c->setup(n);
+    while (true)
+    {
+        uint64_t start = Now();
+        c->run(n, iterations);
+        elapsed = Now() - start;
+        if (elapsed >= MIN_TIME / RUNS)
+            break;
+        iterations *= 2;
+    }
+    for (int r = 0; r < RUNS; r++)
+    {
+        allocations = 0;
+        counting = (c->run != RunLoad); // the load counts itself, not the cleanup
+        uint64_t start = Now();
+        c->run(n, iterations);
+        elapsed = Now() - start;
+        counting = false;
+        allocs = allocations;
+        if (elapsed < best)
+            best = elapsed;
+    }
+    c->teardown();
+
+    double ns = (double)best / iterations;
+    double allocs_per_op = (double)allocs / iterations;
+    if (json)
+        printf("{\"bench\":\"%s\",\"n\":%d,\"iterations\":%llu,\"ns_per_op\":%.2f,\"allocs_per_op\":%.2f}\n",
+               c->name, n, (unsigned long long)iterations, ns, (ALLOCATIONS_COUNTED) ? allocs_per_op : -1.0);
+    else if (ALLOCATIONS_COUNTED)
+        printf("%-18s %6d %12llu %14.1f %12.2f\n", c->name, n, (unsigned long long)iterations, ns, allocs_per_op);
+    else
+        printf("%-18s %6d %12llu %14.1f %12s\n", c->name, n, (unsigned long long)iterations, ns, "-");
+}
+
+int main (int argc, char **argv)
+{
+    bool json = false;
+    const char *filter = NULL;
+    int c;
+
+    while ((c = getopt(argc, argv, "j")) != -1)
+    {
+        if (c != 'j')
+        {
+            printf ("Usage: %s [-j] [name filter]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+        json = true;
+    }
+    if (optind < argc)
+        filter = argv[optind];
+
+    ScannerInit(&scanner);
+    scanner.freqs = calloc(FREQ_MAX, sizeof(FREQ));
+    if (!json)
+        printf("%-18s %6s %12s %14s %12s\n", "bench", "n", "iterations", "ns/op", "allocs/op");
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+    {
+        if (filter != NULL && strstr(cases[i].name, filter) == NULL)
+            continue;
+        for (int s = 0; s < 4 && cases[i].sizes[s] != 0; s++)
+            Measure(&cases[i], cases[i].sizes[s], json);
+    }
+    ScannerFree(&scanner);
+    return 0;
+}